@@ -35,6 +35,14 @@ AML_MP_CAS_SRC := \
 	cas/AmlCasBase.cpp \
 	cas/AmlDvbCasHal.cpp \
 	cas/AmCasLibWrapper.cpp \
+	cas/AmlCasEcmPipeline.cpp \
+	cas/AmlCasSessionPool.cpp \
+	cas/AmlCasEcmPrefetcher.cpp \
+	cas/AmlCasMetrics.cpp \
+	cas/AmlCasEmmProcessor.cpp \
+	cas/soft_cas/AmlAes128.cpp \
+	cas/soft_cas/AmlDvbCsa.cpp \
+	cas/soft_cas/AmlSoftCas.cpp \
 
 AML_MP_CAS_SYSTEM_SRC_29 += \
 	cas/vmx_iptvcas/AmlVMXIptvCas.cpp
@@ -62,22 +70,36 @@ endif
 AML_MP_DVR_SRC := \
 	dvr/Aml_MP_DVR.cpp \
 	dvr/AmlDVRPlayer.cpp \
-	dvr/AmlDVRRecorder.cpp
+	dvr/AmlDVRRecorder.cpp \
+	dvr/AmlDVRRecorderGroup.cpp \
+	dvr/AmlDVRSegmentCache.cpp \
+	dvr/AmlDVRTsIndex.cpp \
+	dvr/AmlDVRTrickPlay.cpp \
+	dvr/AmlDVRTimeshiftRing.cpp \
+	dvr/AmlDVRCryptoPipeline.cpp \
+	dvr/AmlDVRReadahead.cpp \
+	dvr/AmlDVRSegmentReclaimer.cpp \
+	dvr/AmlDVRSegmentStorage.cpp
 
 AML_MP_DEMUX_SRC := \
 	demux/AmlDemuxBase.cpp \
 	demux/AmlHwDemux.cpp \
 	demux/AmlSwDemux.cpp \
-	demux/AmlTsParser.cpp
+	demux/AmlTsParser.cpp \
+	demux/AmlEmmFilter.cpp
 
 AML_MP_UTILS_SRC := \
 	utils/AmlMpAtomizer.cpp \
 	utils/AmlMpBitReader.cpp \
 	utils/AmlMpBuffer.cpp \
+	utils/AmlMpBufferChain.cpp \
 	utils/AmlMpConfig.cpp \
 	utils/AmlMpEventHandler.cpp \
 	utils/AmlMpEventLooper.cpp \
 	utils/AmlMpEventLooperRoster.cpp \
+	utils/AmlMpExecutor.cpp \
+	utils/AmlMpArena.cpp \
+	utils/AmlMpMemoryTracker.cpp \
 	utils/AmlMpLooper.cpp \
 	utils/AmlMpMessage.cpp \
 	utils/AmlMpRefBase.cpp \
@@ -11,6 +11,7 @@
 #include "cas/AmCasLibWrapper.h"
 #include <dlfcn.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpConfig.h>
 #include <utils/Log.h>
 
 namespace aml_mp
@@ -30,7 +31,8 @@ AmCasLibWrapper<ServiceType>::AmCasLibWrapper(const char *libName)
 {
     snprintf(mName, sizeof(mName), "%s", LOG_TAG);
     std::call_once(sLoadCasLibFlag, [libName] {
-        loadLib(libName);
+        const std::string& casLib = AmlMpConfig::instance().mCasLib;
+        loadLib(casLib.empty() ? libName : casLib.c_str());
     });
     if (!sCasSymbols.createAmCas) {
         return;
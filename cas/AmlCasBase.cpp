@@ -16,7 +16,11 @@
 #include "vmx_iptvcas/AmlVMXIptvCas.h"
 #include "vmx_iptvcas/AmlVMXIptvCas_V2.h"
 #include "vmx_webcas/AmlVMXWebCas.h"
+#include "soft_cas/AmlSoftCas.h"
 #include <utils/AmlMpUtils.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
 
 static const char* mName = LOG_TAG;
 
@@ -70,6 +74,13 @@ sptr<AmlCasBase> AmlCasBase::create(Aml_MP_CASServiceType serviceType)
     }
     break;
 
+    case AML_MP_CAS_SERVICE_SOFT:
+    {
+        MLOGI("%s, software descrambler", __func__);
+        cas = new AmlSoftCas(serviceType);
+    }
+    break;
+
     default:
         MLOGE("unsupported ca type!");
         break;
@@ -80,13 +91,17 @@ sptr<AmlCasBase> AmlCasBase::create(Aml_MP_CASServiceType serviceType)
 
 AmlCasBase::AmlCasBase(Aml_MP_CASServiceType serviceType)
 :mServiceType(serviceType)
+, mMetrics(serviceType)
 {
     memset(&mIptvCasParam, 0, sizeof(mIptvCasParam));
+
+    mEmmFilter = std::make_shared<AmlEmmFilter>();
+    mMetrics.setEmmFilter(mEmmFilter);
 }
 
 AmlCasBase::~AmlCasBase()
 {
-    MLOG();
+    MLOG("ECMs passed:%" PRIu64 ", suppressed:%" PRIu64, mEcmsPassed, mEcmsSuppressed);
 }
 
 int AmlCasBase::registerEventCallback(Aml_MP_CAS_EventCallback cb, void* userData)
@@ -112,6 +127,23 @@ int AmlCasBase::startDescrambling(const Aml_MP_IptvCASParams* params)
     return 0;
 }
 
+int AmlCasBase::prepareSession(const Aml_MP_IptvCASParams* params)
+{
+    AML_MP_UNUSED(params);
+
+    return -1;
+}
+
+int AmlCasBase::suspendDescrambling()
+{
+    return 0;
+}
+
+bool AmlCasBase::isSessionOpen() const
+{
+    return false;
+}
+
 int AmlCasBase::setPrivateData(const uint8_t* data, size_t size)
 {
     AML_MP_UNUSED(data);
@@ -130,6 +162,85 @@ int AmlCasBase::processEcm(bool isSection, int ecmPid, const uint8_t* data, size
     return 0;
 }
 
+int AmlCasBase::ecmKey(bool isSection, int ecmPid, const uint8_t* data, size_t size, uint64_t* hash)
+{
+    size_t offset = 0;
+    if (!isSection) {
+        // the TS header carries the continuity counter.
+        ecmPid = (data[1] << 8 | data[2]) & 0x1FFF;
+        offset = 4;
+        if (data[3] & 0x20) {
+            offset += 1 + data[4];
+        }
+    }
+
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = offset; i < size; ++i) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+
+    *hash = h;
+    return ecmPid;
+}
+
+bool AmlCasBase::isRepeatedEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size)
+{
+    // TS buffers of more than one packet are scanned for ECMs by the CAS.
+    if (data == nullptr || size == 0 || (!isSection && size != TS_PACKET_SIZE)) {
+        return false;
+    }
+
+    uint64_t hash;
+    int pid = ecmKey(isSection, ecmPid, data, size, &hash);
+
+    std::lock_guard<std::mutex> _l(mEcmHistoryLock);
+    EcmHistory& history = mEcmHistory[pid];
+    for (size_t i = 0; i < history.count; ++i) {
+        if (history.hashes[i] == hash) {
+            mEcmsSuppressed++;
+            mMetrics.onRepeatedEcm();
+            return true;
+        }
+    }
+
+    history.hashes[history.next] = hash;
+    history.next = (history.next + 1) % kEcmHistorySize;
+    history.count = std::min(history.count + 1, kEcmHistorySize);
+    mEcmsPassed++;
+
+    return false;
+}
+
+void AmlCasBase::forgetEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size)
+{
+    if (data == nullptr || size == 0 || (!isSection && size != TS_PACKET_SIZE)) {
+        return;
+    }
+
+    uint64_t hash;
+    int pid = ecmKey(isSection, ecmPid, data, size, &hash);
+
+    std::lock_guard<std::mutex> _l(mEcmHistoryLock);
+    auto it = mEcmHistory.find(pid);
+    if (it == mEcmHistory.end()) {
+        return;
+    }
+
+    for (size_t i = 0; i < it->second.count; ++i) {
+        if (it->second.hashes[i] == hash) {
+            // the next copy counts as new again.
+            it->second.hashes[i] = ~hash;
+        }
+    }
+}
+
+void AmlCasBase::resetEcmHistory()
+{
+    std::lock_guard<std::mutex> _l(mEcmHistoryLock);
+    mEcmHistory.clear();
+}
+
 int AmlCasBase::processEmm(const uint8_t* data, size_t size)
 {
     AML_MP_UNUSED(data);
@@ -148,6 +259,68 @@ int AmlCasBase::decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer* ou
     return 0;
 }
 
+int AmlCasBase::decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers)
+{
+    beginDecryptv(iov, iovcnt, outbuffers);
+
+    for (int i = 0; i < iovcnt; ++i) {
+        uint8_t* in = static_cast<uint8_t*>(iov[i].iov_base);
+        Aml_MP_Buffer outbuffer{};
+        int ret = decrypt(in, iov[i].iov_len, ext_data, &outbuffer);
+        if (ret != 0) {
+            return ret;
+        }
+
+        ret = putDecrypted(in, outbuffer.address, outbuffer.size, &outbuffers[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+void AmlCasBase::beginDecryptv(const struct iovec* iov, int iovcnt, const Aml_MP_Buffer* outbuffers)
+{
+    // results never exceed their chunk, and the pool is not moved while pointers into it are handed out.
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (outbuffers[i].address == nullptr) {
+            size += iov[i].iov_len;
+        }
+    }
+
+    if (mDecryptPool.size() < size) {
+        mDecryptPool.resize(size);
+    }
+    mDecryptPoolOffset = 0;
+}
+
+int AmlCasBase::putDecrypted(const uint8_t* in, const uint8_t* data, size_t size, Aml_MP_Buffer* outbuffer)
+{
+    if (outbuffer->address != nullptr) {
+        if (size > outbuffer->size) {
+            MLOGE("outbuffer too small, %zu < %zu", outbuffer->size, size);
+            return -1;
+        }
+        if (outbuffer->address != data) {
+            memmove(outbuffer->address, data, size);
+        }
+        outbuffer->size = size;
+    } else if (data == in) {
+        outbuffer->address = const_cast<uint8_t*>(data);
+        outbuffer->size = size;
+    } else {
+        RETURN_IF(-1, mDecryptPoolOffset + size > mDecryptPool.size());
+        outbuffer->address = mDecryptPool.data() + mDecryptPoolOffset;
+        outbuffer->size = size;
+        memcpy(outbuffer->address, data, size);
+        mDecryptPoolOffset += size;
+    }
+
+    return 0;
+}
+
 int AmlCasBase::updateDescramblingPid(int oldStreamPid, int newStreamPid)
 {
     AML_MP_UNUSED(oldStreamPid);
@@ -219,6 +392,46 @@ int AmlCasBase::ioctl(const char* inJson, char* outJson, uint32_t outLen)
     return 0;
 }
 
+int AmlCasBase::handleIoctl(const char* inJson, char* outJson, uint32_t outLen)
+{
+    std::string cmd;
+    if (inJson != nullptr && jsonString(inJson, "cmd", &cmd)) {
+        if (cmd == "getCasMetrics") {
+            return mMetrics.toJson(outJson, outLen);
+        } else if (cmd == "resetCasMetrics") {
+            mMetrics.reset();
+            return 0;
+        }
+    }
+
+    return ioctl(inJson, outJson, outLen);
+}
+
+bool AmlCasBase::jsonString(const char* json, const char* name, std::string* value)
+{
+    std::string key = std::string("\"") + name + "\"";
+    const char* p = strstr(json, key.c_str());
+    if (p == nullptr) {
+        return false;
+    }
+
+    p += key.size();
+    while (*p == ' ' || *p == ':') {
+        ++p;
+    }
+    if (*p != '"') {
+        return false;
+    }
+
+    const char* end = strchr(++p, '"');
+    if (end == nullptr) {
+        return false;
+    }
+    value->assign(p, end - p);
+
+    return true;
+}
+
 int AmlCasBase::getStoreRegion(Aml_MP_CASStoreRegion* region, uint8_t* regionCount)
 {
     AML_MP_UNUSED(region);
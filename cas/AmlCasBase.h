@@ -14,6 +14,11 @@
 #include <Aml_MP/Cas.h>
 #include <utils/AmlMpHandle.h>
 #include <utils/AmlMpUtils.h>
+#include "AmlCasMetrics.h"
+#include <demux/AmlEmmFilter.h>
+#include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace aml_mp {
@@ -44,10 +49,19 @@ public:
     virtual int startDescrambling(Aml_MP_CASServiceInfo* params);
     virtual int startDescrambling(const Aml_MP_IptvCASParams* params);
     virtual int stopDescrambling() = 0;
+    // AmlCasSessionPool keeps IPTV sessions open across services.
+    // prepareSession() provisions and opens one ahead of startDescrambling(),
+    // which then only binds it to the service. suspendDescrambling() unbinds
+    // an open session, stopDescrambling() closes it.
+    virtual int prepareSession(const Aml_MP_IptvCASParams* params);
+    virtual int suspendDescrambling();
+    virtual bool isSessionOpen() const;
     virtual int setPrivateData(const uint8_t* data, size_t size);
     virtual int processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size);
     virtual int processEmm(const uint8_t* data, size_t size);
     virtual int decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer* outbuffer);
+    // decrypt iovcnt chunks in one call, outbuffers as in Aml_MP_CAS_DecryptIPTVv().
+    virtual int decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers);
 
     virtual int updateDescramblingPid(int oldStreamPid, int newStreamPid);
     virtual int startDVRRecord(Aml_MP_CASServiceInfo* serviceInfo);
@@ -63,21 +77,74 @@ public:
     virtual int destroySecmem(AML_MP_SECMEM secMem);
 
     virtual int ioctl(const char* inJson, char* outJson, uint32_t outLen);
+    // answers the metrics commands, passes the others to ioctl().
+    int handleIoctl(const char* inJson, char* outJson, uint32_t outLen);
     virtual int getStoreRegion(Aml_MP_CASStoreRegion* region, uint8_t* regionCount);
 
     Aml_MP_CASServiceType serviceType() const {
         return mServiceType;
     }
 
+    const Aml_MP_IptvCASParams& iptvCasParams() const {
+        return mIptvCasParam;
+    }
+
     int getEcmPids(std::vector<int>& ecmPids);
 
+    AmlCasMetrics& metrics() {
+        return mMetrics;
+    }
+
+    // EMMs the player passes to processEmm(), see Aml_MP_CAS_SetEmmFilters().
+    const std::shared_ptr<AmlEmmFilter>& emmFilter() const {
+        return mEmmFilter;
+    }
+
+    // the string value of name in a flat JSON object.
+    static bool jsonString(const char* json, const char* name, std::string* value);
+
+    // ECMs repeat every few hundred ms but change once per crypto period.
+    // true if the section or single TS packet ECM is among the last ones of
+    // its PID, TS header ignored, so the callers of processEcm() skip it.
+    // forgetEcm() lets the next copy of an ECM the CAS failed through again.
+    bool isRepeatedEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size);
+    void forgetEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size);
+    void resetEcmHistory();
+
 protected:
     AmlCasBase(Aml_MP_CASServiceType serviceType);
 
+    // a decryptv() call first reserves room for the results that go to
+    // outbuffers without an address, then hands over each result.
+    void beginDecryptv(const struct iovec* iov, int iovcnt, const Aml_MP_Buffer* outbuffers);
+    int putDecrypted(const uint8_t* in, const uint8_t* data, size_t size, Aml_MP_Buffer* outbuffer);
+
     Aml_MP_CASServiceType mServiceType;
     Aml_MP_IptvCASParams mIptvCasParam;
 
 private:
+    // odd and even ECMs alternate, keep a few of them.
+    static constexpr size_t kEcmHistorySize = 4;
+
+    struct EcmHistory {
+        uint64_t hashes[kEcmHistorySize];
+        size_t count = 0;
+        size_t next = 0;
+    };
+
+    static int ecmKey(bool isSection, int ecmPid, const uint8_t* data, size_t size, uint64_t* hash);
+
+    std::mutex mEcmHistoryLock;
+    std::map<int, EcmHistory> mEcmHistory;
+    uint64_t mEcmsPassed = 0;
+    uint64_t mEcmsSuppressed = 0;
+
+    std::vector<uint8_t> mDecryptPool;
+    size_t mDecryptPoolOffset = 0;
+
+    std::shared_ptr<AmlEmmFilter> mEmmFilter;
+    AmlCasMetrics mMetrics;
+
     AmlCasBase(const AmlCasBase&) = delete;
     AmlCasBase& operator= (const AmlCasBase&) = delete;
 };
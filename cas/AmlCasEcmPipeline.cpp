@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlCasEcmPipeline"
+#include <utils/AmlMpLog.h>
+#include "AmlCasEcmPipeline.h"
+#include "AmlCasBase.h"
+#include <utils/AmlMpEventLooper.h>
+#include <inttypes.h>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const size_t kTsHeaderSize = 4;
+static const int64_t kSlowEcmUs = 100 * 1000;
+
+AmlCasEcmPipeline::AmlCasEcmPipeline(const sptr<AmlCasBase>& cas, const DrainedCallback& drainedCb)
+: mCas(cas)
+, mDrainedCb(drainedCb)
+{
+    mThread = std::thread([this] { threadLoop(); });
+}
+
+AmlCasEcmPipeline::~AmlCasEcmPipeline()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+}
+
+bool AmlCasEcmPipeline::queue(const uint8_t* packet, size_t size)
+{
+    if (size < kTsHeaderSize || mCas->isRepeatedEcm(false, 0, packet, size)) {
+        return false;
+    }
+
+    int pid = (packet[1] << 8 | packet[2]) & 0x1FFF;
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mQueue.push_back({pid, std::vector<uint8_t>(packet, packet + size)});
+    mPending++;
+    mCond.notify_one();
+
+    return true;
+}
+
+void AmlCasEcmPipeline::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    for (;;) {
+        mCond.wait(_l, [this] { return mExiting || !mQueue.empty(); });
+        if (mExiting) {
+            break;
+        }
+
+        Ecm ecm = std::move(mQueue.front());
+        mQueue.pop_front();
+        _l.unlock();
+
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        int ret = mCas->processEcm(false, 0, ecm.packet.data(), ecm.packet.size());
+        int64_t elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+        mCas->metrics().record(AML_MP_CAS_OP_PROCESS_ECM, startUs, ret, ecm.packet.size());
+        if (ret < 0) {
+            MLOGW("ECM of pid %#x failed, ret:%d", ecm.pid, ret);
+            mCas->forgetEcm(false, 0, ecm.packet.data(), ecm.packet.size());
+        } else if (elapsedUs > kSlowEcmUs) {
+            MLOGI("ECM of pid %#x took %" PRId64 " ms", ecm.pid, elapsedUs / 1000);
+        }
+
+        _l.lock();
+        if (--mPending == 0 && mDrainedCb) {
+            _l.unlock();
+            mDrainedCb();
+            _l.lock();
+        }
+    }
+
+    // unprocessed ECMs no longer hold anything back, and are new to the next writer.
+    for (const Ecm& ecm : mQueue) {
+        mCas->forgetEcm(false, 0, ecm.packet.data(), ecm.packet.size());
+    }
+    mQueue.clear();
+    mPending = 0;
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_CAS_ECM_PIPELINE_H_
+#define _AML_CAS_ECM_PIPELINE_H_
+
+#include <utils/AmlMpRefBase.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aml_mp {
+class AmlCasBase;
+
+/*
+ * Hands ECM packets found in the written TS to the CAS on a thread of its own.
+ *
+ * A VMX or Widevine ECM round trip takes up to hundreds of ms. queue() returns
+ * at once and tells whether the ECM is new to the CAS ECM history, i.e.
+ * announces a new crypto period. The writer then holds back the data after it
+ * until pending() drops to 0, data before it and behind repeated ECMs flows on.
+ * Repeats are dropped, an ECM the CAS failed is forgotten by the history so
+ * its next copy is queued again.
+ *
+ * drainedCb is called on the pipeline thread each time pending() drops to 0,
+ * so the held data goes without waiting for the next write. It must not wait
+ * for the writer, which may be destroying the pipeline.
+ */
+class AmlCasEcmPipeline
+{
+public:
+    typedef std::function<void()> DrainedCallback;
+
+    AmlCasEcmPipeline(const sptr<AmlCasBase>& cas, const DrainedCallback& drainedCb = nullptr);
+    ~AmlCasEcmPipeline();
+
+    const sptr<AmlCasBase>& cas() const {
+        return mCas;
+    }
+
+    bool queue(const uint8_t* packet, size_t size);
+    // new crypto period ECMs not processed yet.
+    int pending() const {
+        return mPending;
+    }
+
+private:
+    struct Ecm {
+        int pid;
+        std::vector<uint8_t> packet;
+    };
+
+    void threadLoop();
+
+    const sptr<AmlCasBase> mCas;
+    const DrainedCallback mDrainedCb;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mExiting = false;
+    std::deque<Ecm> mQueue;
+    std::atomic<int> mPending{0};
+    std::thread mThread;
+
+    AmlCasEcmPipeline(const AmlCasEcmPipeline&) = delete;
+    AmlCasEcmPipeline& operator= (const AmlCasEcmPipeline&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlCasEcmPrefetcher"
+#include <utils/AmlMpLog.h>
+#include "AmlCasEcmPrefetcher.h"
+#include "AmlCasEmmProcessor.h"
+#include "AmlCasSessionPool.h"
+#include <utils/AmlMpConfig.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// PMTs of the multiplex arrive in the first seconds, then only change rarely.
+static const int64_t kRefreshMs = 5000;
+
+static bool isValidPid(int pid)
+{
+    return pid > 0 && pid < AML_MP_INVALID_PID;
+}
+
+AmlCasEcmPrefetcher::AmlCasEcmPrefetcher(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams& params, bool isHardwareSource,
+                                         AmlCasEmmProcessor* emmProcessor)
+: mServiceType(serviceType)
+, mParams(params)
+, mServiceCount(std::max(AmlMpConfig::instance().mEcmPrefetch, 0))
+{
+    mParser = new Parser(params.demuxId, isHardwareSource, true);
+    mParser->setProgram(params.videoPid, params.audioPid);
+    if (emmProcessor != nullptr) {
+        mParser->setEmmFilter(emmProcessor->emmFilter());
+    }
+    mParser->setEventCallback([this, emmProcessor] (Parser::ProgramEventType event, int param1, int param2, void* data) {
+        if (event == Parser::ProgramEventType::EVENT_ECM_DATA_PARSED) {
+            onEcm(param1, (const uint8_t*)data, param2);
+        } else if (event == Parser::ProgramEventType::EVENT_EMM_DATA_PARSED) {
+            emmProcessor->onEmm(param1, (const uint8_t*)data, param2);
+        } else if (event == Parser::ProgramEventType::EVENT_PROGRAM_PARSED) {
+            std::lock_guard<std::mutex> _l(mLock);
+            mChanged = true;
+            mCond.notify_all();
+        }
+    });
+
+    if (mParser->open() < 0) {
+        MLOGE("open parser failed!");
+        mParser.clear();
+        return;
+    }
+
+    mThread = std::thread([this] { threadLoop(); });
+}
+
+AmlCasEcmPrefetcher::~AmlCasEcmPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+    }
+    mCond.notify_all();
+
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mParser != nullptr) {
+        mParser->close();
+        mParser.clear();
+    }
+}
+
+int AmlCasEcmPrefetcher::writeData(const uint8_t* buffer, size_t size)
+{
+    if (mParser == nullptr) {
+        return -1;
+    }
+
+    return mParser->writeData(buffer, size);
+}
+
+void AmlCasEcmPrefetcher::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    while (!mExiting) {
+        mCond.wait_for(_l, std::chrono::milliseconds(kRefreshMs), [this] { return mExiting || mChanged; });
+        if (mExiting) {
+            break;
+        }
+        mChanged = false;
+
+        _l.unlock();
+        refresh();
+        _l.lock();
+    }
+}
+
+void AmlCasEcmPrefetcher::refresh()
+{
+    std::vector<sptr<ProgramInfo>> programs = mParser->getPrograms();
+    auto current = std::find_if(programs.begin(), programs.end(), [this](const sptr<ProgramInfo>& program) {
+        return (isValidPid(mParams.videoPid) && program->videoPid == mParams.videoPid) ||
+               (isValidPid(mParams.audioPid) && program->audioPid == mParams.audioPid);
+    });
+    if (current == programs.end()) {
+        return;
+    }
+
+    // next and previous services first, channel up and down are the likely zaps.
+    std::map<int, std::vector<Aml_MP_IptvCASParams>> services;
+    std::vector<Aml_MP_IptvCASParams> neighbours;
+    int index = current - programs.begin();
+    int count = programs.size();
+    for (int step = 1; step < count && neighbours.size() < mServiceCount; ++step) {
+        for (int i : {index + step, index - step}) {
+            if (i < 0 || i >= count || neighbours.size() >= mServiceCount) {
+                continue;
+            }
+
+            const ProgramInfo& program = *programs[i];
+            int videoEcmPid = program.ecmPid[ECM_INDEX_VIDEO];
+            int audioEcmPid = program.ecmPid[ECM_INDEX_AUDIO];
+            if (!program.scrambled || (int)mParams.caSystemId != program.caSystemId ||
+                (!isValidPid(videoEcmPid) && !isValidPid(audioEcmPid))) {
+                continue;
+            }
+
+            Aml_MP_IptvCASParams params = mParams;
+            params.videoPid = program.videoPid;
+            params.audioPid = program.audioPid;
+            params.ecmPid[VIDEO_ECM_PID_INDEX] = videoEcmPid;
+            params.ecmPid[AUDIO_ECM_PID_INDEX] = audioEcmPid;
+            neighbours.push_back(params);
+
+            for (int ecmPid : {videoEcmPid, audioEcmPid}) {
+                if (isValidPid(ecmPid)) {
+                    std::vector<Aml_MP_IptvCASParams>& v = services[ecmPid];
+                    if (v.empty() || !(v.back().videoPid == params.videoPid && v.back().audioPid == params.audioPid)) {
+                        v.push_back(params);
+                    }
+                }
+            }
+        }
+    }
+
+    for (const Aml_MP_IptvCASParams& params : neighbours) {
+        AmlCasSessionPool::instance().prepare(mServiceType, &params, true);
+    }
+
+    // the parser filters the ECMs of the playing service itself.
+    std::set<int> filterPids;
+    for (auto& p : services) {
+        if (p.first != mParams.ecmPid[VIDEO_ECM_PID_INDEX] && p.first != mParams.ecmPid[AUDIO_ECM_PID_INDEX]) {
+            filterPids.insert(p.first);
+        }
+    }
+
+    for (int pid : mFilterPids) {
+        if (filterPids.count(pid) == 0) {
+            mParser->removeSectionFilter(pid);
+        }
+    }
+    for (int pid : filterPids) {
+        if (mFilterPids.count(pid) == 0) {
+            MLOGI("prefetch ECM pid %#x", pid);
+            mParser->addSectionFilter(pid, Parser::ecmCb, false);
+        }
+    }
+    mFilterPids = std::move(filterPids);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mServices = std::move(services);
+}
+
+void AmlCasEcmPrefetcher::onEcm(int ecmPid, const uint8_t* data, size_t size)
+{
+    std::vector<Aml_MP_IptvCASParams> services;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        auto it = mServices.find(ecmPid);
+        if (it == mServices.end()) {
+            return;
+        }
+        services = it->second;
+    }
+
+    for (const Aml_MP_IptvCASParams& params : services) {
+        AmlCasSessionPool::instance().processEcm(mServiceType, &params, ecmPid, data, size);
+    }
+}
+
+}
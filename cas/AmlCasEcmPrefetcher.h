@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_CAS_ECM_PREFETCHER_H_
+#define _AML_CAS_ECM_PREFETCHER_H_
+
+#include <Aml_MP/Common.h>
+#include <utils/AmlMpRefBase.h>
+#include <demux/AmlTsParser.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace aml_mp {
+class AmlCasEmmProcessor;
+
+/*
+ * Processes the ECMs of the services next to the playing one ahead of a zap.
+ *
+ * A parser of its own keeps the PMTs of the multiplex. The scrambled services
+ * with the same CA system next to the playing one by program number, up to
+ * AmlMpConfig::mEcmPrefetch of them, get a session of their own in the
+ * AmlCasSessionPool and section filters on their ECM PIDs. Their ECMs go to
+ * those sessions, so a zap to one of them acquires a session whose control
+ * words are current and does not wait for the next ECM.
+ *
+ * Given an emmProcessor, the parser also filters the EMMs for it, so the TS
+ * is not parsed twice. The emmProcessor must outlive the prefetcher.
+ */
+class AmlCasEcmPrefetcher
+{
+public:
+    AmlCasEcmPrefetcher(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams& params, bool isHardwareSource,
+                        AmlCasEmmProcessor* emmProcessor = nullptr);
+    ~AmlCasEcmPrefetcher();
+
+    // TS of a memory source, hardware sources feed the demux themselves.
+    int writeData(const uint8_t* buffer, size_t size);
+
+private:
+    void threadLoop();
+    void refresh();
+    void onEcm(int ecmPid, const uint8_t* data, size_t size);
+
+    const Aml_MP_CASServiceType mServiceType;
+    const Aml_MP_IptvCASParams mParams;
+    const size_t mServiceCount;
+    sptr<Parser> mParser;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mExiting = false;
+    bool mChanged = false;
+    // ECM pid -> services
+    std::map<int, std::vector<Aml_MP_IptvCASParams>> mServices;
+    std::thread mThread;
+
+    // only used on mThread
+    std::set<int> mFilterPids;
+
+    AmlCasEcmPrefetcher(const AmlCasEcmPrefetcher&) = delete;
+    AmlCasEcmPrefetcher& operator= (const AmlCasEcmPrefetcher&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlCasEmmProcessor"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpEventLooper.h>
+#include "AmlCasEmmProcessor.h"
+#include "AmlCasBase.h"
+#include <demux/AmlEmmFilter.h>
+#include <inttypes.h>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// EMMs come in bursts, the oldest ones go when the CAS falls behind.
+static const size_t kMaxQueuedEmms = 256;
+
+AmlCasEmmProcessor::AmlCasEmmProcessor(const sptr<AmlCasBase>& cas, Aml_MP_DemuxId demuxId, bool isHardwareSource, bool ownParser)
+: mCas(cas)
+{
+    mThread = std::thread([this] { threadLoop(); });
+
+    if (!ownParser) {
+        return;
+    }
+
+    mParser = new Parser(demuxId, isHardwareSource, true);
+    mParser->setEmmFilter(mCas->emmFilter());
+    mParser->setEventCallback([this] (Parser::ProgramEventType event, int param1, int param2, void* data) {
+        if (event == Parser::ProgramEventType::EVENT_EMM_DATA_PARSED) {
+            onEmm(param1, (const uint8_t*)data, param2);
+        }
+    });
+
+    if (mParser->open() < 0) {
+        MLOGE("open parser failed!");
+        mParser.clear();
+    }
+}
+
+AmlCasEmmProcessor::~AmlCasEmmProcessor()
+{
+    if (mParser != nullptr) {
+        mParser->close();
+        mParser.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+
+    AmlEmmFilter::Stats stats = mCas->emmFilter()->stats();
+    MLOGI("EMMs received:%" PRIu64 ", filtered:%" PRIu64 ", repeated:%" PRIu64,
+            stats.received, stats.filtered, stats.repeated);
+}
+
+const std::shared_ptr<AmlEmmFilter>& AmlCasEmmProcessor::emmFilter() const
+{
+    return mCas->emmFilter();
+}
+
+int AmlCasEmmProcessor::writeData(const uint8_t* buffer, size_t size)
+{
+    if (mParser == nullptr) {
+        return -1;
+    }
+
+    return mParser->writeData(buffer, size);
+}
+
+void AmlCasEmmProcessor::onEmm(int emmPid, const uint8_t* data, size_t size)
+{
+    MLOGV("EMM pid:%#x, size:%zu", emmPid, size);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mQueue.size() >= kMaxQueuedEmms) {
+        // its next copy passes the filter again.
+        mCas->emmFilter()->forget(mQueue.front().data(), mQueue.front().size());
+        mQueue.pop_front();
+    }
+    mQueue.emplace_back(data, data + size);
+    mCond.notify_one();
+}
+
+void AmlCasEmmProcessor::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    for (;;) {
+        mCond.wait(_l, [this] { return mExiting || !mQueue.empty(); });
+        if (mExiting) {
+            break;
+        }
+
+        std::vector<uint8_t> emm = std::move(mQueue.front());
+        mQueue.pop_front();
+        _l.unlock();
+
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        int ret = mCas->processEmm(emm.data(), emm.size());
+        mCas->metrics().record(AML_MP_CAS_OP_PROCESS_EMM, startUs, ret, emm.size());
+        if (ret < 0) {
+            mCas->emmFilter()->forget(emm.data(), emm.size());
+        }
+
+        _l.lock();
+    }
+
+    // unprocessed EMMs are new to the next session.
+    for (const std::vector<uint8_t>& emm : mQueue) {
+        mCas->emmFilter()->forget(emm.data(), emm.size());
+    }
+    mQueue.clear();
+}
+
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_CAS_EMM_PROCESSOR_H_
+#define _AML_CAS_EMM_PROCESSOR_H_
+
+#include <Aml_MP/Common.h>
+#include <utils/AmlMpRefBase.h>
+#include <demux/AmlTsParser.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aml_mp {
+class AmlCasBase;
+class AmlEmmFilter;
+
+/*
+ * Passes the EMMs of the multiplex to an IPTV CAS session.
+ *
+ * A parser finds the EMM PID in the CAT and runs its sections through the
+ * AmlEmmFilter of the session in the demux callback, so only EMMs for this
+ * smartcard that were not seen recently reach processEmm(). That is the
+ * parser of its own, or with ownParser false the one of the
+ * AmlCasEcmPrefetcher, which hands the EMMs to onEmm(). processEmm() runs
+ * on a thread of its own, as AmlCasEcmPipeline does for the ECMs, the
+ * demux callback only queues.
+ */
+class AmlCasEmmProcessor
+{
+public:
+    AmlCasEmmProcessor(const sptr<AmlCasBase>& cas, Aml_MP_DemuxId demuxId, bool isHardwareSource, bool ownParser = true);
+    ~AmlCasEmmProcessor();
+
+    const std::shared_ptr<AmlEmmFilter>& emmFilter() const;
+
+    // TS of a memory source, hardware sources feed the demux themselves.
+    int writeData(const uint8_t* buffer, size_t size);
+    // an EMM the filter passed, queued for processEmm().
+    void onEmm(int emmPid, const uint8_t* data, size_t size);
+
+private:
+    void threadLoop();
+
+    const sptr<AmlCasBase> mCas;
+    sptr<Parser> mParser;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mExiting = false;
+    std::deque<std::vector<uint8_t>> mQueue;
+    std::thread mThread;
+
+    AmlCasEmmProcessor(const AmlCasEmmProcessor&) = delete;
+    AmlCasEmmProcessor& operator= (const AmlCasEmmProcessor&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlCasMetrics"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include <utils/AmlMpEventLooper.h>
+#include "AmlCasMetrics.h"
+#include <demux/AmlEmmFilter.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// upper bounds of the histogram buckets, the last one takes the rest.
+static const int64_t kBucketBoundsUs[AML_MP_CAS_LATENCY_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+};
+
+static const char* const kOperationNames[AML_MP_CAS_OP_NB] = {
+    "processEcm",
+    "processEmm",
+    "decrypt",
+    "dvrEncrypt",
+    "dvrDecrypt",
+};
+
+AmlCasMetrics::AmlCasMetrics(Aml_MP_CASServiceType serviceType)
+: mServiceType(serviceType)
+{
+    reset();
+}
+
+void AmlCasMetrics::record(Aml_MP_CASOperation op, int64_t startUs, int ret, size_t bytes)
+{
+    if (op < 0 || op >= AML_MP_CAS_OP_NB) {
+        return;
+    }
+
+    int64_t nowUs = AmlMpEventLooper::GetNowUs();
+    int64_t latencyUs = std::max<int64_t>(nowUs - startUs, 0);
+    size_t bucket = std::upper_bound(kBucketBoundsUs, kBucketBoundsUs + AML_MP_CAS_LATENCY_BUCKETS - 1, latencyUs)
+                    - kBucketBoundsUs;
+
+    std::lock_guard<std::mutex> _l(mLock);
+    Aml_MP_CASOperationStats& stats = mStats.operations[op];
+    stats.calls++;
+    stats.bytes += bytes;
+    if (ret < 0) {
+        stats.failures++;
+    }
+    mBusyUs[op] += latencyUs;
+    stats.throughput = mBusyUs[op] > 0 ? std::min<uint64_t>(stats.bytes * 1000000 / mBusyUs[op], UINT32_MAX) : 0;
+    stats.avgLatencyUs = mBusyUs[op] / stats.calls;
+    stats.maxLatencyUs = std::max<int64_t>(stats.maxLatencyUs, std::min<int64_t>(latencyUs, UINT32_MAX));
+    stats.latencyHistogram[bucket]++;
+
+    if (!mZapping || ret < 0) {
+        return;
+    }
+
+    if (op == AML_MP_CAS_OP_PROCESS_ECM) {
+        mEcmSeen = true;
+    } else if ((op == AML_MP_CAS_OP_DECRYPT || op == AML_MP_CAS_OP_DVR_DECRYPT) && bytes > 0) {
+        // data before the ECM is in the clear.
+        if (mEcmSeen) {
+            onDescrambled_l(nowUs);
+        }
+    }
+}
+
+void AmlCasMetrics::startZap()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mStats.zaps++;
+    mZapping = true;
+    mEcmSeen = false;
+    mZapStartUs = AmlMpEventLooper::GetNowUs();
+}
+
+void AmlCasMetrics::onRepeatedEcm()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mZapping) {
+        mEcmSeen = true;
+    }
+}
+
+void AmlCasMetrics::onFirstFrame()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mZapping) {
+        onDescrambled_l(AmlMpEventLooper::GetNowUs());
+    }
+}
+
+void AmlCasMetrics::setEmmFilter(const std::shared_ptr<AmlEmmFilter>& emmFilter)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mEmmFilter = emmFilter;
+}
+
+void AmlCasMetrics::onDescrambled_l(int64_t nowUs)
+{
+    uint32_t zapUs = std::min<int64_t>(nowUs - mZapStartUs, UINT32_MAX);
+    mZapping = false;
+    mStats.descrambledZaps++;
+    mStats.lastZapUs = zapUs;
+    mZapTotalUs += zapUs;
+    mStats.avgZapUs = mZapTotalUs / mStats.descrambledZaps;
+    mStats.maxZapUs = std::max(mStats.maxZapUs, zapUs);
+
+    MLOGI("%s descrambled %u ms after the zap", mpCASServiceType2Str(mServiceType), zapUs / 1000);
+}
+
+void AmlCasMetrics::getStats(Aml_MP_CASStats* stats) const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    *stats = mStats;
+
+    if (mEmmFilter != nullptr) {
+        AmlEmmFilter::Stats emmStats = mEmmFilter->stats();
+        stats->emmsReceived = emmStats.received;
+        stats->emmsFiltered = emmStats.filtered;
+        stats->emmsRepeated = emmStats.repeated;
+    }
+}
+
+int AmlCasMetrics::toJson(char* outJson, uint32_t outLen) const
+{
+    RETURN_IF(-1, outJson == nullptr || outLen == 0);
+
+    Aml_MP_CASStats stats;
+    getStats(&stats);
+
+    char buf[256];
+    std::string json;
+    snprintf(buf, sizeof(buf), "{\"serviceType\":\"%s\",\"zaps\":%u,"
+            "\"zapUs\":{\"count\":%u,\"last\":%u,\"avg\":%u,\"max\":%u},\"histogramBoundsUs\":[",
+            mpCASServiceType2Str(mServiceType), stats.zaps, stats.descrambledZaps,
+            stats.lastZapUs, stats.avgZapUs, stats.maxZapUs);
+    json = buf;
+    for (size_t i = 0; i < AML_MP_CAS_LATENCY_BUCKETS - 1; ++i) {
+        snprintf(buf, sizeof(buf), "%s%" PRId64, i ? "," : "", kBucketBoundsUs[i]);
+        json += buf;
+    }
+    json += "]";
+
+    for (int op = 0; op < AML_MP_CAS_OP_NB; ++op) {
+        const Aml_MP_CASOperationStats& s = stats.operations[op];
+        snprintf(buf, sizeof(buf), ",\"%s\":{\"calls\":%" PRIu64 ",\"failures\":%" PRIu64 ",\"bytes\":%" PRIu64
+                ",\"throughput\":%u,\"avgUs\":%u,\"maxUs\":%u,\"histogram\":[",
+                kOperationNames[op], s.calls, s.failures, s.bytes, s.throughput, s.avgLatencyUs, s.maxLatencyUs);
+        json += buf;
+        for (size_t i = 0; i < AML_MP_CAS_LATENCY_BUCKETS; ++i) {
+            snprintf(buf, sizeof(buf), "%s%u", i ? "," : "", s.latencyHistogram[i]);
+            json += buf;
+        }
+        json += "]}";
+    }
+    snprintf(buf, sizeof(buf), ",\"emm\":{\"received\":%" PRIu64 ",\"filtered\":%" PRIu64 ",\"repeated\":%" PRIu64 "}}",
+            stats.emmsReceived, stats.emmsFiltered, stats.emmsRepeated);
+    json += buf;
+
+    if (json.size() >= outLen) {
+        MLOGE("outJson too small, %u < %zu", outLen, json.size() + 1);
+        return -1;
+    }
+    memcpy(outJson, json.c_str(), json.size() + 1);
+
+    return 0;
+}
+
+void AmlCasMetrics::reset()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    memset(&mStats, 0, sizeof(mStats));
+    mStats.serviceType = mServiceType;
+    memset(mBusyUs, 0, sizeof(mBusyUs));
+    mZapping = false;
+    mEcmSeen = false;
+    mZapStartUs = -1;
+    mZapTotalUs = 0;
+
+    if (mEmmFilter != nullptr) {
+        mEmmFilter->resetStats();
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_CAS_METRICS_H_
+#define _AML_CAS_METRICS_H_
+
+#include <Aml_MP/Cas.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace aml_mp {
+class AmlEmmFilter;
+
+/*
+ * Call counts and latencies of one CAS session.
+ *
+ * The callers of the CAS time each call and record it, whichever path the
+ * data took to the session. The zap time runs from startZap() to the first
+ * data decrypted once the service's ECM reached the session, or to the first
+ * frame the player shows when the descrambler is in hardware or the ECMs
+ * are handled by the CAS HAL.
+ */
+class AmlCasMetrics
+{
+public:
+    explicit AmlCasMetrics(Aml_MP_CASServiceType serviceType);
+    ~AmlCasMetrics() = default;
+
+    // startUs is AmlMpEventLooper::GetNowUs() before the call, bytes the data passed to it.
+    void record(Aml_MP_CASOperation op, int64_t startUs, int ret, size_t bytes = 0);
+    void startZap();
+    // an ECM the session already processed came again, e.g. after a
+    // prefetch, its keys are in place without another processEcm().
+    void onRepeatedEcm();
+    void onFirstFrame();
+    // its EMM counts are part of the stats.
+    void setEmmFilter(const std::shared_ptr<AmlEmmFilter>& emmFilter);
+
+    void getStats(Aml_MP_CASStats* stats) const;
+    int toJson(char* outJson, uint32_t outLen) const;
+    void reset();
+
+private:
+    void onDescrambled_l(int64_t nowUs);
+
+    const Aml_MP_CASServiceType mServiceType;
+
+    mutable std::mutex mLock;
+    Aml_MP_CASStats mStats;
+    int64_t mBusyUs[AML_MP_CAS_OP_NB];
+    bool mZapping = false;
+    bool mEcmSeen = false;
+    int64_t mZapStartUs = -1;
+    uint64_t mZapTotalUs = 0;
+    std::shared_ptr<AmlEmmFilter> mEmmFilter;
+
+    AmlCasMetrics(const AmlCasMetrics&) = delete;
+    AmlCasMetrics& operator= (const AmlCasMetrics&) = delete;
+};
+
+}
+
+#endif
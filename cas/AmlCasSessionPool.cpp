@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlCasSessionPool"
+#include <utils/AmlMpLog.h>
+#include "AmlCasSessionPool.h"
+#include "AmlCasBase.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpEventLooper.h>
+#include <utils/AmlMpUtils.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+AmlCasSessionPool& AmlCasSessionPool::instance()
+{
+    static AmlCasSessionPool* pool = new AmlCasSessionPool();
+
+    return *pool;
+}
+
+AmlCasSessionPool::AmlCasSessionPool()
+: mPoolSize(AmlMpConfig::instance().mCasSessionPool > 0 ?
+            AmlMpConfig::instance().mCasSessionPool + std::max(AmlMpConfig::instance().mEcmPrefetch, 0) : 0)
+{
+    if (mPoolSize > 0) {
+        mThread = std::thread([this] { threadLoop(); });
+    }
+}
+
+void AmlCasSessionPool::prepare(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, bool forService)
+{
+    if (mPoolSize == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        if (find_l(serviceType, params, forService) != mSessions.end()) {
+            return;
+        }
+    }
+
+    sptr<AmlCasBase> cas = AmlCasBase::create(serviceType);
+    if (cas == nullptr) {
+        return;
+    }
+
+    sptr<AmlCasBase> evicted;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        if (find_l(serviceType, params, forService) != mSessions.end()) {
+            return;
+        }
+        evicted = makeRoom_l(serviceType);
+        mSessions.push_back({serviceType, *params, cas, false, 0});
+        mPreparing.push_back(cas);
+    }
+    mCond.notify_all();
+
+    if (evicted != nullptr) {
+        evicted->stopDescrambling();
+    }
+}
+
+sptr<AmlCasBase> AmlCasSessionPool::acquire(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params)
+{
+    if (mPoolSize > 0) {
+        std::unique_lock<std::mutex> _l(mLock);
+        for (;;) {
+            auto it = find_l(serviceType, params, true);
+            if (it == mSessions.end()) {
+                it = find_l(serviceType, params, false);
+            }
+            if (it == mSessions.end()) {
+                break;
+            }
+
+            if (it->ready && it->ecmUsers == 0) {
+                sptr<AmlCasBase> cas = it->cas;
+                mSessions.erase(it);
+                MLOGI("reuse %s session", mpCASServiceType2Str(serviceType));
+                return cas;
+            }
+
+            // being opened, which is what would be done here anyway, or busy
+            // with an ECM the vendor lib must not see next to startDescrambling().
+            mCond.wait(_l);
+        }
+    }
+
+    return AmlCasBase::create(serviceType);
+}
+
+void AmlCasSessionPool::release(const sptr<AmlCasBase>& cas)
+{
+    if (cas == nullptr) {
+        return;
+    }
+
+    if (mPoolSize == 0 || !cas->isSessionOpen()) {
+        cas->stopDescrambling();
+        return;
+    }
+
+    cas->suspendDescrambling();
+
+    sptr<AmlCasBase> evicted;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        evicted = makeRoom_l(cas->serviceType());
+        mSessions.push_back({cas->serviceType(), cas->iptvCasParams(), cas, true, 0});
+    }
+    mCond.notify_all();
+
+    if (evicted != nullptr) {
+        evicted->stopDescrambling();
+    }
+}
+
+int AmlCasSessionPool::processEcm(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, int ecmPid, const uint8_t* data, size_t size)
+{
+    std::list<Session>::iterator it;
+    sptr<AmlCasBase> cas;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        it = find_l(serviceType, params, true);
+        if (it == mSessions.end() || !it->ready) {
+            return -1;
+        }
+        // acquire() and makeRoom_l() leave the entry alone until it is back to 0.
+        it->ecmUsers++;
+        cas = it->cas;
+    }
+
+    int ret = 0;
+    if (!cas->isRepeatedEcm(true, ecmPid, data, size)) {
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        ret = cas->processEcm(true, ecmPid, data, size);
+        cas->metrics().record(AML_MP_CAS_OP_PROCESS_ECM, startUs, ret, size);
+        if (ret < 0) {
+            cas->forgetEcm(true, ecmPid, data, size);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        it->ecmUsers--;
+    }
+    mCond.notify_all();
+
+    return ret;
+}
+
+bool AmlCasSessionPool::sameProvisioning(const Aml_MP_IptvCASParams& a, const Aml_MP_IptvCASParams& b)
+{
+    return a.caSystemId == b.caSystemId &&
+           a.demuxId == b.demuxId &&
+           a.serverPort == b.serverPort &&
+           strncmp(a.serverAddress, b.serverAddress, sizeof(a.serverAddress)) == 0 &&
+           strncmp(a.keyPath, b.keyPath, sizeof(a.keyPath)) == 0 &&
+           a.private_size == b.private_size &&
+           memcmp(a.private_data, b.private_data, std::min(a.private_size, sizeof(a.private_data))) == 0;
+}
+
+bool AmlCasSessionPool::sameService(const Aml_MP_IptvCASParams& a, const Aml_MP_IptvCASParams& b)
+{
+    return sameProvisioning(a, b) &&
+           a.videoPid == b.videoPid &&
+           a.audioPid == b.audioPid &&
+           a.ecmPid[VIDEO_ECM_PID_INDEX] == b.ecmPid[VIDEO_ECM_PID_INDEX] &&
+           a.ecmPid[AUDIO_ECM_PID_INDEX] == b.ecmPid[AUDIO_ECM_PID_INDEX];
+}
+
+std::list<AmlCasSessionPool::Session>::iterator AmlCasSessionPool::find_l(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, bool sameServiceOnly)
+{
+    return std::find_if(mSessions.begin(), mSessions.end(), [&](const Session& session) {
+        return session.serviceType == serviceType &&
+               (sameServiceOnly ? sameService(session.params, *params) : sameProvisioning(session.params, *params));
+    });
+}
+
+sptr<AmlCasBase> AmlCasSessionPool::makeRoom_l(Aml_MP_CASServiceType serviceType)
+{
+    int count = std::count_if(mSessions.begin(), mSessions.end(), [serviceType](const Session& session) {
+        return session.serviceType == serviceType;
+    });
+    if (count < mPoolSize) {
+        return nullptr;
+    }
+
+    // the oldest idle one, sessions being opened are waited for.
+    auto it = std::find_if(mSessions.begin(), mSessions.end(), [serviceType](const Session& session) {
+        return session.serviceType == serviceType && session.ready && session.ecmUsers == 0;
+    });
+    if (it == mSessions.end()) {
+        return nullptr;
+    }
+
+    sptr<AmlCasBase> cas = it->cas;
+    mSessions.erase(it);
+
+    return cas;
+}
+
+void AmlCasSessionPool::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    for (;;) {
+        mCond.wait(_l, [this] { return !mPreparing.empty(); });
+        sptr<AmlCasBase> cas = mPreparing.front();
+        mPreparing.pop_front();
+
+        auto byCas = [&cas](const Session& session) { return session.cas == cas; };
+        auto it = std::find_if(mSessions.begin(), mSessions.end(), byCas);
+        if (it == mSessions.end()) {
+            continue;
+        }
+        // prepareSession() copies the params into the CAS before the vendor
+        // lib sees them, this copy only has to outlive the call.
+        Aml_MP_IptvCASParams params = it->params;
+
+        _l.unlock();
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        int ret = cas->prepareSession(&params);
+        int64_t elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+        _l.lock();
+
+        it = std::find_if(mSessions.begin(), mSessions.end(), byCas);
+        if (ret == 0) {
+            MLOGI("%s session opened in %" PRId64 " ms", mpCASServiceType2Str(cas->serviceType()), elapsedUs / 1000);
+            if (it != mSessions.end()) {
+                it->ready = true;
+            }
+        } else {
+            MLOGW("%s session open failed, ret:%d", mpCASServiceType2Str(cas->serviceType()), ret);
+            if (it != mSessions.end()) {
+                mSessions.erase(it);
+            }
+            _l.unlock();
+            cas->stopDescrambling();
+            _l.lock();
+        }
+        mCond.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_CAS_SESSION_POOL_H_
+#define _AML_CAS_SESSION_POOL_H_
+
+#include <Aml_MP/Common.h>
+#include <utils/AmlMpRefBase.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace aml_mp {
+class AmlCasBase;
+
+/*
+ * Keeps IPTV CAS sessions provisioned and open between services.
+ *
+ * Creating the CAS library object, provisioning and opening a session costs
+ * hundreds of ms per zap. release() keeps a stopped player's session open,
+ * and acquire() hands it to the next service of the same CAS type and
+ * provisioning, where startDescrambling() only rebinds the PIDs. prepare()
+ * opens a session on the pool thread as soon as the service is known.
+ * At most AmlMpConfig::mCasSessionPool idle sessions are kept per CAS type,
+ * plus AmlMpConfig::mEcmPrefetch ones the ECM prefetcher opens for the
+ * services next to the playing one. acquire() prefers a session opened for
+ * the very same service, its control words are loaded already. A session
+ * is not handed out or evicted while processEcm() is inside it.
+ */
+class AmlCasSessionPool
+{
+public:
+    static AmlCasSessionPool& instance();
+
+    // forService opens a session of its own for the service PIDs.
+    void prepare(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, bool forService = false);
+    // an open session for params, or a new one.
+    sptr<AmlCasBase> acquire(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params);
+    // takes over cas from a player that stops descrambling.
+    void release(const sptr<AmlCasBase>& cas);
+    // hands an ECM section to the idle session opened for the service.
+    int processEcm(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, int ecmPid, const uint8_t* data, size_t size);
+
+private:
+    struct Session {
+        Aml_MP_CASServiceType serviceType;
+        Aml_MP_IptvCASParams params;
+        sptr<AmlCasBase> cas;
+        bool ready;
+        int ecmUsers;   // prefetched ECMs in the vendor lib, the entry stays put meanwhile
+    };
+
+    AmlCasSessionPool();
+    ~AmlCasSessionPool() = default;
+
+    static bool sameProvisioning(const Aml_MP_IptvCASParams& a, const Aml_MP_IptvCASParams& b);
+    static bool sameService(const Aml_MP_IptvCASParams& a, const Aml_MP_IptvCASParams& b);
+    std::list<Session>::iterator find_l(Aml_MP_CASServiceType serviceType, const Aml_MP_IptvCASParams* params, bool sameServiceOnly);
+    sptr<AmlCasBase> makeRoom_l(Aml_MP_CASServiceType serviceType);
+    void threadLoop();
+
+    const int mPoolSize;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::list<Session> mSessions;
+    std::deque<sptr<AmlCasBase>> mPreparing;
+    std::thread mThread;
+
+    AmlCasSessionPool(const AmlCasSessionPool&) = delete;
+    AmlCasSessionPool& operator= (const AmlCasSessionPool&) = delete;
+};
+
+}
+
+#endif
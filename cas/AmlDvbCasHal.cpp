@@ -13,6 +13,8 @@
 #include <pthread.h>
 #include <utils/AmlMpUtils.h>
 #include <utils/AmlMpLog.h>
+#include <utils/AmlMpMemoryTracker.h>
+#include <utils/AmlMpConfig.h>
 
 static const char* mName = LOG_TAG;
 
@@ -80,19 +82,42 @@ static int convertToAmlMPErrorCode(AM_RESULT CasResult) {
 
 ///////////////////////////////////////////////////////////////////////////////
 namespace aml_mp {
+#ifdef HAVE_CAS_HAL
+std::mutex AmlDvbCasHal::sSharedLock;
+std::map<AmlDvbCasHal::DescramblingKey, std::shared_ptr<AmlDvbCasHal::SharedDescrambling>> AmlDvbCasHal::sSharedDescramblings;
+std::mutex AmlDvbCasHal::sEventLock;
+std::set<AmlDvbCasHal*> AmlDvbCasHal::sInstances;
+
+AmlDvbCasHal::HalSession::~HalSession()
+{
+    AM_RESULT ret = AM_CA_CloseSession(casSession);
+    if (ret != AM_ERROR_SUCCESS) {
+        MLOGE("AM_CA_CloseSession failed!");
+    }
+}
+
+bool AmlDvbCasHal::DescramblingKey::operator<(const DescramblingKey& rhs) const
+{
+    if (dmxDev != rhs.dmxDev) {
+        return dmxDev < rhs.dmxDev;
+    }
+
+    if (serviceId != rhs.serviceId) {
+        return serviceId < rhs.serviceId;
+    }
+
+    return ecmPid < rhs.ecmPid;
+}
+#endif
+
 AmlDvbCasHal::AmlDvbCasHal(Aml_MP_CASServiceType serviceType)
 : AmlCasBase(serviceType)
 {
 #ifdef HAVE_CAS_HAL
-    AM_RESULT ret = AM_ERROR_GENERAL_ERORR;
-    CA_SERVICE_TYPE_t caServiceType = convertToCAServiceType(mServiceType);
-    ret = AM_CA_OpenSession(g_casHandle, &mCasSession, caServiceType);
-    if (ret != AM_ERROR_SUCCESS) {
-        MLOGE("AM_CA_OpenSession failed!");
-        return;
-    }
+    mCasSession = openHalSession(mServiceType);
 
-    MLOG("openSession:%#x", mCasSession);
+    std::lock_guard<std::mutex> _l(sEventLock);
+    sInstances.insert(this);
 #endif
 }
 
@@ -101,12 +126,23 @@ AmlDvbCasHal::~AmlDvbCasHal()
     MLOG();
 
 #ifdef HAVE_CAS_HAL
-    AM_RESULT ret = AM_ERROR_GENERAL_ERORR;
-    ret = AM_CA_CloseSession(mCasSession);
-    if (ret != AM_ERROR_SUCCESS) {
-        MLOGE("AM_CA_CloseSession failed!");
+    {
+        std::lock_guard<std::mutex> _l(sEventLock);
+        sInstances.erase(this);
+    }
+
+    // the other consumers of a shared session go on without this one.
+    if (mLive != nullptr) {
+        detach(false);
+    }
+    if (mRecord != nullptr) {
+        detach(true);
     }
 #endif
+
+    for (auto& p : mSecmems) {
+        AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_CAS, AmlMpMemoryTracker::kNoInstance, p.second.size);
+    }
 }
 
 int AmlDvbCasHal::registerEventCallback(Aml_MP_CAS_EventCallback cb, void* userData __unused)
@@ -116,9 +152,23 @@ int AmlDvbCasHal::registerEventCallback(Aml_MP_CAS_EventCallback cb, void* userD
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-    CAS_EventFunction_t eventFn = reinterpret_cast<CAS_EventFunction_t>(cb);
-
-    ret = convertToAmlMPErrorCode(AM_CA_RegisterEventCallback(mCasSession, eventFn));
+    RETURN_IF(AML_MP_ERROR, mCasSession == nullptr);
+
+    // the sessions call onHalEvent(), which finds the consumers of each.
+    std::lock_guard<std::mutex> _l(sEventLock);
+    mEventCb = cb;
+    std::lock_guard<std::mutex> _sl(mSessionLock);
+    for (SharedDescrambling* shared : {mLive.get(), mRecord.get()}) {
+        if (shared == nullptr) {
+            continue;
+        }
+        if (cb != nullptr) {
+            shared->eventCallbacks[this] = {this, cb};
+        } else {
+            shared->eventCallbacks.erase(this);
+        }
+    }
+    ret = AML_MP_OK;
 #else
     AML_MP_UNUSED(cb);
 #endif
@@ -132,10 +182,7 @@ int AmlDvbCasHal::startDescrambling(Aml_MP_CASServiceInfo* serviceInfo)
 
     int ret = AML_MP_ERROR;
 #ifdef HAVE_CAS_HAL
-    AM_CA_ServiceInfo_t caServiceInfo;
-    convertToCAServiceInfo(&caServiceInfo, serviceInfo);
-
-    ret = convertToAmlMPErrorCode(AM_CA_StartDescrambling(mCasSession, &caServiceInfo));
+    ret = attach(serviceInfo, false);
 #else
     AML_MP_UNUSED(serviceInfo);
 #endif
@@ -150,7 +197,7 @@ int AmlDvbCasHal::stopDescrambling()
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-    ret = convertToAmlMPErrorCode(AM_CA_StopDescrambling(mCasSession));
+    ret = detach(false);
 #endif
 
     return ret;
@@ -163,7 +210,9 @@ int AmlDvbCasHal::updateDescramblingPid(int oldStreamPid, int newStreamPid)
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-   ret = convertToAmlMPErrorCode(AM_CA_UpdateDescramblingPid(mCasSession, oldStreamPid, newStreamPid));
+    std::shared_ptr<HalSession> session = halSession();
+    RETURN_IF(AML_MP_ERROR, session == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_UpdateDescramblingPid(session->casSession, oldStreamPid, newStreamPid));
 #endif
 
     return ret;
@@ -176,10 +225,7 @@ int AmlDvbCasHal::startDVRRecord(Aml_MP_CASServiceInfo* serviceInfo)
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-    AM_CA_ServiceInfo_t caServiceInfo;
-    convertToCAServiceInfo(&caServiceInfo, serviceInfo);
-
-    ret = convertToAmlMPErrorCode(AM_CA_DVRStart(mCasSession, &caServiceInfo));
+    ret = attach(serviceInfo, true);
 #else
     AML_MP_UNUSED(serviceInfo);
 #endif
@@ -194,7 +240,7 @@ int AmlDvbCasHal::stopDVRRecord()
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-    ret = convertToAmlMPErrorCode(AM_CA_DVRStop(mCasSession));
+    ret = detach(true);
 #endif
 
     return ret;
@@ -206,10 +252,11 @@ int AmlDvbCasHal::startDVRReplay(Aml_MP_CASDVRReplayParams* dvrReplayParams)
 
     int ret = AML_MP_ERROR;
 #ifdef HAVE_CAS_HAL
+    RETURN_IF(AML_MP_ERROR, mCasSession == nullptr);
     AM_CA_PreParam_t caParams;
     caParams.dmx_dev = dvrReplayParams->dmxDev;
 
-    ret = convertToAmlMPErrorCode(AM_CA_DVRSetPreParam(mCasSession, &caParams));
+    ret = convertToAmlMPErrorCode(AM_CA_DVRSetPreParam(mCasSession->casSession, &caParams));
 #else
     AML_MP_UNUSED(dvrReplayParams);
 #endif
@@ -224,7 +271,8 @@ int AmlDvbCasHal::stopDVRReplay()
     int ret = AML_MP_ERROR;
 
 #ifdef HAVE_CAS_HAL
-    ret = convertToAmlMPErrorCode(AM_CA_DVRStopReplay(mCasSession));
+    RETURN_IF(AML_MP_ERROR, mCasSession == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_DVRStopReplay(mCasSession->casSession));
 #endif
 
     return ret;
@@ -238,7 +286,9 @@ int AmlDvbCasHal::DVREncrypt(Aml_MP_CASCryptoParams* cryptoParams)
     static_assert(sizeof(loff_t) == sizeof(int64_t), "Imcompatible loff_t vs int64_t");
     AM_CA_CryptoPara_t* amCryptoParams = reinterpret_cast<AM_CA_CryptoPara_t*>(cryptoParams);
 
-    ret = convertToAmlMPErrorCode(AM_CA_DVREncrypt(mCasSession, amCryptoParams));
+    std::shared_ptr<HalSession> session = halSession(true);
+    RETURN_IF(AML_MP_ERROR, session == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_DVREncrypt(session->casSession, amCryptoParams));
 #else
     AML_MP_UNUSED(cryptoParams);
 #endif
@@ -253,18 +303,19 @@ int AmlDvbCasHal::DVRDecrypt(Aml_MP_CASCryptoParams* cryptoParams)
     static_assert(sizeof(Aml_MP_CASCryptoParams) == sizeof(AM_CA_CryptoPara_t), "Imcompatible with AM_CA_CryptoPara_t!");
     static_assert(sizeof(loff_t) == sizeof(int64_t), "Imcompatible loff_t vs int64_t");
     AM_CA_CryptoPara_t* amCryptoParams = reinterpret_cast<AM_CA_CryptoPara_t*>(cryptoParams);
+    RETURN_IF(AML_MP_ERROR, mCasSession == nullptr);
 
     if (!mDvrReplayInited) {
         mDvrReplayInited = true;
         MLOGI("DVRReplay");
-        ret = convertToAmlMPErrorCode(AM_CA_DVRReplay(mCasSession, amCryptoParams));
+        ret = convertToAmlMPErrorCode(AM_CA_DVRReplay(mCasSession->casSession, amCryptoParams));
         if (ret != AML_MP_OK) {
             MLOGE("CAS DVR replay failed, ret = %d", ret);
             return ret;
         }
     }
 
-    ret = convertToAmlMPErrorCode(AM_CA_DVRDecrypt(mCasSession, amCryptoParams));
+    ret = convertToAmlMPErrorCode(AM_CA_DVRDecrypt(mCasSession->casSession, amCryptoParams));
 #else
     AML_MP_UNUSED(cryptoParams);
 #endif
@@ -278,9 +329,20 @@ AML_MP_SECMEM AmlDvbCasHal::createSecmem(Aml_MP_CASServiceType type, void** pSec
     SecMemHandle secMem = 0;
     CA_SERVICE_TYPE_t caServiceType = convertToCAServiceType(type);
 
-    secMem = AM_CA_CreateSecmem(mCasSession, caServiceType, pSecbuf, size);
+    // on the session DVREncrypt() uses.
+    std::shared_ptr<HalSession> session = halSession(type == AML_MP_CAS_SERVICE_PVR_RECORDING);
+    RETURN_IF(nullptr, session == nullptr);
+    secMem = AM_CA_CreateSecmem(session->casSession, caServiceType, pSecbuf, size);
     MLOG("service type:%d, secMem:%#x", type, secMem);
 
+    if (secMem) {
+        std::lock_guard<std::mutex> _l(mSecmemLock);
+        mSecmems[(AML_MP_SECMEM)secMem] = {session, size ? *size : 0};
+        if (size) {
+            AmlMpMemoryTracker::instance().charge(AML_MP_MEMORY_CAS, AmlMpMemoryTracker::kNoInstance, *size);
+        }
+    }
+
     return (AML_MP_SECMEM)secMem;
 #else
     AML_MP_UNUSED(type);
@@ -299,7 +361,20 @@ int AmlDvbCasHal::destroySecmem(AML_MP_SECMEM secMem)
 
 #ifdef HAVE_CAS_HAL
     MLOG("secMem:%#x", (SecMemHandle)secMem);
-    ret = convertToAmlMPErrorCode(AM_CA_DestroySecmem(mCasSession, (SecMemHandle)secMem));
+    Secmem secmem{};
+    {
+        std::lock_guard<std::mutex> _l(mSecmemLock);
+        auto it = mSecmems.find(secMem);
+        if (it != mSecmems.end()) {
+            secmem = it->second;
+            AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_CAS, AmlMpMemoryTracker::kNoInstance, it->second.size);
+            mSecmems.erase(it);
+        }
+    }
+
+    std::shared_ptr<HalSession> session = secmem.session ? secmem.session : mCasSession;
+    RETURN_IF(AML_MP_ERROR, session == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_DestroySecmem(session->casSession, (SecMemHandle)secMem));
 #else
     AML_MP_UNUSED(secMem);
 #endif
@@ -311,7 +386,9 @@ int AmlDvbCasHal::ioctl(const char* inJson, char* outJson, uint32_t outLen)
 {
     int ret = AML_MP_ERROR;
 #ifdef HAVE_CAS_HAL
-    ret = convertToAmlMPErrorCode(AM_CA_Ioctl(mCasSession, inJson, outJson, outLen));
+    std::shared_ptr<HalSession> session = halSession();
+    RETURN_IF(AML_MP_ERROR, session == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_Ioctl(session->casSession, inJson, outJson, outLen));
 #else
     AML_MP_UNUSED(inJson);
     AML_MP_UNUSED(outJson);
@@ -325,7 +402,9 @@ int AmlDvbCasHal::getStoreRegion(Aml_MP_CASStoreRegion* region, uint8_t* regionC
     int ret = AML_MP_ERROR;
 #ifdef HAVE_CAS_HAL
     static_assert(sizeof(Aml_MP_CASStoreRegion) == sizeof(AM_CA_StoreRegion_t), "Imcompatible with AM_CA_StoreRegion_t!");
-    ret = convertToAmlMPErrorCode(AM_CA_GetStoreRegion(mCasSession, reinterpret_cast<AM_CA_StoreRegion_t*>(region), regionCount));
+    std::shared_ptr<HalSession> session = halSession(true);
+    RETURN_IF(AML_MP_ERROR, session == nullptr);
+    ret = convertToAmlMPErrorCode(AM_CA_GetStoreRegion(session->casSession, reinterpret_cast<AM_CA_StoreRegion_t*>(region), regionCount));
 #else
     AML_MP_UNUSED(region);
     AML_MP_UNUSED(regionCount);
@@ -333,6 +412,204 @@ int AmlDvbCasHal::getStoreRegion(Aml_MP_CASStoreRegion* region, uint8_t* regionC
     return ret;
 }
 
+#ifdef HAVE_CAS_HAL
+std::shared_ptr<AmlDvbCasHal::HalSession> AmlDvbCasHal::openHalSession(Aml_MP_CASServiceType serviceType)
+{
+    CasSession casSession = 0;
+    CA_SERVICE_TYPE_t caServiceType = convertToCAServiceType(serviceType);
+    AM_RESULT ret = AM_CA_OpenSession(g_casHandle, &casSession, caServiceType);
+    if (ret != AM_ERROR_SUCCESS) {
+        MLOGE("AM_CA_OpenSession failed!");
+        return nullptr;
+    }
+
+    MLOG("openSession:%#x", casSession);
+    ret = AM_CA_RegisterEventCallback(casSession, reinterpret_cast<CAS_EventFunction_t>(&AmlDvbCasHal::onHalEvent));
+    if (ret != AM_ERROR_SUCCESS) {
+        MLOGW("AM_CA_RegisterEventCallback failed!");
+    }
+
+    return std::make_shared<HalSession>(casSession);
+}
+
+int AmlDvbCasHal::onHalEvent(CasSession casSession, char* json)
+{
+    // the consumers the session descrambles for, or its owner when it is idle.
+    std::map<const AmlDvbCasHal*, EventCallback> targets;
+    {
+        std::lock_guard<std::mutex> _l(sEventLock);
+        for (AmlDvbCasHal* instance : sInstances) {
+            std::lock_guard<std::mutex> _sl(instance->mSessionLock);
+            if (instance->mLive == nullptr && instance->mRecord == nullptr) {
+                if (instance->mEventCb != nullptr && instance->mCasSession != nullptr &&
+                    instance->mCasSession->casSession == casSession) {
+                    targets[instance] = {instance, instance->mEventCb};
+                }
+                continue;
+            }
+
+            for (const SharedDescrambling* shared : {instance->mLive.get(), instance->mRecord.get()}) {
+                if (shared != nullptr && shared->session->casSession == casSession) {
+                    targets.insert(shared->eventCallbacks.begin(), shared->eventCallbacks.end());
+                }
+            }
+        }
+    }
+
+    for (auto& p : targets) {
+        sptr<AmlDvbCasHal> consumer = p.second.consumer.promote();
+        if (consumer != nullptr) {
+            p.second.cb(aml_handle_cast(consumer), json);
+        }
+    }
+
+    return 0;
+}
+
+// live: AM_CA_StartDescrambling() unless the service is already descrambled
+// for a recording, the descrambler of the demux is fed by then.
+// record: AM_CA_DVRStart() on the shared session, the PVR keys come from the
+// ECMs it already processes.
+int AmlDvbCasHal::attach(Aml_MP_CASServiceInfo* serviceInfo, bool record)
+{
+    if ((record ? mRecord : mLive) != nullptr) {
+        MLOGW("%s already started, restart", record ? "record" : "descrambling");
+        detach(record);
+    }
+
+    AM_CA_ServiceInfo_t caServiceInfo;
+    convertToCAServiceInfo(&caServiceInfo, serviceInfo);
+    DescramblingKey key{serviceInfo->dmx_dev, serviceInfo->service_id, serviceInfo->ecm_pid};
+    bool share = AmlMpConfig::instance().mCasShareDescrambling > 0;
+
+    std::lock_guard<std::mutex> _l(sSharedLock);
+    std::shared_ptr<SharedDescrambling> shared;
+    auto it = share ? sSharedDescramblings.find(key) : sSharedDescramblings.end();
+    if (it != sSharedDescramblings.end()) {
+        shared = it->second;
+        MLOGI("%s shares session %#x of dmx:%d, service:%d, ecm pid:%#x", record ? "record" : "descrambling",
+                shared->session->casSession, key.dmxDev, key.serviceId, key.ecmPid);
+    } else {
+        // the own session can still descramble an earlier service for others.
+        std::shared_ptr<HalSession> session;
+        {
+            std::lock_guard<std::mutex> _sl(mSessionLock);
+            bool lent = false;
+            for (auto& p : sSharedDescramblings) {
+                lent |= p.second->session == mCasSession && p.second != mLive && p.second != mRecord;
+            }
+            if (mCasSession == nullptr || lent) {
+                mCasSession = openHalSession(mServiceType);
+            }
+            session = mCasSession;
+        }
+        RETURN_IF(AML_MP_ERROR, session == nullptr);
+
+        shared = std::make_shared<SharedDescrambling>();
+        shared->key = key;
+        shared->session = session;
+    }
+
+    int ret = AML_MP_OK;
+    if (record) {
+        if (!shared->recording) {
+            ret = convertToAmlMPErrorCode(AM_CA_DVRStart(shared->session->casSession, &caServiceInfo));
+            shared->recording = ret == AML_MP_OK;
+        }
+    } else {
+        if (!shared->descrambling && !shared->recording) {
+            ret = convertToAmlMPErrorCode(AM_CA_StartDescrambling(shared->session->casSession, &caServiceInfo));
+            shared->descrambling = ret == AML_MP_OK;
+        }
+        if (ret == AML_MP_OK && shared->liveRefs == 0) {
+            shared->liveServiceInfo = caServiceInfo;
+        }
+    }
+
+    if (ret != AML_MP_OK) {
+        return ret;
+    }
+
+    (record ? shared->recordRefs : shared->liveRefs)++;
+    if (share) {
+        sSharedDescramblings[key] = shared;
+    }
+
+    {
+        std::lock_guard<std::mutex> _el(sEventLock);
+        if (mEventCb != nullptr) {
+            shared->eventCallbacks[this] = {this, mEventCb};
+        }
+    }
+
+    std::lock_guard<std::mutex> _sl(mSessionLock);
+    (record ? mRecord : mLive) = shared;
+    return ret;
+}
+
+int AmlDvbCasHal::detach(bool record)
+{
+    std::lock_guard<std::mutex> _l(sSharedLock);
+    std::shared_ptr<SharedDescrambling> shared;
+    bool otherRole;
+    {
+        std::lock_guard<std::mutex> _sl(mSessionLock);
+        shared = std::move(record ? mRecord : mLive);
+        otherRole = (record ? mLive : mRecord) == shared;
+    }
+    RETURN_IF(AML_MP_ERROR, shared == nullptr);
+
+    if (!otherRole) {
+        std::lock_guard<std::mutex> _el(sEventLock);
+        shared->eventCallbacks.erase(this);
+    }
+
+    CasSession casSession = shared->session->casSession;
+    int ret = AML_MP_OK;
+    (record ? shared->recordRefs : shared->liveRefs)--;
+
+    if (shared->recordRefs == 0 && shared->recording) {
+        // the live players take over the ECMs of the recording.
+        if (shared->liveRefs > 0 && !shared->descrambling) {
+            shared->descrambling = AM_CA_StartDescrambling(casSession, &shared->liveServiceInfo) == AM_ERROR_SUCCESS;
+            if (!shared->descrambling) {
+                MLOGE("AM_CA_StartDescrambling failed, dmx:%d, service:%d", shared->key.dmxDev, shared->key.serviceId);
+            }
+        }
+        ret = convertToAmlMPErrorCode(AM_CA_DVRStop(casSession));
+        shared->recording = false;
+    }
+
+    // a recording still needs the control words of a stopped player.
+    if (shared->liveRefs == 0 && shared->recordRefs == 0 && shared->descrambling) {
+        ret = convertToAmlMPErrorCode(AM_CA_StopDescrambling(casSession));
+        shared->descrambling = false;
+    }
+
+    if (shared->liveRefs == 0 && shared->recordRefs == 0) {
+        auto it = sSharedDescramblings.find(shared->key);
+        if (it != sSharedDescramblings.end() && it->second == shared) {
+            sSharedDescramblings.erase(it);
+        }
+    }
+
+    return ret;
+}
+
+std::shared_ptr<AmlDvbCasHal::HalSession> AmlDvbCasHal::halSession(bool record) const
+{
+    std::lock_guard<std::mutex> _l(mSessionLock);
+    const std::shared_ptr<SharedDescrambling>& first = record ? mRecord : mLive;
+    const std::shared_ptr<SharedDescrambling>& second = record ? mLive : mRecord;
+
+    if (first != nullptr) {
+        return first->session;
+    } else if (second != nullptr) {
+        return second->session;
+    }
 
+    return mCasSession;
 }
+#endif
 
+}
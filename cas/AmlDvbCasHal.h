@@ -16,6 +16,10 @@
 #include "am_cas.h"
 #endif
 #include "AmlCasBase.h"
+#include <mutex>
+#include <map>
+#include <memory>
+#include <set>
 
 namespace aml_mp {
 
@@ -50,10 +54,77 @@ public:
 
 private:
 #ifdef HAVE_CAS_HAL
-    CasSession mCasSession = 0;
+    // closes the CAS HAL session with its last user.
+    struct HalSession {
+        explicit HalSession(CasSession session) : casSession(session) {}
+        ~HalSession();
+
+        const CasSession casSession;
+    };
+
+    // a service of a demux is descrambled by one CAS HAL session for all
+    // its live players and recorders, so its ECMs are processed once. The
+    // session of the first consumer is shared, the later ones only add the
+    // role they need, see attach().
+    struct DescramblingKey {
+        int dmxDev;
+        int serviceId;
+        int ecmPid;
+
+        bool operator<(const DescramblingKey& rhs) const;
+    };
+
+    struct EventCallback {
+        wptr<AmlDvbCasHal> consumer;
+        Aml_MP_CAS_EventCallback cb;
+    };
+
+    struct SharedDescrambling {
+        DescramblingKey key;
+        std::shared_ptr<HalSession> session;
+        // the events of the session go to each consumer attached, see onHalEvent().
+        std::map<const AmlDvbCasHal*, EventCallback> eventCallbacks;
+        int liveRefs = 0;
+        int recordRefs = 0;
+        bool descrambling = false;
+        bool recording = false;
+        AM_CA_ServiceInfo_t liveServiceInfo;
+    };
+
+    static std::shared_ptr<HalSession> openHalSession(Aml_MP_CASServiceType serviceType);
+    // the one callback of every HAL session, fans the events out.
+    static int onHalEvent(CasSession casSession, char* json);
+    int attach(Aml_MP_CASServiceInfo* serviceInfo, bool record);
+    int detach(bool record);
+    // the session of a role, of the other one if that is not started.
+    std::shared_ptr<HalSession> halSession(bool record = false) const;
+
+    static std::mutex sSharedLock;
+    static std::map<DescramblingKey, std::shared_ptr<SharedDescrambling>> sSharedDescramblings;
+
+    // taken after sSharedLock, never across a CAS HAL call, which may send events.
+    static std::mutex sEventLock;
+    static std::set<AmlDvbCasHal*> sInstances;
+    Aml_MP_CAS_EventCallback mEventCb = nullptr;
+
+    mutable std::mutex mSessionLock;
+    std::shared_ptr<HalSession> mCasSession;
+    std::shared_ptr<SharedDescrambling> mLive;
+    std::shared_ptr<SharedDescrambling> mRecord;
 #endif
     bool mDvrReplayInited = false;
 
+    // secure memory sizes, for memory accounting, and the session they
+    // were created on.
+    struct Secmem {
+#ifdef HAVE_CAS_HAL
+        std::shared_ptr<HalSession> session;
+#endif
+        uint32_t size;
+    };
+    std::mutex mSecmemLock;
+    std::map<AML_MP_SECMEM, Secmem> mSecmems;
+
 private:
     AmlDvbCasHal(const AmlDvbCasHal&) = delete;
     AmlDvbCasHal& operator= (const AmlDvbCasHal&) = delete;
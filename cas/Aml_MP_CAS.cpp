@@ -13,6 +13,8 @@
 #include "AmlDvbCasHal.h"
 #include <utils/AmlMpHandle.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpEventLooper.h>
+#include <utils/AmlMpConfig.h>
 #include "cas/AmlCasBase.h"
 
 static const char* mName = LOG_TAG;
@@ -191,7 +193,25 @@ int Aml_MP_CAS_Ioctl(AML_MP_CASSESSION casSession, const char* inJson, char* out
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
 
-    return casBase->ioctl(inJson, outJson, outLen);
+    return casBase->handleIoctl(inJson, outJson, outLen);
+}
+
+int Aml_MP_CAS_GetStats(AML_MP_CASSESSION casSession, Aml_MP_CASStats* stats)
+{
+    sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
+    RETURN_IF(-1, casBase == nullptr || stats == nullptr);
+
+    casBase->metrics().getStats(stats);
+    return 0;
+}
+
+int Aml_MP_CAS_ResetStats(AML_MP_CASSESSION casSession)
+{
+    sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
+    RETURN_IF(-1, casBase == nullptr);
+
+    casBase->metrics().reset();
+    return 0;
 }
 
 int Aml_MP_CAS_StartDescrambling(AML_MP_CASSESSION casSession, Aml_MP_CASServiceInfo* serviceInfo)
@@ -199,6 +219,7 @@ int Aml_MP_CAS_StartDescrambling(AML_MP_CASSESSION casSession, Aml_MP_CASService
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
 
+    casBase->metrics().startZap();
     return casBase->startDescrambling(serviceInfo);
 }
 
@@ -207,6 +228,7 @@ int Aml_MP_CAS_StartDescramblingIPTV(AML_MP_CASSESSION casSession, const Aml_MP_
     sptr<AmlCasBase> casIptv = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casIptv == nullptr);
 
+    casIptv->metrics().startZap();
     return casIptv->startDescrambling(params);
 }
 
@@ -262,16 +284,26 @@ int Aml_MP_CAS_DVREncrypt(AML_MP_CASSESSION casSession, Aml_MP_CASCryptoParams *
 {
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
+    RETURN_IF(-1, cryptoParams == nullptr);
+
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = casBase->DVREncrypt(cryptoParams);
+    casBase->metrics().record(AML_MP_CAS_OP_DVR_ENCRYPT, startUs, ret, cryptoParams->inputBuffer.size);
 
-    return casBase->DVREncrypt(cryptoParams);
+    return ret;
 }
 
 int Aml_MP_CAS_DVRDecrypt(AML_MP_CASSESSION casSession, Aml_MP_CASCryptoParams *cryptoParams)
 {
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
+    RETURN_IF(-1, cryptoParams == nullptr);
 
-    return casBase->DVRDecrypt(cryptoParams);
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = casBase->DVRDecrypt(cryptoParams);
+    casBase->metrics().record(AML_MP_CAS_OP_DVR_DECRYPT, startUs, ret, cryptoParams->inputBuffer.size);
+
+    return ret;
 }
 
 AML_MP_SECMEM Aml_MP_CAS_CreateSecmem(AML_MP_CASSESSION casSession, Aml_MP_CASServiceType type, void **pSecbuf, uint32_t *size)
@@ -298,18 +330,69 @@ int Aml_MP_CAS_GetStoreRegion(AML_MP_CASSESSION casSession, Aml_MP_CASStoreRegio
     return casBase->getStoreRegion(region, regionCount);
 }
 
+int Aml_MP_CAS_SetEmmFilters(AML_MP_CASSESSION casSession, const Aml_MP_CASEmmFilter* filters, int count)
+{
+    sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
+    RETURN_IF(-1, casBase == nullptr);
+
+    // the CAS HAL takes the EMMs of DVB sessions itself.
+    if (casBase->serviceType() < AML_MP_CAS_SERVICE_TYPE_IPTV) {
+        MLOGE("EMM filters are for IPTV CAS sessions only!");
+        return -1;
+    }
+
+    return casBase->emmFilter()->setFilters(filters, count);
+}
+
 int Aml_MP_CAS_ProcessEcmIPTV(AML_MP_CASSESSION casSession, bool isSection, int ecmPid, const uint8_t* data, size_t size)
 {
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
-    return casBase->processEcm(isSection, ecmPid, data, size);
+
+    // some CAS libs count the ECMs they see, the app decides.
+    bool dedup = AmlMpConfig::instance().mCasEcmDedup > 0;
+    if (dedup && casBase->isRepeatedEcm(isSection, ecmPid, data, size)) {
+        return 0;
+    }
+
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = casBase->processEcm(isSection, ecmPid, data, size);
+    casBase->metrics().record(AML_MP_CAS_OP_PROCESS_ECM, startUs, ret, size);
+    if (dedup && ret < 0) {
+        casBase->forgetEcm(isSection, ecmPid, data, size);
+    }
+
+    return ret;
 }
 
 int Aml_MP_CAS_DecryptIPTV(AML_MP_CASSESSION casSession, uint8_t* data, size_t size, void* ext_data, Aml_MP_Buffer* outbuffer)
 {
     sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
     RETURN_IF(-1, casBase == nullptr);
-    return casBase->decrypt(data, size, ext_data, outbuffer);
+
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = casBase->decrypt(data, size, ext_data, outbuffer);
+    casBase->metrics().record(AML_MP_CAS_OP_DECRYPT, startUs, ret, size);
+
+    return ret;
+}
+
+int Aml_MP_CAS_DecryptIPTVv(AML_MP_CASSESSION casSession, const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers)
+{
+    sptr<AmlCasBase> casBase = aml_handle_cast<AmlCasBase>(casSession);
+    RETURN_IF(-1, casBase == nullptr);
+    RETURN_IF(-1, iovcnt < 0 || (iovcnt > 0 && (iov == nullptr || outbuffers == nullptr)));
+
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        size += iov[i].iov_len;
+    }
+
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = casBase->decryptv(iov, iovcnt, ext_data, outbuffers);
+    casBase->metrics().record(AML_MP_CAS_OP_DECRYPT, startUs, ret, size);
+
+    return ret;
 }
 
 #ifdef __cplusplus
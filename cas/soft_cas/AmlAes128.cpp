@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#include "AmlAes128.h"
+#include <string.h>
+
+namespace aml_mp {
+
+namespace {
+
+struct Tables {
+    uint8_t sbox[256];
+    uint8_t invSbox[256];
+    uint32_t te[4][256];
+    uint32_t td[4][256];
+
+    Tables();
+};
+
+uint8_t gfMul(uint8_t a, uint8_t b)
+{
+    uint8_t p = 0;
+    while (b) {
+        if (b & 1) {
+            p ^= a;
+        }
+        a = (a << 1) ^ ((a & 0x80) ? 0x1B : 0);
+        b >>= 1;
+    }
+    return p;
+}
+
+uint8_t rotl8(uint8_t x, int n)
+{
+    return (x << n) | (x >> (8 - n));
+}
+
+uint32_t ror32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+// FIPS-197 5.1.1, multiplicative inverse followed by the affine transform.
+Tables::Tables()
+{
+    for (int x = 0; x < 256; ++x) {
+        uint8_t inv = 0;
+        for (int y = 1; x != 0 && y < 256; ++y) {
+            if (gfMul(x, y) == 1) {
+                inv = y;
+                break;
+            }
+        }
+        uint8_t s = inv ^ rotl8(inv, 1) ^ rotl8(inv, 2) ^ rotl8(inv, 3) ^ rotl8(inv, 4) ^ 0x63;
+        sbox[x] = s;
+        invSbox[s] = x;
+    }
+
+    for (int x = 0; x < 256; ++x) {
+        uint8_t s = sbox[x];
+        uint32_t e = (uint32_t)gfMul(s, 2) << 24 | (uint32_t)s << 16 | (uint32_t)s << 8 | gfMul(s, 3);
+        uint8_t i = invSbox[x];
+        uint32_t d = (uint32_t)gfMul(i, 0x0E) << 24 | (uint32_t)gfMul(i, 0x09) << 16 |
+                     (uint32_t)gfMul(i, 0x0D) << 8 | gfMul(i, 0x0B);
+        for (int j = 0; j < 4; ++j) {
+            te[j][x] = ror32(e, 8 * j);
+            td[j][x] = ror32(d, 8 * j);
+        }
+    }
+}
+
+const Tables& tables()
+{
+    static const Tables* t = new Tables();
+    return *t;
+}
+
+inline uint32_t load32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+inline void store32(uint8_t* p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+inline void xorBlock(uint8_t* dst, const uint8_t* src)
+{
+    for (size_t i = 0; i < AmlAes128::kBlockSize; ++i) {
+        dst[i] ^= src[i];
+    }
+}
+
+}
+
+void AmlAes128::setKey(const uint8_t key[kKeySize])
+{
+    const Tables& t = tables();
+    static const uint32_t rcon[kRounds] = {
+        0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000,
+        0x20000000, 0x40000000, 0x80000000, 0x1B000000, 0x36000000,
+    };
+
+    uint32_t* rk = mEncKey;
+    for (int i = 0; i < 4; ++i) {
+        rk[i] = load32(key + 4 * i);
+    }
+    for (int i = 4; i < 4 * (kRounds + 1); ++i) {
+        uint32_t temp = rk[i - 1];
+        if (i % 4 == 0) {
+            temp = (uint32_t)t.sbox[(temp >> 16) & 0xFF] << 24 | (uint32_t)t.sbox[(temp >> 8) & 0xFF] << 16 |
+                   (uint32_t)t.sbox[temp & 0xFF] << 8 | t.sbox[temp >> 24];
+            temp ^= rcon[i / 4 - 1];
+        }
+        rk[i] = rk[i - 4] ^ temp;
+    }
+
+    // equivalent inverse cipher: round keys in reverse, InvMixColumns on the inner ones.
+    for (int r = 0; r <= kRounds; ++r) {
+        for (int i = 0; i < 4; ++i) {
+            uint32_t w = mEncKey[4 * (kRounds - r) + i];
+            if (r > 0 && r < kRounds) {
+                w = t.td[0][t.sbox[w >> 24]] ^ t.td[1][t.sbox[(w >> 16) & 0xFF]] ^
+                    t.td[2][t.sbox[(w >> 8) & 0xFF]] ^ t.td[3][t.sbox[w & 0xFF]];
+            }
+            mDecKey[4 * r + i] = w;
+        }
+    }
+}
+
+void AmlAes128::encryptBlock(const uint8_t* in, uint8_t* out) const
+{
+    const Tables& t = tables();
+    const uint32_t* rk = mEncKey;
+    uint32_t s0 = load32(in) ^ rk[0];
+    uint32_t s1 = load32(in + 4) ^ rk[1];
+    uint32_t s2 = load32(in + 8) ^ rk[2];
+    uint32_t s3 = load32(in + 12) ^ rk[3];
+
+    for (int r = 1; r < kRounds; ++r) {
+        rk += 4;
+        uint32_t t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xFF] ^ t.te[2][(s2 >> 8) & 0xFF] ^ t.te[3][s3 & 0xFF] ^ rk[0];
+        uint32_t t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xFF] ^ t.te[2][(s3 >> 8) & 0xFF] ^ t.te[3][s0 & 0xFF] ^ rk[1];
+        uint32_t t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xFF] ^ t.te[2][(s0 >> 8) & 0xFF] ^ t.te[3][s1 & 0xFF] ^ rk[2];
+        uint32_t t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xFF] ^ t.te[2][(s1 >> 8) & 0xFF] ^ t.te[3][s2 & 0xFF] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+    const uint8_t* sb = t.sbox;
+    store32(out, ((uint32_t)sb[s0 >> 24] << 24 | (uint32_t)sb[(s1 >> 16) & 0xFF] << 16 |
+                  (uint32_t)sb[(s2 >> 8) & 0xFF] << 8 | sb[s3 & 0xFF]) ^ rk[0]);
+    store32(out + 4, ((uint32_t)sb[s1 >> 24] << 24 | (uint32_t)sb[(s2 >> 16) & 0xFF] << 16 |
+                      (uint32_t)sb[(s3 >> 8) & 0xFF] << 8 | sb[s0 & 0xFF]) ^ rk[1]);
+    store32(out + 8, ((uint32_t)sb[s2 >> 24] << 24 | (uint32_t)sb[(s3 >> 16) & 0xFF] << 16 |
+                      (uint32_t)sb[(s0 >> 8) & 0xFF] << 8 | sb[s1 & 0xFF]) ^ rk[2]);
+    store32(out + 12, ((uint32_t)sb[s3 >> 24] << 24 | (uint32_t)sb[(s0 >> 16) & 0xFF] << 16 |
+                       (uint32_t)sb[(s1 >> 8) & 0xFF] << 8 | sb[s2 & 0xFF]) ^ rk[3]);
+}
+
+void AmlAes128::decryptBlock(const uint8_t* in, uint8_t* out) const
+{
+    const Tables& t = tables();
+    const uint32_t* rk = mDecKey;
+    uint32_t s0 = load32(in) ^ rk[0];
+    uint32_t s1 = load32(in + 4) ^ rk[1];
+    uint32_t s2 = load32(in + 8) ^ rk[2];
+    uint32_t s3 = load32(in + 12) ^ rk[3];
+
+    for (int r = 1; r < kRounds; ++r) {
+        rk += 4;
+        uint32_t t0 = t.td[0][s0 >> 24] ^ t.td[1][(s3 >> 16) & 0xFF] ^ t.td[2][(s2 >> 8) & 0xFF] ^ t.td[3][s1 & 0xFF] ^ rk[0];
+        uint32_t t1 = t.td[0][s1 >> 24] ^ t.td[1][(s0 >> 16) & 0xFF] ^ t.td[2][(s3 >> 8) & 0xFF] ^ t.td[3][s2 & 0xFF] ^ rk[1];
+        uint32_t t2 = t.td[0][s2 >> 24] ^ t.td[1][(s1 >> 16) & 0xFF] ^ t.td[2][(s0 >> 8) & 0xFF] ^ t.td[3][s3 & 0xFF] ^ rk[2];
+        uint32_t t3 = t.td[0][s3 >> 24] ^ t.td[1][(s2 >> 16) & 0xFF] ^ t.td[2][(s1 >> 8) & 0xFF] ^ t.td[3][s0 & 0xFF] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+    const uint8_t* isb = t.invSbox;
+    store32(out, ((uint32_t)isb[s0 >> 24] << 24 | (uint32_t)isb[(s3 >> 16) & 0xFF] << 16 |
+                  (uint32_t)isb[(s2 >> 8) & 0xFF] << 8 | isb[s1 & 0xFF]) ^ rk[0]);
+    store32(out + 4, ((uint32_t)isb[s1 >> 24] << 24 | (uint32_t)isb[(s0 >> 16) & 0xFF] << 16 |
+                      (uint32_t)isb[(s3 >> 8) & 0xFF] << 8 | isb[s2 & 0xFF]) ^ rk[1]);
+    store32(out + 8, ((uint32_t)isb[s2 >> 24] << 24 | (uint32_t)isb[(s1 >> 16) & 0xFF] << 16 |
+                      (uint32_t)isb[(s0 >> 8) & 0xFF] << 8 | isb[s3 & 0xFF]) ^ rk[2]);
+    store32(out + 12, ((uint32_t)isb[s3 >> 24] << 24 | (uint32_t)isb[(s2 >> 16) & 0xFF] << 16 |
+                       (uint32_t)isb[(s1 >> 8) & 0xFF] << 8 | isb[s0 & 0xFF]) ^ rk[3]);
+}
+
+void AmlAes128::encryptEcb(uint8_t* data, size_t blocks) const
+{
+    for (size_t i = 0; i < blocks; ++i, data += kBlockSize) {
+        encryptBlock(data, data);
+    }
+}
+
+void AmlAes128::decryptEcb(uint8_t* data, size_t blocks) const
+{
+    for (size_t i = 0; i < blocks; ++i, data += kBlockSize) {
+        decryptBlock(data, data);
+    }
+}
+
+void AmlAes128::encryptCbc(uint8_t* data, size_t blocks, const uint8_t iv[kBlockSize]) const
+{
+    const uint8_t* prev = iv;
+    for (size_t i = 0; i < blocks; ++i, data += kBlockSize) {
+        xorBlock(data, prev);
+        encryptBlock(data, data);
+        prev = data;
+    }
+}
+
+void AmlAes128::decryptCbc(uint8_t* data, size_t blocks, const uint8_t iv[kBlockSize]) const
+{
+    uint8_t prev[kBlockSize];
+    uint8_t cipher[kBlockSize];
+    memcpy(prev, iv, kBlockSize);
+    for (size_t i = 0; i < blocks; ++i, data += kBlockSize) {
+        memcpy(cipher, data, kBlockSize);
+        decryptBlock(data, data);
+        xorBlock(data, prev);
+        memcpy(prev, cipher, kBlockSize);
+    }
+}
+
+}
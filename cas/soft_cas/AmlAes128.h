@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_AES128_H_
+#define _AML_AES128_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aml_mp {
+
+/*
+ * AES-128 block cipher, table driven, for the software descrambler.
+ *
+ * The tables are built on first use. Data is processed in place, whole
+ * blocks only, CBC starts from the given IV for every call.
+ */
+class AmlAes128
+{
+public:
+    static constexpr size_t kBlockSize = 16;
+    static constexpr size_t kKeySize = 16;
+
+    AmlAes128() = default;
+
+    void setKey(const uint8_t key[kKeySize]);
+
+    void encryptEcb(uint8_t* data, size_t blocks) const;
+    void decryptEcb(uint8_t* data, size_t blocks) const;
+    void encryptCbc(uint8_t* data, size_t blocks, const uint8_t iv[kBlockSize]) const;
+    void decryptCbc(uint8_t* data, size_t blocks, const uint8_t iv[kBlockSize]) const;
+
+private:
+    static constexpr int kRounds = 10;
+
+    void encryptBlock(const uint8_t* in, uint8_t* out) const;
+    void decryptBlock(const uint8_t* in, uint8_t* out) const;
+
+    uint32_t mEncKey[4 * (kRounds + 1)]{};
+    uint32_t mDecKey[4 * (kRounds + 1)]{};
+};
+
+}
+
+#endif
@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#include "AmlDvbCsa.h"
+#include <string.h>
+#include <algorithm>
+
+namespace aml_mp {
+
+namespace {
+
+const uint8_t kBlockSbox[256] = {
+    0x3a, 0xea, 0x68, 0xfe, 0x33, 0xe9, 0x88, 0x1a, 0x83, 0xcf, 0xe1, 0x7f, 0xba, 0xe2, 0x38, 0x12,
+    0xe8, 0x27, 0x61, 0x95, 0x0c, 0x36, 0xe5, 0x70, 0xa2, 0x06, 0x82, 0x7c, 0x17, 0xa3, 0x26, 0x49,
+    0xbe, 0x7a, 0x6d, 0x47, 0xc1, 0x51, 0x8f, 0xf3, 0xcc, 0x5b, 0x67, 0xbd, 0xcd, 0x18, 0x08, 0xc9,
+    0xff, 0x69, 0xef, 0x03, 0x4e, 0x48, 0x4a, 0x84, 0x3f, 0xb4, 0x10, 0x04, 0xdc, 0xf5, 0x5c, 0xc6,
+    0x16, 0xab, 0xac, 0x4c, 0xf1, 0x6a, 0x2f, 0x3c, 0x3b, 0xd4, 0xd5, 0x94, 0xd0, 0xc4, 0x63, 0x62,
+    0x71, 0xa1, 0xf9, 0x4f, 0x2e, 0xaa, 0xc5, 0x56, 0xe3, 0x39, 0x93, 0xce, 0x65, 0x64, 0xe4, 0x58,
+    0x6c, 0x19, 0x42, 0x79, 0xdd, 0xee, 0x96, 0xf6, 0x8a, 0xec, 0x1e, 0x85, 0x53, 0x45, 0xde, 0xbb,
+    0x7e, 0x0a, 0x9a, 0x13, 0x2a, 0x9d, 0xc2, 0x5e, 0x5a, 0x1f, 0x32, 0x35, 0x9c, 0xa8, 0x73, 0x30,
+    0x29, 0x3d, 0xe7, 0x92, 0x87, 0x1b, 0x2b, 0x4b, 0xa5, 0x57, 0x97, 0x40, 0x15, 0xe6, 0xbc, 0x0e,
+    0xeb, 0xc3, 0x34, 0x2d, 0xb8, 0x44, 0x25, 0xa4, 0x1c, 0xc7, 0x23, 0xed, 0x90, 0x6e, 0x50, 0x00,
+    0x99, 0x9e, 0x4d, 0xd9, 0xda, 0x8d, 0x6f, 0x5f, 0x3e, 0xd7, 0x21, 0x74, 0x86, 0xdf, 0x6b, 0x05,
+    0x8e, 0x5d, 0x37, 0x11, 0xd2, 0x28, 0x75, 0xd6, 0xa7, 0x77, 0x24, 0xbf, 0xf0, 0xb0, 0x02, 0xb7,
+    0xf8, 0xfc, 0x81, 0x09, 0xb1, 0x01, 0x76, 0x91, 0x7d, 0x0f, 0xc8, 0xa0, 0xf2, 0xcb, 0x78, 0x60,
+    0xd1, 0xf7, 0xe0, 0xb5, 0x98, 0x22, 0xb3, 0x20, 0x1d, 0xa6, 0xdb, 0x7b, 0x59, 0x9f, 0xae, 0x31,
+    0xfb, 0xd3, 0xb6, 0xca, 0x43, 0x72, 0x07, 0xf4, 0xd8, 0x41, 0x14, 0x55, 0x0d, 0x54, 0x8b, 0xb9,
+    0xad, 0x46, 0x0b, 0xaf, 0x80, 0x52, 0x2c, 0xfa, 0x8c, 0x89, 0x66, 0xfd, 0xb2, 0xa9, 0x9b, 0xc0,
+};
+
+// bit permutation of the block cipher sbox output.
+const uint8_t kBlockPermBits[8] = {0x02, 0x80, 0x20, 0x10, 0x04, 0x40, 0x01, 0x08};
+
+// 1 based destination of each key bit in the 64 bit key schedule permutation.
+const uint8_t kKeyPerm[64] = {
+    0x12, 0x24, 0x09, 0x07, 0x2a, 0x31, 0x1d, 0x15, 0x1c, 0x36, 0x3e, 0x32, 0x13, 0x21, 0x3b, 0x40,
+    0x18, 0x14, 0x25, 0x27, 0x02, 0x35, 0x1b, 0x01, 0x22, 0x04, 0x0d, 0x0e, 0x39, 0x28, 0x1a, 0x29,
+    0x33, 0x23, 0x34, 0x0c, 0x16, 0x30, 0x1e, 0x3a, 0x2d, 0x1f, 0x08, 0x19, 0x17, 0x2f, 0x3d, 0x11,
+    0x3c, 0x05, 0x38, 0x2b, 0x0b, 0x06, 0x0a, 0x2c, 0x20, 0x3f, 0x2e, 0x0f, 0x03, 0x26, 0x10, 0x37,
+};
+
+const uint8_t kStreamSbox[7][32] = {
+    {2, 0, 1, 1, 2, 3, 3, 0, 3, 2, 2, 0, 1, 1, 0, 3, 0, 3, 3, 0, 2, 2, 1, 1, 2, 2, 0, 3, 1, 1, 3, 0},
+    {3, 1, 0, 2, 2, 3, 3, 0, 1, 3, 2, 1, 0, 0, 1, 2, 3, 1, 0, 3, 3, 2, 0, 2, 0, 0, 1, 2, 2, 1, 3, 1},
+    {2, 0, 1, 2, 2, 3, 3, 1, 1, 1, 0, 3, 3, 0, 2, 0, 1, 3, 0, 1, 3, 0, 2, 2, 2, 0, 1, 2, 0, 3, 3, 1},
+    {3, 1, 2, 3, 0, 2, 1, 2, 1, 2, 0, 1, 3, 0, 0, 3, 1, 0, 3, 1, 2, 3, 0, 3, 0, 3, 2, 0, 1, 2, 2, 1},
+    {2, 0, 0, 1, 3, 2, 3, 2, 0, 1, 3, 3, 1, 0, 2, 1, 2, 3, 2, 0, 0, 3, 1, 1, 1, 0, 3, 2, 3, 1, 0, 2},
+    {0, 1, 2, 3, 1, 2, 2, 0, 0, 1, 3, 0, 2, 3, 1, 3, 2, 3, 0, 2, 3, 0, 1, 1, 2, 1, 1, 2, 0, 3, 3, 0},
+    {0, 3, 2, 2, 3, 0, 0, 1, 3, 0, 1, 3, 1, 2, 2, 1, 1, 0, 3, 3, 0, 1, 1, 2, 2, 3, 1, 0, 2, 3, 0, 2},
+};
+
+struct BlockTables {
+    uint8_t perm[256];
+    // sbox output in the low byte, its permutation in the high one.
+    uint16_t sboxPerm[256];
+
+    BlockTables() {
+        for (int x = 0; x < 256; ++x) {
+            perm[x] = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+                if (x & (1 << bit)) {
+                    perm[x] |= kBlockPermBits[bit];
+                }
+            }
+        }
+        for (int x = 0; x < 256; ++x) {
+            sboxPerm[x] = perm[kBlockSbox[x]] << 8 | kBlockSbox[x];
+        }
+    }
+};
+
+const BlockTables& blockTables()
+{
+    static const BlockTables* t = new BlockTables();
+    return *t;
+}
+
+inline int bit(int v, int n)
+{
+    return (v >> n) & 1;
+}
+
+// the nibble oriented stream cipher, A and B are 1 based as in the standard.
+struct StreamCipher {
+    int A[11];
+    int B[11];
+    int X = 0, Y = 0, Z = 0;
+    int D = 0, E = 0, F = 0;
+    int p = 0, q = 0, r = 0;
+
+    StreamCipher(const uint8_t* cw) {
+        for (int i = 0; i < 4; ++i) {
+            A[1 + 2 * i] = cw[i] >> 4;
+            A[2 + 2 * i] = cw[i] & 0x0F;
+            B[1 + 2 * i] = cw[4 + i] >> 4;
+            B[2 + 2 * i] = cw[4 + i] & 0x0F;
+        }
+        A[0] = A[9] = A[10] = 0;
+        B[0] = B[9] = B[10] = 0;
+    }
+
+    // four clocks, two output bits each, in is only fed during initialization.
+    uint8_t clockByte(bool init, uint8_t in) {
+        int in1 = in >> 4;
+        int in2 = in & 0x0F;
+        int op = 0;
+
+        for (int j = 0; j < 4; ++j) {
+            const int s1 = kStreamSbox[0][bit(A[4], 0) << 4 | bit(A[1], 2) << 3 | bit(A[6], 1) << 2 | bit(A[7], 3) << 1 | bit(A[9], 0)];
+            const int s2 = kStreamSbox[1][bit(A[2], 1) << 4 | bit(A[3], 2) << 3 | bit(A[6], 3) << 2 | bit(A[7], 0) << 1 | bit(A[9], 1)];
+            const int s3 = kStreamSbox[2][bit(A[1], 3) << 4 | bit(A[2], 0) << 3 | bit(A[5], 1) << 2 | bit(A[5], 3) << 1 | bit(A[6], 2)];
+            const int s4 = kStreamSbox[3][bit(A[3], 3) << 4 | bit(A[1], 1) << 3 | bit(A[2], 3) << 2 | bit(A[4], 2) << 1 | bit(A[8], 0)];
+            const int s5 = kStreamSbox[4][bit(A[5], 2) << 4 | bit(A[4], 3) << 3 | bit(A[6], 0) << 2 | bit(A[8], 1) << 1 | bit(A[9], 2)];
+            const int s6 = kStreamSbox[5][bit(A[3], 1) << 4 | bit(A[4], 1) << 3 | bit(A[5], 0) << 2 | bit(A[7], 2) << 1 | bit(A[9], 3)];
+            const int s7 = kStreamSbox[6][bit(A[2], 2) << 4 | bit(A[3], 0) << 3 | bit(A[7], 1) << 2 | bit(A[8], 2) << 1 | bit(A[8], 3)];
+
+            int extraB = (((B[3] & 1) << 3) ^ ((B[6] & 2) << 2) ^ ((B[7] & 4) << 1) ^ (B[9] & 8)) |
+                         (((B[6] & 1) << 2) ^ ((B[8] & 2) << 1) ^ ((B[3] & 8) >> 1) ^ (B[4] & 4)) |
+                         (((B[5] & 8) >> 2) ^ ((B[8] & 4) >> 1) ^ ((B[4] & 1) << 1) ^ (B[5] & 2)) |
+                         (((B[9] & 4) >> 2) ^ ((B[6] & 8) >> 3) ^ ((B[3] & 2) >> 1) ^ (B[8] & 1));
+
+            int nextA1 = A[10] ^ X;
+            if (init) {
+                nextA1 ^= D ^ ((j % 2) ? in2 : in1);
+            }
+
+            int nextB1 = B[7] ^ B[10] ^ Y;
+            if (init) {
+                nextB1 ^= (j % 2) ? in1 : in2;
+            }
+            if (p) {
+                nextB1 = ((nextB1 << 1) | ((nextB1 >> 3) & 1)) & 0x0F;
+            }
+
+            D = E ^ Z ^ extraB;
+
+            int nextE = F;
+            if (q) {
+                F = Z + E + r;
+                r = (F >> 4) & 1;
+                F &= 0x0F;
+            } else {
+                F = E;
+            }
+            E = nextE;
+
+            for (int k = 10; k > 1; --k) {
+                A[k] = A[k - 1];
+                B[k] = B[k - 1];
+            }
+            A[1] = nextA1;
+            B[1] = nextB1;
+
+            X = ((s4 & 1) << 3) | ((s3 & 1) << 2) | (s2 & 2) | ((s1 & 2) >> 1);
+            Y = ((s6 & 1) << 3) | ((s5 & 1) << 2) | (s4 & 2) | ((s3 & 2) >> 1);
+            Z = ((s2 & 1) << 3) | ((s1 & 1) << 2) | (s7 & 2) | ((s6 & 2) >> 1);
+            p = (s7 & 2) >> 1;
+            q = s7 & 1;
+
+            op = (op << 2) ^ ((((D ^ (D >> 1)) >> 1) & 2) | ((D ^ (D >> 1)) & 1));
+        }
+
+        return op;
+    }
+};
+
+// sbox input bits of the stream cipher, register and bit, most significant first.
+const uint8_t kStreamSboxInput[7][5][2] = {
+    {{4, 0}, {1, 2}, {6, 1}, {7, 3}, {9, 0}},
+    {{2, 1}, {3, 2}, {6, 3}, {7, 0}, {9, 1}},
+    {{1, 3}, {2, 0}, {5, 1}, {5, 3}, {6, 2}},
+    {{3, 3}, {1, 1}, {2, 3}, {4, 2}, {8, 0}},
+    {{5, 2}, {4, 3}, {6, 0}, {8, 1}, {9, 2}},
+    {{3, 1}, {4, 1}, {5, 0}, {7, 2}, {9, 3}},
+    {{2, 2}, {3, 0}, {7, 1}, {8, 2}, {8, 3}},
+};
+
+// algebraic normal form of a stream sbox output bit: bit m set if the product
+// of the input bits in m is one of the terms xored together.
+constexpr uint32_t streamSboxAnf(int s, int o)
+{
+    uint8_t a[32] = {};
+    for (int x = 0; x < 32; ++x) {
+        a[x] = (kStreamSbox[s][x] >> o) & 1;
+    }
+    for (int i = 0; i < 5; ++i) {
+        for (int x = 0; x < 32; ++x) {
+            if (x & (1 << i)) {
+                a[x] ^= a[x ^ (1 << i)];
+            }
+        }
+    }
+    uint32_t anf = 0;
+    for (int m = 0; m < 32; ++m) {
+        anf |= (uint32_t)a[m] << m;
+    }
+    return anf;
+}
+
+constexpr uint32_t kStreamSboxAnf[7][2] = {
+    {streamSboxAnf(0, 0), streamSboxAnf(0, 1)},
+    {streamSboxAnf(1, 0), streamSboxAnf(1, 1)},
+    {streamSboxAnf(2, 0), streamSboxAnf(2, 1)},
+    {streamSboxAnf(3, 0), streamSboxAnf(3, 1)},
+    {streamSboxAnf(4, 0), streamSboxAnf(4, 1)},
+    {streamSboxAnf(5, 0), streamSboxAnf(5, 1)},
+    {streamSboxAnf(6, 0), streamSboxAnf(6, 1)},
+};
+
+// the stream cipher of up to 64 packets at once, one bit of state per lane.
+struct BitslicedStreamCipher {
+    using Word = uint64_t;
+
+    Word A[11][4];
+    Word B[11][4];
+    Word X[4]{}, Y[4]{}, Z[4]{};
+    Word D[4]{}, E[4]{}, F[4]{};
+    Word p = 0, q = 0, r = 0;
+
+    BitslicedStreamCipher(const uint8_t* cw) {
+        memset(A, 0, sizeof(A));
+        memset(B, 0, sizeof(B));
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 4; ++b) {
+                A[1 + 2 * i][b] = bit(cw[i], 4 + b) ? ~(Word)0 : 0;
+                A[2 + 2 * i][b] = bit(cw[i], b) ? ~(Word)0 : 0;
+                B[1 + 2 * i][b] = bit(cw[4 + i], 4 + b) ? ~(Word)0 : 0;
+                B[2 + 2 * i][b] = bit(cw[4 + i], b) ? ~(Word)0 : 0;
+            }
+        }
+    }
+
+    // the terms are known at compile time, the unrolled loops leave only the needed ones.
+    template <int S>
+    void sbox(Word* hi, Word* lo) const {
+        Word v[5];
+        for (int i = 0; i < 5; ++i) {
+            v[4 - i] = A[kStreamSboxInput[S][i][0]][kStreamSboxInput[S][i][1]];
+        }
+
+        Word m[32];
+        m[0] = ~(Word)0;
+#pragma GCC unroll 32
+        for (int i = 1; i < 32; ++i) {
+            m[i] = m[i & (i - 1)] & v[__builtin_ctz(i)];
+        }
+
+        Word out[2] = {0, 0};
+#pragma GCC unroll 2
+        for (int o = 0; o < 2; ++o) {
+#pragma GCC unroll 32
+            for (int i = 0; i < 32; ++i) {
+                if ((kStreamSboxAnf[S][o] >> i) & 1) {
+                    out[o] ^= m[i];
+                }
+            }
+        }
+        *lo = out[0];
+        *hi = out[1];
+    }
+
+    // one clock, in is the nibble fed during initialization, or null.
+    // the two output bits are returned in *hi and *lo.
+    void clock(const Word* inA, const Word* inB, Word* hi, Word* lo) {
+        Word sh[7], sl[7];
+        sbox<0>(&sh[0], &sl[0]);
+        sbox<1>(&sh[1], &sl[1]);
+        sbox<2>(&sh[2], &sl[2]);
+        sbox<3>(&sh[3], &sl[3]);
+        sbox<4>(&sh[4], &sl[4]);
+        sbox<5>(&sh[5], &sl[5]);
+        sbox<6>(&sh[6], &sl[6]);
+
+        Word extraB[4];
+        extraB[3] = B[3][0] ^ B[6][1] ^ B[7][2] ^ B[9][3];
+        extraB[2] = B[6][0] ^ B[8][1] ^ B[3][3] ^ B[4][2];
+        extraB[1] = B[5][3] ^ B[8][2] ^ B[4][0] ^ B[5][1];
+        extraB[0] = B[9][2] ^ B[6][3] ^ B[3][1] ^ B[8][0];
+
+        Word nextA1[4], nextB1[4];
+        for (int b = 0; b < 4; ++b) {
+            nextA1[b] = A[10][b] ^ X[b];
+            nextB1[b] = B[7][b] ^ B[10][b] ^ Y[b];
+            if (inA != nullptr) {
+                nextA1[b] ^= D[b] ^ inA[b];
+                nextB1[b] ^= inB[b];
+            }
+        }
+        Word rotated[4] = {nextB1[3], nextB1[0], nextB1[1], nextB1[2]};
+        for (int b = 0; b < 4; ++b) {
+            nextB1[b] = (p & rotated[b]) | (~p & nextB1[b]);
+        }
+
+        Word nextE[4];
+        Word carry = r;
+        for (int b = 0; b < 4; ++b) {
+            D[b] = E[b] ^ Z[b] ^ extraB[b];
+            nextE[b] = F[b];
+            Word sum = Z[b] ^ E[b] ^ carry;
+            carry = (Z[b] & E[b]) | (carry & (Z[b] ^ E[b]));
+            F[b] = (q & sum) | (~q & E[b]);
+        }
+        r = (q & carry) | (~q & r);
+        memcpy(E, nextE, sizeof(E));
+
+        memmove(A[2], A[1], sizeof(A[1]) * 9);
+        memmove(B[2], B[1], sizeof(B[1]) * 9);
+        memcpy(A[1], nextA1, sizeof(nextA1));
+        memcpy(B[1], nextB1, sizeof(nextB1));
+
+        X[3] = sl[3]; X[2] = sl[2]; X[1] = sh[1]; X[0] = sh[0];
+        Y[3] = sl[5]; Y[2] = sl[4]; Y[1] = sh[3]; Y[0] = sh[2];
+        Z[3] = sl[1]; Z[2] = sl[0]; Z[1] = sh[6]; Z[0] = sh[5];
+        p = sh[6];
+        q = sl[6];
+
+        *hi = D[2] ^ D[3];
+        *lo = D[0] ^ D[1];
+    }
+
+    // a byte of every lane, as bit planes, least significant first.
+    void clockByte(const Word* in, Word* out) {
+        for (int j = 0; j < 4; ++j) {
+            const Word* inA = nullptr;
+            const Word* inB = nullptr;
+            if (in != nullptr) {
+                inA = (j % 2) ? in : in + 4;
+                inB = (j % 2) ? in + 4 : in;
+            }
+            clock(inA, inB, &out[7 - 2 * j], &out[6 - 2 * j]);
+        }
+    }
+};
+
+inline uint64_t load64(const uint8_t* p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+// row r bit c moves to row c bit r.
+void transpose64(uint64_t a[64])
+{
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+inline void xor64(uint8_t* dst, const uint8_t* src)
+{
+    for (int i = 0; i < 8; ++i) {
+        dst[i] ^= src[i];
+    }
+}
+
+}
+
+void AmlDvbCsa::setKey(const uint8_t cw[kKeySize])
+{
+    memcpy(mCw, cw, kKeySize);
+
+    // kb[6] is the control word, each kb[i - 1] the bit permutation of kb[i].
+    uint8_t kb[7][8];
+    memcpy(kb[6], cw, kKeySize);
+    for (int i = 6; i > 0; --i) {
+        uint8_t bits[64];
+        for (int j = 0; j < 64; ++j) {
+            bits[kKeyPerm[j] - 1] = (kb[i][j / 8] >> (7 - j % 8)) & 1;
+        }
+        for (int j = 0; j < 8; ++j) {
+            kb[i - 1][j] = 0;
+            for (int k = 0; k < 8; ++k) {
+                kb[i - 1][j] |= bits[j * 8 + k] << (7 - k);
+            }
+        }
+    }
+
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            mKeySchedule[i * 8 + j] = kb[i][j] ^ i;
+        }
+    }
+}
+
+void AmlDvbCsa::encryptBlock(uint8_t* block) const
+{
+    const uint8_t* perm = blockTables().perm;
+    int R[9];
+    for (int i = 0; i < 8; ++i) {
+        R[i + 1] = block[i];
+    }
+
+    for (int i = 0; i < kRounds; ++i) {
+        const int sboxOut = kBlockSbox[mKeySchedule[i] ^ R[8]];
+        const int nextR1 = R[2];
+        R[2] = R[3] ^ R[1];
+        R[3] = R[4] ^ R[1];
+        R[4] = R[5] ^ R[1];
+        R[5] = R[6];
+        R[6] = R[7] ^ perm[sboxOut];
+        R[7] = R[8];
+        R[8] = R[1] ^ sboxOut;
+        R[1] = nextR1;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        block[i] = R[i + 1];
+    }
+}
+
+// blocks are independent in decryption, several of them run interleaved to
+// hide the latency of the sbox lookups that chain the rounds of one block.
+template <int N>
+void AmlDvbCsa::decryptBlocks(uint8_t* const* blocks) const
+{
+    const uint16_t* sboxPerm = blockTables().sboxPerm;
+    int R[N][9];
+    for (int n = 0; n < N; ++n) {
+        for (int i = 0; i < 8; ++i) {
+            R[n][i + 1] = blocks[n][i];
+        }
+    }
+
+    for (int i = kRounds - 1; i >= 0; --i) {
+        const int key = mKeySchedule[i];
+#pragma GCC unroll 4
+        for (int n = 0; n < N; ++n) {
+            const int sp = sboxPerm[key ^ R[n][7]];
+            const int t = R[n][8] ^ (sp & 0xFF);
+            const int nextR8 = R[n][7];
+            R[n][7] = R[n][6] ^ (sp >> 8);
+            R[n][6] = R[n][5];
+            R[n][5] = R[n][4] ^ t;
+            R[n][4] = R[n][3] ^ t;
+            R[n][3] = R[n][2] ^ t;
+            R[n][2] = R[n][1];
+            R[n][1] = t;
+            R[n][8] = nextR8;
+        }
+    }
+
+    for (int n = 0; n < N; ++n) {
+        for (int i = 0; i < 8; ++i) {
+            blocks[n][i] = R[n][i + 1];
+        }
+    }
+}
+
+// the first block output of the block cipher initializes the stream cipher.
+void AmlDvbCsa::streamXor(const uint8_t* iv, uint8_t* data, size_t size) const
+{
+    StreamCipher stream(mCw);
+    for (int i = 0; i < 8; ++i) {
+        stream.clockByte(true, iv[i]);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        data[i] ^= stream.clockByte(false, 0);
+    }
+}
+
+void AmlDvbCsa::streamXor(uint8_t* const* data, const size_t* sizes, size_t count) const
+{
+    using Word = BitslicedStreamCipher::Word;
+    BitslicedStreamCipher stream(mCw);
+
+    // 8 bytes of each lane, byte i bit b of all lanes in words[8 * i + b] once transposed.
+    Word words[64];
+    memset(words, 0, sizeof(words));
+    size_t maxSize = 0;
+    for (size_t l = 0; l < count; ++l) {
+        words[l] = load64(data[l]);
+        maxSize = std::max(maxSize, sizes[l]);
+    }
+    transpose64(words);
+
+    Word out[8];
+    for (int i = 0; i < 8; ++i) {
+        stream.clockByte(&words[8 * i], out);
+    }
+
+    for (size_t offset = 8; offset < maxSize; offset += 8) {
+        for (int i = 0; i < 8; ++i) {
+            stream.clockByte(nullptr, &words[8 * i]);
+        }
+        transpose64(words);
+
+        for (size_t l = 0; l < count; ++l) {
+            if (offset >= sizes[l]) {
+                continue;
+            }
+            size_t n = std::min<size_t>(sizes[l] - offset, 8);
+            for (size_t i = 0; i < n; ++i) {
+                data[l][offset + i] ^= words[l] >> (8 * i);
+            }
+        }
+    }
+}
+
+void AmlDvbCsa::decrypt(uint8_t* const* data, const size_t* sizes, size_t count) const
+{
+    while (count > 0) {
+        size_t n = std::min(count, kBatchSize);
+        if (n < kMinBatchSize) {
+            for (size_t l = 0; l < n; ++l) {
+                decrypt(data[l], sizes[l]);
+            }
+        } else {
+            // payloads under 8 bytes are left out of the batch.
+            uint8_t* batch[kBatchSize];
+            size_t batchSizes[kBatchSize];
+            size_t m = 0;
+            for (size_t l = 0; l < n; ++l) {
+                if (sizes[l] >= 8) {
+                    batch[m] = data[l];
+                    batchSizes[m++] = sizes[l];
+                }
+            }
+
+            streamXor(batch, batchSizes, m);
+            for (size_t l = 0; l < m; ++l) {
+                decryptBlocks(batch[l], batchSizes[l]);
+            }
+        }
+
+        data += n;
+        sizes += n;
+        count -= n;
+    }
+}
+
+void AmlDvbCsa::encrypt(uint8_t* data, size_t size) const
+{
+    if (size < 8) {
+        return;
+    }
+
+    // block layer in reverse chaining from the last whole block.
+    size_t i = size / 8 * 8 - 8;
+    encryptBlock(data + i);
+    while (i > 0) {
+        xor64(data + i - 8, data + i);
+        i -= 8;
+        encryptBlock(data + i);
+    }
+
+    streamXor(data, data + 8, size - 8);
+}
+
+void AmlDvbCsa::decrypt(uint8_t* data, size_t size) const
+{
+    if (size < 8) {
+        return;
+    }
+
+    streamXor(data, data + 8, size - 8);
+    decryptBlocks(data, size);
+}
+
+void AmlDvbCsa::decryptBlocks(uint8_t* data, size_t size) const
+{
+    // DB(i) = D(IB(i)) ^ IB(i + 1), with IB(i + 1) still scrambled.
+    static constexpr int kInterleave = 4;
+    size_t blocks = size / 8;
+    uint8_t scrambled[kInterleave + 1][8];
+
+    for (size_t i = 0; i < blocks; i += kInterleave) {
+        size_t n = std::min<size_t>(blocks - i, kInterleave);
+        memcpy(scrambled, data + 8 * i, 8 * std::min<size_t>(blocks - i, kInterleave + 1));
+
+        uint8_t* b[kInterleave];
+        for (size_t j = 0; j < n; ++j) {
+            b[j] = data + 8 * (i + j);
+        }
+        switch (n) {
+        case 1: decryptBlocks<1>(b); break;
+        case 2: decryptBlocks<2>(b); break;
+        case 3: decryptBlocks<3>(b); break;
+        default: decryptBlocks<kInterleave>(b); break;
+        }
+
+        for (size_t j = 0; j < n; ++j) {
+            if (i + j + 1 < blocks) {
+                xor64(b[j], scrambled[j + 1]);
+            }
+        }
+    }
+}
+
+}
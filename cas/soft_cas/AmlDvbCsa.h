@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVB_CSA_H_
+#define _AML_DVB_CSA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aml_mp {
+
+/*
+ * DVB-CSA2 (ETSI TS 100 289) for the software descrambler.
+ *
+ * The block cipher key schedule is computed once per control word, the
+ * stream cipher is initialized per TS packet payload as the standard wants.
+ * The stream cipher is the costly part, nibble wide and clocked four times a
+ * byte. For a batch of payloads it runs bitsliced, each bit of its state a
+ * 64 bit word holding that bit of 64 packets, the sboxes evaluated in their
+ * algebraic normal form.
+ */
+class AmlDvbCsa
+{
+public:
+    static constexpr size_t kKeySize = 8;
+    static constexpr size_t kBatchSize = 64;
+
+    AmlDvbCsa() = default;
+
+    void setKey(const uint8_t cw[kKeySize]);
+
+    // a TS packet payload in place, payloads under 8 bytes are not scrambled.
+    void encrypt(uint8_t* data, size_t size) const;
+    void decrypt(uint8_t* data, size_t size) const;
+    // payloads of several TS packets scrambled with this key.
+    void decrypt(uint8_t* const* data, const size_t* sizes, size_t count) const;
+
+private:
+    static constexpr int kRounds = 56;
+    // a few packets are faster one by one than in a mostly empty batch.
+    static constexpr size_t kMinBatchSize = 4;
+
+    void encryptBlock(uint8_t* block) const;
+    template <int N>
+    void decryptBlocks(uint8_t* const* blocks) const;
+    void decryptBlocks(uint8_t* data, size_t size) const;
+    void streamXor(const uint8_t* iv, uint8_t* data, size_t size) const;
+    void streamXor(uint8_t* const* data, const size_t* sizes, size_t count) const;
+
+    uint8_t mCw[kKeySize]{};
+    uint8_t mKeySchedule[kRounds]{};
+};
+
+}
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlSoftCas"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include "AmlSoftCas.h"
+#include <string.h>
+#include <inttypes.h>
+#include <string>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const size_t kTsPacketSize = 188;
+
+static int hexToBytes(const std::string& hex, uint8_t* out, size_t size)
+{
+    if (hex.size() != size * 2) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        char* end;
+        out[i] = strtoul(byte, &end, 16);
+        if (*end != '\0') {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+AmlSoftCas::AmlSoftCas(Aml_MP_CASServiceType serviceType)
+: AmlCasBase(serviceType)
+{
+    MLOGI("ctor AmlSoftCas");
+}
+
+AmlSoftCas::~AmlSoftCas()
+{
+    MLOGI("dtor AmlSoftCas, packets:%" PRIu64 ", descrambled:%" PRIu64 ", no key:%" PRIu64,
+            mPackets, mDescrambled, mNoKey);
+}
+
+int AmlSoftCas::startDescrambling(const Aml_MP_IptvCASParams* params)
+{
+    return AmlCasBase::startDescrambling(params);
+}
+
+int AmlSoftCas::stopDescrambling()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mKeys[0] = Key();
+    mKeys[1] = Key();
+
+    return 0;
+}
+
+int AmlSoftCas::processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size)
+{
+    AML_MP_UNUSED(isSection);
+    AML_MP_UNUSED(ecmPid);
+    AML_MP_UNUSED(data);
+    AML_MP_UNUSED(size);
+
+    // clear keys only, they come through ioctl.
+    return 0;
+}
+
+int AmlSoftCas::decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer* outbuffer)
+{
+    AML_MP_UNUSED(ext_data);
+    RETURN_IF(-1, in == nullptr || size < 0);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    outbuffer->address = in;
+    outbuffer->size = descramble_l(in, size);
+
+    return 0;
+}
+
+int AmlSoftCas::decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers)
+{
+    AML_MP_UNUSED(ext_data);
+    beginDecryptv(iov, iovcnt, outbuffers);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    for (int i = 0; i < iovcnt; ++i) {
+        uint8_t* in = static_cast<uint8_t*>(iov[i].iov_base);
+        size_t size = descramble_l(in, iov[i].iov_len);
+        int ret = putDecrypted(in, in, size, &outbuffers[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int AmlSoftCas::ioctl(const char* inJson, char* outJson, uint32_t outLen)
+{
+    RETURN_IF(-1, inJson == nullptr);
+
+    std::string cmd;
+    if (!jsonString(inJson, "cmd", &cmd)) {
+        MLOGE("no cmd in %s", inJson);
+        return -1;
+    }
+
+    if (cmd == "setKey") {
+        return setKey(inJson);
+    } else if (cmd == "clearKeys") {
+        return stopDescrambling();
+    } else if (cmd == "getStats") {
+        RETURN_IF(-1, outJson == nullptr || outLen == 0);
+        std::lock_guard<std::mutex> _l(mLock);
+        snprintf(outJson, outLen, "{\"packets\":%" PRIu64 ",\"descrambled\":%" PRIu64 ",\"noKey\":%" PRIu64 "}",
+                mPackets, mDescrambled, mNoKey);
+        return 0;
+    }
+
+    MLOGE("unknown cmd %s", cmd.c_str());
+    return -1;
+}
+
+int AmlSoftCas::setKey(const char* json)
+{
+    Key key;
+    std::string value;
+
+    if (!jsonString(json, "algo", &value)) {
+        MLOGE("no algo!");
+        return -1;
+    }
+    if (value == "aes") {
+        key.algo = kAlgoAes;
+    } else if (value == "csa") {
+        key.algo = kAlgoCsa;
+    } else {
+        MLOGE("unsupported algo %s", value.c_str());
+        return -1;
+    }
+
+    std::string hex;
+    uint8_t bytes[AmlAes128::kKeySize];
+    size_t keySize = key.algo == kAlgoAes ? AmlAes128::kKeySize : AmlDvbCsa::kKeySize;
+    if (!jsonString(json, "key", &hex) || hexToBytes(hex, bytes, keySize) < 0) {
+        MLOGE("key must be %zu hex bytes!", keySize);
+        return -1;
+    }
+    if (key.algo == kAlgoAes) {
+        key.aes.setKey(bytes);
+    } else {
+        key.csa.setKey(bytes);
+    }
+
+    key.cbc = jsonString(json, "mode", &value) && value == "cbc";
+    key.alignRight = jsonString(json, "alignment", &value) && value == "right";
+    if (jsonString(json, "iv", &hex) && hexToBytes(hex, key.iv, sizeof(key.iv)) < 0) {
+        MLOGE("iv must be %zu hex bytes!", sizeof(key.iv));
+        return -1;
+    }
+
+    std::string parity = "both";
+    jsonString(json, "parity", &parity);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (parity == "even" || parity == "both") {
+        mKeys[0] = key;
+    }
+    if (parity == "odd" || parity == "both") {
+        mKeys[1] = key;
+    }
+    MLOGI("%s key set, %s%s", parity.c_str(), key.algo == kAlgoAes ? "aes" : "csa",
+            key.algo == kAlgoAes ? (key.cbc ? " cbc" : " ecb") : "");
+
+    return 0;
+}
+
+size_t AmlSoftCas::descramble_l(uint8_t* data, size_t size)
+{
+    // chunks need not start on a packet, resync on 0x47 and pass the bytes
+    // out of sync and a trailing partial packet through as they are.
+    size_t offset = 0;
+    while (offset + kTsPacketSize <= size) {
+        uint8_t* p = data + offset;
+        if (p[0] != 0x47 || (offset + kTsPacketSize < size && p[kTsPacketSize] != 0x47)) {
+            offset++;
+            continue;
+        }
+        offset += kTsPacketSize;
+        mPackets++;
+
+        int scrambling = p[3] >> 6;
+        if (scrambling < 2) {
+            continue;
+        }
+
+        int parity = scrambling & 1;
+        const Key& key = mKeys[parity];
+        if (key.algo == kAlgoNone) {
+            mNoKey++;
+            continue;
+        }
+
+        size_t header = 4;
+        if (p[3] & 0x20) {
+            header += 1 + p[4];
+        }
+        p[3] &= 0x3F;
+        mDescrambled++;
+        if (!(p[3] & 0x10) || header >= kTsPacketSize) {
+            continue;
+        }
+
+        uint8_t* payload = p + header;
+        size_t payloadSize = kTsPacketSize - header;
+        if (key.algo == kAlgoAes) {
+            descrambleAes(key, payload, payloadSize);
+        } else {
+            CsaBatch& batch = mCsaBatch[parity];
+            batch.data[batch.count] = payload;
+            batch.sizes[batch.count] = payloadSize;
+            if (++batch.count == AmlDvbCsa::kBatchSize) {
+                flushCsa_l(parity);
+            }
+        }
+    }
+
+    flushCsa_l(0);
+    flushCsa_l(1);
+
+    return size;
+}
+
+void AmlSoftCas::descrambleAes(const Key& key, uint8_t* payload, size_t size)
+{
+    size_t blocks = size / AmlAes128::kBlockSize;
+    if (key.alignRight) {
+        payload += size % AmlAes128::kBlockSize;
+    }
+
+    if (key.cbc) {
+        key.aes.decryptCbc(payload, blocks, key.iv);
+    } else {
+        key.aes.decryptEcb(payload, blocks);
+    }
+}
+
+void AmlSoftCas::flushCsa_l(int parity)
+{
+    CsaBatch& batch = mCsaBatch[parity];
+    if (batch.count > 0) {
+        mKeys[parity].csa.decrypt(batch.data, batch.sizes, batch.count);
+        batch.count = 0;
+    }
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_SOFT_CAS_H_
+#define _AML_SOFT_CAS_H_
+
+#include <cas/AmlCasBase.h>
+#include "AmlAes128.h"
+#include "AmlDvbCsa.h"
+#include <mutex>
+
+namespace aml_mp {
+
+/*
+ * Descrambles TS packets in software with clear keys, for IPTV streams
+ * and lab streams on boxes without a DSC.
+ *
+ * The keys come through Aml_MP_CAS_Ioctl():
+ *   {"cmd":"setKey", "parity":"even", "algo":"aes", "mode":"cbc",
+ *    "alignment":"left", "key":"<hex>", "iv":"<hex>"}
+ *   {"cmd":"clearKeys"}
+ *   {"cmd":"getStats"}
+ * parity is even, odd or both (default), algo aes (AES-128) or csa
+ * (DVB-CSA2), mode ecb (default) or cbc, and alignment tells which end of an
+ * AES payload holds the whole blocks, the residue is left in the clear, as
+ * signalled by ProgramInfo::scrambleInfo. Packets scrambled with a parity
+ * that has no key are passed through untouched.
+ *
+ * Aml_MP_CAS_DecryptIPTV() and Aml_MP_CAS_DecryptIPTVv() descramble in place
+ * and return the whole chunk, bytes out of packet sync are left as they are.
+ */
+class AmlSoftCas : public AmlCasBase
+{
+public:
+    AmlSoftCas(Aml_MP_CASServiceType serviceType);
+    ~AmlSoftCas();
+    virtual int startDescrambling(const Aml_MP_IptvCASParams* params) override;
+    virtual int stopDescrambling() override;
+    virtual int processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size) override;
+    virtual int decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer* outbuffer) override;
+    virtual int decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers) override;
+    virtual int ioctl(const char* inJson, char* outJson, uint32_t outLen) override;
+
+private:
+    enum Algo {
+        kAlgoNone,
+        kAlgoAes,
+        kAlgoCsa,
+    };
+
+    struct Key {
+        Algo algo = kAlgoNone;
+        bool cbc = false;
+        bool alignRight = false;
+        uint8_t iv[AmlAes128::kBlockSize]{};
+        AmlAes128 aes;
+        AmlDvbCsa csa;
+    };
+
+    // CSA payloads of one parity, descrambled together.
+    struct CsaBatch {
+        uint8_t* data[AmlDvbCsa::kBatchSize];
+        size_t sizes[AmlDvbCsa::kBatchSize];
+        size_t count = 0;
+    };
+
+    int setKey(const char* json);
+    size_t descramble_l(uint8_t* data, size_t size);
+    void descrambleAes(const Key& key, uint8_t* payload, size_t size);
+    void flushCsa_l(int parity);
+
+    std::mutex mLock;
+    Key mKeys[2];    // even, odd
+    CsaBatch mCsaBatch[2];
+    uint64_t mPackets = 0;
+    uint64_t mDescrambled = 0;
+    uint64_t mNoKey = 0;
+
+    AmlSoftCas(const AmlSoftCas&) = delete;
+    AmlSoftCas& operator= (const AmlSoftCas&) = delete;
+};
+
+}
+
+#endif
@@ -53,12 +53,20 @@ int AmlVMXIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* params)
     AmlCasBase::startDescrambling(params);
 
     int ret = 0;
+    if (mSessionOpened) {
+        // provisioned and opened by the session pool, bind it to the service.
+        setDscSource(TSN_IPTV);
+        MLOGI("%s, rebind vpid=0x%x, apid=0x%x, vecm:%#x, acem:%#x", __func__, params->videoPid, params->audioPid,
+            params->ecmPid[1], params->ecmPid[0]);
+        return pIptvCas->setPids(params->videoPid, params->audioPid);
+    }
+
     iptvseverinfo_t initParam = {0};
     initParam.enablelog = 1;
-    initParam.serveraddr = (char*)params->serverAddress;
-    snprintf(mServerPort, sizeof(mServerPort), "%d", params->serverPort);
+    initParam.serveraddr = mIptvCasParam.serverAddress;
+    snprintf(mServerPort, sizeof(mServerPort), "%d", mIptvCasParam.serverPort);
     initParam.serverport = mServerPort;
-    initParam.storepath = (char*)params->keyPath;
+    initParam.storepath = mIptvCasParam.keyPath;
     pIptvCas->setPrivateData((void *)&initParam, sizeof(iptvseverinfo_t));
 
     ret = pIptvCas->provision();
@@ -69,11 +77,62 @@ int AmlVMXIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* params)
             params->ecmPid[1], params->ecmPid[0]);
         pIptvCas->setPids(params->videoPid, params->audioPid);
         ret = pIptvCas->openSession(&sessionId[0]);
+        mSessionOpened = ret == 0;
+    }
+
+    return ret;
+}
+
+int AmlVMXIptvCas_V2::prepareSession(const Aml_MP_IptvCASParams* params)
+{
+    MLOG();
+    RETURN_IF(-1, pIptvCas == nullptr);
+
+    if (mSessionOpened) {
+        return 0;
+    }
+    // ECMs may be processed before the session is bound to the service, and
+    // the vendor lib keeps the server address and key path pointers.
+    mIptvCasParam = *params;
+
+    iptvseverinfo_t initParam = {0};
+    initParam.enablelog = 1;
+    initParam.serveraddr = mIptvCasParam.serverAddress;
+    snprintf(mServerPort, sizeof(mServerPort), "%d", mIptvCasParam.serverPort);
+    initParam.serverport = mServerPort;
+    initParam.storepath = mIptvCasParam.keyPath;
+    pIptvCas->setPrivateData((void *)&initParam, sizeof(iptvseverinfo_t));
+
+    int ret = pIptvCas->provision();
+    if (ret != 0) {
+        MLOGE("provision failed, ret =%d", ret);
+        return ret;
     }
 
+    pIptvCas->setPids(params->videoPid, params->audioPid);
+    ret = pIptvCas->openSession(&sessionId[0]);
+    mSessionOpened = ret == 0;
+
     return ret;
 }
 
+int AmlVMXIptvCas_V2::suspendDescrambling()
+{
+    MLOG();
+
+    setDscSource(TSN_DVB);
+    mFirstEcm = 0;
+    memset(mEcmTsPacket, 0, sizeof(mEcmTsPacket));
+    resetEcmHistory();
+
+    return 0;
+}
+
+bool AmlVMXIptvCas_V2::isSessionOpen() const
+{
+    return mSessionOpened;
+}
+
 int AmlVMXIptvCas_V2::stopDescrambling()
 {
     MLOG();
@@ -85,6 +144,7 @@ int AmlVMXIptvCas_V2::stopDescrambling()
         ret = pIptvCas->closeSession(&sessionId[0]);
         pIptvCas.clear();
     }
+    mSessionOpened = false;
 
     return ret;
 }
@@ -238,7 +298,9 @@ int AmlVMXIptvCas_V2::setDscSource(const char* source)
         ret = amsysfs_set_sysfs_str(DMX0_SOURCE_PATH, DMX_SRC);
         if (ret)
             MLOGI("Error ret 0x%x\n", ret);
-        mDscFd = dscDevOpen(DSC_DEVICE, O_RDWR);
+        if (mDscFd < 0) {
+            mDscFd = dscDevOpen(DSC_DEVICE, O_RDWR);
+        }
         MLOGI("%s, dsc_fd=%d\n", __func__, mDscFd);
         ret = amsysfs_set_sysfs_str(DSC0_SOURCE_PATH, DSC_SRC);
         if (ret)
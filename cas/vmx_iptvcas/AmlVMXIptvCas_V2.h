@@ -24,6 +24,9 @@ public:
     ~AmlVMXIptvCas_V2();
     virtual int startDescrambling(const Aml_MP_IptvCASParams* params) override;
     virtual int stopDescrambling() override;
+    virtual int prepareSession(const Aml_MP_IptvCASParams* params) override;
+    virtual int suspendDescrambling() override;
+    virtual bool isSessionOpen() const override;
     virtual int setPrivateData(const uint8_t* data, size_t size) override;
     virtual int processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size) override;
     virtual int processEmm(const uint8_t* data, size_t size) override;
@@ -33,6 +36,7 @@ private:
     sptr<AmCasLibWrapper<AML_MP_CAS_SERVICE_VERIMATRIX_IPTV>> pIptvCas;
     uint8_t sessionId[8]{};
     int mInstanceId;
+    bool mSessionOpened = false;
 
     int mDscFd = -1;
     int mFirstEcm = 0;
@@ -10,6 +10,7 @@
 #define LOG_TAG "AmlVMXWebCas"
 #include <utils/Log.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpConfig.h>
 #include "AmlVMXWebCas.h"
 #include <dlfcn.h>
 #include <cutils/properties.h>
@@ -18,6 +19,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <string.h>
+#include <algorithm>
 
 static const char* mName = LOG_TAG;
 
@@ -26,6 +29,7 @@ namespace aml_mp {
 
 AmlVMXWebCas::AmlVMXWebCas(Aml_MP_CASServiceType serviceType)
 :AmlCasBase(serviceType)
+, mDecryptBatchSize((size_t)std::max(AmlMpConfig::instance().mCasDecryptBatch, 0) * 1024 / 188 * 188)
 {
     MLOGI("ctor AmlVMXWebCas");
     pIptvCas = new AmCasLibWrapper<AML_MP_CAS_SERVICE_VERIMATRIX_WEB>("libdec_ca_vmx_web.so");
@@ -127,6 +131,86 @@ int AmlVMXWebCas::decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer*
     return 0;
 }
 
+int AmlVMXWebCas::decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers)
+{
+    beginDecryptv(iov, iovcnt, outbuffers);
+
+    int i = 0;
+    while (i < iovcnt) {
+        // whole TS packets of a run of chunks go to the cas lib in one call,
+        // hls data is decrypted chunk by chunk.
+        int count = 0;
+        size_t size = 0;
+        while (ext_data == nullptr && i + count < iovcnt && iov[i + count].iov_len % 188 == 0 &&
+               size + iov[i + count].iov_len <= mDecryptBatchSize) {
+            size += iov[i + count].iov_len;
+            ++count;
+        }
+
+        int ret;
+        if (count > 1) {
+            ret = decryptBatch(iov + i, count, outbuffers + i);
+        } else {
+            count = 1;
+            uint8_t* in = static_cast<uint8_t*>(iov[i].iov_base);
+            Aml_MP_Buffer outbuffer{};
+            ret = decrypt(in, iov[i].iov_len, ext_data, &outbuffer);
+            if (ret == 0) {
+                ret = putDecrypted(in, outbuffer.address, outbuffer.size, &outbuffers[i]);
+            }
+        }
+        if (ret != 0) {
+            return ret;
+        }
+
+        i += count;
+    }
+
+    return 0;
+}
+
+int AmlVMXWebCas::decryptBatch(const struct iovec* iov, int iovcnt, Aml_MP_Buffer* outbuffers)
+{
+    // chunks of one receive buffer are usually adjacent and need no gathering.
+    uint8_t* in = static_cast<uint8_t*>(iov[0].iov_base);
+    size_t size = iov[0].iov_len;
+    bool adjacent = true;
+    for (int i = 1; i < iovcnt; ++i) {
+        adjacent = adjacent && iov[i].iov_base == in + size;
+        size += iov[i].iov_len;
+    }
+
+    if (!adjacent) {
+        mDecryptGather.resize(std::max(mDecryptGather.size(), size));
+        in = mDecryptGather.data();
+        size_t offset = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            memcpy(in + offset, iov[i].iov_base, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+    }
+
+    int ret = pIptvCas->decrypt(in, in, size, nullptr);
+    if (ret) {
+        MLOGE("decrypt failed, ret=%d", ret);
+        return ret;
+    }
+
+    const uint8_t* out = pIptvCas->getOutbuffer();
+    RETURN_IF(-1, out == nullptr);
+
+    size_t offset = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        ret = putDecrypted(static_cast<uint8_t*>(iov[i].iov_base), out + offset, iov[i].iov_len, &outbuffers[i]);
+        if (ret != 0) {
+            return ret;
+        }
+        offset += iov[i].iov_len;
+    }
+
+    return 0;
+}
+
 int AmlVMXWebCas::dscDevOpen(const char *port_addr, int flags)
 {
     int r;
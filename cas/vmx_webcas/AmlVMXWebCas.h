@@ -28,6 +28,7 @@ public:
     virtual int processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size) override;
     virtual int processEmm(const uint8_t* data, size_t size) override;
     virtual int decrypt(uint8_t *in, int size, void *ext_data, Aml_MP_Buffer* outbuffer) override;
+    virtual int decryptv(const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers) override;
 
 
 private:
@@ -40,9 +41,13 @@ private:
     int mFirstEcm;
     uint8_t mEcmTsPacket[188];
 
+    const size_t mDecryptBatchSize;
+    std::vector<uint8_t> mDecryptGather;
+
     int setDscSource();
     int dscDevOpen(const char *port_addr, int flags);
     int checkEcmProcess(uint8_t* pBuffer, uint32_t vEcmPid, uint32_t aEcmPid, size_t * nSize);
+    int decryptBatch(const struct iovec* iov, int iovcnt, Aml_MP_Buffer* outbuffers);
 
 
     AmlVMXWebCas(const AmlVMXWebCas&) = delete;
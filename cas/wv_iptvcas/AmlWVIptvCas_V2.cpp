@@ -50,7 +50,7 @@ AmlWVIptvCas_V2::~AmlWVIptvCas_V2()
     MLOGI("dtor AmlWVIptvCas_V2");
     int ret = 0;
 
-    if (mDscFd) {
+    if (mDscFd >= 0) {
         ret = close(mDscFd);
         if (ret)
             MLOGE("~AmlWVIptvCas_V2 fd= %d error=%d \n", mDscFd, errno);
@@ -63,22 +63,71 @@ int AmlWVIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* param)
     MLOG();
     AmlCasBase::startDescrambling(param);
 
-    int ret = 0;
+    if (mSessionOpened) {
+        // provisioned and opened by the session pool, bind it to the service.
+        // the vendor lib keeps the private_data pointer, it must be our copy.
+        CasStreamInfo initPara;
+        fillStreamInfo(&mIptvCasParam, &initPara);
+        int ret = pIptvCas->setPrivateData((void *)&initPara, sizeof(CasStreamInfo));
+        if (ret == 0) {
+            setDscSource();
+            ret = pIptvCas->setPids(mIptvCasParam.videoPid, mIptvCasParam.audioPid);
+        }
+        return convertToAmlMPErrorCode_V2((AmCasCode_t)ret);
+    }
 
-    CasStreamInfo initPara;
-    initPara.ca_system_id = param->caSystemId;
-    initPara.video_pid = param->videoPid;
-    initPara.audio_pid = param->audioPid;
-    initPara.ecm_pid[0] = param->ecmPid[0];
-    initPara.ecm_pid[1] = param->ecmPid[1];
-    initPara.av_diff_ecm = false;
-    if (initPara.ecm_pid[0] != 0x1FFF && initPara.ecm_pid[1] != 0x1FFF &&
-        initPara.ecm_pid[0] != initPara.ecm_pid[1]) {
-        initPara.av_diff_ecm = true;
+    return openSession(&mIptvCasParam, true);
+}
+
+int AmlWVIptvCas_V2::prepareSession(const Aml_MP_IptvCASParams* params)
+{
+    MLOG();
+    if (mSessionOpened) {
+        return 0;
     }
+    // ECMs may be processed before the session is bound to the service.
+    // the vendor lib keeps the private_data pointer, hand it our own copy.
+    mIptvCasParam = *params;
 
-    MLOGI("%s,vpid=0x%x,apid=0x%x,ecmpid=0x%x,0x%x", __func__, initPara.video_pid, initPara.audio_pid,
-        initPara.ecm_pid[0], initPara.ecm_pid[1]);
+    return openSession(&mIptvCasParam, false);
+}
+
+int AmlWVIptvCas_V2::suspendDescrambling()
+{
+    MLOG();
+    // unbind the dsc source, setDscSource() binds it again on restart.
+    if (mDscFd >= 0) {
+        if (close(mDscFd))
+            MLOGE("suspendDescrambling fd= %d error=%d \n", mDscFd, errno);
+        mDscFd = -1;
+    }
+    mFirstEcm = 0;
+    memset(mEcmTsPacket, 0, sizeof(mEcmTsPacket));
+    resetEcmHistory();
+
+    return 0;
+}
+
+bool AmlWVIptvCas_V2::isSessionOpen() const
+{
+    return mSessionOpened;
+}
+
+void AmlWVIptvCas_V2::fillStreamInfo(const Aml_MP_IptvCASParams* param, CasStreamInfo* initPara)
+{
+    initPara->ca_system_id = param->caSystemId;
+    initPara->video_pid = param->videoPid;
+    initPara->audio_pid = param->audioPid;
+    initPara->ecm_pid[0] = param->ecmPid[0];
+    initPara->ecm_pid[1] = param->ecmPid[1];
+    initPara->av_diff_ecm = false;
+    if (initPara->ecm_pid[0] != 0x1FFF && initPara->ecm_pid[1] != 0x1FFF &&
+        initPara->ecm_pid[0] != initPara->ecm_pid[1]) {
+        initPara->av_diff_ecm = true;
+    }
+
+    MLOGI("%s,vpid=0x%x,apid=0x%x,ecmpid=0x%x,0x%x", __func__, initPara->video_pid, initPara->audio_pid,
+        initPara->ecm_pid[0], initPara->ecm_pid[1]);
 
     bool useThirdPartyLicServer = false;
     char value[PROPERTY_VALUE_MAX] = {0};
@@ -93,19 +142,24 @@ int AmlWVIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* param)
 
     if (useThirdPartyLicServer) {
         uint8_t *pdata = const_cast<uint8_t *>(param->private_data);
-        initPara.private_data = pdata;  //get from pmt
-        initPara.pri_data_len = param->private_size;
+        initPara->private_data = pdata;  //get from pmt
+        initPara->pri_data_len = param->private_size;
         MLOGI("wvcas use third private data: 0x%x,0x%x, len=%d",
-            initPara.private_data[0],initPara.private_data[1], initPara.pri_data_len);
+            initPara->private_data[0],initPara->private_data[1], initPara->pri_data_len);
     } else {
-        initPara.private_data = NULL;
-        initPara.pri_data_len = 0;
+        initPara->private_data = NULL;
+        initPara->pri_data_len = 0;
     }
 
-    initPara.headers = NULL;
+    initPara->headers = NULL;
+}
 
-    //initPara->headers = cas_stream_info->headers;
+int AmlWVIptvCas_V2::openSession(const Aml_MP_IptvCASParams* param, bool bind)
+{
+    int ret = 0;
 
+    CasStreamInfo initPara;
+    fillStreamInfo(param, &initPara);
 
 #ifndef __ANDROID_VNDK__
     pIptvCas = new AmCasLibWrapper<AML_MP_CAS_SERVICE_WIDEVINE>("libdec_ca_wvcas.system.so");
@@ -118,7 +172,6 @@ int AmlWVIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* param)
         return -1;
     }
 
-    mDscFd = 0;
     mFirstEcm = 0;
     pIptvCas->setCasInstanceId(param->demuxId);
 
@@ -137,10 +190,13 @@ int AmlWVIptvCas_V2::startDescrambling(const Aml_MP_IptvCASParams* param)
     }
 
     if (pIptvCas) {
-        setDscSource();
-        MLOGI("%s, vpid=0x%x, apid=0x%x", __func__, mIptvCasParam.videoPid, mIptvCasParam.audioPid);
-        pIptvCas->setPids(mIptvCasParam.videoPid, mIptvCasParam.audioPid);
+        if (bind) {
+            setDscSource();
+        }
+        MLOGI("%s, vpid=0x%x, apid=0x%x", __func__, param->videoPid, param->audioPid);
+        pIptvCas->setPids(param->videoPid, param->audioPid);
         ret = pIptvCas->openSession(&sessionId[0]);
+        mSessionOpened = ret == 0;
     }
 
     return convertToAmlMPErrorCode_V2((AmCasCode_t)ret);
@@ -155,6 +211,7 @@ int AmlWVIptvCas_V2::stopDescrambling()
         ret = pIptvCas->closeSession(&sessionId[0]);
         pIptvCas.clear();
     }
+    mSessionOpened = false;
 
     return convertToAmlMPErrorCode_V2((AmCasCode_t)ret);
 }
@@ -308,7 +365,9 @@ int AmlWVIptvCas_V2::setDscSource()
         ret = amsysfs_set_sysfs_str(DMX0_SOURCE_PATH, DMX_SRC);
         if (ret)
             MLOGI("Error ret 0x%x\n", ret);
-        mDscFd = dscDevOpen(DSC_DEVICE, O_RDWR);
+        if (mDscFd < 0) {
+            mDscFd = dscDevOpen(DSC_DEVICE, O_RDWR);
+        }
         MLOGI("%s, dsc_fd=%d\n", __func__, mDscFd);
         ret = amsysfs_set_sysfs_str(DSC0_SOURCE_PATH, DSC_SRC);
         if (ret)
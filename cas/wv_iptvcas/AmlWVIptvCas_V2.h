@@ -25,6 +25,9 @@ public:
     ~AmlWVIptvCas_V2();
     virtual int startDescrambling(const Aml_MP_IptvCASParams* params) override;
     virtual int stopDescrambling() override;
+    virtual int prepareSession(const Aml_MP_IptvCASParams* params) override;
+    virtual int suspendDescrambling() override;
+    virtual bool isSessionOpen() const override;
     virtual int setPrivateData(const uint8_t* data, size_t size) override;
     virtual int processEcm(bool isSection, int ecmPid, const uint8_t* data, size_t size) override;
     virtual int processEmm(const uint8_t* data, size_t size) override;
@@ -35,10 +38,13 @@ private:
     int mInstanceId{0};
     char mName[64];
 
-    int mDscFd;
-    int mFirstEcm;
+    int mDscFd = -1;
+    int mFirstEcm = 0;
+    bool mSessionOpened = false;
     uint8_t mEcmTsPacket[188];
 
+    void fillStreamInfo(const Aml_MP_IptvCASParams* param, CasStreamInfo* initPara);
+    int openSession(const Aml_MP_IptvCASParams* param, bool bind);
     int setDscSource();
     int dscDevOpen(const char *port_addr, int flags);
     int checkEcmProcess(uint8_t* pBuffer, uint32_t vEcmPid, uint32_t aEcmPid, size_t * nSize);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlEmmFilter"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include <utils/AmlMpConfig.h>
+#include "AmlEmmFilter.h"
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+AmlEmmFilter::AmlEmmFilter()
+: mCacheSize(std::max(AmlMpConfig::instance().mEmmCacheSize, 0))
+{
+}
+
+int AmlEmmFilter::setFilters(const Aml_MP_CASEmmFilter* filters, int count)
+{
+    RETURN_IF(-1, count < 0 || (count > 0 && filters == nullptr));
+
+    for (int i = 0; i < count; ++i) {
+        if (filters[i].addressing != AML_MP_CAS_EMM_GLOBAL && filters[i].addressLength > AML_MP_CAS_EMM_ADDRESS_SIZE) {
+            MLOGE("filter %d, address length %d too long!", i, filters[i].addressLength);
+            return -1;
+        }
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mFilters.assign(filters, filters + count);
+    // EMMs dropped before may be for this smartcard now.
+    mRecent.clear();
+    mCache.clear();
+    MLOGI("%d EMM filters", count);
+
+    return 0;
+}
+
+bool AmlEmmFilter::accept(const uint8_t* section, size_t size)
+{
+    if (section == nullptr || size == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mStats.received++;
+
+    if (!matches_l(section, size)) {
+        mStats.filtered++;
+        return false;
+    }
+
+    if (mCacheSize == 0) {
+        return true;
+    }
+
+    uint64_t h = hash(section, size);
+    auto it = mCache.find(h);
+    if (it != mCache.end()) {
+        mRecent.splice(mRecent.begin(), mRecent, it->second);
+        mStats.repeated++;
+        return false;
+    }
+
+    mRecent.push_front(h);
+    mCache[h] = mRecent.begin();
+    if (mRecent.size() > mCacheSize) {
+        mCache.erase(mRecent.back());
+        mRecent.pop_back();
+    }
+
+    return true;
+}
+
+void AmlEmmFilter::forget(const uint8_t* section, size_t size)
+{
+    if (section == nullptr || size == 0) {
+        return;
+    }
+
+    uint64_t h = hash(section, size);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mCache.find(h);
+    if (it != mCache.end()) {
+        mRecent.erase(it->second);
+        mCache.erase(it);
+    }
+}
+
+AmlEmmFilter::Stats AmlEmmFilter::stats() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mStats;
+}
+
+void AmlEmmFilter::resetStats()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mStats = Stats();
+}
+
+bool AmlEmmFilter::matches_l(const uint8_t* section, size_t size) const
+{
+    if (mFilters.empty()) {
+        return true;
+    }
+
+    for (const Aml_MP_CASEmmFilter& filter : mFilters) {
+        if ((section[0] & filter.tableIdMask) != (filter.tableId & filter.tableIdMask)) {
+            continue;
+        }
+
+        if (filter.addressing == AML_MP_CAS_EMM_GLOBAL) {
+            return true;
+        }
+
+        if ((size_t)filter.addressOffset + filter.addressLength > size) {
+            continue;
+        }
+
+        const uint8_t* address = section + filter.addressOffset;
+        bool match = true;
+        for (size_t i = 0; i < filter.addressLength && match; ++i) {
+            match = (address[i] & filter.addressMask[i]) == (filter.address[i] & filter.addressMask[i]);
+        }
+        if (match) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t AmlEmmFilter::hash(const uint8_t* section, size_t size)
+{
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ section[i]) * 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+}
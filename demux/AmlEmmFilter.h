@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_EMM_FILTER_H_
+#define _AML_EMM_FILTER_H_
+
+#include <Aml_MP/Cas.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * Drops the EMM sections the CAS has no use for, in the demux callback.
+ *
+ * An EMM PID carries the EMMs of every smartcard of the operator, most of
+ * them for other cards, and repeats each of them for cards that were off.
+ * A section passes if its table id and address match one of the filters,
+ * or if there is none, and it is not among the last AmlMpConfig::mEmmCacheSize
+ * EMMs passed. forget() lets the next copy of an EMM the CAS failed through.
+ */
+class AmlEmmFilter
+{
+public:
+    struct Stats {
+        uint64_t received = 0;
+        uint64_t filtered = 0;
+        uint64_t repeated = 0;
+    };
+
+    AmlEmmFilter();
+    ~AmlEmmFilter() = default;
+
+    int setFilters(const Aml_MP_CASEmmFilter* filters, int count);
+    bool accept(const uint8_t* section, size_t size);
+    void forget(const uint8_t* section, size_t size);
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    bool matches_l(const uint8_t* section, size_t size) const;
+    static uint64_t hash(const uint8_t* section, size_t size);
+
+    const size_t mCacheSize;
+
+    mutable std::mutex mLock;
+    std::vector<Aml_MP_CASEmmFilter> mFilters;
+    // most recent first
+    std::list<uint64_t> mRecent;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> mCache;
+    Stats mStats;
+
+    AmlEmmFilter(const AmlEmmFilter&) = delete;
+    AmlEmmFilter& operator= (const AmlEmmFilter&) = delete;
+};
+
+}
+
+#endif
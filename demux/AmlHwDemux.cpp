@@ -100,18 +100,11 @@ int AmlHwDemux::close()
 int AmlHwDemux::start()
 {
     mTsParser->dvr_open(mDemuxId, mIsHardwareSource);
-    if (mLooper == nullptr) {
-        mLooper = new Looper(Looper::PREPARE_ALLOW_NON_CALLBACKS);
-        if (mLooper == nullptr) {
-            MLOGE("create looper failed!");
-            return -1;
-        }
+    if (mStrand == nullptr) {
+        // section fds are polled by the shared executor, callbacks run serially on this strand.
+        mStrand = AmlMpExecutor::instance().createStrand(mDemuxName.c_str());
     }
 
-    mThread = std::thread([this] {
-        threadLoop();
-    });
-
     return 0;
 }
 
@@ -124,13 +117,9 @@ int AmlHwDemux::stop()
         mStopped = true;
     }
 
-    if (mLooper) {
-        mLooper->wake();
-    }
-
-    MLOGI("join...");
-    if (mThread.joinable()) {
-        mThread.join();
+    if (mStrand) {
+        mStrand->shutdown();
+        mStrand.clear();
     }
 
     mTsParser->dvr_close();
@@ -157,11 +146,15 @@ int AmlHwDemux::feedTs(const uint8_t* buffer, size_t size)
 
 int AmlHwDemux::addPSISection(int pid, bool checkCRC)
 {
+    if (mStrand == nullptr) {
+        MLOGE("demux not started!");
+        return -1;
+    }
+
     int channelFd = mTsParser->addPSISection(pid, checkCRC);
 
-    int ret = mLooper->addFd(
+    int ret = mStrand->addFd(
             channelFd,
-            Looper::POLL_CALLBACK,
             Looper::EVENT_ERROR|Looper::EVENT_INPUT,
             mTsParser,
             (void*)pid);
@@ -176,9 +169,13 @@ int AmlHwDemux::addPSISection(int pid, bool checkCRC)
 int AmlHwDemux::removePSISection(int pid)
 {
     int channelFd = mTsParser->getPSISectionData(pid);
-    int ret = mLooper->removeFd(channelFd);
-    if (ret <= 0) {
-        MLOGE("removeFd failed! fd:%d", channelFd);
+    int ret = 0;
+    // fds are already dropped by stop()
+    if (mStrand != nullptr) {
+        ret = mStrand->removeFd(channelFd);
+        if (ret <= 0) {
+            MLOGE("removeFd failed! fd:%d", channelFd);
+        }
     }
 
     mTsParser->removePSISection(pid);
@@ -191,34 +188,6 @@ bool AmlHwDemux::isStopped() const
     return mStopped.load(std::memory_order_relaxed);
 }
 
-void AmlHwDemux::threadLoop()
-{
-    int ret = 0;
-    ALOGI("hwdemux thread start!");
-
-    if (mLooper == nullptr) {
-        MLOGE("looper is NULL!");
-        return;
-    }
-    Looper::setForThread(mLooper);
-
-    for (;;) {
-        ret = mLooper->pollOnce(10 * 1000);
-        if (ret == Looper::POLL_ERROR) {
-            MLOGE("error!");
-            break;
-        }
-
-        bool stopped = mStopped.load(std::memory_order_relaxed);
-        if (stopped) {
-            MLOGE("request stop...");
-            break;
-        }
-    }
-
-    MLOGI("AmlHwDemux threadLoop exited!");
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 HwTsParser::HwTsParser(const std::function<SectionCallback>& cb, const std::string& name)
 : ITsParser(cb)
@@ -11,10 +11,9 @@
 #define _AML_HW_DEMUX_H_
 
 #include "AmlDemuxBase.h"
-#include <thread>
 #include <map>
 #include <set>
-#include <utils/AmlMpLooper.h>
+#include <utils/AmlMpExecutor.h>
 
 namespace aml_mp {
 class HwTsParser;
@@ -32,15 +31,13 @@ public:
     virtual int feedTs(const uint8_t* buffer, size_t size) override;
 
 private:
-    void threadLoop();
     int addPSISection(int pid, bool checkCRC) override;
     int removePSISection(int pid) override;
     bool isStopped() const override;
 
     Aml_MP_DemuxId mDemuxId = AML_MP_DEMUX_ID_DEFAULT;
     std::string mDemuxName;
-    std::thread mThread;
-    sptr<Looper> mLooper;
+    sptr<AmlMpExecutor::Strand> mStrand;
     sptr<HwTsParser> mTsParser;
     bool mIsHardwareSource;
 
@@ -14,6 +14,7 @@
 #include <map>
 #include <utils/AmlMpEventLooper.h>
 #include <utils/AmlMpBuffer.h>
+#include <utils/AmlMpMemoryTracker.h>
 #include <utils/AmlMpMessage.h>
 #ifdef ANDROID
 #include <media/stagefright/foundation/ADebug.h>
@@ -84,7 +85,7 @@ struct SwTsParser::PSISection : public AmlMpRefBase {
     size_t size() const;
     void setRange(size_t offset, size_t length);
     size_t sectionLength() const;
-    const sptr<AmlMpBuffer> rawBuffer() const {return mBuffer;}
+    const sptr<AmlMpBuffer>& rawBuffer() const {return mBuffer;}
     bool isChanged() const {return mChanged;}
     bool needCheckVersionChange();
     int sectionVersion() const;
@@ -187,7 +188,7 @@ int AmlSwDemux::start()
         mLooper = new AmlMpEventLooper;
         mLooper->setName("swDemux");
         mLooper->registerHandler(mHandler);
-        int ret = mLooper->start();
+        int ret = mLooper->startOnExecutor();
         MLOGI("start swDemux looper, ret = %d", ret);
     }
 
@@ -224,16 +225,23 @@ int AmlSwDemux::feedTs(const uint8_t* buffer, size_t size)
         return 0;
     }
 
-    sptr<AmlMpBuffer> data = new AmlMpBuffer(size);
-    memcpy(data->base(), buffer, size);
-    data->setRange(0, size);
+    sptr<AmlMpBuffer> data = AmlMpBuffer::CreateAsCopy(buffer, size);
+    if (data == nullptr) {
+        MLOGE("alloc feed buffer failed, size:%zu", size);
+        return -1;
+    }
+
+    postFeedData(data);
+
+    return 0;
+}
 
+void AmlSwDemux::postFeedData(const sptr<AmlMpBuffer>& data)
+{
     sptr<AmlMpMessage> msg = new AmlMpMessage(kWhatFeedData, mHandler);
     msg->setBuffer("buffer", data);
     msg->setInt32("generation", mBufferGeneration);
     msg->post();
-
-    return 0;
 }
 
 int AmlSwDemux::addPSISection(int pid, bool checkCRC)
@@ -889,6 +897,9 @@ SwTsParser::PSISection::PSISection(int pid, SwTsParser* tsParser)
 }
 
 SwTsParser::PSISection::~PSISection() {
+    if (mBuffer != NULL) {
+        AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_SECTION, AmlMpMemoryTracker::kNoInstance, mBuffer->capacity());
+    }
 }
 
 int SwTsParser::PSISection::append(const void *data, size_t size) {
@@ -903,11 +914,13 @@ int SwTsParser::PSISection::append(const void *data, size_t size) {
         if (mBuffer != NULL) {
             memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
             newBuffer->setRange(0, mBuffer->size());
+            AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_SECTION, AmlMpMemoryTracker::kNoInstance, mBuffer->capacity());
         } else {
             newBuffer->setRange(0, 0);
         }
+        AmlMpMemoryTracker::instance().charge(AML_MP_MEMORY_SECTION, AmlMpMemoryTracker::kNoInstance, newCapacity);
 
-        mBuffer = newBuffer;
+        mBuffer = std::move(newBuffer);
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
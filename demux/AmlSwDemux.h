@@ -48,6 +48,7 @@ private:
 
     void onMessageReceived(const sptr<AmlMpMessage>& msg);
 
+    void postFeedData(const sptr<AmlMpBuffer>& data);
     void onFeedData(const sptr<AmlMpBuffer>& data);
     int resync(const sptr<AmlMpBuffer>& buffer);
     void onFlush();
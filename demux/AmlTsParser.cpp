@@ -11,10 +11,12 @@
 #define LOG_TAG "AmlMpPlayerDemo_Parser"
 #include <utils/Log.h>
 #include "AmlTsParser.h"
+#include "AmlEmmFilter.h"
 #ifdef ANDROID
 #include <media/stagefright/foundation/ADebug.h>
 #endif
 #include <vector>
+#include <algorithm>
 #include <utils/AmlMpUtils.h>
 
 static const char* mName = LOG_TAG;
@@ -74,6 +76,20 @@ static const struct StreamType* getStreamTypeInfo(int esStreamType, const Stream
     return result;
 }
 
+// by stream type, or by the registration and stream descriptors of private streams.
+static const struct StreamType* identifyStreamType(int esStreamType, const int* descriptorTags, int descriptorCount)
+{
+    const struct StreamType* typeInfo = getStreamTypeInfo(esStreamType);
+    for (int i = 0; typeInfo == nullptr && i < descriptorCount; ++i) {
+        typeInfo = getStreamTypeInfo(descriptorTags[i], g_descTypes);
+        if (typeInfo == nullptr) {
+            typeInfo = getStreamTypeInfo(descriptorTags[i], g_identifierTypes);
+        }
+    }
+
+    return typeInfo;
+}
+
 void ProgramInfo::debugLog() const
 {
     MLOGI("ProgramInfo: programNumber=%d, pid=%d", programNumber, pmtPid);
@@ -171,9 +187,16 @@ void Parser::setEventCallback(const std::function<ProgramEventCallback>& cb)
     mCb = cb;
 }
 
+void Parser::setEmmFilter(const std::shared_ptr<AmlEmmFilter>& emmFilter)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mEmmFilter = emmFilter;
+}
+
 int Parser::close()
 {
     clearAllSectionFilters();
+    mEmmPid = AML_MP_INVALID_PID;
     sptr<AmlDemuxBase> dmxTemp;
     {
         std::lock_guard<std::mutex> _l(mLock);
@@ -209,6 +232,56 @@ void Parser::signalQuit()
     mCond.notify_all();
 }
 
+std::vector<sptr<ProgramInfo>> Parser::getPrograms() const
+{
+    std::vector<sptr<ProgramInfo>> programs;
+
+    std::lock_guard<std::mutex> _l(mLock);
+    for (auto& p : mPidPmtMap) {
+        const PMTSection& pmt = p.second;
+        sptr<ProgramInfo> info = new ProgramInfo;
+        info->programNumber = pmt.programNumber;
+        info->pmtPid = pmt.pmtPid;
+        info->caSystemId = pmt.caSystemId;
+        info->scrambled = pmt.scrambled;
+        info->scrambleInfo = pmt.scrambleInfo;
+        for (int& ecmPid : info->ecmPid) {
+            ecmPid = pmt.ecmPid;
+        }
+        info->privateDataLength = pmt.privateDataLength;
+        memcpy(info->privateData, pmt.privateData, pmt.privateDataLength);
+
+        for (const PMTStream& stream : pmt.streams) {
+            const struct StreamType* typeInfo = identifyStreamType(stream.streamType, stream.descriptorTags, stream.descriptorCount);
+            if (typeInfo == nullptr) {
+                continue;
+            }
+
+            if (typeInfo->mpStreamType == AML_MP_STREAM_TYPE_VIDEO && info->videoPid == AML_MP_INVALID_PID) {
+                info->videoPid = stream.streamPid;
+                info->videoCodec = typeInfo->codecId;
+                if (stream.ecmPid != AML_MP_INVALID_PID) {
+                    info->ecmPid[ECM_INDEX_VIDEO] = stream.ecmPid;
+                }
+            } else if (typeInfo->mpStreamType == AML_MP_STREAM_TYPE_AUDIO && info->audioPid == AML_MP_INVALID_PID) {
+                info->audioPid = stream.streamPid;
+                info->audioCodec = typeInfo->codecId;
+                if (stream.ecmPid != AML_MP_INVALID_PID) {
+                    info->ecmPid[ECM_INDEX_AUDIO] = stream.ecmPid;
+                }
+            }
+        }
+
+        programs.push_back(info);
+    }
+
+    std::sort(programs.begin(), programs.end(), [](const sptr<ProgramInfo>& a, const sptr<ProgramInfo>& b) {
+        return a->programNumber < b->programNumber;
+    });
+
+    return programs;
+}
+
 sptr<ProgramInfo> Parser::getProgramInfo() const
 {
     std::lock_guard<std::mutex> _l(mLock);
@@ -554,6 +627,31 @@ int Parser::ecmCb(int pid, size_t size, const uint8_t* data, void* userData)
     return 0;
 }
 
+int Parser::emmCb(int pid, size_t size, const uint8_t* data, void* userData)
+{
+    Parser* parser = (Parser*)userData;
+    if (parser == nullptr) {
+        return 0;
+    }
+
+    std::shared_ptr<AmlEmmFilter> emmFilter;
+    {
+        std::lock_guard<std::mutex> _l(parser->mLock);
+        emmFilter = parser->mEmmFilter;
+    }
+
+    // EMMs for other smartcards and repeats stop here.
+    if (emmFilter == nullptr || !emmFilter->accept(data, size)) {
+        return 0;
+    }
+
+    if (parser->mCb) {
+        parser->mCb(ProgramEventType::EVENT_EMM_DATA_PARSED, pid, size, (void*)data);
+    }
+
+    return 0;
+}
+
 void Parser::onPatParsed(const std::vector<PATSection>& results)
 {
     if (results.empty()) {
@@ -662,23 +760,7 @@ void Parser::onPmtParsed(const PMTSection& results)
     const struct StreamType* typeInfo;
     for (auto it : results.streams) {
         PMTStream* stream = &it;
-        typeInfo = getStreamTypeInfo(stream->streamType);
-        if (typeInfo == nullptr) {
-            for (size_t j = 0; j < stream->descriptorCount; ++j) {
-                typeInfo = getStreamTypeInfo(stream->descriptorTags[j], g_descTypes);
-                if (typeInfo != nullptr) {
-                    MLOGI("stream pid:%d, found tag:%#x", stream->streamPid, stream->descriptorTags[j]);
-                    break;
-                }
-
-                typeInfo = getStreamTypeInfo(stream->descriptorTags[j], g_identifierTypes);
-                if (typeInfo != nullptr) {
-                    MLOGI("identified stream pid:%d, %.4s", stream->streamPid, (char*)&stream->descriptorTags[j]);
-                    break;
-                }
-            }
-        }
-
+        typeInfo = identifyStreamType(stream->streamType, stream->descriptorTags, stream->descriptorCount);
         if (typeInfo == nullptr) {
             continue;
         }
@@ -776,6 +858,20 @@ void Parser::onCatParsed(const CATSection& results)
     mProgramInfo->caSystemId = results.caSystemId;
     mProgramInfo->emmPid = results.emmPid;
 
+    bool filterEmm;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        filterEmm = mEmmFilter != nullptr;
+    }
+    if (filterEmm && results.emmPid != mEmmPid && results.emmPid != AML_MP_INVALID_PID) {
+        if (mEmmPid != AML_MP_INVALID_PID) {
+            removeSectionFilter(mEmmPid);
+        }
+        mEmmPid = results.emmPid;
+        // EMMs are short sections, often without CRC.
+        addSectionFilter(mEmmPid, emmCb, false);
+    }
+
     if (mCb && mProgramInfo->isComplete()) {
         mCb(ProgramEventType::EVENT_PROGRAM_PARSED, mProgramInfo->pmtPid, mProgramInfo->programNumber, mProgramInfo.get());
     }
@@ -17,11 +17,13 @@
 #include <set>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
 #include <Aml_MP/Common.h>
 #include <demux/AmlDemuxBase.h>
 
 namespace aml_mp {
 class AmlDemuxBase;
+class AmlEmmFilter;
 
 typedef enum {
     SCRAMBLE_ALGO_CSA,
@@ -125,6 +127,8 @@ public:
     int wait();
     void signalQuit();
     sptr<ProgramInfo> getProgramInfo() const;
+    // every program of the PMT cache, by program number.
+    std::vector<sptr<ProgramInfo>> getPrograms() const;
     Aml_MP_DemuxId getDemuxId() const {
         return mDemuxId;
     }
@@ -133,7 +137,8 @@ public:
     enum ProgramEventType {
         EVENT_PROGRAM_PARSED,
         EVENT_AV_PID_CHANGED,
-        EVENT_ECM_DATA_PARSED
+        EVENT_ECM_DATA_PARSED,
+        EVENT_EMM_DATA_PARSED
     };
     using ProgramEventCallback = void(ProgramEventType event, int programPid, int param, void* data);
     void setProgram(int programNumber);
@@ -142,8 +147,12 @@ public:
     void setEventCallback(const std::function<ProgramEventCallback>& cb);
     int addSectionFilter(int pid, Aml_MP_Demux_SectionFilterCb cb, bool checkCRC = true);
     int removeSectionFilter(int pid);
+    // filters the sections of the CAT EMM PID into EVENT_EMM_DATA_PARSED,
+    // set before open().
+    void setEmmFilter(const std::shared_ptr<AmlEmmFilter>& emmFilter);
 
     static int ecmCb(int pid, size_t size, const uint8_t* data, void* userData);
+    static int emmCb(int pid, size_t size, const uint8_t* data, void* userData);
 
 private:
     struct Section {
@@ -276,6 +285,8 @@ private:
     std::map<int, int> mPidProgramMap; // map: pid--programNumber
     std::map<int, PMTSection> mPidPmtMap; // map: pid--pmt
     std::set<int> mEcmPidSet;// ecmPid
+    std::shared_ptr<AmlEmmFilter> mEmmFilter;
+    int mEmmPid = AML_MP_INVALID_PID;
 
     mutable std::mutex mLock;
     std::condition_variable mCond;
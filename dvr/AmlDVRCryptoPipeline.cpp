@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRCryptoPipeline"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRCryptoPipeline.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpEventLooper.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const size_t kTsPacketSize = 188;
+static const int kMaxWorkers = 8;
+
+AmlDVRCryptoPipeline::AmlDVRCryptoPipeline(Aml_MP_CAS_CryptoFunction cryptoFn, void* cryptoData)
+: mCryptoFn(cryptoFn)
+, mCryptoData(cryptoData)
+{
+    const AmlMpConfig& config = AmlMpConfig::instance();
+    int workers = std::min(config.mDvrCryptoThreads, kMaxWorkers);
+    mBatchSize = (size_t)std::max(config.mDvrCryptoBatch, 1) * 1024;
+    mBatchSize = std::max(mBatchSize / kTsPacketSize, (size_t)1) * kTsPacketSize;
+    mQueueCapacity = 2 * std::max(workers, 0);
+
+    for (int i = 0; i < workers; ++i) {
+        mWorkers.emplace_back([this] { workerLoop(); });
+    }
+
+    MLOGI("workers:%d, batch:%zu", workers, mBatchSize);
+}
+
+AmlDVRCryptoPipeline::~AmlDVRCryptoPipeline()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+    }
+    mWorkCond.notify_all();
+
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+
+    MLOGI("%" PRIu64 " bytes in %u calls, %u bytes/s, latency avg %u us, max %u us",
+            mStats.bytes, mStats.calls, mStats.throughput, mStats.avgLatencyUs, mStats.maxLatencyUs);
+}
+
+int AmlDVRCryptoPipeline::process(Aml_MP_CASCryptoParams* params, void* userData)
+{
+    AmlDVRCryptoPipeline* pipeline = static_cast<AmlDVRCryptoPipeline*>(userData);
+    return pipeline->run(params);
+}
+
+void AmlDVRCryptoPipeline::getStats(Aml_MP_DVRCryptoStats* stats) const
+{
+    std::lock_guard<std::mutex> _l(mStatsLock);
+    *stats = mStats;
+}
+
+int AmlDVRCryptoPipeline::run(Aml_MP_CASCryptoParams* params)
+{
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    size_t size = params->inputBuffer.size;
+    size_t depth = 0;
+    int ret = 0;
+
+    if (mWorkers.empty() || size <= mBatchSize || params->outputBuffer.size < size) {
+        ret = mCryptoFn(params, mCryptoData);
+    } else {
+        std::vector<Job> jobs((size + mBatchSize - 1) / mBatchSize);
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            size_t offset = i * mBatchSize;
+            size_t length = std::min(mBatchSize, size - offset);
+            Aml_MP_CASCryptoParams& p = jobs[i].params;
+            p = *params;
+            p.offset += offset;
+            p.inputBuffer.address += offset;
+            p.inputBuffer.size = length;
+            p.outputBuffer.address += offset;
+            p.outputBuffer.size = length;
+            p.outputSize = 0;
+        }
+
+        std::unique_lock<std::mutex> _l(mLock);
+        for (Job& job : jobs) {
+            // bounded, the caller waits for the workers to catch up.
+            mDoneCond.wait(_l, [this] { return mQueue.size() < mQueueCapacity; });
+            mQueue.push_back(&job);
+            depth = std::max(depth, mQueue.size());
+            mWorkCond.notify_one();
+        }
+        mDoneCond.wait(_l, [&jobs] {
+            return std::all_of(jobs.begin(), jobs.end(), [](const Job& job) { return job.done; });
+        });
+        _l.unlock();
+
+        // put the outputs back in order, batches may produce less than they got.
+        size_t outputSize = 0;
+        for (Job& job : jobs) {
+            if (job.ret < 0 && ret == 0) {
+                ret = job.ret;
+            }
+            uint8_t* dest = params->outputBuffer.address + outputSize;
+            if (dest != job.params.outputBuffer.address) {
+                memmove(dest, job.params.outputBuffer.address, job.params.outputSize);
+            }
+            outputSize += job.params.outputSize;
+        }
+        params->outputSize = outputSize;
+    }
+
+    int64_t latencyUs = AmlMpEventLooper::GetNowUs() - startUs;
+    std::lock_guard<std::mutex> _l(mStatsLock);
+    mStats.bytes += size;
+    mStats.calls++;
+    mBusyUs += latencyUs;
+    mStats.throughput = mBusyUs > 0 ? std::min<uint64_t>(mStats.bytes * 1000000 / mBusyUs, UINT32_MAX) : 0;
+    mStats.avgLatencyUs = mBusyUs / mStats.calls;
+    mStats.maxLatencyUs = std::max<uint32_t>(mStats.maxLatencyUs, latencyUs);
+    mStats.maxQueueDepth = std::max<uint32_t>(mStats.maxQueueDepth, depth);
+
+    return ret;
+}
+
+void AmlDVRCryptoPipeline::workerLoop()
+{
+    for (;;) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> _l(mLock);
+            mWorkCond.wait(_l, [this] { return mExiting || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                return;
+            }
+            job = mQueue.front();
+            mQueue.pop_front();
+        }
+
+        job->ret = mCryptoFn(&job->params, mCryptoData);
+
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            job->done = true;
+        }
+        mDoneCond.notify_all();
+    }
+}
+
+}
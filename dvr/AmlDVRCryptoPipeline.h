@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_CRYPTO_PIPELINE_H_
+#define _AML_DVR_CRYPTO_PIPELINE_H_
+
+#include <Aml_MP/Dvr.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * Runs the app's DVR crypto function on worker threads.
+ *
+ * libdvr calls the crypto function synchronously for every block it writes or
+ * injects. process() splits each block at TS packet boundaries into batches of
+ * AmlMpConfig::mDvrCryptoBatch bytes, queues them to mDvrCryptoThreads
+ * workers, and returns once all batches are done, their outputs put back in
+ * order. The crypto function must then be thread safe and work per TS packet,
+ * which is what the CAS DVR crypto does. Without workers the function is called
+ * directly, and only the stats are kept.
+ */
+class AmlDVRCryptoPipeline
+{
+public:
+    AmlDVRCryptoPipeline(Aml_MP_CAS_CryptoFunction cryptoFn, void* cryptoData);
+    ~AmlDVRCryptoPipeline();
+
+    // same contract as Aml_MP_CAS_CryptoFunction, userData is the pipeline.
+    static int process(Aml_MP_CASCryptoParams* params, void* userData);
+
+    void getStats(Aml_MP_DVRCryptoStats* stats) const;
+
+private:
+    struct Job {
+        Aml_MP_CASCryptoParams params;
+        int ret = 0;
+        bool done = false;
+    };
+
+    int run(Aml_MP_CASCryptoParams* params);
+    void workerLoop();
+
+    const Aml_MP_CAS_CryptoFunction mCryptoFn;
+    void* const mCryptoData;
+    size_t mBatchSize = 0;
+    size_t mQueueCapacity = 0;
+
+    std::mutex mLock;
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    std::deque<Job*> mQueue;
+    bool mExiting = false;
+    std::vector<std::thread> mWorkers;
+
+    mutable std::mutex mStatsLock;
+    Aml_MP_DVRCryptoStats mStats{};
+    uint64_t mBusyUs = 0;
+
+    AmlDVRCryptoPipeline(const AmlDVRCryptoPipeline&) = delete;
+    AmlDVRCryptoPipeline& operator= (const AmlDVRCryptoPipeline&) = delete;
+};
+
+}
+
+#endif
@@ -9,10 +9,18 @@
 
 #define LOG_TAG "AmlDVRPlayer"
 #include "AmlDVRPlayer.h"
+#include "AmlDVRCryptoPipeline.h"
+#include "AmlDVRReadahead.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTimeshiftRing.h"
+#include "AmlDVRTrickPlay.h"
 #include <Aml_MP/Dvr.h>
 #include <utils/AmlMpHandle.h>
 #include <utils/AmlMpUtils.h>
 #include <utils/AmlMpLog.h>
+#include <utils/AmlMpConfig.h>
+#include <inttypes.h>
+#include <string.h>
 #ifdef ANDROID
 #ifndef __ANDROID_VNDK__
 #include <gui/Surface.h>
@@ -39,6 +47,7 @@ AmlDVRPlayer::AmlDVRPlayer(Aml_MP_DVRPlayerBasicParams* basicParams, Aml_MP_DVRP
 
     memset(&mPlaybackOpenParams, 0, sizeof(DVR_WrapperPlaybackOpenParams_t));
     setBasicParams(basicParams);
+    mTimeline.reset(new AmlDVRIndexTimeline(mPlaybackOpenParams.location));
     mRecStartTime = 0;
     mLimit = 0;
     mIsEncryptStream = basicParams->drmMode != AML_MP_INPUT_STREAM_NORMAL;
@@ -181,6 +190,23 @@ int AmlDVRPlayer::start(bool initialPaused)
     }
     DVR_PlaybackFlag_t play_flag = initialPaused ? DVR_PLAYBACK_STARTED_PAUSEDLIVE : (DVR_PlaybackFlag_t)0;
     error = dvr_wrapper_start_playback(mDVRPlayerHandle, play_flag, &mPlayPids);
+    if (error < 0) {
+        return error;
+    }
+
+    if (AmlMpConfig::instance().mDvrReadahead > 0) {
+        DVR_WrapperPlaybackStatus_t dvrStatus;
+        int64_t position = 0;
+        if (dvr_wrapper_get_playback_status(mDVRPlayerHandle, &dvrStatus) == 0) {
+            position = dvrStatus.info_cur.time;
+        }
+
+        mReadahead.reset(new AmlDVRReadahead(mTimeline.get(), [this](const Aml_MP_DVRPlayerBufferHealth& health) {
+            if (mEventCb) mEventCb(mEventUserData, AML_MP_DVRPLAYER_EVENT_BUFFER_HEALTH, (int64_t)&health);
+        }));
+        mReadahead->start(position, initialPaused ? 0.0f : 1.0f);
+    }
+
     return error;
 }
 
@@ -188,6 +214,12 @@ int AmlDVRPlayer::stop()
 {
     MLOG();
 
+    if (mTrickPlay != nullptr) {
+        mTrickPlay->stop();
+        mTrickPlay.reset();
+    }
+    mReadahead.reset();
+
     int error = dvr_wrapper_stop_playback(mDVRPlayerHandle);
     //Add support cas
     if (mIsEncryptStream) {
@@ -204,6 +236,11 @@ int AmlDVRPlayer::pause()
 
     int ret = 0;
 
+    // pause on the frame trick play has reached.
+    if (mTrickPlay != nullptr) {
+        stopTrickPlay();
+    }
+
     ret = dvr_wrapper_pause_playback(mDVRPlayerHandle);
     if (ret < 0) {
         MLOGE("pause playback failed!");
@@ -229,6 +266,18 @@ int AmlDVRPlayer::resume()
 int AmlDVRPlayer::setLimit(int time, int limit)
 {
     MLOG("rec start time:%d limit:%d", time, limit);
+    // start the window on a random access point.
+    if (limit > 0 && mTimeline->refresh() == 0) {
+        int64_t total = mTimeline->duration();
+        if (total > limit) {
+            int start = resolveRandomAccessPoint(total - limit, false);
+            if (start > total - limit && start < total) {
+                MLOGI("limit %d -> %d", limit, (int)(total - start));
+                limit = total - start;
+            }
+        }
+    }
+
     mRecStartTime = time;
     mLimit = limit;
     if (mRecStartTime > 0) {
@@ -241,9 +290,22 @@ int AmlDVRPlayer::seek(int timeOffset)
 {
     MLOG("timeOffset:%d", timeOffset);
 
+    if (mTrickPlay != nullptr) {
+        mTrickPlay->seek(timeOffset);
+        return 0;
+    }
+
+    int position = resolveRandomAccessPoint(timeOffset, true);
+    if (position != timeOffset) {
+        MLOGI("seek to random access point %d", position);
+        timeOffset = position;
+    }
+
     int ret = dvr_wrapper_seek_playback(mDVRPlayerHandle, timeOffset);
     if (ret < 0) {
         MLOGE("seek playback %d failed!", timeOffset);
+    } else if (mReadahead != nullptr) {
+        mReadahead->setPosition(timeOffset);
     }
 
     return ret;
@@ -255,9 +317,23 @@ int AmlDVRPlayer::setPlaybackRate(float rate)
 
     int ret = 0;
 
+    if (AmlDVRTrickPlay::isTrickRate(rate) && !mIsEncryptStream) {
+        if (mTrickPlay != nullptr) {
+            mTrickPlay->setRate(rate);
+            return 0;
+        }
+        if (startTrickPlay(rate) == 0) {
+            return 0;
+        }
+    } else if (mTrickPlay != nullptr) {
+        stopTrickPlay();
+    }
+
     ret = dvr_wrapper_set_playback_speed(mDVRPlayerHandle, rate * 100);
     if (ret < 0) {
         MLOGE("set playback speed failed!");
+    } else if (mReadahead != nullptr) {
+        mReadahead->setRate(rate);
     }
 
     return 0;
@@ -275,6 +351,22 @@ int AmlDVRPlayer::getStatus(Aml_MP_DVRPlayerStatus* status)
     }
 
     convertToMpDVRPlayerStatus(status, &dvrStatus);
+    if (mTrickPlay != nullptr) {
+        float rate = mTrickPlay->rate();
+        status->state = rate > 0 ? AML_MP_DVRPLAYER_STATE_FF : AML_MP_DVRPLAYER_STATE_FB;
+        status->infoCur.time = mTrickPlay->position();
+        status->speed = rate;
+    }
+
+    return 0;
+}
+
+int AmlDVRPlayer::getCryptoStats(Aml_MP_DVRCryptoStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (mCryptoPipeline != nullptr) {
+        mCryptoPipeline->getStats(stats);
+    }
 
     return 0;
 }
@@ -515,6 +607,11 @@ int AmlDVRPlayer::setBasicParams(Aml_MP_DVRPlayerBasicParams* basicParams)
 {
     mPlaybackOpenParams.dmx_dev_id = basicParams->demuxId;
     memcpy(&(mPlaybackOpenParams.location), &(basicParams->location), DVR_MAX_LOCATION_SIZE);
+    if (basicParams->isTimeShift) {
+        // the recorder may keep the timeshift in RAM.
+        std::string location = AmlDVRTimeshiftRing::resolve(basicParams->location);
+        snprintf(mPlaybackOpenParams.location, sizeof(mPlaybackOpenParams.location), "%s", location.c_str());
+    }
     mPlaybackOpenParams.block_size = basicParams->blockSize;
     mPlaybackOpenParams.is_timeshift = basicParams->isTimeShift;
 
@@ -525,6 +622,11 @@ int AmlDVRPlayer::setDecryptParams(Aml_MP_DVRPlayerDecryptParams * decryptParams
 {
     mPlaybackOpenParams.crypto_fn = (DVR_CryptoFunction_t)decryptParams->cryptoFn;
     mPlaybackOpenParams.crypto_data = decryptParams->cryptoData;
+    if (decryptParams->cryptoFn != nullptr) {
+        mCryptoPipeline.reset(new AmlDVRCryptoPipeline(decryptParams->cryptoFn, decryptParams->cryptoData));
+        mPlaybackOpenParams.crypto_fn = (DVR_CryptoFunction_t)AmlDVRCryptoPipeline::process;
+        mPlaybackOpenParams.crypto_data = mCryptoPipeline.get();
+    }
 
     mSecureBuffer = decryptParams->secureBuffer;
     mSecureBufferSize = decryptParams->secureBufferSize;
@@ -534,6 +636,89 @@ int AmlDVRPlayer::setDecryptParams(Aml_MP_DVRPlayerDecryptParams * decryptParams
     return 0;
 }
 
+int AmlDVRPlayer::resolveRandomAccessPoint(int timeMs, bool before)
+{
+    AmlDVRIndexTimeline::Entry entry;
+    if (timeMs < 0 || mTimeline->refresh() < 0 ||
+        !mTimeline->find(timeMs, before, AML_DVR_TS_INDEX_RANDOM_ACCESS, &entry)) {
+        return timeMs;
+    }
+
+    return entry.timeMs;
+}
+
+int AmlDVRPlayer::startTrickPlay(float rate)
+{
+    DVR_WrapperPlaybackStatus_t dvrStatus;
+    if (dvr_wrapper_get_playback_status(mDVRPlayerHandle, &dvrStatus) < 0) {
+        return -1;
+    }
+
+    // without a keyframe index, libdvr does the trick play.
+    int64_t position = dvrStatus.info_cur.time;
+    AmlDVRIndexTimeline::Entry entry;
+    if (mTimeline->refresh() < 0 ||
+        !mTimeline->find(position, rate > 0, AML_DVR_TS_INDEX_KEYFRAME, &entry)) {
+        return -1;
+    }
+
+    int ret = dvr_wrapper_pause_playback(mDVRPlayerHandle);
+    if (ret < 0) {
+        MLOGE("pause playback failed!");
+        return ret;
+    }
+
+    Aml_MP_VideoDecodeMode decodeMode = AML_MP_VIDEO_DECODE_MODE_IONLY;
+    setParameter(AML_MP_PLAYER_PARAMETER_VIDEO_DECODE_MODE, &decodeMode);
+    // libdvr paused the decoder along with the injection.
+    AmTsPlayer_resumeVideoDecoding(mTsPlayerHandle);
+
+    mTrickPlay.reset(new AmlDVRTrickPlay(mTimeline.get(), mTsPlayerHandle, [this](bool reachedEnd, int64_t positionMs) {
+        onTrickPlayBound(reachedEnd, positionMs);
+    }));
+    return mTrickPlay->start(position, rate);
+}
+
+int AmlDVRPlayer::stopTrickPlay()
+{
+    int64_t position = mTrickPlay->stop();
+    mTrickPlay.reset();
+
+    Aml_MP_VideoDecodeMode decodeMode = AML_MP_VIDEO_DECODE_MODE_NONE;
+    setParameter(AML_MP_PLAYER_PARAMETER_VIDEO_DECODE_MODE, &decodeMode);
+
+    int ret = dvr_wrapper_seek_playback(mDVRPlayerHandle, position);
+    if (ret < 0) {
+        MLOGE("seek playback %" PRId64 " failed!", position);
+    } else if (mReadahead != nullptr) {
+        mReadahead->setPosition(position);
+    }
+
+    return dvr_wrapper_resume_playback(mDVRPlayerHandle);
+}
+
+void AmlDVRPlayer::onTrickPlayBound(bool reachedEnd, int64_t positionMs)
+{
+    if (mEventCb == nullptr) {
+        return;
+    }
+
+    DVR_WrapperPlaybackStatus_t dvrStatus;
+    if (dvr_wrapper_get_playback_status(mDVRPlayerHandle, &dvrStatus) < 0) {
+        return;
+    }
+
+    // libdvr is paused, report the trick play position.
+    Aml_MP_DVRPlayerStatus mpStatus;
+    convertToMpDVRPlayerStatus(&mpStatus, &dvrStatus);
+    mpStatus.infoCur.time = positionMs;
+    if (reachedEnd) {
+        mEventCb(mEventUserData, AML_MP_DVRPLAYER_EVENT_REACHED_END, (int64_t)&mpStatus);
+    } else {
+        mEventCb(mEventUserData, AML_MP_DVRPLAYER_EVENT_REACHED_BEGIN, (int64_t)&mpStatus);
+    }
+}
+
 int AmlDVRPlayer::createTsPlayerIfNeeded()
 {
     if (mTsPlayerHandle != 0) {
@@ -597,6 +782,9 @@ DVR_Result_t AmlDVRPlayer::eventHandlerLibDVR(DVR_PlaybackEvent_t event, void* p
         break;
 
     case DVR_PLAYBACK_EVENT_NOTIFY_PLAYTIME:
+        if (mReadahead != nullptr) {
+            mReadahead->setPosition(mpStatus.infoCur.time);
+        }
         if (mEventCb) mEventCb(mEventUserData, AML_MP_DVRPLAYER_EVENT_NOTIFY_PLAYTIME, (int64_t)&mpStatus);
         break;
 
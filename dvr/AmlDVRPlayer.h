@@ -15,6 +15,7 @@
 #include <utils/AmlMpHandle.h>
 #include <utils/AmlMpUtils.h>
 #include "AmTsPlayer.h"
+#include <memory>
 #ifdef ANDROID
 #include <system/window.h>
 #include <utils/RefBase.h>
@@ -29,6 +30,10 @@ extern "C" int dvr_wrapper_set_playback_secure_buffer (DVR_WrapperPlayback_t pla
 
 namespace aml_mp {
 using android::NativeHandle;
+class AmlDVRIndexTimeline;
+class AmlDVRTrickPlay;
+class AmlDVRCryptoPipeline;
+class AmlDVRReadahead;
 
 class AmlDVRPlayer final : public AmlMpHandle
 {
@@ -45,6 +50,7 @@ public:
     int seek(int timeOffset);
     int setPlaybackRate(float rate);
     int getStatus(Aml_MP_DVRPlayerStatus* status);
+    int getCryptoStats(Aml_MP_DVRCryptoStats* stats);
     int showVideo();
     int hideVideo();
     int setVolume(float volume);
@@ -65,16 +71,26 @@ private:
     bool mIsEncryptStream;
     uint8_t* mSecureBuffer = nullptr;
     size_t mSecureBufferSize = 0;
+    std::unique_ptr<AmlDVRCryptoPipeline> mCryptoPipeline;
 
     Aml_MP_PlayerEventCallback mEventCb = nullptr;
     void* mEventUserData = nullptr;
     //record start time
     int mRecStartTime;
     int mLimit;
+    std::unique_ptr<AmlDVRIndexTimeline> mTimeline;
+    // I-frame injection while fast forwarding or rewinding.
+    std::unique_ptr<AmlDVRTrickPlay> mTrickPlay;
+    // keeps the data ahead of the playback position in the page cache.
+    std::unique_ptr<AmlDVRReadahead> mReadahead;
 
     int setBasicParams(Aml_MP_DVRPlayerBasicParams* basicParams);
     int setDecryptParams(Aml_MP_DVRPlayerDecryptParams* decryptParams);
     int createTsPlayerIfNeeded();
+    int resolveRandomAccessPoint(int timeMs, bool before);
+    int startTrickPlay(float rate);
+    int stopTrickPlay();
+    void onTrickPlayBound(bool reachedEnd, int64_t positionMs);
     DVR_Result_t eventHandlerLibDVR(DVR_PlaybackEvent_t event, void* params);
     DVR_Result_t eventHandlerPlayer(am_tsplayer_event* event);
 #ifdef ANDROID
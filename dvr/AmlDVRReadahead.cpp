@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRReadahead"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRReadahead.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTrickPlay.h"
+#include "AmlDVRTsIndex.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpEventLooper.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const int64_t kTickMs = 500;
+static const size_t kChunkSize = 512 * 1024;
+static const int64_t kMinBytes = 1024 * 1024;
+static const int64_t kMaxBytes = 64 * 1024 * 1024;
+// used until a segment tells its bitrate.
+static const int64_t kDefaultBytesPerSecond = 1024 * 1024;
+// a read this slow means the disk was spinning up or is saturated.
+static const int64_t kStallUs = 300 * 1000;
+static const int64_t kMaxLeadMs = 30 * 1000;
+
+AmlDVRReadahead::AmlDVRReadahead(AmlDVRIndexTimeline* timeline, const HealthCallback& cb)
+: mTimeline(timeline)
+, mHealthCallback(cb)
+, mBaseLeadMs(AmlMpConfig::instance().mDvrReadahead)
+{
+    mLeadMs = mBaseLeadMs;
+}
+
+AmlDVRReadahead::~AmlDVRReadahead()
+{
+    stop();
+}
+
+void AmlDVRReadahead::start(int64_t positionMs, float rate)
+{
+    if (mThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = false;
+        mChanged = true;
+        mPositionMs = positionMs;
+        mRate = rate;
+    }
+
+    mScratch.resize(kChunkSize);
+    mThread = std::thread([this] { threadLoop(); });
+}
+
+void AmlDVRReadahead::stop()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+    }
+    mCond.notify_all();
+
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mHasReadEnd = false;
+}
+
+void AmlDVRReadahead::setPosition(int64_t positionMs)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mPositionMs = positionMs;
+    mChanged = true;
+    mCond.notify_all();
+}
+
+void AmlDVRReadahead::setRate(float rate)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mRate = rate;
+    mChanged = true;
+    mCond.notify_all();
+}
+
+void AmlDVRReadahead::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    while (!mExiting) {
+        mCond.wait_for(_l, std::chrono::milliseconds(kTickMs), [this] { return mExiting || mChanged; });
+        if (mExiting) {
+            break;
+        }
+        mChanged = false;
+        int64_t positionMs = mPositionMs;
+        float rate = mRate;
+
+        _l.unlock();
+        step(positionMs, rate);
+        _l.lock();
+    }
+}
+
+void AmlDVRReadahead::step(int64_t positionMs, float rate)
+{
+    Cursor cursor;
+    if (!loadSegments() || !locate(positionMs, &cursor)) {
+        return;
+    }
+
+    const Segment& segment = mSegments[cursor.index];
+    int64_t bytesPerSecond = segment.durationMs > 0 ? segment.size * 1000 / segment.durationMs : 0;
+    if (bytesPerSecond <= 0) {
+        bytesPerSecond = kDefaultBytesPerSecond;
+    }
+    // paused playback keeps the data for resuming at normal speed.
+    bytesPerSecond *= std::max(fabsf(rate), 1.0f);
+
+    int64_t target = std::min(std::max(bytesPerSecond * mLeadMs / 1000, kMinBytes), kMaxBytes);
+
+    // after a seek, or when playback overtook the reader.
+    int64_t ahead = mHasReadEnd ? distance(cursor, mReadEnd) : -1;
+    if (ahead < 0 || ahead > 4 * target) {
+        mHasReadEnd = true;
+        mReadEnd = cursor;
+        mReadEndId = segment.id;
+        ahead = 0;
+    }
+
+    // rewinding is served by the trick play engine's frame reads.
+    if (rate < 0) {
+        return;
+    }
+
+    reportHealth(ahead, target, bytesPerSecond);
+    if (ahead < target) {
+        ahead += prefetch(target - ahead);
+        reportHealth(ahead, target, bytesPerSecond);
+    }
+}
+
+bool AmlDVRReadahead::loadSegments()
+{
+    AmlDVRSegmentCache& cache = AmlDVRSegmentCache::instance();
+    std::vector<uint64_t> ids;
+    if (cache.getList(mTimeline->location(), &ids) < 0 || ids.empty()) {
+        return false;
+    }
+
+    std::vector<Segment> segments;
+    int64_t start = 0;
+    for (uint64_t id : ids) {
+        Aml_MP_DVRSegmentInfo info;
+        if (cache.getInfo(mTimeline->location(), id, &info) < 0) {
+            return false;
+        }
+        segments.push_back({id, start, (int64_t)info.duration, (int64_t)info.size});
+        start += info.duration;
+    }
+    mSegments = std::move(segments);
+
+    // timeshift drops the oldest segments, follow the read end by id.
+    if (mHasReadEnd) {
+        auto it = std::find_if(mSegments.begin(), mSegments.end(),
+                [this](const Segment& s) { return s.id == mReadEndId; });
+        if (it == mSegments.end()) {
+            mHasReadEnd = false;
+        } else {
+            mReadEnd.index = it - mSegments.begin();
+        }
+    }
+
+    return true;
+}
+
+bool AmlDVRReadahead::locate(int64_t positionMs, Cursor* cursor) const
+{
+    auto it = std::upper_bound(mSegments.begin(), mSegments.end(), positionMs,
+            [](int64_t t, const Segment& s) { return t < s.startMs; });
+    size_t index = it == mSegments.begin() ? 0 : it - mSegments.begin() - 1;
+    const Segment& segment = mSegments[index];
+
+    AmlDVRIndexTimeline::Entry entry;
+    if (mTimeline->find(positionMs, true, 0, &entry) && entry.segmentId == segment.id) {
+        *cursor = {index, (int64_t)entry.offset};
+    } else if (segment.durationMs > 0) {
+        int64_t relative = std::min(std::max<int64_t>(positionMs - segment.startMs, 0), segment.durationMs);
+        *cursor = {index, segment.size * relative / segment.durationMs};
+    } else {
+        *cursor = {index, 0};
+    }
+
+    return true;
+}
+
+int64_t AmlDVRReadahead::distance(const Cursor& from, const Cursor& to) const
+{
+    if (to.index < from.index) {
+        return -1;
+    }
+    if (to.index == from.index) {
+        return to.offset - from.offset;
+    }
+
+    int64_t bytes = std::max<int64_t>(mSegments[from.index].size - from.offset, 0);
+    for (size_t i = from.index + 1; i < to.index; ++i) {
+        bytes += mSegments[i].size;
+    }
+
+    return bytes + to.offset;
+}
+
+int64_t AmlDVRReadahead::prefetch(int64_t bytes)
+{
+    int64_t done = 0;
+    bool stalled = false;
+
+    while (done < bytes) {
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            if (mExiting || mChanged) {
+                break;
+            }
+        }
+
+        const Segment& segment = mSegments[mReadEnd.index];
+        if (mReadEnd.offset >= segment.size && mReadEnd.index + 1 < mSegments.size()) {
+            // on to the next segment ahead of the boundary.
+            mReadEnd = {mReadEnd.index + 1, 0};
+            mReadEndId = mSegments[mReadEnd.index].id;
+            continue;
+        }
+
+        if (mFd < 0 || mFdSegment != segment.id) {
+            if (mFd >= 0) {
+                ::close(mFd);
+            }
+            mFd = ::open(AmlDVRSegmentFile(mTimeline->location(), segment.id, "ts").c_str(), O_RDONLY | O_CLOEXEC);
+            if (mFd < 0) {
+                break;
+            }
+            mFdSegment = segment.id;
+        }
+
+        size_t length = std::min<int64_t>(kChunkSize, bytes - done);
+        posix_fadvise(mFd, mReadEnd.offset, bytes - done, POSIX_FADV_WILLNEED);
+
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        ssize_t len = pread(mFd, mScratch.data(), length, mReadEnd.offset);
+        int64_t elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+        if (len <= 0) {
+            // the live edge of a recording in progress.
+            break;
+        }
+
+        mReadEnd.offset += len;
+        done += len;
+
+        if (elapsedUs > 0) {
+            int64_t sample = len * 1000000LL / elapsedUs;
+            mThroughput = mThroughput > 0 ? (mThroughput * 7 + sample) / 8 : sample;
+        }
+        if (elapsedUs > kStallUs && mLeadMs < kMaxLeadMs) {
+            mLeadMs = std::min(mLeadMs * 2, kMaxLeadMs);
+            MLOGW("read stalled %" PRId64 " ms, readahead %" PRId64 " ms", elapsedUs / 1000, mLeadMs);
+        }
+        stalled |= elapsedUs > kStallUs;
+    }
+
+    // shrink back slowly once the disk keeps up.
+    if (!stalled && done > 0 && mLeadMs > mBaseLeadMs) {
+        mLeadMs = std::max(mBaseLeadMs, mLeadMs - mLeadMs / 8);
+    }
+
+    return done;
+}
+
+void AmlDVRReadahead::reportHealth(int64_t aheadBytes, int64_t targetBytes, int64_t bytesPerSecond)
+{
+    Aml_MP_DVRPlayerBufferLevel level;
+    if (aheadBytes <= 0) {
+        level = AML_MP_DVRPLAYER_BUFFER_EMPTY;
+    } else if (aheadBytes < targetBytes / 2) {
+        level = AML_MP_DVRPLAYER_BUFFER_LOW;
+    } else {
+        level = AML_MP_DVRPLAYER_BUFFER_HEALTHY;
+    }
+
+    if (mReported && level == mLevel) {
+        return;
+    }
+    mReported = true;
+    mLevel = level;
+
+    Aml_MP_DVRPlayerBufferHealth health;
+    health.level = level;
+    health.aheadMs = std::max<int64_t>(aheadBytes, 0) * 1000 / bytesPerSecond;
+    health.targetMs = targetBytes * 1000 / bytesPerSecond;
+    health.throughput = std::min<int64_t>(mThroughput, UINT32_MAX);
+    MLOGI("buffer level:%d, ahead %u ms, target %u ms, throughput %u", level, health.aheadMs, health.targetMs, health.throughput);
+
+    if (mHealthCallback) {
+        mHealthCallback(health);
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_READAHEAD_H_
+#define _AML_DVR_READAHEAD_H_
+
+#include <Aml_MP/Common.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aml_mp {
+class AmlDVRIndexTimeline;
+
+/*
+ * Keeps the segment data ahead of the playback position in the page cache.
+ *
+ * libdvr reads the segments itself, block by block, so a disk that has spun
+ * down or a slow USB stick stalls the inject thread. A reader thread reads the
+ * data the player is about to need, across segment boundaries, so libdvr finds
+ * it cached. The amount is the playback time given by AmlMpConfig::mDvrReadahead
+ * at the current bitrate and rate, and grows when reads stall.
+ */
+class AmlDVRReadahead
+{
+public:
+    using HealthCallback = std::function<void(const Aml_MP_DVRPlayerBufferHealth&)>;
+
+    AmlDVRReadahead(AmlDVRIndexTimeline* timeline, const HealthCallback& cb);
+    ~AmlDVRReadahead();
+
+    void start(int64_t positionMs, float rate);
+    void stop();
+    void setPosition(int64_t positionMs);
+    void setRate(float rate);
+
+private:
+    struct Segment {
+        uint64_t id;
+        int64_t startMs;
+        int64_t durationMs;
+        int64_t size;
+    };
+
+    // position in the recording, as segment index and byte offset.
+    struct Cursor {
+        size_t index;
+        int64_t offset;
+    };
+
+    void threadLoop();
+    void step(int64_t positionMs, float rate);
+    bool loadSegments();
+    bool locate(int64_t positionMs, Cursor* cursor) const;
+    int64_t distance(const Cursor& from, const Cursor& to) const;
+    int64_t prefetch(int64_t bytes);
+    void reportHealth(int64_t aheadBytes, int64_t targetBytes, int64_t bytesPerSecond);
+
+    AmlDVRIndexTimeline* mTimeline;
+    const HealthCallback mHealthCallback;
+    const int64_t mBaseLeadMs;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mExiting = false;
+    bool mChanged = false;
+    int64_t mPositionMs = 0;
+    float mRate = 1.0f;
+    std::thread mThread;
+
+    // only used on mThread
+    std::vector<Segment> mSegments;
+    bool mHasReadEnd = false;
+    Cursor mReadEnd{0, 0};
+    uint64_t mReadEndId = 0;
+    int mFd = -1;
+    uint64_t mFdSegment = 0;
+    std::vector<uint8_t> mScratch;
+    int64_t mLeadMs = 0;
+    int64_t mThroughput = 0;    // bytes per second, moving average
+    Aml_MP_DVRPlayerBufferLevel mLevel = AML_MP_DVRPLAYER_BUFFER_HEALTHY;
+    bool mReported = false;
+
+    AmlDVRReadahead(const AmlDVRReadahead&) = delete;
+    AmlDVRReadahead& operator= (const AmlDVRReadahead&) = delete;
+};
+
+}
+
+#endif
@@ -10,11 +10,22 @@
 #define LOG_TAG "AmlDVRRecorder"
 #include <utils/AmlMpLog.h>
 #include "AmlDVRRecorder.h"
+#include "AmlDVRCryptoPipeline.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRSegmentStorage.h"
+#include "AmlDVRTimeshiftRing.h"
+#include "AmlDVRTsIndex.h"
 #include <Aml_MP/Dvr.h>
 #include <utils/AmlMpHandle.h>
 #include <cutils/properties.h>
 #include <dvr_utils.h>
+#include <utils/AmlMpMemoryTracker.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpConfig.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
 
 namespace aml_mp {
 static void convertToMpDVRRecorderStatus(Aml_MP_DVRRecorderStatus* mpStatus, DVR_WrapperRecordStatus_t* dvrStatus);
@@ -40,11 +51,22 @@ AmlDVRRecorder::AmlDVRRecorder(Aml_MP_DVRRecorderBasicParams* basicParams, Aml_M
     }
 
     memset(&mRecordPids, 0, sizeof(mRecordPids));
+
+    mIndexInterval = AmlMpConfig::instance().mDvrIndexInterval;
 }
 
 AmlDVRRecorder::~AmlDVRRecorder()
 {
     MLOG();
+
+    sptr<AmlMpExecutor::Strand> workStrand;
+    {
+        std::lock_guard<std::mutex> _l(mWorkLock);
+        workStrand = std::move(mWorkStrand);
+    }
+    if (workStrand != nullptr) {
+        workStrand->shutdown();
+    }
 }
 
 int AmlDVRRecorder::registerEventCallback(Aml_MP_DVRRecorderEventCallback cb, void* userData)
@@ -180,12 +202,35 @@ int AmlDVRRecorder::start()
     };
     mRecOpenParams.event_userdata = this;
 
+    // the index taps the blocks libdvr hands to crypto_fn, which costs clear
+    // recordings a copy, so it is opt-in. The data of a scrambled recording
+    // without crypto sits in secure memory.
+    if (mCryptoFn != nullptr || mDataCb != nullptr || (mIndexInterval > 0 && !mIsEncryptStream)) {
+        mRecOpenParams.crypto_fn = (DVR_CryptoFunction_t)cryptoTap;
+        mRecOpenParams.crypto_data = this;
+    }
+
     int ret = dvr_wrapper_open_record(&mRecoderHandle, &mRecOpenParams);
     if (ret < 0) {
         MLOGE("Open dvr record fail");
         return -1;
     }
 
+    mAccountedBytes = mRecOpenParams.flush_size;
+    AmlMpMemoryTracker::instance().charge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, mAccountedBytes);
+
+    // a timeshift in RAM has no disk layout to care about.
+    if (mStorageFlags && mTimeshiftRing == nullptr) {
+        mStorage.reset(new AmlDVRSegmentStorage(mRecOpenParams.segment_size, mStorageFlags));
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mWorkLock);
+        if ((mIndexInterval > 0 || mTimeshiftRing != nullptr || mStorage != nullptr) && mWorkStrand == nullptr) {
+            mWorkStrand = AmlMpExecutor::instance().createStrand(LOG_TAG);
+        }
+    }
+
     if (mIsEncryptStream) {
         MLOGI("set secureBuffer:%p, secureBufferSize:%d", mSecureBuffer, mSecureBufferSize);
         dvr_wrapper_set_record_secure_buffer(mRecoderHandle, mSecureBuffer, mSecureBufferSize);
@@ -195,6 +240,8 @@ int AmlDVRRecorder::start()
         ret = dvr_wrapper_start_record(mRecoderHandle, &mRecStartParams);
         if (ret < 0) {
             dvr_wrapper_close_record(mRecoderHandle);
+            AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, mAccountedBytes);
+            mAccountedBytes = 0;
             MLOGE("Failed to start recording.");
             return -1;
         }
@@ -216,6 +263,30 @@ int AmlDVRRecorder::stop()
     }
     //Add support cas
     ret = dvr_wrapper_close_record(mRecoderHandle);
+    AmlDVRSegmentCache::instance().invalidateRecording(mRecOpenParams.location);
+
+    sptr<AmlMpExecutor::Strand> workStrand;
+    {
+        std::lock_guard<std::mutex> _l(mWorkLock);
+        workStrand = std::move(mWorkStrand);
+    }
+    if (workStrand != nullptr) {
+        workStrand->shutdown();
+        workStrand.clear();
+        onStatus();
+        if (mStorage != nullptr) {
+            mStorage->finish();
+        }
+    }
+
+    {
+        // libdvr is closed, the last segment is complete.
+        std::lock_guard<std::mutex> _l(mIndexLock);
+        mIndexBuilder.reset();
+    }
+
+    AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, mAccountedBytes);
+    mAccountedBytes = 0;
 
     return ret;
 }
@@ -254,6 +325,26 @@ int AmlDVRRecorder::getStatus(Aml_MP_DVRRecorderStatus* status)
     return 0;
 }
 
+int AmlDVRRecorder::getCryptoStats(Aml_MP_DVRCryptoStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (mCryptoPipeline != nullptr) {
+        mCryptoPipeline->getStats(stats);
+    }
+
+    return 0;
+}
+
+int AmlDVRRecorder::getWriteStats(Aml_MP_DVRWriteStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (mStorage != nullptr) {
+        mStorage->getStats(stats);
+    }
+
+    return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 int AmlDVRRecorder::setBasicParams(Aml_MP_DVRRecorderBasicParams* basicParams)
 {
@@ -261,8 +352,14 @@ int AmlDVRRecorder::setBasicParams(Aml_MP_DVRRecorderBasicParams* basicParams)
     mRecOpenParams.dmx_dev_id = basicParams->demuxId;
     memcpy(&(mRecOpenParams.location), &(basicParams->location), DVR_MAX_LOCATION_SIZE);
     mRecOpenParams.segment_size = basicParams->segmentSize;
-    mRecOpenParams.flags = (DVR_RecordFlag_t)basicParams->flags;
+    mStorageFlags = basicParams->flags & (AML_MP_DVRRECORDER_PREALLOCATE | AML_MP_DVRRECORDER_WRITE_THROUGH);
+    mRecOpenParams.flags = (DVR_RecordFlag_t)(basicParams->flags & ~mStorageFlags);
     mRecOpenParams.flush_size = basicParams->bufferSize;
+    if (mStorageFlags) {
+        // coalesce libdvr's writes into large packet and page aligned ones.
+        int alignment = AmlDVRSegmentStorage::kAlignment;
+        mRecOpenParams.flush_size = std::max((basicParams->bufferSize + alignment - 1) / alignment, 1) * alignment;
+    }
     mRecOpenParams.ringbuf_size = basicParams->ringbufSize;
     MLOGI("location:%s", basicParams->location);
 
@@ -275,6 +372,14 @@ int AmlDVRRecorder::setTimeShiftParams(Aml_MP_DVRRecorderTimeShiftParams* timeSh
     mRecOpenParams.max_time = timeShiftParams->maxTime;
     mRecOpenParams.is_timeshift = DVR_TRUE;
 
+    // called again, the location is already the RAM one.
+    if (mTimeshiftRing == nullptr) {
+        mTimeshiftRing = AmlDVRTimeshiftRing::create(mRecOpenParams.location);
+    }
+    if (mTimeshiftRing != nullptr) {
+        snprintf(mRecOpenParams.location, sizeof(mRecOpenParams.location), "%s", mTimeshiftRing->location());
+    }
+
     return 0;
 }
 
@@ -282,8 +387,12 @@ int AmlDVRRecorder::setEncryptParams(Aml_MP_DVRRecorderEncryptParams* encryptPar
 {
     mRecOpenParams.crypto_period.interval_bytes = encryptParams->intervalBytes;
     mRecOpenParams.crypto_period.notify_clear_periods = encryptParams->notifyClearPeriods;
-    mRecOpenParams.crypto_fn = (DVR_CryptoFunction_t)encryptParams->cryptoFn;
-    mRecOpenParams.crypto_data = encryptParams->cryptoData;
+    // installed behind cryptoTap() in start().
+    if (encryptParams->cryptoFn != nullptr) {
+        mCryptoPipeline.reset(new AmlDVRCryptoPipeline(encryptParams->cryptoFn, encryptParams->cryptoData));
+        mCryptoFn = AmlDVRCryptoPipeline::process;
+        mCryptoData = mCryptoPipeline.get();
+    }
 
     mSecureBuffer = encryptParams->secureBuffer;
     mSecureBufferSize = encryptParams->secureBufferSize;
@@ -303,6 +412,13 @@ DVR_Result_t AmlDVRRecorder::eventHandler(DVR_RecordEvent_t event, void* params)
         break;
 
     case DVR_RECORD_EVENT_STATUS:
+        AmlDVRSegmentCache::instance().invalidateRecording(mRecOpenParams.location);
+        {
+            std::lock_guard<std::mutex> _l(mWorkLock);
+            if (mWorkStrand != nullptr) {
+                mWorkStrand->post([this] { onStatus(); });
+            }
+        }
         if (mEventCb)  mEventCb(mEventUserData, AML_MP_DVRRECORDER_EVENT_STATUS, (int64_t)&mpStatus);
         break;
 
@@ -326,6 +442,109 @@ DVR_Result_t AmlDVRRecorder::eventHandler(DVR_RecordEvent_t event, void* params)
     return ret;
 }
 
+void AmlDVRRecorder::onStatus()
+{
+    if (mIndexInterval > 0) {
+        updateIndex();
+    }
+
+    if (mTimeshiftRing != nullptr) {
+        mTimeshiftRing->update();
+    }
+
+    if (mStorage != nullptr) {
+        mStorage->update(mRecOpenParams.location);
+    }
+}
+
+void AmlDVRRecorder::updateIndex()
+{
+    const char* location = mRecOpenParams.location;
+    std::vector<uint64_t> ids;
+    if (AmlDVRSegmentCache::instance().getList(location, &ids) < 0) {
+        return;
+    }
+
+    // segments dropped by timeshift take their index along.
+    std::lock_guard<std::mutex> _l(mIndexLock);
+    for (auto it = mIndexedSegments.begin(); it != mIndexedSegments.end(); ) {
+        if (*it != mIndexSegmentId && std::find(ids.begin(), ids.end(), *it) == ids.end()) {
+            unlink(AmlDVRSegmentFile(location, *it, "tsidx").c_str());
+            it = mIndexedSegments.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int AmlDVRRecorder::cryptoTap(Aml_MP_CASCryptoParams* params, void* userData)
+{
+    AmlDVRRecorder* recorder = static_cast<AmlDVRRecorder*>(userData);
+
+    if (params->type == AML_MP_CAS_ENCRYPT && params->inputBuffer.type == AML_MP_INPUT_BUFFER_TYPE_NORMAL) {
+        recorder->indexData(params->segmentId, params->offset, params->inputBuffer.address, params->inputBuffer.size);
+    }
+
+    if (recorder->mDataCb != nullptr) {
+        if (params->inputBuffer.type == AML_MP_INPUT_BUFFER_TYPE_NORMAL) {
+            recorder->mDataCb(params->inputBuffer.address, params->inputBuffer.size);
+        }
+        // nothing left for libdvr to write.
+        params->outputSize = 0;
+        return 0;
+    }
+
+    if (recorder->mCryptoFn != nullptr) {
+        return recorder->mCryptoFn(params, recorder->mCryptoData);
+    }
+
+    if (params->outputBuffer.size < params->inputBuffer.size) {
+        MLOGE("output buffer too small, %zu < %zu", params->outputBuffer.size, params->inputBuffer.size);
+        return -1;
+    }
+    memcpy(params->outputBuffer.address, params->inputBuffer.address, params->inputBuffer.size);
+    params->outputSize = params->inputBuffer.size;
+
+    return 0;
+}
+
+void AmlDVRRecorder::indexData(uint64_t segmentId, int64_t offset, const uint8_t* data, size_t size)
+{
+    std::lock_guard<std::mutex> _l(mIndexLock);
+    if (mIndexInterval <= 0) {
+        return;
+    }
+
+    if (mIndexBuilder == nullptr || mIndexSegmentId != segmentId) {
+        // closing finishes the previous segment.
+        mIndexBuilder.reset();
+
+        std::unique_ptr<AmlDVRTsIndexBuilder> builder(new AmlDVRTsIndexBuilder(mIndexInterval));
+        for (int i = 0; i < mRecordPids.nb_pids; ++i) {
+            Aml_MP_DVRStream stream;
+            convertToMpDVRStream(&stream, &mRecordPids.pids[i]);
+            if (stream.type == AML_MP_STREAM_TYPE_VIDEO) {
+                builder->setVideoStream(stream.pid, stream.codecId);
+                break;
+            }
+        }
+        if (builder->open(AmlDVRSegmentFile(mRecOpenParams.location, segmentId, "tsidx").c_str()) < 0) {
+            return;
+        }
+        mIndexBuilder = std::move(builder);
+        mIndexSegmentId = segmentId;
+        mIndexedSegments.insert(segmentId);
+    }
+
+    if (offset >= 0 && (uint64_t)offset != mIndexBuilder->offset()) {
+        MLOGW("index segment %" PRIu64 " skips from %" PRIu64 " to %" PRId64, segmentId, mIndexBuilder->offset(), offset);
+        mIndexBuilder->skipTo(offset);
+    }
+
+    mIndexBuilder->feed(data, size);
+    mIndexBuilder->flush();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 static Aml_MP_DVRRecorderState convertToMpDVRRecordState(DVR_RecordState_t state)
 {
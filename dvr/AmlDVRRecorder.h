@@ -13,8 +13,17 @@
 #include <Aml_MP/Dvr.h>
 #include <utils/AmlMpHandle.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpExecutor.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
 
 namespace aml_mp {
+class AmlDVRTsIndexBuilder;
+class AmlDVRTimeshiftRing;
+class AmlDVRCryptoPipeline;
+class AmlDVRSegmentStorage;
 
 class AmlDVRRecorder final : public AmlMpHandle
 {
@@ -28,6 +37,20 @@ public:
     int pause();
     int resume();
     int getStatus(Aml_MP_DVRRecorderStatus* status);
+    int getCryptoStats(Aml_MP_DVRCryptoStats* stats);
+    int getWriteStats(Aml_MP_DVRWriteStats* stats);
+
+    // call before start(), 0 disables the ts index.
+    void setIndexInterval(int intervalMs) {
+        mIndexInterval = intervalMs;
+    }
+
+    typedef std::function<void(const uint8_t* data, size_t size)> DataCallback;
+    // call before start(). The clear data libdvr records goes to cb instead of
+    // the segment files, libdvr keeps its bookkeeping only.
+    void setDataCallback(const DataCallback& cb) {
+        mDataCb = cb;
+    }
 
 private:
     int setBasicParams(Aml_MP_DVRRecorderBasicParams* basicParams);
@@ -35,6 +58,13 @@ private:
     int setEncryptParams(Aml_MP_DVRRecorderEncryptParams* encryptParams);
 
     DVR_Result_t eventHandler(DVR_RecordEvent_t event, void* params);
+    void onStatus();
+    void updateIndex();
+    // libdvr crypto function, sees every block written. Indexes the clear
+    // data, then hands it to mDataCb, runs the app's crypto, or copies the
+    // data through.
+    static int cryptoTap(Aml_MP_CASCryptoParams* params, void* userData);
+    void indexData(uint64_t segmentId, int64_t offset, const uint8_t* data, size_t size);
 
     char mName[50];
     DVR_WrapperRecordOpenParams_t mRecOpenParams{};
@@ -44,12 +74,39 @@ private:
     bool mIsEncryptStream;
     uint8_t* mSecureBuffer = nullptr;
     size_t mSecureBufferSize = 0;
+    std::unique_ptr<AmlDVRCryptoPipeline> mCryptoPipeline;
+    // the app's crypto, or mCryptoPipeline running it, called from cryptoTap().
+    Aml_MP_CAS_CryptoFunction mCryptoFn = nullptr;
+    void* mCryptoData = nullptr;
+    DataCallback mDataCb;
 
     DVR_WrapperPidsInfo_t mRecordPids;
 
+    // record buffer accounted to AmlMpMemoryTracker while the recorder is open.
+    size_t mAccountedBytes = 0;
+
     Aml_MP_DVRRecorderEventCallback mEventCb = nullptr;
     void* mEventUserData = nullptr;
 
+    // file work following the status events: index cleanup and timeshift spilling.
+    // mWorkLock guards the pointer, libdvr posts to it while stop() clears it.
+    std::mutex mWorkLock;
+    sptr<AmlMpExecutor::Strand> mWorkStrand;
+
+    // ts index of the segment being recorded, fed by cryptoTap().
+    int mIndexInterval = 0;
+    std::mutex mIndexLock;
+    std::unique_ptr<AmlDVRTsIndexBuilder> mIndexBuilder;
+    uint64_t mIndexSegmentId = 0;
+    std::set<uint64_t> mIndexedSegments;
+
+    // timeshift kept in RAM, mRecOpenParams.location then points into it.
+    std::unique_ptr<AmlDVRTimeshiftRing> mTimeshiftRing;
+
+    // AML_MP_DVRRECORDER_PREALLOCATE and AML_MP_DVRRECORDER_WRITE_THROUGH, handled on mWorkStrand.
+    int mStorageFlags = 0;
+    std::unique_ptr<AmlDVRSegmentStorage> mStorage;
+
 private:
     AmlDVRRecorder(const AmlDVRRecorder&) = delete;
     AmlDVRRecorder& operator= (const AmlDVRRecorder&) = delete;
@@ -0,0 +1,738 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRRecorderGroup"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRRecorderGroup.h"
+#include "AmlDVRRecorder.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTsIndex.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpUtils.h>
+#include <dvr_segment.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+namespace aml_mp {
+
+static const size_t kTsPacketSize = 188;
+static const size_t kMaxSectionSize = 1024;
+// pts written to libdvr's .idx, in 90KHz.
+static const int64_t kPtsInterval = 90 * 100;
+// .dat rewritten while a segment grows.
+static const int64_t kStoreInterval = 90 * 1000;
+static const int64_t kPcrMask = (1LL << 33) - 1;
+
+static uint32_t crc32(const uint8_t* data, size_t size)
+{
+    static uint32_t table[256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i << 24;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc << 1) ^ ((crc & 0x80000000) ? 0x04C11DB7 : 0);
+            }
+            table[i] = crc;
+        }
+        return true;
+    }();
+    AML_MP_UNUSED(initialized);
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xFF];
+    }
+
+    return crc;
+}
+
+// offset of the section in a packet starting one, -1 if there is none.
+static int sectionOffset(const uint8_t* packet)
+{
+    if (!(packet[1] & 0x40)) {
+        return -1;
+    }
+
+    int afc = (packet[3] >> 4) & 0x03;
+    if (!(afc & 0x01)) {
+        return -1;
+    }
+
+    int offset = 4;
+    if (afc & 0x02) {
+        offset += 1 + packet[4];
+    }
+    if (offset >= (int)kTsPacketSize) {
+        return -1;
+    }
+
+    offset += 1 + packet[offset];
+    return offset + 3 <= (int)kTsPacketSize ? offset : -1;
+}
+
+// payload offset of a packet, -1 if it has none.
+static int payloadOffset(const uint8_t* packet)
+{
+    int afc = (packet[3] >> 4) & 0x03;
+    if (!(afc & 0x01)) {
+        return -1;
+    }
+
+    int offset = 4;
+    if (afc & 0x02) {
+        offset += 1 + packet[4];
+    }
+
+    return offset < (int)kTsPacketSize ? offset : -1;
+}
+
+static int64_t parsePcr(const uint8_t* packet)
+{
+    if (!(packet[3] & 0x20) || packet[4] < 7 || !(packet[5] & 0x10)) {
+        return -1;
+    }
+
+    return (int64_t)packet[6] << 25 | packet[7] << 17 | packet[8] << 9 | packet[9] << 1 | packet[10] >> 7;
+}
+
+static void convertToDVRStreamPid(DVR_StreamPid_t* pid, const Aml_MP_DVRStream& stream)
+{
+    int format = 0;
+    if (stream.type == AML_MP_STREAM_TYPE_VIDEO) {
+        format = convertToDVRVideoFormat(stream.codecId);
+    } else if (stream.type == AML_MP_STREAM_TYPE_AUDIO || stream.type == AML_MP_STREAM_TYPE_AD) {
+        format = convertToDVRAudioFormat(stream.codecId);
+    }
+
+    pid->pid = stream.pid;
+    pid->type = (DVR_StreamType_t)(convertToDVRStreamType(stream.type) << 24 | format);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AmlDVRRecorderGroup::AmlDVRRecorderGroup(Aml_MP_DVRRecorderBasicParams* basicParams)
+{
+    snprintf(mName, sizeof(mName), "%s", LOG_TAG);
+    MLOG();
+
+    Aml_MP_DVRRecorderBasicParams params = *basicParams;
+    params.isTimeShift = false;
+    mCaptureLocation = params.location;
+    mIndexInterval = AmlMpConfig::instance().mDvrIndexInterval;
+    mSegmentSize = params.segmentSize;
+    if (params.flags & AML_MP_DVRRECORDER_SCRAMBLED) {
+        MLOGE("scrambled data is out of reach, services won't be written!");
+    }
+
+    mCapture = new AmlDVRRecorder(&params);
+    // the services are indexed, the capture holds no data.
+    mCapture->setIndexInterval(0);
+    mCapture->setDataCallback([this](const uint8_t* data, size_t size) {
+        onCaptureData(data, size);
+    });
+    mCapture->registerEventCallback(onCaptureEvent, this);
+    mStrand = AmlMpExecutor::instance().createStrand(LOG_TAG);
+}
+
+AmlDVRRecorderGroup::~AmlDVRRecorderGroup()
+{
+    MLOG();
+
+    stop();
+    mStrand->shutdown();
+}
+
+int AmlDVRRecorderGroup::registerEventCallback(Aml_MP_DVRRecorderEventCallback cb, void* userData)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mEventCb = cb;
+    mEventUserData = userData;
+
+    return 0;
+}
+
+int AmlDVRRecorderGroup::addService(const Aml_MP_DVRRecorderGroupService* service, int* serviceId)
+{
+    RETURN_IF(-1, service == nullptr || serviceId == nullptr);
+
+    std::shared_ptr<Service> s = std::make_shared<Service>();
+    s->location = service->location;
+    s->programNumber = service->programNumber;
+    s->pmtPid = service->pmtPid;
+    for (int i = 0; i < service->streams.nbStreams; ++i) {
+        const Aml_MP_DVRStream& stream = service->streams.streams[i];
+        s->streams.push_back(stream);
+        s->pids.insert(stream.pid);
+        if (stream.type == AML_MP_STREAM_TYPE_VIDEO && s->videoPid == AML_MP_INVALID_PID) {
+            s->videoPid = stream.pid;
+            s->videoCodec = stream.codecId;
+        }
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mServices.size() >= AML_MP_DVR_GROUP_SERVICES_COUNT) {
+        MLOGE("too many services!");
+        return -1;
+    }
+
+    s->id = mNextServiceId++;
+    mServices.emplace(s->id, s);
+    if (updateStreams_l() < 0) {
+        mServices.erase(s->id);
+        updateStreams_l();
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> _w(mWriteLock);
+        mWriteServices.push_back(s);
+    }
+
+    MLOGI("add service %d, program:%d, pmt:0x%x, location:%s", s->id, s->programNumber, s->pmtPid, s->location.c_str());
+    *serviceId = s->id;
+
+    return 0;
+}
+
+int AmlDVRRecorderGroup::removeService(int serviceId)
+{
+    std::shared_ptr<Service> s;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        auto it = mServices.find(serviceId);
+        if (it == mServices.end()) {
+            return -1;
+        }
+
+        s = it->second;
+        mServices.erase(it);
+        updateStreams_l();
+    }
+    MLOGI("remove service %d", serviceId);
+
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    mWriteServices.erase(std::find(mWriteServices.begin(), mWriteServices.end(), s));
+    closeSegment(*s);
+
+    return 0;
+}
+
+int AmlDVRRecorderGroup::start()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mStarted) {
+        return 0;
+    }
+
+    int ret = mCapture->start();
+    if (ret < 0) {
+        return ret;
+    }
+    mStarted = true;
+
+    return 0;
+}
+
+int AmlDVRRecorderGroup::stop()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        if (!mStarted) {
+            return 0;
+        }
+        mStarted = false;
+    }
+
+    // no data comes in once libdvr is closed.
+    int ret = mCapture->stop();
+
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    for (auto& s : mWriteServices) {
+        closeSegment(*s);
+    }
+    mCarry.clear();
+    deleteCaptureSegments();
+
+    MLOGI("captured %" PRIu64 " bytes, written %" PRIu64 " bytes", mCapturedBytes, mWrittenBytes);
+
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int AmlDVRRecorderGroup::updateStreams_l()
+{
+    Aml_MP_DVRStreamArray streams;
+    memset(&streams, 0, sizeof(streams));
+    std::set<int> pids;
+
+    auto add = [&](Aml_MP_StreamType type, int pid, Aml_MP_CodecID codecId) {
+        if (!pids.insert(pid).second) {
+            return true;
+        }
+        if (streams.nbStreams >= AML_MP_DVR_STREAMS_COUNT) {
+            return false;
+        }
+        streams.streams[streams.nbStreams++] = {type, pid, codecId};
+        return true;
+    };
+
+    // the PAT is captured once for all services.
+    bool ok = add(AML_MP_STREAM_TYPE_SECTION, 0, AML_MP_CODEC_UNKNOWN);
+    for (auto& p : mServices) {
+        ok = ok && add(AML_MP_STREAM_TYPE_SECTION, p.second->pmtPid, AML_MP_CODEC_UNKNOWN);
+    }
+
+    for (auto& p : mServices) {
+        for (const Aml_MP_DVRStream& stream : p.second->streams) {
+            ok = ok && add(stream.type, stream.pid, stream.codecId);
+        }
+    }
+
+    for (auto& p : mServices) {
+        if (p.second->capturePcrPid != AML_MP_INVALID_PID) {
+            ok = ok && add(AML_MP_STREAM_TYPE_SECTION, p.second->capturePcrPid, AML_MP_CODEC_UNKNOWN);
+        }
+    }
+
+    if (!ok) {
+        MLOGE("more than %d pids to capture!", AML_MP_DVR_STREAMS_COUNT);
+        return -1;
+    }
+
+    return mCapture->setStreams(&streams);
+}
+
+void AmlDVRRecorderGroup::capturePcrPid(int serviceId, int pcrPid)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mServices.find(serviceId);
+    if (it == mServices.end() || it->second->capturePcrPid == pcrPid) {
+        return;
+    }
+
+    MLOGI("service %d pcr pid:%#x", serviceId, pcrPid);
+    int oldPid = it->second->capturePcrPid;
+    it->second->capturePcrPid = pcrPid;
+    if (updateStreams_l() < 0) {
+        it->second->capturePcrPid = oldPid;
+    }
+}
+
+void AmlDVRRecorderGroup::onCaptureEvent(void* userData, AML_MP_DVRRecorderEventType event, int64_t params)
+{
+    AmlDVRRecorderGroup* group = static_cast<AmlDVRRecorderGroup*>(userData);
+
+    // the status of the capture is that of its scratch location, which holds
+    // no data, the services' own is in their recordings.
+    if (event != AML_MP_DVRRECORDER_EVENT_ERROR && event != AML_MP_DVRRECORDER_EVENT_WRITE_ERROR) {
+        return;
+    }
+
+    Aml_MP_DVRRecorderEventCallback cb;
+    void* cbUserData;
+    {
+        std::lock_guard<std::mutex> _l(group->mLock);
+        cb = group->mEventCb;
+        cbUserData = group->mEventUserData;
+    }
+
+    // the callback may add or remove services.
+    if (cb) {
+        cb(cbUserData, event, params);
+    }
+}
+
+void AmlDVRRecorderGroup::onCaptureData(const uint8_t* data, size_t size)
+{
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    const std::vector<std::shared_ptr<Service>>& services = mWriteServices;
+    mCapturedBytes += size;
+
+    // complete the packet the previous block ended with.
+    if (!mCarry.empty()) {
+        size_t len = std::min(kTsPacketSize - mCarry.size(), size);
+        mCarry.insert(mCarry.end(), data, data + len);
+        data += len;
+        size -= len;
+        if (mCarry.size() < kTsPacketSize) {
+            return;
+        }
+        if (mCarry[0] == 0x47) {
+            dispatch(services, mCarry.data());
+        }
+        mCarry.clear();
+    }
+
+    while (size >= kTsPacketSize) {
+        if (data[0] != 0x47) {
+            // lost sync, look for the next packet.
+            const uint8_t* sync = (const uint8_t*)memchr(data + 1, 0x47, size - 1);
+            size_t skip = sync != nullptr ? sync - data : size;
+            data += skip;
+            size -= skip;
+            continue;
+        }
+
+        dispatch(services, data);
+        data += kTsPacketSize;
+        size -= kTsPacketSize;
+    }
+    if (size > 0) {
+        mCarry.assign(data, data + size);
+    }
+
+    for (auto& s : services) {
+        flushService(*s);
+    }
+}
+
+void AmlDVRRecorderGroup::dispatch(const std::vector<std::shared_ptr<Service>>& services, const uint8_t* packet)
+{
+    int pid = (packet[1] & 0x1F) << 8 | packet[2];
+    if (pid == 0) {
+        parsePat(packet);
+        if (packet[1] & 0x40) {
+            for (auto& s : services) {
+                writePat(*s);
+            }
+        }
+        return;
+    }
+
+    for (auto& s : services) {
+        if (pid == s->pmtPid) {
+            writePmt(*s, packet);
+            continue;
+        }
+        if (pid == s->pcrPid) {
+            updatePcr(*s, packet);
+        }
+        if (pid == s->pcrPid || s->pids.count(pid)) {
+            write(*s, packet);
+        }
+    }
+}
+
+void AmlDVRRecorderGroup::parsePat(const uint8_t* packet)
+{
+    int offset = sectionOffset(packet);
+    if (offset < 0 || offset + 8 > (int)kTsPacketSize || packet[offset] != 0x00) {
+        return;
+    }
+
+    const uint8_t* section = packet + offset;
+    mTransportStreamId = section[3] << 8 | section[4];
+    mPatVersion = (section[5] >> 1) & 0x1F;
+}
+
+void AmlDVRRecorderGroup::writePat(Service& service)
+{
+    if (mPatVersion < 0) {
+        return;
+    }
+
+    // a single program, shared transport_stream_id and version.
+    uint8_t section[16];
+    section[0] = 0x00;
+    section[1] = 0xB0;
+    section[2] = sizeof(section) - 3;
+    section[3] = mTransportStreamId >> 8;
+    section[4] = mTransportStreamId & 0xFF;
+    section[5] = 0xC1 | (mPatVersion << 1);
+    section[6] = 0x00;
+    section[7] = 0x00;
+    section[8] = service.programNumber >> 8;
+    section[9] = service.programNumber & 0xFF;
+    section[10] = 0xE0 | ((service.pmtPid >> 8) & 0x1F);
+    section[11] = service.pmtPid & 0xFF;
+
+    writeSection(service, 0, service.patCC, section, sizeof(section));
+}
+
+void AmlDVRRecorderGroup::writePmt(Service& service, const uint8_t* packet)
+{
+    int offset = payloadOffset(packet);
+    if (offset < 0) {
+        return;
+    }
+
+    const uint8_t* payload = packet + offset;
+    size_t payloadSize = kTsPacketSize - offset;
+    std::vector<uint8_t>& section = service.pmtSection;
+
+    auto append = [&](const uint8_t* data, size_t size) {
+        section.insert(section.end(), data, data + size);
+        if (section.size() < 3) {
+            return;
+        }
+        size_t sectionSize = (((section[1] & 0x0F) << 8) | section[2]) + 3;
+        if (sectionSize > kMaxSectionSize) {
+            section.clear();
+        } else if (section.size() >= sectionSize) {
+            rewritePmt(service, section.data(), sectionSize);
+            section.clear();
+        }
+    };
+
+    if (!(packet[1] & 0x40)) {
+        // continues the section of the previous packets.
+        if (!section.empty()) {
+            append(payload, payloadSize);
+        }
+        return;
+    }
+
+    size_t pointer = payload[0];
+    if (1 + pointer >= payloadSize) {
+        section.clear();
+        return;
+    }
+    // the tail of the previous section comes first.
+    if (!section.empty()) {
+        append(payload + 1, pointer);
+    }
+    section.clear();
+    append(payload + 1 + pointer, payloadSize - 1 - pointer);
+}
+
+void AmlDVRRecorderGroup::rewritePmt(Service& service, const uint8_t* section, size_t sectionSize)
+{
+    if (section[0] != 0x02 || sectionSize < 16) {
+        return;
+    }
+
+    // another program carried on the same PID.
+    if ((section[3] << 8 | section[4]) != service.programNumber) {
+        return;
+    }
+    int pcrPid = (section[8] & 0x1F) << 8 | section[9];
+    if (pcrPid != service.pcrPid) {
+        service.pcrPid = pcrPid;
+        int capturePid = service.pids.count(pcrPid) ? AML_MP_INVALID_PID : pcrPid;
+        int id = service.id;
+        mStrand->post([this, id, capturePid] { capturePcrPid(id, capturePid); });
+    }
+
+    size_t programInfoSize = ((section[10] & 0x0F) << 8) | section[11];
+    size_t pos = 12 + programInfoSize;
+    size_t end = sectionSize - 4;
+    if (pos > end) {
+        return;
+    }
+
+    uint8_t out[kMaxSectionSize];
+    memcpy(out, section, pos);
+    size_t outSize = pos;
+    while (pos + 5 <= end) {
+        int pid = (section[pos + 1] & 0x1F) << 8 | section[pos + 2];
+        size_t esSize = 5 + ((((section[pos + 3] & 0x0F) << 8) | section[pos + 4]));
+        if (pos + esSize > end) {
+            break;
+        }
+        if (service.pids.count(pid)) {
+            memcpy(out + outSize, section + pos, esSize);
+            outSize += esSize;
+        }
+        pos += esSize;
+    }
+
+    outSize += 4;
+    out[1] = (out[1] & 0xF0) | (((outSize - 3) >> 8) & 0x0F);
+    out[2] = (outSize - 3) & 0xFF;
+
+    writeSection(service, service.pmtPid, service.pmtCC, out, outSize);
+}
+
+// sign the section and split it into packets.
+void AmlDVRRecorderGroup::writeSection(Service& service, int pid, uint8_t& cc, uint8_t* section, size_t size)
+{
+    uint32_t crc = crc32(section, size - 4);
+    section[size - 4] = crc >> 24;
+    section[size - 3] = crc >> 16;
+    section[size - 2] = crc >> 8;
+    section[size - 1] = crc;
+
+    uint8_t packet[kTsPacketSize];
+    size_t pos = 0;
+    while (pos < size) {
+        size_t header = pos == 0 ? 5 : 4;
+        size_t len = std::min(size - pos, kTsPacketSize - header);
+
+        memset(packet, 0xFF, kTsPacketSize);
+        packet[0] = 0x47;
+        packet[1] = (pos == 0 ? 0x40 : 0x00) | ((pid >> 8) & 0x1F);
+        packet[2] = pid & 0xFF;
+        packet[3] = 0x10 | (cc++ & 0x0F);
+        if (pos == 0) {
+            packet[4] = 0x00;
+        }
+        memcpy(packet + header, section + pos, len);
+        pos += len;
+
+        write(service, packet);
+    }
+}
+
+void AmlDVRRecorderGroup::updatePcr(Service& service, const uint8_t* packet)
+{
+    int64_t pcr = parsePcr(packet);
+    if (pcr < 0 || service.segment == nullptr) {
+        return;
+    }
+
+    if (service.firstPcr < 0) {
+        service.firstPcr = pcr;
+    }
+    service.lastPcr = pcr;
+
+    // same time line as libdvr's own records: pcr and the offset it starts at.
+    if (service.indexedPcr < 0 || ((pcr - service.indexedPcr) & kPcrMask) >= kPtsInterval) {
+        segment_update_pts(service.segment, pcr, service.segmentSize + service.pending.size());
+        service.indexedPcr = pcr;
+    }
+}
+
+void AmlDVRRecorderGroup::write(Service& service, const uint8_t* packet)
+{
+    if (service.segment == nullptr && openSegment(service) < 0) {
+        return;
+    }
+
+    service.pending.insert(service.pending.end(), packet, packet + kTsPacketSize);
+}
+
+void AmlDVRRecorderGroup::flushService(Service& service)
+{
+    if (service.segment == nullptr || service.pending.empty()) {
+        return;
+    }
+
+    ssize_t len = segment_write(service.segment, service.pending.data(), service.pending.size());
+    if (len < 0) {
+        MLOGE("service %d write failed, %s", service.id, strerror(errno));
+        len = 0;
+    }
+
+    if (service.index != nullptr) {
+        service.index->feed(service.pending.data(), len);
+        service.index->flush();
+    }
+    service.segmentSize += len;
+    service.segmentPackets += len / kTsPacketSize;
+    mWrittenBytes += len;
+    service.pending.clear();
+
+    if (service.lastPcr >= 0 && (service.storedPcr < 0 || ((service.lastPcr - service.storedPcr) & kPcrMask) >= kStoreInterval)) {
+        // keep the segment playable while it grows.
+        storeInfo(service);
+        service.storedPcr = service.lastPcr;
+    }
+
+    if (mSegmentSize > 0 && service.segmentSize >= mSegmentSize) {
+        closeSegment(service);
+        service.segmentId++;
+    }
+}
+
+void AmlDVRRecorderGroup::storeInfo(Service& service)
+{
+    Segment_StoreInfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.id = service.segmentId;
+    for (const Aml_MP_DVRStream& stream : service.streams) {
+        if (info.nb_pids >= DVR_MAX_RECORD_PIDS_COUNT) {
+            break;
+        }
+        convertToDVRStreamPid(&info.pids[info.nb_pids++], stream);
+    }
+    if (service.firstPcr >= 0) {
+        info.duration = ((service.lastPcr - service.firstPcr) & kPcrMask) / 90;
+    }
+    info.size = service.segmentSize;
+    info.nb_packets = service.segmentPackets;
+
+    segment_store_info(service.segment, &info);
+    AmlDVRSegmentCache::instance().invalidateSegment(service.location.c_str(), service.segmentId);
+}
+
+int AmlDVRRecorderGroup::openSegment(Service& service)
+{
+    Segment_OpenParams_t params;
+    memset(&params, 0, sizeof(params));
+    params.segment_id = service.segmentId;
+    params.mode = SEGMENT_MODE_WRITE;
+    snprintf(params.location, sizeof(params.location), "%s", service.location.c_str());
+
+    if (segment_open(&params, &service.segment) < 0) {
+        MLOGE("open segment %" PRIu64 " of %s failed!", service.segmentId, service.location.c_str());
+        service.segment = nullptr;
+        return -1;
+    }
+
+    service.segmentSize = 0;
+    service.segmentPackets = 0;
+    service.firstPcr = -1;
+    service.lastPcr = -1;
+    service.indexedPcr = -1;
+    service.storedPcr = -1;
+
+    // list the segment right away, the recording can be played while it grows.
+    service.segmentIds.push_back(service.segmentId);
+    dvr_segment_link(service.location.c_str(), service.segmentIds.size(), service.segmentIds.data());
+    AmlDVRSegmentCache::instance().invalidate(service.location.c_str());
+
+    if (mIndexInterval > 0) {
+        std::unique_ptr<AmlDVRTsIndexBuilder> index(new AmlDVRTsIndexBuilder(mIndexInterval));
+        index->setVideoStream(service.videoPid, service.videoCodec);
+        if (index->open(AmlDVRSegmentFile(service.location.c_str(), service.segmentId, "tsidx").c_str()) == 0) {
+            service.index = std::move(index);
+        }
+    }
+
+    return 0;
+}
+
+void AmlDVRRecorderGroup::closeSegment(Service& service)
+{
+    if (service.segment == nullptr) {
+        return;
+    }
+
+    flushService(service);
+    // flushService() closes a segment that grew past mSegmentSize.
+    if (service.segment == nullptr) {
+        return;
+    }
+    storeInfo(service);
+    segment_close(service.segment);
+    service.segment = nullptr;
+
+    if (service.index != nullptr) {
+        service.index->close();
+        service.index.reset();
+    }
+
+    AmlDVRSegmentCache::instance().invalidate(service.location.c_str());
+}
+
+void AmlDVRRecorderGroup::deleteCaptureSegments()
+{
+    std::vector<uint64_t> ids;
+    if (AmlDVRSegmentCache::instance().getList(mCaptureLocation.c_str(), &ids) < 0) {
+        return;
+    }
+
+    for (uint64_t id : ids) {
+        dvr_segment_delete(mCaptureLocation.c_str(), id);
+    }
+    AmlDVRSegmentCache::instance().invalidate(mCaptureLocation.c_str());
+}
+
+}
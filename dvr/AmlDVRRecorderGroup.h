@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_RECORDER_GROUP_H_
+#define _AML_DVR_RECORDER_GROUP_H_
+
+#include <Aml_MP/Dvr.h>
+#include <utils/AmlMpHandle.h>
+#include <utils/AmlMpExecutor.h>
+#include <segment.h>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace aml_mp {
+class AmlDVRRecorder;
+class AmlDVRTsIndexBuilder;
+
+/*
+ * Records several services of one multiplex from a single capture.
+ *
+ * One libdvr record session captures the union of the services' PIDs, plus
+ * the PAT and their PMTs. Its data is taken from the record data path and
+ * handed in memory to the services that want each packet, libdvr writes
+ * nothing but its bookkeeping to the capture location. Every service gets a
+ * PAT holding its program only, its PMT reduced to the recorded streams, and
+ * its own streams, written through libdvr's segment writer so the segments
+ * come with the .list, .idx and .dat files libdvr playback needs, and with
+ * a ts index. A PCR PID apart from the recorded streams is added to the
+ * capture once the PMT names it.
+ */
+class AmlDVRRecorderGroup final : public AmlMpHandle
+{
+public:
+    explicit AmlDVRRecorderGroup(Aml_MP_DVRRecorderBasicParams* basicParams);
+    ~AmlDVRRecorderGroup();
+
+    int registerEventCallback(Aml_MP_DVRRecorderEventCallback cb, void* userData);
+    int addService(const Aml_MP_DVRRecorderGroupService* service, int* serviceId);
+    int removeService(int serviceId);
+    int start();
+    int stop();
+
+private:
+    struct Service {
+        int id;
+        std::string location;
+        int programNumber;
+        int pmtPid;
+        std::vector<Aml_MP_DVRStream> streams;
+        std::set<int> pids;
+        int videoPid = AML_MP_INVALID_PID;
+        Aml_MP_CodecID videoCodec = AML_MP_CODEC_UNKNOWN;
+        // only used under mLock, the PCR PID captured for the service alone.
+        int capturePcrPid = AML_MP_INVALID_PID;
+
+        // only used under mWriteLock
+        Segment_Handle_t segment = nullptr;
+        uint64_t segmentId = 0;
+        std::vector<uint64_t> segmentIds;
+        uint64_t segmentSize = 0;
+        uint32_t segmentPackets = 0;
+        int pcrPid = AML_MP_INVALID_PID;
+        int64_t firstPcr = -1;
+        int64_t lastPcr = -1;
+        int64_t indexedPcr = -1;
+        int64_t storedPcr = -1;
+        std::unique_ptr<AmlDVRTsIndexBuilder> index;
+        std::vector<uint8_t> pending;
+        // PMT section being reassembled across packets.
+        std::vector<uint8_t> pmtSection;
+        uint8_t patCC = 0;
+        uint8_t pmtCC = 0;
+    };
+
+    int updateStreams_l();
+    void capturePcrPid(int serviceId, int pcrPid);
+    static void onCaptureEvent(void* userData, AML_MP_DVRRecorderEventType event, int64_t params);
+
+    void onCaptureData(const uint8_t* data, size_t size);
+    void dispatch(const std::vector<std::shared_ptr<Service>>& services, const uint8_t* packet);
+    void parsePat(const uint8_t* packet);
+    void writePat(Service& service);
+    void writePmt(Service& service, const uint8_t* packet);
+    void rewritePmt(Service& service, const uint8_t* section, size_t sectionSize);
+    void writeSection(Service& service, int pid, uint8_t& cc, uint8_t* section, size_t size);
+    void updatePcr(Service& service, const uint8_t* packet);
+    void write(Service& service, const uint8_t* packet);
+    void flushService(Service& service);
+    void storeInfo(Service& service);
+    int openSegment(Service& service);
+    void closeSegment(Service& service);
+    void deleteCaptureSegments();
+
+    char mName[50];
+    std::string mCaptureLocation;
+    int mIndexInterval = 0;
+    uint64_t mSegmentSize = 0;
+    sptr<AmlDVRRecorder> mCapture;
+    // capture PID updates, libdvr calls can't be made from its record thread.
+    sptr<AmlMpExecutor::Strand> mStrand;
+
+    std::mutex mLock;
+    Aml_MP_DVRRecorderEventCallback mEventCb = nullptr;
+    void* mEventUserData = nullptr;
+    int mNextServiceId = 0;
+    std::map<int, std::shared_ptr<Service>> mServices;
+    bool mStarted = false;
+
+    // held by the libdvr record thread while it writes the services. mLock is
+    // never taken under it, libdvr calls made under mLock may wait for that thread.
+    std::mutex mWriteLock;
+    std::vector<std::shared_ptr<Service>> mWriteServices;
+    std::vector<uint8_t> mCarry;
+    int mPatVersion = -1;
+    int mTransportStreamId = 0;
+    uint64_t mCapturedBytes = 0;
+    uint64_t mWrittenBytes = 0;
+
+private:
+    AmlDVRRecorderGroup(const AmlDVRRecorderGroup&) = delete;
+    AmlDVRRecorderGroup& operator= (const AmlDVRRecorderGroup&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRSegmentCache"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRSegmentCache.h"
+#include <utils/AmlMpUtils.h>
+#include <dvr_segment.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <chrono>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// locations kept in the cache, the least recently used one is dropped first.
+static const size_t kMaxLocations = 16;
+// lifetime of an entry whose directory can't be watched.
+static const int64_t kUnwatchedTtlUs = 2 * 1000 * 1000;
+
+// segments growing in another process only report IN_MODIFY until they are closed.
+static const int64_t kModifyIntervalUs = 1000 * 1000;
+
+static const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AmlDVRSegmentCache& AmlDVRSegmentCache::instance()
+{
+    static AmlDVRSegmentCache* cache = new AmlDVRSegmentCache();
+    return *cache;
+}
+
+AmlDVRSegmentCache::AmlDVRSegmentCache()
+{
+    mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mInotifyFd < 0) {
+        MLOGW("inotify_init1 failed, %s", strerror(errno));
+        return;
+    }
+
+    mStrand = AmlMpExecutor::instance().createStrand(LOG_TAG);
+    if (mStrand->addFd(mInotifyFd, Looper::EVENT_INPUT, new SimpleLooperCallback(inotifyCallback), this) <= 0) {
+        MLOGW("watch inotify fd failed!");
+        mStrand->shutdown();
+        mStrand.clear();
+        ::close(mInotifyFd);
+        mInotifyFd = -1;
+    }
+}
+
+int AmlDVRSegmentCache::getList(const char* location, std::vector<uint64_t>* segmentIds)
+{
+    RETURN_IF(-1, location == nullptr || segmentIds == nullptr);
+
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        Entry& e = entry_l(location);
+        if (e.listValid) {
+            *segmentIds = e.ids;
+            removeHidden_l(location, segmentIds);
+            return 0;
+        }
+        generation = e.generation;
+    }
+
+    std::vector<uint64_t> ids;
+    int ret = loadList(location, &ids);
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    Entry& e = entry_l(location);
+    // don't store a list that was invalidated while it was loaded.
+    if (e.generation == generation) {
+        e.ids = ids;
+        e.listValid = true;
+    }
+    *segmentIds = std::move(ids);
+    removeHidden_l(location, segmentIds);
+
+    return 0;
+}
+
+int AmlDVRSegmentCache::getInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo)
+{
+    RETURN_IF(-1, location == nullptr || segmentInfo == nullptr);
+
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        if (isHidden_l(location, segmentId)) {
+            return -1;
+        }
+
+        Entry& e = entry_l(location);
+        auto it = e.infos.find(segmentId);
+        if (it != e.infos.end()) {
+            *segmentInfo = it->second;
+            return 0;
+        }
+        generation = e.generation;
+    }
+
+    int ret = loadInfo(location, segmentId, segmentInfo);
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    Entry& e = entry_l(location);
+    if (e.generation == generation) {
+        e.infos[segmentId] = *segmentInfo;
+    }
+
+    return 0;
+}
+
+void AmlDVRSegmentCache::invalidate(const char* location)
+{
+    if (location == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mEntries.find(location);
+    if (it == mEntries.end()) {
+        return;
+    }
+
+    Entry& e = it->second;
+    e.listValid = false;
+    e.infos.clear();
+    e.generation++;
+}
+
+void AmlDVRSegmentCache::invalidateSegment(const char* location, uint64_t segmentId)
+{
+    if (location == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mEntries.find(location);
+    if (it == mEntries.end()) {
+        return;
+    }
+
+    Entry& e = it->second;
+    e.listValid = false;
+    e.infos.erase(segmentId);
+    e.generation++;
+}
+
+void AmlDVRSegmentCache::invalidateRecording(const char* location)
+{
+    if (location == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mEntries.find(location);
+    if (it == mEntries.end()) {
+        return;
+    }
+
+    // only the newest segment grows, a new one may have been started since the list was read.
+    Entry& e = it->second;
+    if (!e.ids.empty()) {
+        uint64_t newest = *std::max_element(e.ids.begin(), e.ids.end());
+        e.infos.erase(e.infos.lower_bound(newest), e.infos.end());
+    } else {
+        e.infos.clear();
+    }
+    e.listValid = false;
+    e.generation++;
+}
+
+void AmlDVRSegmentCache::hide(const char* location, uint64_t segmentId)
+{
+    if (location == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mHidden[location].insert(segmentId);
+}
+
+void AmlDVRSegmentCache::unhide(const char* location, uint64_t segmentId)
+{
+    if (location == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mHidden.find(location);
+    if (it == mHidden.end()) {
+        return;
+    }
+
+    it->second.erase(segmentId);
+    if (it->second.empty()) {
+        mHidden.erase(it);
+    }
+}
+
+bool AmlDVRSegmentCache::isHidden_l(const std::string& location, uint64_t segmentId) const
+{
+    auto it = mHidden.find(location);
+    return it != mHidden.end() && it->second.count(segmentId);
+}
+
+void AmlDVRSegmentCache::removeHidden_l(const std::string& location, std::vector<uint64_t>* segmentIds) const
+{
+    auto it = mHidden.find(location);
+    if (it == mHidden.end()) {
+        return;
+    }
+
+    const std::set<uint64_t>& hidden = it->second;
+    segmentIds->erase(std::remove_if(segmentIds->begin(), segmentIds->end(),
+            [&hidden](uint64_t id) { return hidden.count(id) != 0; }), segmentIds->end());
+}
+
+AmlDVRSegmentCache::Entry& AmlDVRSegmentCache::entry_l(const std::string& location)
+{
+    int64_t now = nowUs();
+
+    auto it = mEntries.find(location);
+    if (it == mEntries.end()) {
+        it = mEntries.emplace(location, Entry()).first;
+        Entry& e = it->second;
+        size_t pos = location.rfind('/');
+        if (pos == std::string::npos) {
+            e.dir = ".";
+            e.prefix = location;
+        } else {
+            e.dir = pos == 0 ? "/" : location.substr(0, pos);
+            e.prefix = location.substr(pos + 1);
+        }
+        e.loadTimeUs = now;
+        e.lastUseUs = now;
+        watch_l(e.dir);
+        evict_l(location);
+    }
+
+    Entry& e = it->second;
+    e.lastUseUs = now;
+    if (!isFresh_l(e)) {
+        e.listValid = false;
+        e.infos.clear();
+        e.generation++;
+        e.loadTimeUs = now;
+    }
+
+    return e;
+}
+
+bool AmlDVRSegmentCache::isFresh_l(const Entry& entry) const
+{
+    for (auto& w : mWatches) {
+        if (w.second == entry.dir) {
+            return true;
+        }
+    }
+
+    return nowUs() - entry.loadTimeUs < kUnwatchedTtlUs;
+}
+
+void AmlDVRSegmentCache::watch_l(const std::string& dir)
+{
+    if (mInotifyFd < 0) {
+        return;
+    }
+
+    for (auto& w : mWatches) {
+        if (w.second == dir) {
+            return;
+        }
+    }
+
+    int wd = inotify_add_watch(mInotifyFd, dir.c_str(), kWatchMask);
+    if (wd < 0) {
+        MLOGW("watch %s failed, %s", dir.c_str(), strerror(errno));
+        return;
+    }
+
+    MLOGI("watch %s, wd:%d", dir.c_str(), wd);
+    mWatches[wd] = dir;
+}
+
+void AmlDVRSegmentCache::unwatch_l(const std::string& dir)
+{
+    for (auto& p : mEntries) {
+        if (p.second.dir == dir) {
+            return;
+        }
+    }
+
+    for (auto it = mWatches.begin(); it != mWatches.end(); ++it) {
+        if (it->second == dir) {
+            inotify_rm_watch(mInotifyFd, it->first);
+            mWatches.erase(it);
+            break;
+        }
+    }
+}
+
+void AmlDVRSegmentCache::evict_l(const std::string& keep)
+{
+    while (mEntries.size() > kMaxLocations) {
+        auto oldest = mEntries.end();
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (it->first == keep) {
+                continue;
+            }
+            if (oldest == mEntries.end() || it->second.lastUseUs < oldest->second.lastUseUs) {
+                oldest = it;
+            }
+        }
+
+        std::string dir = oldest->second.dir;
+        mEntries.erase(oldest);
+        unwatch_l(dir);
+    }
+}
+
+int AmlDVRSegmentCache::inotifyCallback(int fd, int events, void* data)
+{
+    AML_MP_UNUSED(fd);
+    AML_MP_UNUSED(events);
+
+    static_cast<AmlDVRSegmentCache*>(data)->onInotifyEvent();
+    return 1;
+}
+
+void AmlDVRSegmentCache::onInotifyEvent()
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = read(mInotifyFd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> _l(mLock);
+        for (char* p = buf; p < buf + len; ) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto& entry : mEntries) {
+                    entry.second.listValid = false;
+                    entry.second.infos.clear();
+                    entry.second.generation++;
+                }
+                continue;
+            }
+
+            auto w = mWatches.find(event->wd);
+            if (w == mWatches.end()) {
+                continue;
+            }
+            const std::string dir = w->second;
+
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // the directory is gone, its entries fall back to expiring.
+                if (event->mask & IN_IGNORED) {
+                    mWatches.erase(w);
+                }
+                for (auto& entry : mEntries) {
+                    if (entry.second.dir == dir) {
+                        entry.second.listValid = false;
+                        entry.second.infos.clear();
+                        entry.second.generation++;
+                        entry.second.loadTimeUs = nowUs();
+                    }
+                }
+                continue;
+            }
+
+            if (event->len == 0) {
+                continue;
+            }
+
+            // segment files are named <prefix>-<id>.<ext>, the list file <prefix>.list
+            const std::string name(event->name);
+            bool listChanged = event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+            bool modifyOnly = (event->mask & ~IN_ISDIR) == IN_MODIFY;
+            int64_t now = nowUs();
+            for (auto& entry : mEntries) {
+                Entry& e = entry.second;
+                if (e.dir != dir || name.compare(0, e.prefix.size(), e.prefix) != 0) {
+                    continue;
+                }
+
+                // a recording writes continuously, drop its infos at most once per interval.
+                if (modifyOnly) {
+                    if (now - e.modifyTimeUs < kModifyIntervalUs) {
+                        continue;
+                    }
+                    e.modifyTimeUs = now;
+                }
+
+                const char* rest = name.c_str() + e.prefix.size();
+                if (strcmp(rest, ".list") == 0) {
+                    e.listValid = false;
+                    e.generation++;
+                } else if (rest[0] == '-' && rest[1] >= '0' && rest[1] <= '9') {
+                    e.infos.erase(strtoull(rest + 1, nullptr, 10));
+                    if (listChanged) {
+                        e.listValid = false;
+                    }
+                    e.generation++;
+                }
+            }
+        }
+    }
+}
+
+int AmlDVRSegmentCache::loadList(const char* location, std::vector<uint64_t>* segmentIds)
+{
+    uint32_t segmentNums = 0;
+    uint64_t* ids = nullptr;
+
+    int ret = dvr_segment_get_list(location, &segmentNums, &ids);
+    if (ret < 0) {
+        MLOGE("get segment list of %s failed, ret:%d", location, ret);
+        return ret;
+    }
+
+    segmentIds->assign(ids, ids + (ids ? segmentNums : 0));
+    free(ids);
+
+    return 0;
+}
+
+int AmlDVRSegmentCache::loadInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo)
+{
+    DVR_RecordSegmentInfo_t info;
+    int ret = dvr_segment_get_info(location, segmentId, &info);
+    if (ret < 0) {
+        MLOGE("get segment %" PRIu64 " info of %s failed, ret:%d", segmentId, location, ret);
+        return ret;
+    }
+
+    memset(segmentInfo, 0, sizeof(*segmentInfo));
+    segmentInfo->id = info.id;
+    segmentInfo->streams.nbStreams = info.nb_pids;
+    MLOGD("nb_pids:%d", info.nb_pids);
+    for (size_t i = 0; i < info.nb_pids; ++i) {
+        convertToMpDVRStream(&segmentInfo->streams.streams[i], &info.pids[i]);
+
+        MLOGD("streamType:%d, pid:%d, codecId:%d(%s)", segmentInfo->streams.streams[i].type,
+                segmentInfo->streams.streams[i].pid,
+                segmentInfo->streams.streams[i].codecId,
+                mpCodecId2Str(segmentInfo->streams.streams[i].codecId));
+    }
+
+    segmentInfo->duration = info.duration;
+    segmentInfo->size = info.size;
+    segmentInfo->nbPackets = info.nb_packets;
+
+    return 0;
+}
+
+}
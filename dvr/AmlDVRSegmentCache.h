@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_SEGMENT_CACHE_H_
+#define _AML_DVR_SEGMENT_CACHE_H_
+
+#include <Aml_MP/Dvr.h>
+#include <utils/AmlMpExecutor.h>
+#include <mutex>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * Location keyed cache of the segment list and segment infos.
+ *
+ * libdvr reads the metadata files on every dvr_segment_get_list/get_info call,
+ * which is slow on USB disks. Entries are dropped when inotify reports a change
+ * of the location's files, writes to a growing segment at most once a second,
+ * when a recorder of this process reports a status, or when a segment is
+ * deleted through Aml_MP_DVRRecorder_DeleteSegment. Without inotify, entries
+ * expire after a short time. Hidden segments are filtered out of the list
+ * until they are unhidden.
+ */
+class AmlDVRSegmentCache
+{
+public:
+    static AmlDVRSegmentCache& instance();
+
+    int getList(const char* location, std::vector<uint64_t>* segmentIds);
+    int getInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo);
+
+    void invalidate(const char* location);
+    void invalidateSegment(const char* location, uint64_t segmentId);
+    // the newest segment of location is being written.
+    void invalidateRecording(const char* location);
+
+    // segments being deleted in the background are left out of the list.
+    void hide(const char* location, uint64_t segmentId);
+    void unhide(const char* location, uint64_t segmentId);
+
+private:
+    struct Entry {
+        std::string dir;
+        std::string prefix;
+        uint32_t generation = 0;
+        int64_t loadTimeUs = 0;
+        int64_t lastUseUs = 0;
+        int64_t modifyTimeUs = 0;
+        bool listValid = false;
+        std::vector<uint64_t> ids;
+        std::map<uint64_t, Aml_MP_DVRSegmentInfo> infos;
+    };
+
+    AmlDVRSegmentCache();
+    ~AmlDVRSegmentCache() = default;
+
+    Entry& entry_l(const std::string& location);
+    bool isFresh_l(const Entry& entry) const;
+    void watch_l(const std::string& dir);
+    void unwatch_l(const std::string& dir);
+    void evict_l(const std::string& keep);
+    bool isHidden_l(const std::string& location, uint64_t segmentId) const;
+    void removeHidden_l(const std::string& location, std::vector<uint64_t>* segmentIds) const;
+    void onInotifyEvent();
+    static int inotifyCallback(int fd, int events, void* data);
+
+    static int loadList(const char* location, std::vector<uint64_t>* segmentIds);
+    static int loadInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo);
+
+    std::mutex mLock;
+    std::map<std::string, Entry> mEntries;
+    // kept apart from mEntries, which are evicted.
+    std::map<std::string, std::set<uint64_t>> mHidden;
+    int mInotifyFd = -1;
+    sptr<AmlMpExecutor::Strand> mStrand;
+    std::map<int, std::string> mWatches;
+
+    AmlDVRSegmentCache(const AmlDVRSegmentCache&) = delete;
+    AmlDVRSegmentCache& operator= (const AmlDVRSegmentCache&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRSegmentReclaimer"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRSegmentReclaimer.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTsIndex.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpUtils.h>
+#include <dvr_segment.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+AmlDVRSegmentReclaimer& AmlDVRSegmentReclaimer::instance()
+{
+    static AmlDVRSegmentReclaimer* reclaimer = new AmlDVRSegmentReclaimer();
+    return *reclaimer;
+}
+
+AmlDVRSegmentReclaimer::AmlDVRSegmentReclaimer()
+: mStepBytes((int64_t)AmlMpConfig::instance().mDvrDeleteStep * 1024 * 1024)
+, mIntervalUs((int64_t)std::max(AmlMpConfig::instance().mDvrDeleteInterval, 0) * 1000)
+, mStrand(AmlMpExecutor::instance().createStrand(LOG_TAG))
+{
+}
+
+int AmlDVRSegmentReclaimer::deleteSegments(const char* location, const uint64_t* segmentIds, uint32_t segmentNums,
+        Aml_MP_DVRDeleteSegmentsCallback cb, void* userData)
+{
+    RETURN_IF(-1, location == nullptr || (segmentIds == nullptr && segmentNums > 0));
+
+    Job job;
+    job.location = location;
+    job.ids.assign(segmentIds, segmentIds + segmentNums);
+    job.cb = cb;
+    job.userData = userData;
+
+    for (uint64_t id : job.ids) {
+        AmlDVRSegmentCache::instance().hide(location, id);
+    }
+
+    MLOGI("delete %u segments of %s", segmentNums, location);
+    mStrand->post([this, job]() {
+        mJobs.push_back(job);
+        if (mJobs.size() == 1) {
+            step();
+        }
+    });
+
+    return 0;
+}
+
+void AmlDVRSegmentReclaimer::step()
+{
+    if (mJobs.empty()) {
+        return;
+    }
+
+    Job& job = mJobs.front();
+    if (job.next == job.ids.size()) {
+        MLOGI("%s deleted, result:%d", job.location.c_str(), job.result);
+        if (job.cb) {
+            job.cb(job.userData, job.location.c_str(), job.result);
+        }
+        mJobs.pop_front();
+        if (!mJobs.empty()) {
+            mStrand->post([this] { step(); });
+        }
+        return;
+    }
+
+    const char* location = job.location.c_str();
+    uint64_t id = job.ids[job.next];
+    if (truncateStep(job.location, id)) {
+        int ret = dvr_segment_delete(location, id);
+        if (ret < 0) {
+            MLOGE("delete segment %" PRIu64 " of %s failed, ret:%d", id, location, ret);
+            job.result = ret;
+        }
+        unlink(AmlDVRSegmentFile(location, id, "tsidx").c_str());
+
+        AmlDVRSegmentCache::instance().invalidateSegment(location, id);
+        AmlDVRSegmentCache::instance().unhide(location, id);
+        job.next++;
+    }
+
+    mStrand->post([this] { step(); }, mIntervalUs);
+}
+
+bool AmlDVRSegmentReclaimer::truncateStep(const std::string& location, uint64_t segmentId)
+{
+    if (mStepBytes <= 0) {
+        return true;
+    }
+
+    // a timeshift segment moved to disk is a symlink, truncate its target.
+    std::string path = AmlDVRSegmentFile(location.c_str(), segmentId, "ts");
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0 || st.st_size <= mStepBytes) {
+        return true;
+    }
+
+    off_t size = st.st_size - mStepBytes;
+    if (truncate(path.c_str(), size) < 0) {
+        MLOGW("truncate %s failed, %s", path.c_str(), strerror(errno));
+        return true;
+    }
+
+    return false;
+}
+
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_SEGMENT_RECLAIMER_H_
+#define _AML_DVR_SEGMENT_RECLAIMER_H_
+
+#include <Aml_MP/Dvr.h>
+#include <utils/AmlMpExecutor.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * Deletes segments in the background.
+ *
+ * Unlinking a multi-GB file on ext4 or exFAT frees all its extents at once and
+ * stalls the disk for seconds, also for a recording running next to it. The
+ * segment files are truncated from the end by AmlMpConfig::mDvrDeleteStep MB
+ * per step, with mDvrDeleteInterval ms between steps, before libdvr deletes
+ * what is left. The segments are hidden in AmlDVRSegmentCache until then.
+ */
+class AmlDVRSegmentReclaimer
+{
+public:
+    static AmlDVRSegmentReclaimer& instance();
+
+    int deleteSegments(const char* location, const uint64_t* segmentIds, uint32_t segmentNums,
+            Aml_MP_DVRDeleteSegmentsCallback cb, void* userData);
+
+private:
+    struct Job {
+        std::string location;
+        std::vector<uint64_t> ids;
+        size_t next = 0;
+        int result = 0;
+        Aml_MP_DVRDeleteSegmentsCallback cb = nullptr;
+        void* userData = nullptr;
+    };
+
+    AmlDVRSegmentReclaimer();
+    ~AmlDVRSegmentReclaimer() = default;
+
+    void step();
+    // one truncate step of the segment, return true when nothing is left to truncate.
+    bool truncateStep(const std::string& location, uint64_t segmentId);
+
+    const int64_t mStepBytes;
+    const int64_t mIntervalUs;
+    sptr<AmlMpExecutor::Strand> mStrand;
+    // only used on mStrand
+    std::deque<Job> mJobs;
+
+    AmlDVRSegmentReclaimer(const AmlDVRSegmentReclaimer&) = delete;
+    AmlDVRSegmentReclaimer& operator= (const AmlDVRSegmentReclaimer&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRSegmentStorage"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRSegmentStorage.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTsIndex.h"
+#include <utils/AmlMpEventLooper.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const int64_t kPageSize = 4096;
+static const int64_t kSpikeUs = 100 * 1000;
+
+// disk space the segment takes, without what is reserved past its end.
+static int64_t diskUsage(const struct stat& st)
+{
+    int64_t allocated = (int64_t)st.st_blocks * 512;
+    int64_t used = (st.st_size + kPageSize - 1) / kPageSize * kPageSize;
+    return std::min(allocated, used);
+}
+
+AmlDVRSegmentStorage::AmlDVRSegmentStorage(int64_t segmentSize, int flags)
+: mSegmentSize(segmentSize)
+, mFlags(flags)
+{
+    MLOGI("segmentSize:%" PRId64 ", flags:%#x", segmentSize, flags);
+
+    if (mFlags & AML_MP_DVRRECORDER_WRITE_THROUGH) {
+        mWriteBackThread = std::thread([this] { writeBackLoop(); });
+    }
+}
+
+AmlDVRSegmentStorage::~AmlDVRSegmentStorage()
+{
+    finish();
+
+    if (mWriteBackThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> _l(mWriteBackLock);
+            mExiting = true;
+            mWriteBackCond.notify_all();
+        }
+        mWriteBackThread.join();
+    }
+}
+
+void AmlDVRSegmentStorage::update(const char* location)
+{
+    std::vector<uint64_t> ids;
+    if (AmlDVRSegmentCache::instance().getList(location, &ids) < 0 || ids.empty()) {
+        return;
+    }
+
+    uint64_t newest = *std::max_element(ids.begin(), ids.end());
+    if (mFd < 0 || newest != mSegmentId) {
+        closeSegment();
+        openSegment(location, newest);
+    }
+
+    struct stat st;
+    if (mFd < 0 || fstat(mFd, &st) < 0) {
+        return;
+    }
+    mSize = st.st_size;
+
+    if (mFlags & AML_MP_DVRRECORDER_WRITE_THROUGH) {
+        queueWriteBack(mSize);
+    }
+
+    std::lock_guard<std::mutex> _l(mStatsLock);
+    mStats.bytes = mFinishedBytes + mSize;
+    mStats.deviceBytes = mFinishedDiskBytes + diskUsage(st);
+    mStats.amplification = mStats.bytes > 0 ? mStats.deviceBytes * 100 / mStats.bytes : 0;
+}
+
+void AmlDVRSegmentStorage::finish()
+{
+    closeSegment();
+
+    // the data is on the device when the recording is reported stopped.
+    std::unique_lock<std::mutex> _l(mWriteBackLock);
+    mWriteBackCond.wait(_l, [this] { return mWriteBacks.empty() && !mWriteBackBusy; });
+}
+
+void AmlDVRSegmentStorage::getStats(Aml_MP_DVRWriteStats* stats) const
+{
+    std::lock_guard<std::mutex> _l(mStatsLock);
+    *stats = mStats;
+}
+
+void AmlDVRSegmentStorage::openSegment(const char* location, uint64_t segmentId)
+{
+    // a timeshift segment moved to disk is a symlink, its target is the file.
+    std::string path = AmlDVRSegmentFile(location, segmentId, "ts");
+    mFd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (mFd < 0) {
+        return;
+    }
+    mSegmentId = segmentId;
+    mSize = 0;
+    mWrittenBack = 0;
+
+    if ((mFlags & AML_MP_DVRRECORDER_PREALLOCATE) && mSegmentSize > 0) {
+        // keep the size, libdvr appends at the end of file.
+        if (fallocate(mFd, FALLOC_FL_KEEP_SIZE, 0, mSegmentSize) == 0) {
+            std::lock_guard<std::mutex> _l(mStatsLock);
+            mStats.preallocated++;
+        } else if (!mFallocateWarned) {
+            mFallocateWarned = true;
+            MLOGW("preallocate %s failed, %s", path.c_str(), strerror(errno));
+        }
+    }
+}
+
+void AmlDVRSegmentStorage::closeSegment()
+{
+    if (mFd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) == 0) {
+        mSize = st.st_size;
+        if (mFlags & AML_MP_DVRRECORDER_WRITE_THROUGH) {
+            queueWriteBack(mSize);
+        }
+        // libdvr is done with it, give back the space reserved past the end.
+        if ((mFlags & AML_MP_DVRRECORDER_PREALLOCATE) && (int64_t)st.st_blocks * 512 > st.st_size) {
+            if (ftruncate(mFd, st.st_size) < 0) {
+                MLOGE("ftruncate segment to %" PRId64 " failed, %s", (int64_t)st.st_size, strerror(errno));
+            } else {
+                fstat(mFd, &st);
+            }
+        }
+        mFinishedDiskBytes += diskUsage(st);
+    }
+
+    mFinishedBytes += mSize;
+    mSize = 0;
+    ::close(mFd);
+    mFd = -1;
+}
+
+void AmlDVRSegmentStorage::queueWriteBack(int64_t size)
+{
+    // whole pages only, the tail is written back with the next status.
+    int64_t end = size / kPageSize * kPageSize;
+    if (end <= mWrittenBack) {
+        return;
+    }
+
+    // the write back thread has its own fd, the segment may be closed meanwhile.
+    int fd = dup(mFd);
+    if (fd < 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mWriteBackLock);
+    mWriteBacks.push_back({fd, mSegmentId, mWrittenBack, end - mWrittenBack});
+    mWrittenBack = end;
+    mWriteBackCond.notify_all();
+}
+
+void AmlDVRSegmentStorage::writeBackLoop()
+{
+    std::unique_lock<std::mutex> _l(mWriteBackLock);
+    for (;;) {
+        mWriteBackCond.wait(_l, [this] { return mExiting || !mWriteBacks.empty(); });
+        if (mWriteBacks.empty()) {
+            break;
+        }
+
+        WriteBack request = mWriteBacks.front();
+        mWriteBacks.pop_front();
+        mWriteBackBusy = true;
+        _l.unlock();
+
+        writeBack(request);
+        ::close(request.fd);
+
+        _l.lock();
+        mWriteBackBusy = false;
+        mWriteBackCond.notify_all();
+    }
+}
+
+void AmlDVRSegmentStorage::writeBack(const WriteBack& request)
+{
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = sync_file_range(request.fd, request.offset, request.size,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    int64_t latencyUs = AmlMpEventLooper::GetNowUs() - startUs;
+    if (ret < 0) {
+        MLOGW("write back segment %" PRIu64 " failed, %s", request.segmentId, strerror(errno));
+        return;
+    }
+
+    posix_fadvise(request.fd, request.offset, request.size, POSIX_FADV_DONTNEED);
+
+    if (latencyUs > kSpikeUs) {
+        MLOGW("write back of segment %" PRIu64 " took %" PRId64 " ms", request.segmentId, latencyUs / 1000);
+    }
+
+    mWriteBackCount++;
+    mLatencySumUs += latencyUs;
+
+    std::lock_guard<std::mutex> _l(mStatsLock);
+    mStats.avgLatencyUs = mLatencySumUs / mWriteBackCount;
+    mStats.maxLatencyUs = std::max<int64_t>(mStats.maxLatencyUs, latencyUs);
+    if (latencyUs > kSpikeUs) {
+        mStats.latencySpikes++;
+    }
+}
+
+}
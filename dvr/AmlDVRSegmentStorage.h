@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_SEGMENT_STORAGE_H_
+#define _AML_DVR_SEGMENT_STORAGE_H_
+
+#include <Aml_MP/Dvr.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace aml_mp {
+
+/*
+ * Disk layout and write back of the segments libdvr records.
+ *
+ * Appending segments block by block fragments FAT/exFAT USB sticks, and the
+ * page cache then writes gigabytes back in bursts. With
+ * AML_MP_DVRRECORDER_PREALLOCATE the segment being recorded is given
+ * segmentSize bytes of disk space as soon as it appears, released again when
+ * the recording moves on. With AML_MP_DVRRECORDER_WRITE_THROUGH the data written
+ * since the last status is written back and dropped from the page cache, on a
+ * thread of its own since waiting for the device blocks.
+ *
+ * update() is called after each record status, all methods but getStats() on
+ * the same thread.
+ */
+class AmlDVRSegmentStorage
+{
+public:
+    // flush sizes are rounded to this, whole TS packets and whole pages:
+    // lcm(188, 4096).
+    static const int kAlignment = 192512;
+
+    AmlDVRSegmentStorage(int64_t segmentSize, int flags);
+    ~AmlDVRSegmentStorage();
+
+    void update(const char* location);
+    // the recording stopped, release what was reserved.
+    void finish();
+
+    void getStats(Aml_MP_DVRWriteStats* stats) const;
+
+private:
+    struct WriteBack {
+        int fd;
+        uint64_t segmentId;
+        int64_t offset;
+        int64_t size;
+    };
+
+    void openSegment(const char* location, uint64_t segmentId);
+    void closeSegment();
+    void queueWriteBack(int64_t size);
+    void writeBackLoop();
+    void writeBack(const WriteBack& request);
+
+    const int64_t mSegmentSize;
+    const int mFlags;
+
+    int mFd = -1;
+    uint64_t mSegmentId = 0;
+    int64_t mSize = 0;
+    int64_t mWrittenBack = 0;
+    int64_t mFinishedBytes = 0;
+    int64_t mFinishedDiskBytes = 0;
+    bool mFallocateWarned = false;
+
+    std::mutex mWriteBackLock;
+    std::condition_variable mWriteBackCond;
+    std::deque<WriteBack> mWriteBacks;
+    bool mWriteBackBusy = false;
+    bool mExiting = false;
+    std::thread mWriteBackThread;
+
+    mutable std::mutex mStatsLock;
+    Aml_MP_DVRWriteStats mStats{};
+    // only used on mWriteBackThread
+    uint64_t mLatencySumUs = 0;
+    uint32_t mWriteBackCount = 0;
+
+    AmlDVRSegmentStorage(const AmlDVRSegmentStorage&) = delete;
+    AmlDVRSegmentStorage& operator= (const AmlDVRSegmentStorage&) = delete;
+};
+
+}
+
+#endif
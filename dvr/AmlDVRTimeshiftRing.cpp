@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRTimeshiftRing"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRTimeshiftRing.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRTsIndex.h"
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpMemoryTracker.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// files libdvr and the ts index keep per segment.
+static const char* const kSegmentExts[] = {"ts", "idx", "dat", "tsidx"};
+static const char kRingPrefix[] = "timeshift-";
+// holds the pid of the process recording to a RAM location.
+static const char kOwnerExt[] = ".owner";
+
+static std::mutex gRegistryLock;
+static std::map<std::string, std::string>& registry()
+{
+    static std::map<std::string, std::string>* locations = new std::map<std::string, std::string>();
+    return *locations;
+}
+
+static size_t fileUsage(const char* path)
+{
+    struct stat st;
+    // spilled segments are symlinks and cost nothing.
+    if (lstat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+
+    return st.st_blocks * 512;
+}
+
+static int copyFile(const char* from, const char* to)
+{
+    int in = ::open(from, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    int ret = -1;
+    struct stat st;
+    int out = ::open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out >= 0 && fstat(in, &st) == 0) {
+        off_t offset = 0;
+        while (offset < st.st_size) {
+            ssize_t len = sendfile(out, in, &offset, st.st_size - offset);
+            if (len <= 0) {
+                break;
+            }
+        }
+        ret = offset == st.st_size ? 0 : -1;
+    }
+
+    if (out >= 0) {
+        ::close(out);
+    }
+    ::close(in);
+
+    return ret;
+}
+
+static bool isStaleOwner(const std::string& markerPath)
+{
+    FILE* fp = fopen(markerPath.c_str(), "re");
+    if (fp == nullptr) {
+        return false;
+    }
+
+    int pid = 0;
+    bool valid = fscanf(fp, "%d", &pid) == 1 && pid > 0;
+    fclose(fp);
+
+    return valid && kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+// remove the files of rings whose owner died without the app deleting them,
+// files without a marker aren't ours to remove.
+static void cleanStaleRings(const std::string& dir)
+{
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return;
+    }
+
+    std::vector<std::string> stale;
+    size_t prefixLen = strlen(kRingPrefix);
+    size_t extLen = strlen(kOwnerExt);
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        size_t len = strlen(de->d_name);
+        if (len > prefixLen + extLen && !strncmp(de->d_name, kRingPrefix, prefixLen) &&
+            !strcmp(de->d_name + len - extLen, kOwnerExt) && isStaleOwner(dir + "/" + de->d_name)) {
+            stale.emplace_back(de->d_name, len - extLen);
+        }
+    }
+
+    rewinddir(d);
+    while ((de = readdir(d)) != nullptr) {
+        for (const std::string& name : stale) {
+            char next = de->d_name[name.size()];
+            if (!strncmp(de->d_name, name.c_str(), name.size()) && (next == '-' || next == '.')) {
+                MLOGI("remove stale %s", de->d_name);
+                unlinkat(dirfd(d), de->d_name, 0);
+                break;
+            }
+        }
+    }
+    closedir(d);
+}
+
+std::unique_ptr<AmlDVRTimeshiftRing> AmlDVRTimeshiftRing::create(const char* location)
+{
+    const AmlMpConfig& config = AmlMpConfig::instance();
+    const std::string& dir = config.mTimeshiftRamDir;
+    if (location == nullptr || dir.empty() || config.mTimeshiftRamSize <= 0) {
+        return nullptr;
+    }
+
+    struct statvfs vfs;
+    if (access(dir.c_str(), W_OK) < 0 || statvfs(dir.c_str(), &vfs) < 0) {
+        MLOGW("%s not usable, timeshift on disk", dir.c_str());
+        return nullptr;
+    }
+
+    // leave half of the tmpfs to others.
+    size_t budget = (size_t)config.mTimeshiftRamSize * 1024 * 1024;
+    budget = std::min<size_t>(budget, (size_t)vfs.f_bavail * vfs.f_frsize / 2);
+    budget = AmlMpMemoryTracker::instance().adviseSize(budget, 0, false);
+    if (budget == 0) {
+        MLOGW("no memory left for timeshift, timeshift on disk");
+        return nullptr;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s%08zx", kRingPrefix, std::hash<std::string>()(location) & 0xFFFFFFFF);
+
+    cleanStaleRings(dir);
+
+    std::string ramLocation = dir + "/" + name;
+    FILE* fp = fopen((ramLocation + kOwnerExt).c_str(), "we");
+    if (fp != nullptr) {
+        fprintf(fp, "%d\n", getpid());
+        fclose(fp);
+    }
+    MLOGI("timeshift of %s in %s, %zu bytes", location, ramLocation.c_str(), budget);
+
+    {
+        std::lock_guard<std::mutex> _l(gRegistryLock);
+        registry()[location] = ramLocation;
+    }
+
+    return std::unique_ptr<AmlDVRTimeshiftRing>(new AmlDVRTimeshiftRing(location, ramLocation, budget));
+}
+
+std::string AmlDVRTimeshiftRing::resolve(const char* location)
+{
+    if (location == nullptr) {
+        return std::string();
+    }
+
+    std::lock_guard<std::mutex> _l(gRegistryLock);
+    auto it = registry().find(location);
+    return it != registry().end() ? it->second : std::string(location);
+}
+
+AmlDVRTimeshiftRing::AmlDVRTimeshiftRing(const std::string& diskLocation, const std::string& ramLocation, size_t budget)
+: mDiskLocation(diskLocation)
+, mRamLocation(ramLocation)
+, mBudget(budget)
+{
+}
+
+AmlDVRTimeshiftRing::~AmlDVRTimeshiftRing()
+{
+    // the files and the mapping stay for the app to play and delete them.
+    AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, mAccountedBytes);
+}
+
+void AmlDVRTimeshiftRing::update()
+{
+    std::vector<uint64_t> ids;
+    if (AmlDVRSegmentCache::instance().getList(mRamLocation.c_str(), &ids) < 0) {
+        return;
+    }
+    std::set<uint64_t> current(ids.begin(), ids.end());
+
+    // libdvr only unlinks the symlinks of segments out of the window.
+    for (auto it = mSpilled.begin(); it != mSpilled.end(); ) {
+        if (current.count(*it) == 0) {
+            removeFiles(mDiskLocation, *it);
+            it = mSpilled.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    size_t usage = 0;
+    for (uint64_t id : current) {
+        usage += ramUsage(id);
+    }
+
+    // the newest segment is being written and always stays in RAM.
+    for (auto it = current.begin(); usage > mBudget && it != current.end() && *it != *current.rbegin(); ++it) {
+        if (mSpilled.count(*it)) {
+            continue;
+        }
+
+        size_t size = ramUsage(*it);
+        if (spill(*it) < 0) {
+            break;
+        }
+        usage -= std::min(size, usage);
+    }
+
+    // a spilled file a reader still has open keeps its RAM.
+    usage = heldUsage();
+    for (uint64_t id : current) {
+        usage += ramUsage(id);
+    }
+
+    if (usage > mAccountedBytes) {
+        AmlMpMemoryTracker::instance().charge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, usage - mAccountedBytes);
+    } else if (usage < mAccountedBytes) {
+        AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_DVR, AmlMpMemoryTracker::kNoInstance, mAccountedBytes - usage);
+    }
+    mAccountedBytes = usage;
+}
+
+size_t AmlDVRTimeshiftRing::ramUsage(uint64_t segmentId) const
+{
+    size_t usage = 0;
+    for (const char* ext : kSegmentExts) {
+        usage += fileUsage(AmlDVRSegmentFile(mRamLocation.c_str(), segmentId, ext).c_str());
+    }
+
+    return usage;
+}
+
+size_t AmlDVRTimeshiftRing::heldUsage() const
+{
+    DIR* d = opendir("/proc/self/fd");
+    if (d == nullptr) {
+        return 0;
+    }
+
+    std::string prefix = mRamLocation + "-";
+    static const char kDeleted[] = " (deleted)";
+    std::set<ino_t> inodes;
+    size_t usage = 0;
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        char path[64];
+        char target[PATH_MAX];
+        snprintf(path, sizeof(path), "/proc/self/fd/%s", de->d_name);
+        ssize_t len = readlink(path, target, sizeof(target) - 1);
+        if (len <= 0) {
+            continue;
+        }
+        target[len] = '\0';
+
+        size_t deletedLen = strlen(kDeleted);
+        struct stat st;
+        if ((size_t)len > deletedLen && !strncmp(target, prefix.c_str(), prefix.size()) &&
+            !strcmp(target + len - deletedLen, kDeleted) &&
+            stat(path, &st) == 0 && inodes.insert(st.st_ino).second) {
+            usage += st.st_blocks * 512;
+        }
+    }
+    closedir(d);
+
+    return usage;
+}
+
+int AmlDVRTimeshiftRing::spill(uint64_t segmentId)
+{
+    for (const char* ext : kSegmentExts) {
+        std::string ramPath = AmlDVRSegmentFile(mRamLocation.c_str(), segmentId, ext);
+        std::string diskPath = AmlDVRSegmentFile(mDiskLocation.c_str(), segmentId, ext);
+        if (copyFile(ramPath.c_str(), diskPath.c_str()) < 0) {
+            MLOGE("copy %s to %s failed, %s", ramPath.c_str(), diskPath.c_str(), strerror(errno));
+            removeFiles(mDiskLocation, segmentId);
+            return -1;
+        }
+    }
+
+    // replace the RAM files by symlinks, readers that have them open keep
+    // reading the old inode until they close it.
+    for (const char* ext : kSegmentExts) {
+        std::string ramPath = AmlDVRSegmentFile(mRamLocation.c_str(), segmentId, ext);
+        std::string diskPath = AmlDVRSegmentFile(mDiskLocation.c_str(), segmentId, ext);
+        if (access(diskPath.c_str(), F_OK) < 0) {
+            continue;
+        }
+        std::string tmpPath = ramPath + ".tmp";
+        unlink(tmpPath.c_str());
+        if (symlink(diskPath.c_str(), tmpPath.c_str()) < 0 || rename(tmpPath.c_str(), ramPath.c_str()) < 0) {
+            MLOGE("link %s failed, %s", ramPath.c_str(), strerror(errno));
+            unlink(tmpPath.c_str());
+        }
+    }
+
+    mSpilled.insert(segmentId);
+    MLOGI("segment %" PRIu64 " moved to %s", segmentId, mDiskLocation.c_str());
+
+    return 0;
+}
+
+void AmlDVRTimeshiftRing::removeFiles(const std::string& location, uint64_t segmentId)
+{
+    for (const char* ext : kSegmentExts) {
+        unlink(AmlDVRSegmentFile(location.c_str(), segmentId, ext).c_str());
+    }
+}
+
+}
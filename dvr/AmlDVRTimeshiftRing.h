@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_TIMESHIFT_RING_H_
+#define _AML_DVR_TIMESHIFT_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace aml_mp {
+
+/*
+ * Timeshift kept in RAM.
+ *
+ * The recorder is pointed at a location on tmpfs (AmlMpConfig::mTimeshiftRamDir)
+ * instead of the one given by the app. libdvr already drops the oldest segments
+ * beyond maxSize/maxTime, so as long as the window fits mTimeshiftRamSize the
+ * flash is never written. Beyond that, the oldest segments are moved to the
+ * app's location and replaced by symlinks, so libdvr keeps finding every
+ * segment under the RAM location.
+ *
+ * The player and the segment APIs look the app's location up with resolve().
+ * The files outlive the ring like the ones on disk do, the app deletes them,
+ * and the mapping stays registered for that. A marker holding the pid of the
+ * owner lets a later process clean the files of one that died.
+ */
+class AmlDVRTimeshiftRing
+{
+public:
+    // nullptr if timeshift of location has to stay on disk.
+    static std::unique_ptr<AmlDVRTimeshiftRing> create(const char* location);
+    // RAM location timeshift of location is recorded to, location if none.
+    static std::string resolve(const char* location);
+
+    ~AmlDVRTimeshiftRing();
+
+    const char* location() const {
+        return mRamLocation.c_str();
+    }
+
+    // call after libdvr reported a status, moves segments to disk if needed.
+    void update();
+
+private:
+    AmlDVRTimeshiftRing(const std::string& diskLocation, const std::string& ramLocation, size_t budget);
+
+    size_t ramUsage(uint64_t segmentId) const;
+    // RAM still held by spilled files that are open in this process.
+    size_t heldUsage() const;
+    int spill(uint64_t segmentId);
+    void removeFiles(const std::string& location, uint64_t segmentId);
+
+    const std::string mDiskLocation;
+    const std::string mRamLocation;
+    const size_t mBudget;
+
+    size_t mAccountedBytes = 0;
+    std::set<uint64_t> mSpilled;
+
+    AmlDVRTimeshiftRing(const AmlDVRTimeshiftRing&) = delete;
+    AmlDVRTimeshiftRing& operator= (const AmlDVRTimeshiftRing&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRTrickPlay"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRTrickPlay.h"
+#include "AmlDVRSegmentCache.h"
+#include <utils/AmlMpEventLooper.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+// slower rates are left to libdvr.
+static const float kMinTrickRate = 4.0f;
+// one frame per step, 10 frames per second.
+static const int64_t kStepMs = 100;
+static const int64_t kRefreshIntervalUs = 1000 * 1000;
+static const uint32_t kMaxFrameSize = 4 * 1024 * 1024;
+static const int kWriteTimeoutMs = 100;
+static const size_t kTsPacketSize = 188;
+
+AmlDVRIndexTimeline::AmlDVRIndexTimeline(const char* location)
+: mLocation(location)
+{
+}
+
+int AmlDVRIndexTimeline::refresh()
+{
+    AmlDVRSegmentCache& cache = AmlDVRSegmentCache::instance();
+    std::vector<uint64_t> ids;
+    int ret = cache.getList(mLocation.c_str(), &ids);
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::vector<Segment> segments;
+    int64_t start = 0;
+    for (uint64_t id : ids) {
+        Aml_MP_DVRSegmentInfo info;
+        if (cache.getInfo(mLocation.c_str(), id, &info) < 0) {
+            return -1;
+        }
+        segments.push_back({id, start, (int64_t)info.duration});
+        start += info.duration;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mSegments = std::move(segments);
+    for (auto it = mIndexFiles.begin(); it != mIndexFiles.end(); ) {
+        if (std::find(ids.begin(), ids.end(), it->first) == ids.end()) {
+            it = mIndexFiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return 0;
+}
+
+int64_t AmlDVRIndexTimeline::duration() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mSegments.empty()) {
+        return 0;
+    }
+
+    return mSegments.back().startMs + mSegments.back().durationMs;
+}
+
+bool AmlDVRIndexTimeline::find(int64_t timeMs, bool before, uint32_t flags, Entry* entry)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mSegments.empty()) {
+        return false;
+    }
+
+    // segment holding timeMs
+    auto it = std::upper_bound(mSegments.begin(), mSegments.end(), timeMs,
+            [](int64_t t, const Segment& s) { return t < s.startMs; });
+    ssize_t i = it == mSegments.begin() ? 0 : it - mSegments.begin() - 1;
+
+    // the entry may be in a neighbouring segment.
+    for (; i >= 0 && i < (ssize_t)mSegments.size(); i += before ? -1 : 1) {
+        const Segment& segment = mSegments[i];
+        AmlDVRTsIndexFile* index = indexFile_l(segment.id);
+        if (index == nullptr) {
+            continue;
+        }
+
+        int64_t relative = std::max<int64_t>(timeMs - segment.startMs, 0);
+        relative = std::min<int64_t>(relative, UINT32_MAX);
+        ssize_t n = before ? index->findBefore(relative, flags) : index->findAfter(relative, flags);
+        if (n >= 0) {
+            const AmlDVRTsIndexEntry& e = index->at(n);
+            *entry = {segment.id, segment.startMs + e.timeMs, e.offset, e.size, index->videoPid()};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+AmlDVRTsIndexFile* AmlDVRIndexTimeline::indexFile_l(uint64_t segmentId)
+{
+    auto it = mIndexFiles.find(segmentId);
+    if (it != mIndexFiles.end()) {
+        // the segment may still be recorded.
+        it->second->refresh();
+        return it->second->count() > 0 ? it->second.get() : nullptr;
+    }
+
+    std::unique_ptr<AmlDVRTsIndexFile> index(new AmlDVRTsIndexFile());
+    if (index->open(AmlDVRSegmentFile(mLocation.c_str(), segmentId, "tsidx").c_str()) < 0) {
+        return nullptr;
+    }
+
+    AmlDVRTsIndexFile* ret = index.get();
+    mIndexFiles.emplace(segmentId, std::move(index));
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AmlDVRTrickPlay::AmlDVRTrickPlay(AmlDVRIndexTimeline* timeline, am_tsplayer_handle player, const BoundCallback& boundCb)
+: mTimeline(timeline)
+, mPlayer(player)
+, mBoundCb(boundCb)
+{
+}
+
+AmlDVRTrickPlay::~AmlDVRTrickPlay()
+{
+    stop();
+}
+
+bool AmlDVRTrickPlay::isTrickRate(float rate)
+{
+    return fabsf(rate) >= kMinTrickRate;
+}
+
+int AmlDVRTrickPlay::start(int64_t positionMs, float rate)
+{
+    if (mThread.joinable()) {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mPosition = positionMs;
+        mRate = rate;
+        mBound = 0;
+        mStopping = false;
+    }
+
+    MLOGI("start at %" PRId64 " ms, rate:%f", positionMs, rate);
+    mLastFrameTime = -1;
+    mLastRefreshUs = AmlMpEventLooper::GetNowUs();
+    mBytesRead = 0;
+    mEventStrand = AmlMpExecutor::instance().createStrand(LOG_TAG);
+    mThread = std::thread([this] { threadLoop(); });
+
+    return 0;
+}
+
+void AmlDVRTrickPlay::setRate(float rate)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mRate = rate;
+    if ((mBound > 0 && rate < 0) || (mBound < 0 && rate > 0)) {
+        // turning away from the bound.
+        mBound = 0;
+        mCond.notify_all();
+    }
+}
+
+void AmlDVRTrickPlay::seek(int64_t positionMs)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    mPosition = positionMs;
+    mSeekGeneration++;
+    mBound = 0;
+    mCond.notify_all();
+}
+
+int64_t AmlDVRTrickPlay::stop()
+{
+    if (mThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            mStopping = true;
+            mCond.notify_all();
+        }
+        mThread.join();
+        MLOGI("stop at %" PRId64 " ms, %zu bytes read", position(), mBytesRead);
+    }
+
+    if (mEventStrand != nullptr) {
+        mEventStrand->shutdown();
+        mEventStrand.clear();
+    }
+
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+
+    return position();
+}
+
+int64_t AmlDVRTrickPlay::position() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mPosition;
+}
+
+float AmlDVRTrickPlay::rate() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mRate;
+}
+
+void AmlDVRTrickPlay::threadLoop()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    while (!mStopping) {
+        if (mBound != 0) {
+            mCond.wait(_l, [this] { return mStopping || mBound == 0; });
+            continue;
+        }
+
+        _l.unlock();
+        step();
+        _l.lock();
+
+        mCond.wait_for(_l, std::chrono::milliseconds(kStepMs), [this] { return mStopping; });
+    }
+}
+
+void AmlDVRTrickPlay::step()
+{
+    int64_t nowUs = AmlMpEventLooper::GetNowUs();
+    if (nowUs - mLastRefreshUs >= kRefreshIntervalUs) {
+        // follow a recording in progress.
+        mTimeline->refresh();
+        mLastRefreshUs = nowUs;
+    }
+
+    float rate;
+    int64_t target;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        rate = mRate;
+        target = mPosition + (int64_t)(rate * kStepMs);
+        generation = mSeekGeneration;
+    }
+
+    int64_t duration = mTimeline->duration();
+    int bound = 0;
+    if (rate > 0 && target >= duration) {
+        target = duration;
+        bound = 1;
+    } else if (rate < 0 && target <= 0) {
+        target = 0;
+        bound = -1;
+    }
+
+    // show the I-frame the position has just passed.
+    AmlDVRIndexTimeline::Entry frame;
+    if (mTimeline->find(target, rate > 0, AML_DVR_TS_INDEX_KEYFRAME, &frame) && frame.timeMs != mLastFrameTime) {
+        if (inject(frame) == 0) {
+            mLastFrameTime = frame.timeMs;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        // a seek() during the step wins.
+        if (mSeekGeneration != generation) {
+            return;
+        }
+        mPosition = target;
+        mBound = bound;
+    }
+
+    if (bound != 0) {
+        MLOGI("reached %s at %" PRId64 " ms", bound > 0 ? "end" : "begin", target);
+        if (mBoundCb) {
+            BoundCallback cb = mBoundCb;
+            mEventStrand->post([cb, bound, target] { cb(bound > 0, target); });
+        }
+    }
+}
+
+int AmlDVRTrickPlay::inject(const AmlDVRIndexTimeline::Entry& frame)
+{
+    if (frame.size == 0 || frame.size > kMaxFrameSize) {
+        return -1;
+    }
+
+    if (mFd < 0 || mFdSegment != frame.segmentId) {
+        if (mFd >= 0) {
+            ::close(mFd);
+        }
+        std::string path = AmlDVRSegmentFile(mTimeline->location(), frame.segmentId, "ts");
+        mFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (mFd < 0) {
+            MLOGE("open %s failed!", path.c_str());
+            return -1;
+        }
+        mFdSegment = frame.segmentId;
+    }
+
+    mReadBuffer.resize(frame.size);
+    ssize_t len = pread(mFd, mReadBuffer.data(), frame.size, frame.offset);
+    if (len <= 0) {
+        return -1;
+    }
+    mBytesRead += len;
+
+    // keep the video packets only, audio isn't decoded during trick play.
+    mWriteBuffer.clear();
+    for (ssize_t i = 0; i + (ssize_t)kTsPacketSize <= len; i += kTsPacketSize) {
+        const uint8_t* packet = &mReadBuffer[i];
+        int pid = (packet[1] & 0x1F) << 8 | packet[2];
+        if (packet[0] == 0x47 && pid == frame.videoPid) {
+            mWriteBuffer.insert(mWriteBuffer.end(), packet, packet + kTsPacketSize);
+        }
+    }
+
+    if (mWriteBuffer.empty()) {
+        return -1;
+    }
+
+    am_tsplayer_input_buffer buffer = {TS_INPUT_BUFFER_TYPE_NORMAL, mWriteBuffer.data(), (int32_t)mWriteBuffer.size()};
+    am_tsplayer_result ret = AmTsPlayer_writeData(mPlayer, &buffer, kWriteTimeoutMs);
+    if (ret != AM_TSPLAYER_OK) {
+        MLOGW("write frame at %" PRId64 " ms failed, ret:%d", frame.timeMs, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+}
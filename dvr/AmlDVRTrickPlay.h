@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_TRICK_PLAY_H_
+#define _AML_DVR_TRICK_PLAY_H_
+
+#include <utils/AmlMpExecutor.h>
+#include "AmTsPlayer.h"
+#include "AmlDVRTsIndex.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * The ts indexes of all segments of a location on one time line, segments
+ * start where the previous one ends.
+ */
+class AmlDVRIndexTimeline
+{
+public:
+    struct Entry {
+        uint64_t segmentId;
+        int64_t timeMs;
+        uint64_t offset;
+        uint32_t size;
+        int videoPid;
+    };
+
+    explicit AmlDVRIndexTimeline(const char* location);
+    ~AmlDVRIndexTimeline() = default;
+
+    const char* location() const {
+        return mLocation.c_str();
+    }
+
+    // reload the segment list and durations.
+    int refresh();
+    int64_t duration() const;
+
+    // last entry at or before timeMs if before is set, else first entry at or
+    // after timeMs, with all of flags set.
+    bool find(int64_t timeMs, bool before, uint32_t flags, Entry* entry);
+
+private:
+    struct Segment {
+        uint64_t id;
+        int64_t startMs;
+        int64_t durationMs;
+    };
+
+    AmlDVRTsIndexFile* indexFile_l(uint64_t segmentId);
+
+    const std::string mLocation;
+    mutable std::mutex mLock;
+    std::vector<Segment> mSegments;
+    std::map<uint64_t, std::unique_ptr<AmlDVRTsIndexFile>> mIndexFiles;
+
+    AmlDVRIndexTimeline(const AmlDVRIndexTimeline&) = delete;
+    AmlDVRIndexTimeline& operator= (const AmlDVRIndexTimeline&) = delete;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Fast forward and rewind by injecting I-frames only.
+ *
+ * At high rates the decoder can't keep up with whole GOPs anyway, so instead
+ * of letting libdvr read everything, the engine picks one keyframe from the
+ * index per step, reads just that frame and writes its video packets to the
+ * TsPlayer, which decodes in I-frame only mode.
+ *
+ * Writing to the TsPlayer blocks, so the steps run on a thread of their own.
+ * Stepping stops at either end of the recording and the bound callback is
+ * invoked from a strand, a seek() or a rate turning back resumes it.
+ */
+class AmlDVRTrickPlay
+{
+public:
+    // reachedEnd is false when the beginning is reached.
+    typedef std::function<void(bool reachedEnd, int64_t positionMs)> BoundCallback;
+
+    AmlDVRTrickPlay(AmlDVRIndexTimeline* timeline, am_tsplayer_handle player, const BoundCallback& boundCb);
+    ~AmlDVRTrickPlay();
+
+    // rates handled by the engine instead of libdvr.
+    static bool isTrickRate(float rate);
+
+    int start(int64_t positionMs, float rate);
+    void setRate(float rate);
+    void seek(int64_t positionMs);
+    // return the position reached.
+    int64_t stop();
+
+    int64_t position() const;
+    float rate() const;
+
+private:
+    void threadLoop();
+    void step();
+    int inject(const AmlDVRIndexTimeline::Entry& frame);
+
+    AmlDVRIndexTimeline* mTimeline;
+    const am_tsplayer_handle mPlayer;
+    const BoundCallback mBoundCb;
+    std::thread mThread;
+    // the callback may stop the trick play, it doesn't run on mThread.
+    sptr<AmlMpExecutor::Strand> mEventStrand;
+
+    mutable std::mutex mLock;
+    std::condition_variable mCond;
+    bool mStopping = false;
+    int64_t mPosition = 0;
+    float mRate = 1.0f;
+    uint32_t mSeekGeneration = 0;
+    // 1 at the end, -1 at the beginning, 0 while stepping.
+    int mBound = 0;
+
+    // only used on mThread
+    int64_t mLastFrameTime = -1;
+    int64_t mLastRefreshUs = 0;
+    int mFd = -1;
+    uint64_t mFdSegment = 0;
+    std::vector<uint8_t> mReadBuffer;
+    std::vector<uint8_t> mWriteBuffer;
+    size_t mBytesRead = 0;
+
+    AmlDVRTrickPlay(const AmlDVRTrickPlay&) = delete;
+    AmlDVRTrickPlay& operator= (const AmlDVRTrickPlay&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlDVRTsIndex"
+#include <utils/AmlMpLog.h>
+#include "AmlDVRTsIndex.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const uint32_t kIndexMagic = 0x58444954; // "TIDX"
+static const uint16_t kIndexVersion = 2;
+static const size_t kTsPacketSize = 188;
+static const uint64_t kPcrWrap = 1ULL << 33;
+// larger PCR steps are discontinuities and don't advance the clock.
+static const uint64_t kMaxPcrStep = 10 * 90000;
+
+std::string AmlDVRSegmentFile(const char* location, uint64_t segmentId, const char* ext)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s-%04" PRIu64 ".%s", location, segmentId, ext);
+    return path;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AmlDVRTsIndexBuilder::AmlDVRTsIndexBuilder(int intervalMs)
+: mIntervalMs(intervalMs > 0 ? intervalMs : 500)
+{
+}
+
+AmlDVRTsIndexBuilder::~AmlDVRTsIndexBuilder()
+{
+    close();
+}
+
+void AmlDVRTsIndexBuilder::setVideoStream(int pid, Aml_MP_CodecID codecId)
+{
+    mVideoPid = pid;
+    mVideoCodec = codecId;
+}
+
+int AmlDVRTsIndexBuilder::open(const char* indexPath)
+{
+    close();
+
+    mFd = ::open(indexPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        MLOGE("open %s failed, %s", indexPath, strerror(errno));
+        return -1;
+    }
+
+    AmlDVRTsIndexHeader header{};
+    header.magic = kIndexMagic;
+    header.version = kIndexVersion;
+    header.entrySize = sizeof(AmlDVRTsIndexEntry);
+    header.intervalMs = mIntervalMs;
+    header.videoPid = mVideoPid;
+    if (write(mFd, &header, sizeof(header)) != sizeof(header)) {
+        MLOGE("write %s header failed, %s", indexPath, strerror(errno));
+        ::close(mFd);
+        mFd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void AmlDVRTsIndexBuilder::close()
+{
+    if (mFd >= 0) {
+        // the segment ends here, the last access unit is complete.
+        startAccessUnit(offset(), 0);
+        mAccessUnitState = kAccessUnitNone;
+        flush();
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+void AmlDVRTsIndexBuilder::feed(const uint8_t* data, size_t size)
+{
+    const uint8_t* end = data + size;
+
+    if (mPartialSize > 0) {
+        size_t len = std::min((size_t)(end - data), kTsPacketSize - mPartialSize);
+        memcpy(mPartial + mPartialSize, data, len);
+        mPartialSize += len;
+        data += len;
+        if (mPartialSize < kTsPacketSize) {
+            return;
+        }
+
+        parsePacket(mPartial, mOffset);
+        mOffset += kTsPacketSize;
+        mPartialSize = 0;
+    }
+
+    while (data < end) {
+        if (*data != 0x47) {
+            // lost sync, skip to the next sync byte.
+            data++;
+            mOffset++;
+            continue;
+        }
+
+        if ((size_t)(end - data) < kTsPacketSize) {
+            mPartialSize = end - data;
+            memcpy(mPartial, data, mPartialSize);
+            break;
+        }
+
+        parsePacket(data, mOffset);
+        data += kTsPacketSize;
+        mOffset += kTsPacketSize;
+    }
+}
+
+void AmlDVRTsIndexBuilder::skipTo(uint64_t offset)
+{
+    mPartialSize = 0;
+    mOffset = offset;
+}
+
+void AmlDVRTsIndexBuilder::parsePacket(const uint8_t* packet, uint64_t offset)
+{
+    int pid = (packet[1] & 0x1F) << 8 | packet[2];
+    bool pusi = packet[1] & 0x40;
+    int afc = (packet[3] >> 4) & 0x03;
+    bool rai = false;
+    size_t payloadOffset = 4;
+
+    if ((afc & 0x02) && packet[4] > 0) {
+        uint8_t afFlags = packet[5];
+        rai = afFlags & 0x40;
+
+        if ((afFlags & 0x10) && packet[4] >= 7 && (mPcrPid < 0 || mPcrPid == pid)) {
+            int64_t pcr = (int64_t)packet[6] << 25 | packet[7] << 17 | packet[8] << 9 | packet[9] << 1 | packet[10] >> 7;
+            if (mPcrPid < 0) {
+                mPcrPid = pid;
+                MLOGI("pcr pid:%d", pid);
+            } else {
+                uint64_t step = (pcr - mLastPcr + kPcrWrap) % kPcrWrap;
+                if (step <= kMaxPcrStep) {
+                    mClock += step;
+                }
+            }
+            mLastPcr = pcr;
+        }
+    }
+    if (afc & 0x02) {
+        payloadOffset += 1 + packet[4];
+    }
+
+    bool scanVideo = pid == mVideoPid && (mVideoCodec == AML_MP_VIDEO_CODEC_H264 || mVideoCodec == AML_MP_VIDEO_CODEC_HEVC);
+    bool rap = rai && pusi && !scanVideo;
+    if (mLastPcr < 0) {
+        // no time base yet, remember the first random access point.
+        if (rap && mPendingRap < 0) {
+            mPendingRap = offset;
+        }
+        return;
+    }
+
+    if (mPendingRap >= 0) {
+        addEntry(0, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START, mPendingRap);
+        mLastRapTime = 0;
+        mHasRap = true;
+        mPendingRap = -1;
+    }
+
+    uint32_t now = mClock / 90;
+    if (scanVideo && pusi) {
+        startAccessUnit(offset, now);
+    }
+
+    if (rap && (!mHasRap || now >= mLastRapTime + mIntervalMs)) {
+        addEntry(now, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START, offset);
+        mLastRapTime = now;
+        mHasRap = true;
+    } else if (!mHasEntry || now >= mLastEntryTime + mIntervalMs) {
+        addEntry(now, pusi && pid == mPcrPid ? AML_DVR_TS_INDEX_PES_START : 0, offset);
+    }
+
+    if (scanVideo && mAccessUnitState == kAccessUnitScanning && (afc & 0x01) && payloadOffset < kTsPacketSize) {
+        const uint8_t* payload = packet + payloadOffset;
+        size_t size = kTsPacketSize - payloadOffset;
+        if (pusi) {
+            // skip the PES header
+            if (size < 9 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1 || (size_t)9 + payload[8] > size) {
+                return;
+            }
+            size_t headerSize = 9 + payload[8];
+            payload += headerSize;
+            size -= headerSize;
+        }
+        scanPayload(payload, size);
+    }
+}
+
+void AmlDVRTsIndexBuilder::startAccessUnit(uint64_t offset, uint32_t timeMs)
+{
+    if (mOpenKeyframe >= 0) {
+        mPending[mOpenKeyframe].size = offset - mPending[mOpenKeyframe].offset;
+        mOpenKeyframe = -1;
+    }
+
+    mAccessUnitState = kAccessUnitScanning;
+    mAccessUnitOffset = offset;
+    mAccessUnitTime = timeMs;
+    mAccessUnitPos = mPending.size();
+    mZeroBytes = 0;
+    mNalHeaderSize = 0;
+    mNalHeaderWanted = 0;
+}
+
+void AmlDVRTsIndexBuilder::scanPayload(const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size && mAccessUnitState == kAccessUnitScanning; ++i) {
+        uint8_t b = data[i];
+
+        if (mNalHeaderSize < mNalHeaderWanted) {
+            mNalHeader[mNalHeaderSize++] = b;
+            if (mNalHeaderSize == mNalHeaderWanted) {
+                mNalHeaderWanted = 0;
+                int key = classifyNal();
+                if (key >= 0) {
+                    mAccessUnitState = kAccessUnitDone;
+                }
+                if (key > 0) {
+                    mPending.insert(mPending.begin() + mAccessUnitPos,
+                            {mAccessUnitTime, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START | AML_DVR_TS_INDEX_KEYFRAME,
+                            mAccessUnitOffset, 0, 0});
+                    mOpenKeyframe = mAccessUnitPos;
+                    mEntryCount++;
+                    mHasEntry = true;
+                    mLastEntryTime = std::max(mLastEntryTime, mAccessUnitTime);
+                    mLastRapTime = mAccessUnitTime;
+                    mHasRap = true;
+                }
+            }
+        }
+
+        if (mZeroBytes >= 2 && b == 1) {
+            // start code, collect the NAL header and the start of the slice header.
+            mNalHeaderSize = 0;
+            mNalHeaderWanted = mVideoCodec == AML_MP_VIDEO_CODEC_H264 ? 5 : 2;
+            mZeroBytes = 0;
+        } else if (b == 0) {
+            mZeroBytes++;
+        } else {
+            mZeroBytes = 0;
+        }
+    }
+}
+
+// unsigned Exp-Golomb code, -1 if it doesn't fit in the data.
+static int readUe(const uint8_t* data, size_t size, size_t* bit)
+{
+    size_t total = size * 8;
+    int zeros = 0;
+    while (*bit < total && !(data[*bit / 8] & (0x80 >> (*bit % 8)))) {
+        zeros++;
+        (*bit)++;
+    }
+    if (*bit + zeros + 1 > total || zeros > 16) {
+        return -1;
+    }
+
+    (*bit)++;
+    int value = 0;
+    for (int i = 0; i < zeros; ++i, ++(*bit)) {
+        value = value << 1 | ((data[*bit / 8] >> (7 - *bit % 8)) & 1);
+    }
+
+    return (1 << zeros) - 1 + value;
+}
+
+int AmlDVRTsIndexBuilder::classifyNal() const
+{
+    if (mVideoCodec == AML_MP_VIDEO_CODEC_H264) {
+        int type = mNalHeader[0] & 0x1F;
+        if (type == 5) {
+            return 1;
+        } else if (type == 1) {
+            size_t bit = 0;
+            // first_mb_in_slice, then slice_type
+            if (readUe(mNalHeader + 1, 4, &bit) < 0) {
+                return 0;
+            }
+            int sliceType = readUe(mNalHeader + 1, 4, &bit);
+            return sliceType >= 0 && (sliceType % 5 == 2 || sliceType % 5 == 4) ? 1 : 0;
+        } else if (type >= 2 && type <= 4) {
+            return 0;
+        }
+        return -1;
+    }
+
+    int type = (mNalHeader[0] >> 1) & 0x3F;
+    if (type >= 16 && type <= 23) {
+        // IRAP pictures
+        return 1;
+    } else if (type <= 9) {
+        return 0;
+    }
+    return -1;
+}
+
+void AmlDVRTsIndexBuilder::addEntry(uint32_t timeMs, uint32_t flags, uint64_t offset)
+{
+    mPending.push_back({timeMs, flags, offset, 0, 0});
+    mLastEntryTime = timeMs;
+    mHasEntry = true;
+    mEntryCount++;
+}
+
+int AmlDVRTsIndexBuilder::flush()
+{
+    // keep the entries from an access unit that isn't complete yet, its keyframe
+    // entry is inserted or sized later.
+    size_t count = mPending.size();
+    if (mOpenKeyframe >= 0) {
+        count = mOpenKeyframe;
+    } else if (mAccessUnitState == kAccessUnitScanning) {
+        count = mAccessUnitPos;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (mFd < 0) {
+        dropPending(count);
+        return -1;
+    }
+
+    const uint8_t* data = (const uint8_t*)mPending.data();
+    size_t size = count * sizeof(AmlDVRTsIndexEntry);
+    while (size > 0) {
+        ssize_t ret = write(mFd, data, size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            MLOGE("write index failed, %s", strerror(errno));
+            dropPending(count);
+            return -1;
+        }
+        data += ret;
+        size -= ret;
+    }
+
+    dropPending(count);
+    return 0;
+}
+
+void AmlDVRTsIndexBuilder::dropPending(size_t count)
+{
+    mPending.erase(mPending.begin(), mPending.begin() + count);
+    if (mOpenKeyframe >= 0) {
+        mOpenKeyframe -= count;
+    }
+    if (mAccessUnitState == kAccessUnitScanning) {
+        mAccessUnitPos -= count;
+    }
+}
+
+int AmlDVRTsIndexBuilder::BuildFile(const char* tsPath, const char* indexPath, int intervalMs,
+        int videoPid, Aml_MP_CodecID videoCodec)
+{
+    int fd = ::open(tsPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        MLOGE("open %s failed, %s", tsPath, strerror(errno));
+        return -1;
+    }
+
+    AmlDVRTsIndexBuilder builder(intervalMs);
+    builder.setVideoStream(videoPid, videoCodec);
+    if (builder.open(indexPath) < 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    std::vector<uint8_t> buffer(kTsPacketSize * 1024);
+    ssize_t len;
+    while ((len = read(fd, buffer.data(), buffer.size())) > 0) {
+        builder.feed(buffer.data(), len);
+    }
+    ::close(fd);
+
+    builder.close();
+    MLOGI("%s: %zu entries", indexPath, builder.entryCount());
+
+    return len < 0 ? -1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AmlDVRTsIndexFile::~AmlDVRTsIndexFile()
+{
+    close();
+}
+
+int AmlDVRTsIndexFile::open(const char* indexPath)
+{
+    close();
+    mPath = indexPath;
+
+    return refresh() > 0 ? 0 : -1;
+}
+
+void AmlDVRTsIndexFile::close()
+{
+    if (mMap != nullptr) {
+        munmap(mMap, mMapSize);
+        mMap = nullptr;
+    }
+
+    mMapSize = 0;
+    mEntries = nullptr;
+    mCount = 0;
+}
+
+size_t AmlDVRTsIndexFile::refresh()
+{
+    int fd = ::open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        close();
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size == mMapSize) {
+        ::close(fd);
+        return mCount;
+    }
+
+    close();
+    if ((size_t)st.st_size < sizeof(AmlDVRTsIndexHeader)) {
+        ::close(fd);
+        return 0;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        MLOGE("mmap %s failed, %s", mPath.c_str(), strerror(errno));
+        return 0;
+    }
+
+    const AmlDVRTsIndexHeader* header = (const AmlDVRTsIndexHeader*)map;
+    if (header->magic != kIndexMagic || header->version != kIndexVersion || header->entrySize != sizeof(AmlDVRTsIndexEntry)) {
+        MLOGW("%s is not a ts index", mPath.c_str());
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    mMap = map;
+    mMapSize = st.st_size;
+    mEntries = (const AmlDVRTsIndexEntry*)(header + 1);
+    mVideoPid = header->videoPid;
+    // a partially written entry is ignored.
+    mCount = (mMapSize - sizeof(AmlDVRTsIndexHeader)) / sizeof(AmlDVRTsIndexEntry);
+
+    return mCount;
+}
+
+ssize_t AmlDVRTsIndexFile::findBefore(uint32_t timeMs, uint32_t flags) const
+{
+    const AmlDVRTsIndexEntry* it = std::upper_bound(mEntries, mEntries + mCount, timeMs,
+            [](uint32_t t, const AmlDVRTsIndexEntry& e) { return t < e.timeMs; });
+
+    for (ssize_t i = it - mEntries - 1; i >= 0; --i) {
+        if ((mEntries[i].flags & flags) == flags) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+ssize_t AmlDVRTsIndexFile::findAfter(uint32_t timeMs, uint32_t flags) const
+{
+    const AmlDVRTsIndexEntry* it = std::lower_bound(mEntries, mEntries + mCount, timeMs,
+            [](const AmlDVRTsIndexEntry& e, uint32_t t) { return e.timeMs < t; });
+
+    for (size_t i = it - mEntries; i < mCount; ++i) {
+        if ((mEntries[i].flags & flags) == flags) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+}
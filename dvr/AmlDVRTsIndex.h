@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef _AML_DVR_TS_INDEX_H_
+#define _AML_DVR_TS_INDEX_H_
+
+#include <Aml_MP/Common.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace aml_mp {
+
+/*
+ * Time to byte offset index of a recorded segment.
+ *
+ * The index is stored next to the segment as <location>-<id>.tsidx: a header
+ * followed by fixed size entries sorted by time, so the file can be mapped and
+ * binary searched as is. It is only appended to, readers use as many entries
+ * as the file holds.
+ */
+struct AmlDVRTsIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint32_t intervalMs;
+    uint16_t videoPid;      // 0x1FFF if unknown
+    uint16_t reserved;
+};
+
+struct AmlDVRTsIndexEntry {
+    uint32_t timeMs;        // relative to the first PCR of the segment
+    uint32_t flags;
+    uint64_t offset;        // byte offset of the TS packet in the segment
+    uint32_t size;          // keyframes only, bytes up to the next video PES
+    uint32_t reserved;
+};
+
+enum {
+    AML_DVR_TS_INDEX_RANDOM_ACCESS  = (1 << 0),
+    AML_DVR_TS_INDEX_PES_START      = (1 << 1),
+    AML_DVR_TS_INDEX_KEYFRAME       = (1 << 2),
+};
+
+std::string AmlDVRSegmentFile(const char* location, uint64_t segmentId, const char* ext);
+
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Builds the index from plain TS data, in software.
+ *
+ * The time base is the PCR of the first PID carrying one. An entry is added at
+ * every random access point (random_access_indicator set) at least intervalMs
+ * after the previous one, and every intervalMs in between.
+ *
+ * When the video stream is H.264 or HEVC, its PES payload is scanned for NAL
+ * units instead, and every I-frame gets a keyframe entry with its size, so
+ * trick play can read the I-frames alone.
+ */
+class AmlDVRTsIndexBuilder
+{
+public:
+    explicit AmlDVRTsIndexBuilder(int intervalMs);
+    ~AmlDVRTsIndexBuilder();
+
+    // call before open().
+    void setVideoStream(int pid, Aml_MP_CodecID codecId);
+
+    int open(const char* indexPath);
+    void close();
+
+    // data continues the stream at offset().
+    void feed(const uint8_t* data, size_t size);
+    // the next data starts at offset, drop a partial packet.
+    void skipTo(uint64_t offset);
+    // write the pending entries to the index file.
+    int flush();
+
+    // number of bytes fed so far.
+    uint64_t offset() const {
+        return mOffset + mPartialSize;
+    }
+
+    size_t entryCount() const {
+        return mEntryCount;
+    }
+
+    static int BuildFile(const char* tsPath, const char* indexPath, int intervalMs,
+            int videoPid = 0x1FFF, Aml_MP_CodecID videoCodec = AML_MP_CODEC_UNKNOWN);
+
+private:
+    enum AccessUnitState {
+        kAccessUnitNone,
+        kAccessUnitScanning,
+        kAccessUnitDone,
+    };
+
+    void parsePacket(const uint8_t* packet, uint64_t offset);
+    void startAccessUnit(uint64_t offset, uint32_t timeMs);
+    void scanPayload(const uint8_t* data, size_t size);
+    // return 1 for an I-frame, 0 for another frame, -1 if the NAL unit doesn't tell.
+    int classifyNal() const;
+    void addEntry(uint32_t timeMs, uint32_t flags, uint64_t offset);
+    void dropPending(size_t count);
+
+    const uint32_t mIntervalMs;
+    int mFd = -1;
+
+    int mVideoPid = 0x1FFF;
+    Aml_MP_CodecID mVideoCodec = AML_MP_CODEC_UNKNOWN;
+    AccessUnitState mAccessUnitState = kAccessUnitNone;
+    uint64_t mAccessUnitOffset = 0;
+    uint32_t mAccessUnitTime = 0;
+    size_t mAccessUnitPos = 0;      // where its entry goes in mPending
+    ssize_t mOpenKeyframe = -1;     // keyframe entry waiting for its size
+    int mZeroBytes = 0;
+    uint8_t mNalHeader[5];
+    size_t mNalHeaderSize = 0;
+    size_t mNalHeaderWanted = 0;
+
+    uint8_t mPartial[188];
+    size_t mPartialSize = 0;
+    uint64_t mOffset = 0;
+
+    int mPcrPid = -1;
+    int64_t mLastPcr = -1;
+    uint64_t mClock = 0;    // 90KHz
+    int64_t mPendingRap = -1;
+
+    bool mHasEntry = false;
+    uint32_t mLastEntryTime = 0;
+    uint32_t mLastRapTime = 0;
+    bool mHasRap = false;
+
+    std::vector<AmlDVRTsIndexEntry> mPending;
+    size_t mEntryCount = 0;
+
+    AmlDVRTsIndexBuilder(const AmlDVRTsIndexBuilder&) = delete;
+    AmlDVRTsIndexBuilder& operator= (const AmlDVRTsIndexBuilder&) = delete;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Read only mapping of an index file.
+ */
+class AmlDVRTsIndexFile
+{
+public:
+    AmlDVRTsIndexFile() = default;
+    ~AmlDVRTsIndexFile();
+
+    int open(const char* indexPath);
+    void close();
+    // remap if the file has grown, return the number of entries.
+    size_t refresh();
+
+    size_t count() const {
+        return mCount;
+    }
+
+    const AmlDVRTsIndexEntry& at(size_t index) const {
+        return mEntries[index];
+    }
+
+    int videoPid() const {
+        return mVideoPid;
+    }
+
+    // last entry at or before timeMs with all of flags set, -1 if none.
+    ssize_t findBefore(uint32_t timeMs, uint32_t flags) const;
+    // first entry at or after timeMs with all of flags set, -1 if none.
+    ssize_t findAfter(uint32_t timeMs, uint32_t flags) const;
+
+private:
+    std::string mPath;
+    void* mMap = nullptr;
+    size_t mMapSize = 0;
+    const AmlDVRTsIndexEntry* mEntries = nullptr;
+    size_t mCount = 0;
+    int mVideoPid = 0x1FFF;
+
+    AmlDVRTsIndexFile(const AmlDVRTsIndexFile&) = delete;
+    AmlDVRTsIndexFile& operator= (const AmlDVRTsIndexFile&) = delete;
+};
+
+}
+
+#endif
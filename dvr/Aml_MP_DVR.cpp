@@ -12,9 +12,15 @@
 #include <Aml_MP/Dvr.h>
 #include "AmlDVRPlayer.h"
 #include "AmlDVRRecorder.h"
+#include "AmlDVRRecorderGroup.h"
+#include "AmlDVRSegmentCache.h"
+#include "AmlDVRSegmentReclaimer.h"
+#include "AmlDVRTimeshiftRing.h"
+#include "AmlDVRTsIndex.h"
 #include "utils/AmlMpUtils.h"
 #include "utils/AmlMpHandle.h"
 #include <dvr_segment.h>
+#include <unistd.h>
 
 using namespace aml_mp;
 using namespace android;
@@ -114,39 +120,184 @@ int Aml_MP_DVRRecorder_GetStatus(AML_MP_DVRRECORDER recorder, Aml_MP_DVRRecorder
     return ret;
 }
 
+int Aml_MP_DVRRecorder_GetCryptoStats(AML_MP_DVRRECORDER recorder, Aml_MP_DVRCryptoStats* stats)
+{
+    sptr<AmlDVRRecorder> amlMpHandle = aml_handle_cast<AmlDVRRecorder>(recorder);
+    RETURN_IF(-1, amlMpHandle == nullptr || stats == nullptr);
+
+    return amlMpHandle->getCryptoStats(stats);
+}
+
+int Aml_MP_DVRRecorder_GetWriteStats(AML_MP_DVRRECORDER recorder, Aml_MP_DVRWriteStats* stats)
+{
+    sptr<AmlDVRRecorder> amlMpHandle = aml_handle_cast<AmlDVRRecorder>(recorder);
+    RETURN_IF(-1, amlMpHandle == nullptr || stats == nullptr);
+
+    return amlMpHandle->getWriteStats(stats);
+}
+
 int Aml_MP_DVRRecorder_GetSegmentList(const char* location, uint32_t* segmentNums, uint64_t** segmentIds)
 {
-    return dvr_segment_get_list(location, segmentNums, segmentIds);
+    RETURN_IF(-1, segmentNums == nullptr || segmentIds == nullptr);
+
+    std::string path = AmlDVRTimeshiftRing::resolve(location);
+    location = path.c_str();
+
+    std::vector<uint64_t> ids;
+    int ret = AmlDVRSegmentCache::instance().getList(location, &ids);
+    if (ret < 0) {
+        return ret;
+    }
+
+    // same ownership as dvr_segment_get_list, the caller frees the list.
+    *segmentNums = ids.size();
+    *segmentIds = nullptr;
+    if (!ids.empty()) {
+        *segmentIds = (uint64_t*)malloc(ids.size() * sizeof(uint64_t));
+        if (*segmentIds == nullptr) {
+            *segmentNums = 0;
+            return -1;
+        }
+        memcpy(*segmentIds, ids.data(), ids.size() * sizeof(uint64_t));
+    }
+
+    return 0;
 }
 
 int Aml_MP_DVRRecorder_GetSegmentInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo)
 {
-    DVR_RecordSegmentInfo_t info;
-    int ret = dvr_segment_get_info(location, segmentId, &info);
+    std::string path = AmlDVRTimeshiftRing::resolve(location);
+    return AmlDVRSegmentCache::instance().getInfo(path.c_str(), segmentId, segmentInfo);
+}
+
+int Aml_MP_DVRRecorder_GetSegmentInfoList(const char* location, uint32_t* segmentNums, Aml_MP_DVRSegmentInfo** segmentInfos)
+{
+    RETURN_IF(-1, segmentNums == nullptr || segmentInfos == nullptr);
+
+    std::string path = AmlDVRTimeshiftRing::resolve(location);
+    location = path.c_str();
 
-    memset(segmentInfo, 0, sizeof(*segmentInfo));
-    segmentInfo->id = info.id;
-    segmentInfo->streams.nbStreams = info.nb_pids;
-    MLOGD("nb_pids:%d", info.nb_pids);
-    for (size_t i = 0; i < info.nb_pids; ++i) {
-        convertToMpDVRStream(&segmentInfo->streams.streams[i], &info.pids[i]);
+    AmlDVRSegmentCache& cache = AmlDVRSegmentCache::instance();
+    std::vector<uint64_t> ids;
+    int ret = cache.getList(location, &ids);
+    if (ret < 0) {
+        return ret;
+    }
+
+    *segmentNums = 0;
+    *segmentInfos = nullptr;
+    if (ids.empty()) {
+        return 0;
+    }
 
-        MLOGD("streamType:%d, pid:%d, codecId:%d(%s)", segmentInfo->streams.streams[i].type,
-                segmentInfo->streams.streams[i].pid,
-                segmentInfo->streams.streams[i].codecId,
-                mpCodecId2Str(segmentInfo->streams.streams[i].codecId));
+    Aml_MP_DVRSegmentInfo* infos = (Aml_MP_DVRSegmentInfo*)malloc(ids.size() * sizeof(Aml_MP_DVRSegmentInfo));
+    if (infos == nullptr) {
+        return -1;
     }
 
-    segmentInfo->duration = info.duration;
-    segmentInfo->size = info.size;
-    segmentInfo->nbPackets = info.nb_packets;
+    uint32_t count = 0;
+    for (uint64_t id : ids) {
+        // segments removed since the list was read are skipped.
+        if (cache.getInfo(location, id, &infos[count]) == 0) {
+            count++;
+        }
+    }
 
-    return ret;
+    *segmentNums = count;
+    *segmentInfos = infos;
+
+    return 0;
 }
 
 int Aml_MP_DVRRecorder_DeleteSegment(const char* location, uint64_t segmentId)
 {
-    return dvr_segment_delete(location, segmentId);
+    std::string path = AmlDVRTimeshiftRing::resolve(location);
+    location = path.c_str();
+
+    int ret = dvr_segment_delete(location, segmentId);
+    AmlDVRSegmentCache::instance().invalidateSegment(location, segmentId);
+    unlink(AmlDVRSegmentFile(location, segmentId, "tsidx").c_str());
+
+    return ret;
+}
+
+int Aml_MP_DVRRecorder_DeleteSegments(const char* location, const uint64_t* segmentIds, uint32_t segmentNums,
+        Aml_MP_DVRDeleteSegmentsCallback cb, void* userData)
+{
+    RETURN_IF(-1, location == nullptr);
+
+    std::string path = AmlDVRTimeshiftRing::resolve(location);
+    location = path.c_str();
+
+    return AmlDVRSegmentReclaimer::instance().deleteSegments(location, segmentIds, segmentNums, cb, userData);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int Aml_MP_DVRRecorderGroup_Create(Aml_MP_DVRRecorderBasicParams* basicParams, AML_MP_DVRRECORDERGROUP* handle)
+{
+    RETURN_IF(-1, basicParams == nullptr || handle == nullptr);
+
+    AmlDVRRecorderGroup* group(new AmlDVRRecorderGroup(basicParams));
+    if (group == nullptr) {
+        MLOGE("new AmlDVRRecorderGroup failed!");
+        return -1;
+    }
+
+    group->incStrong(group);
+
+    *handle = aml_handle_cast(group);
+
+    return 0;
+}
+
+int Aml_MP_DVRRecorderGroup_Destroy(AML_MP_DVRRECORDERGROUP group)
+{
+    sptr<AmlDVRRecorderGroup> recorderGroup = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, recorderGroup == nullptr);
+
+    recorderGroup->decStrong(group);
+
+    return 0;
+}
+
+int Aml_MP_DVRRecorderGroup_RegisterEventCallback(AML_MP_DVRRECORDERGROUP group, Aml_MP_DVRRecorderEventCallback cb, void* userData)
+{
+    sptr<AmlDVRRecorderGroup> amlMpHandle = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, amlMpHandle == nullptr);
+
+    return amlMpHandle->registerEventCallback(cb, userData);
+}
+
+int Aml_MP_DVRRecorderGroup_AddService(AML_MP_DVRRECORDERGROUP group, const Aml_MP_DVRRecorderGroupService* service, int* serviceId)
+{
+    sptr<AmlDVRRecorderGroup> amlMpHandle = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, amlMpHandle == nullptr);
+
+    return amlMpHandle->addService(service, serviceId);
+}
+
+int Aml_MP_DVRRecorderGroup_RemoveService(AML_MP_DVRRECORDERGROUP group, int serviceId)
+{
+    sptr<AmlDVRRecorderGroup> amlMpHandle = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, amlMpHandle == nullptr);
+
+    return amlMpHandle->removeService(serviceId);
+}
+
+int Aml_MP_DVRRecorderGroup_Start(AML_MP_DVRRECORDERGROUP group)
+{
+    sptr<AmlDVRRecorderGroup> amlMpHandle = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, amlMpHandle == nullptr);
+
+    return amlMpHandle->start();
+}
+
+int Aml_MP_DVRRecorderGroup_Stop(AML_MP_DVRRECORDERGROUP group)
+{
+    sptr<AmlDVRRecorderGroup> amlMpHandle = aml_handle_cast<AmlDVRRecorderGroup>(group);
+    RETURN_IF(-1, amlMpHandle == nullptr);
+
+    return amlMpHandle->stop();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -276,6 +427,14 @@ int Aml_MP_DVRPlayer_GetStatus(AML_MP_DVRPLAYER player, Aml_MP_DVRPlayerStatus*
     return ret;
 }
 
+int Aml_MP_DVRPlayer_GetCryptoStats(AML_MP_DVRPLAYER player, Aml_MP_DVRCryptoStats* stats)
+{
+    sptr<AmlDVRPlayer> dvrPlayer = aml_handle_cast<AmlDVRPlayer>(player);
+    RETURN_IF(-1, dvrPlayer == nullptr || stats == nullptr);
+
+    return dvrPlayer->getCryptoStats(stats);
+}
+
 int Aml_MP_DVRPlayer_ShowVideo(AML_MP_DVRPLAYER handle)
 {
     sptr<AmlDVRPlayer> dvrPlayer = aml_handle_cast<AmlDVRPlayer>(handle);
@@ -63,6 +63,16 @@ int Aml_MP_SetDemuxSource(Aml_MP_DemuxId demuxId, Aml_MP_DemuxSource source);
  */
 int Aml_MP_GetDemuxSource(Aml_MP_DemuxId demuxId, Aml_MP_DemuxSource *source);
 
+/**
+ * \brief Aml_MP_GetMemoryUsage
+ * Get the memory used by all players, demuxes, CAS and DVR instances
+ *
+ * \param [out] memory usage by component
+ *
+ * \return 0 if success
+ */
+int Aml_MP_GetMemoryUsage(Aml_MP_MemoryUsage* usage);
+
 ///////////////////////////////////////////////////////////////////////////////
 //                                  Player                                   //
 ///////////////////////////////////////////////////////////////////////////////
@@ -300,6 +310,21 @@ int Aml_MP_Player_GetCurrentPts(AML_MP_PLAYER handle, Aml_MP_StreamType streamTy
  */
 int Aml_MP_Player_GetBufferStat(AML_MP_PLAYER handle, Aml_MP_BufferStat* bufferStat);
 
+/**
+ * \brief Aml_MP_Player_GetMemoryUsage
+ * Get the TS buffers used by this player
+ *
+ * Only AML_MP_MEMORY_TS_BUFFER is accounted per player. Demux sections,
+ * looper messages, CAS and DVR memory is shared between players, or not
+ * owned by one, and is only reported by Aml_MP_GetMemoryUsage.
+ *
+ * \param [in]  player handle
+ * \param [out] memory usage by component
+ *
+ * \return 0 if success
+ */
+int Aml_MP_Player_GetMemoryUsage(AML_MP_PLAYER handle, Aml_MP_MemoryUsage* usage);
+
 /**
  * \brief Aml_MP_Player_SetANativeWindow
  * Set nativeWindow
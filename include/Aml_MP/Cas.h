@@ -11,6 +11,7 @@
 #define _AML_MP_CAS_H_
 
 #include "Common.h"
+#include <sys/uio.h>
 
 #define MAX_CHAN_COUNT (8)
 #define MAX_DATA_LEN (8)
@@ -73,6 +74,59 @@ typedef struct {
     loff_t end;
 } Aml_MP_CASStoreRegion;
 
+#define AML_MP_CAS_LATENCY_BUCKETS (12)
+
+typedef enum {
+    AML_MP_CAS_OP_PROCESS_ECM,  /**< processEcm.*/
+    AML_MP_CAS_OP_PROCESS_EMM,  /**< processEmm.*/
+    AML_MP_CAS_OP_DECRYPT,      /**< IPTV decrypt.*/
+    AML_MP_CAS_OP_DVR_ENCRYPT,  /**< DVR encrypt.*/
+    AML_MP_CAS_OP_DVR_DECRYPT,  /**< DVR decrypt.*/
+    AML_MP_CAS_OP_NB,
+} Aml_MP_CASOperation;
+
+typedef struct {
+    uint64_t calls;             /**< Calls into the CAS*/
+    uint64_t failures;          /**< Calls that returned an error*/
+    uint64_t bytes;             /**< Bytes passed to the calls*/
+    uint32_t throughput;        /**< Bytes per second of time spent in the calls*/
+    uint32_t avgLatencyUs;      /**< Average call time*/
+    uint32_t maxLatencyUs;      /**< Longest call*/
+    uint32_t latencyHistogram[AML_MP_CAS_LATENCY_BUCKETS]; /**< Calls shorter than 50, 100, 250, 500 us, 1, 2.5, 5, 10, 25, 50, 100 ms, and longer*/
+} Aml_MP_CASOperationStats;
+
+typedef struct {
+    Aml_MP_CASServiceType serviceType;                      /**< Service type of the session.*/
+    Aml_MP_CASOperationStats operations[AML_MP_CAS_OP_NB];  /**< Per operation, indexed by Aml_MP_CASOperation.*/
+    uint32_t zaps;                      /**< Services started on the session*/
+    uint32_t descrambledZaps;           /**< Services that were descrambled*/
+    uint32_t lastZapUs;                 /**< From the start of the last service to its first decrypted data or frame*/
+    uint32_t avgZapUs;                  /**< Average of the above*/
+    uint32_t maxZapUs;                  /**< Longest of the above*/
+    uint64_t emmsReceived;              /**< EMM sections found on the EMM PID*/
+    uint64_t emmsFiltered;              /**< EMMs dropped as addressed to other smartcards*/
+    uint64_t emmsRepeated;              /**< EMMs dropped as repeats of recent ones*/
+} Aml_MP_CASStats;
+
+/**\brief Addressing of the EMMs an EMM filter passes*/
+typedef enum {
+    AML_MP_CAS_EMM_UNIQUE,      /**< EMMs for this smartcard, matched on its unique address.*/
+    AML_MP_CAS_EMM_SHARED,      /**< EMMs for a group of smartcards, matched on the shared address.*/
+    AML_MP_CAS_EMM_GLOBAL,      /**< EMMs for all smartcards, matched on the table id only.*/
+} Aml_MP_CASEmmAddressing;
+
+#define AML_MP_CAS_EMM_ADDRESS_SIZE (8)
+
+typedef struct {
+    Aml_MP_CASEmmAddressing addressing;             /**< Addressing of the EMMs passed.*/
+    uint8_t tableId;                                /**< Table id of the EMMs passed.*/
+    uint8_t tableIdMask;                            /**< Bits of the table id compared.*/
+    uint8_t addressOffset;                          /**< Offset of the address in the section, from the table id.*/
+    uint8_t addressLength;                          /**< Address bytes compared, unused for global addressing.*/
+    uint8_t address[AML_MP_CAS_EMM_ADDRESS_SIZE];   /**< Address of the smartcard or its group.*/
+    uint8_t addressMask[AML_MP_CAS_EMM_ADDRESS_SIZE]; /**< Bits of the address compared.*/
+} Aml_MP_CASEmmFilter;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -216,6 +270,29 @@ int Aml_MP_CAS_RegisterEventCallback(AML_MP_CASSESSION casSession, Aml_MP_CAS_Ev
  */
 int Aml_MP_CAS_Ioctl(AML_MP_CASSESSION casSession, const char* inJson, char* outJson, uint32_t outLen);
 
+/**
+ * \brief Aml_MP_CAS_GetStats
+ * Get call counts and latencies of a CAS session, also returned as JSON by
+ * Aml_MP_CAS_Ioctl() with {"cmd":"getCasMetrics"}
+ *
+ * \param [in]  CAS session
+ * \param [out] stats
+ *
+ * \return 0 if success
+ */
+int Aml_MP_CAS_GetStats(AML_MP_CASSESSION casSession, Aml_MP_CASStats* stats);
+
+/**
+ * \brief Aml_MP_CAS_ResetStats
+ * Clear the stats of a CAS session, also done by Aml_MP_CAS_Ioctl() with
+ * {"cmd":"resetCasMetrics"}
+ *
+ * \param [in]  CAS session
+ *
+ * \return 0 if success
+ */
+int Aml_MP_CAS_ResetStats(AML_MP_CASSESSION casSession);
+
 //for live
 /**
  * \brief Aml_MP_CAS_StartDescrambling
@@ -341,6 +418,20 @@ int Aml_MP_CAS_DestroySecmem(AML_MP_CASSESSION casSession, AML_MP_SECMEM secMem)
  */
 int Aml_MP_CAS_GetStoreRegion(AML_MP_CASSESSION casSession, Aml_MP_CASStoreRegion *region, uint8_t *regionCount);
 
+/**
+ * \brief Aml_MP_CAS_SetEmmFilters
+ * Set the EMMs passed to an IPTV CAS session by the player. An EMM passes
+ * if it matches one of the filters, or if there is none, and is not a
+ * repeat of a recent one. Needs vendor.amlmp.cas-emm
+ *
+ * \param [in]  CAS session
+ * \param [in]  filters
+ * \param [in]  filter count, 0 passes all EMMs
+ *
+ * \return 0 if success, -1 for a DVB CAS session, whose EMMs the CAS HAL takes
+ */
+int Aml_MP_CAS_SetEmmFilters(AML_MP_CASSESSION casSession, const Aml_MP_CASEmmFilter* filters, int count);
+
 /**
  * \brief Aml_MP_CAS_ProcessEcmIPTV
  * processEcm
@@ -351,6 +442,9 @@ int Aml_MP_CAS_GetStoreRegion(AML_MP_CASSESSION casSession, Aml_MP_CASStoreRegio
  * \param [in]  data ecmData
  * \param [in]  size ecmData size
  *
+ * With vendor.amlmp.cas-ecm-dedup set, a repeat of an ECM recently processed
+ * without error on its PID returns 0 without reaching the CAS lib.
+ *
  * \return 0 if success
  */
 int Aml_MP_CAS_ProcessEcmIPTV(AML_MP_CASSESSION casSession, bool isSection, int ecmPid, const uint8_t* data, size_t size);
@@ -369,6 +463,24 @@ int Aml_MP_CAS_ProcessEcmIPTV(AML_MP_CASSESSION casSession, bool isSection, int
  */
 int Aml_MP_CAS_DecryptIPTV(AML_MP_CASSESSION casSession, uint8_t* data, size_t size, void* ext_data, Aml_MP_Buffer* outbuffer);
 
+/**
+ * \brief Aml_MP_CAS_DecryptIPTVv
+ * decrypt several chunks of data in one call
+ *
+ * \param [in]  casSession session
+ * \param [in]  iov encrypted chunks
+ * \param [in]  iovcnt count of chunks
+ * \param [in]  ext_data hls info
+ * \param [in,out]  outbuffers one per chunk. If its address is set, the
+ *                   decrypted chunk is written there, up to size bytes, and
+ *                   size is updated. Otherwise it is set to the decrypted
+ *                   chunk, in place or in a buffer of the session that is
+ *                   valid until the next decrypt call on it.
+ *
+ * \return 0 if success
+ */
+int Aml_MP_CAS_DecryptIPTVv(AML_MP_CASSESSION casSession, const struct iovec* iov, int iovcnt, void* ext_data, Aml_MP_Buffer* outbuffers);
+
 #ifdef __cplusplus
 }
 #endif
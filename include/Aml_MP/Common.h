@@ -26,6 +26,7 @@
 
 typedef void* AML_MP_PLAYER;
 typedef void* AML_MP_DVRRECORDER;
+typedef void* AML_MP_DVRRECORDERGROUP;
 typedef void* AML_MP_DVRPLAYER;
 typedef void* AML_MP_CASSESSION;
 typedef void* AML_MP_SECMEM;
@@ -167,6 +168,7 @@ typedef enum {
     AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, /**< Verimatrix IPTV*/
     AML_MP_CAS_SERVICE_VERIMATRIX_WEB,  /**<verimatrix WEB*/
     AML_MP_CAS_SERVICE_WIDEVINE,        /**<widevine*/
+    AML_MP_CAS_SERVICE_SOFT,            /**<software descrambler, clear keys*/
     AML_MP_CAS_SERVICE_TYPE_INVALID = 0xFF,    /**< Invalid type.*/
 } Aml_MP_CASServiceType;
 
@@ -266,6 +268,23 @@ typedef struct {
     Aml_MP_BufferItem subtitleBuffer;
 } Aml_MP_BufferStat;
 
+////////////////////////////////////////
+typedef enum {
+    AML_MP_MEMORY_TS_BUFFER,            /**< Player prepare, write and packetize buffers.*/
+    AML_MP_MEMORY_SECTION,              /**< Demux section buffers.*/
+    AML_MP_MEMORY_LOOPER,               /**< Messages queued on event loopers.*/
+    AML_MP_MEMORY_CAS,                  /**< CAS secure memory.*/
+    AML_MP_MEMORY_DVR,                  /**< DVR record and playback buffers.*/
+    AML_MP_MEMORY_COMPONENT_MAX,
+} Aml_MP_MemoryComponent;
+
+typedef struct {
+    size_t total;                       /**< Bytes currently in use.*/
+    size_t peak;                        /**< Highest total seen.*/
+    size_t budget;                      /**< Process-wide budget, 0 if unlimited.*/
+    size_t components[AML_MP_MEMORY_COMPONENT_MAX];    /**< Bytes in use per Aml_MP_MemoryComponent.*/
+} Aml_MP_MemoryUsage;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -613,6 +632,7 @@ typedef enum {
     AML_MP_DVRPLAYER_EVENT_REACHED_BEGIN,                   /**< reached begin*/
     AML_MP_DVRPLAYER_EVENT_REACHED_END,                     /**< reached end*/
     AML_MP_DVRPLAYER_EVENT_NOTIFY_PLAYTIME,                 /**< notify play cur segmeng time ms*/
+    AML_MP_DVRPLAYER_EVENT_BUFFER_HEALTH,                   /**< readahead buffer level changed, param: Aml_MP_DVRPlayerBufferHealth*/
 
     // Video event
     AML_MP_PLAYER_EVENT_VIDEO_BASE              = 0x2000,
@@ -656,6 +676,20 @@ typedef enum {
 } Aml_MP_PlayerEventType;
 
 
+//AML_MP_DVRPLAYER_EVENT_BUFFER_HEALTH
+typedef enum {
+    AML_MP_DVRPLAYER_BUFFER_EMPTY,      /**< playback reads from the disk directly*/
+    AML_MP_DVRPLAYER_BUFFER_LOW,        /**< less than half of the readahead target is cached*/
+    AML_MP_DVRPLAYER_BUFFER_HEALTHY,
+} Aml_MP_DVRPlayerBufferLevel;
+
+typedef struct {
+    Aml_MP_DVRPlayerBufferLevel level;
+    uint32_t aheadMs;           /**< playback time cached ahead of the position*/
+    uint32_t targetMs;          /**< playback time the readahead aims for*/
+    uint32_t throughput;        /**< measured disk throughput in bytes per second*/
+} Aml_MP_DVRPlayerBufferHealth;
+
 //AML_MP_PLAYER_EVENT_VIDEO_CHANGED,
 typedef struct {
     uint32_t frame_width;
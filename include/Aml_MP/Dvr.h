@@ -20,6 +20,8 @@ typedef int (*Aml_MP_CAS_CryptoFunction) (Aml_MP_CASCryptoParams *params, void *
 typedef enum {
     AML_MP_DVRRECORDER_SCRAMBLED = (1 << 0),
     AML_MP_DVRRECORDER_ACCURATE  = (1 << 1),
+    AML_MP_DVRRECORDER_PREALLOCATE = (1 << 8),  /**< Reserve segmentSize bytes on disk for each segment*/
+    AML_MP_DVRRECORDER_WRITE_THROUGH = (1 << 9), /**< Write recorded data back at once and keep it out of the page cache*/
 } Aml_MP_DVRRecorderFlag;
 
 typedef struct {
@@ -64,6 +66,8 @@ typedef enum {
 
 typedef void (*Aml_MP_DVRRecorderEventCallback) (void* userdata, AML_MP_DVRRecorderEventType event, int64_t params);
 
+typedef void (*Aml_MP_DVRDeleteSegmentsCallback) (void* userdata, const char* location, int result);
+
 typedef enum {
     AML_MP_DVRRECORDER_STATE_OPENED,        /**< Record state is opened*/
     AML_MP_DVRRECORDER_STATE_STARTED,       /**< Record state is started*/
@@ -71,6 +75,25 @@ typedef enum {
     AML_MP_DVRRECORDER_STATE_CLOSED,        /**< Record state is closed*/
 } Aml_MP_DVRRecorderState;
 
+typedef struct {
+    uint64_t bytes;             /**< Bytes encrypted or decrypted*/
+    uint32_t calls;             /**< Calls of the crypto function*/
+    uint32_t throughput;        /**< Bytes per second while processing*/
+    uint32_t avgLatencyUs;      /**< Average time the libdvr thread waited per block*/
+    uint32_t maxLatencyUs;      /**< Longest time the libdvr thread waited for a block*/
+    uint32_t maxQueueDepth;     /**< Most batches queued to the workers at once*/
+} Aml_MP_DVRCryptoStats;
+
+typedef struct {
+    uint64_t bytes;             /**< Bytes recorded to the segments*/
+    uint64_t deviceBytes;       /**< Disk space the segments take*/
+    uint32_t amplification;     /**< deviceBytes per recorded byte, in percent*/
+    uint32_t avgLatencyUs;      /**< Average time to write back the data of one status*/
+    uint32_t maxLatencyUs;      /**< Longest write back*/
+    uint32_t latencySpikes;     /**< Write backs slower than 100 ms*/
+    uint32_t preallocated;      /**< Segments preallocated on disk*/
+} Aml_MP_DVRWriteStats;
+
 typedef struct {
     Aml_MP_DVRRecorderState state;
     Aml_MP_DVRSourceInfo info;
@@ -186,6 +209,29 @@ int Aml_MP_DVRRecorder_Resume(AML_MP_DVRPLAYER player);
  */
 int Aml_MP_DVRRecorder_GetStatus(AML_MP_DVRRECORDER recorder, Aml_MP_DVRRecorderStatus* status);
 
+/**
+ * \brief Aml_MP_DVRRecorder_GetCryptoStats
+ * Get the statistics of the encryption, zero when the recording isn't encrypted
+ *
+ * \param [in]  DVR recorder handle
+ * \param [out] crypto statistics
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorder_GetCryptoStats(AML_MP_DVRRECORDER recorder, Aml_MP_DVRCryptoStats* stats);
+
+/**
+ * \brief Aml_MP_DVRRecorder_GetWriteStats
+ * Get the statistics of the segment writes, zero without
+ * AML_MP_DVRRECORDER_PREALLOCATE or AML_MP_DVRRECORDER_WRITE_THROUGH
+ *
+ * \param [in]  DVR recorder handle
+ * \param [out] write statistics
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorder_GetWriteStats(AML_MP_DVRRECORDER recorder, Aml_MP_DVRWriteStats* stats);
+
 /**
  * \brief Aml_MP_DVRRecorder_GetSegmentList
  * Get DVR recorder segment list
@@ -210,6 +256,19 @@ int Aml_MP_DVRRecorder_GetSegmentList(const char* location, uint32_t* segmentNum
  */
 int Aml_MP_DVRRecorder_GetSegmentInfo(const char* location, uint64_t segmentId, Aml_MP_DVRSegmentInfo* segmentInfo);
 
+/**
+ * \brief Aml_MP_DVRRecorder_GetSegmentInfoList
+ * Get the info of all record segment files in one call, the info list
+ * is allocated by this function and should be released with free()
+ *
+ * \param [in]  record file location
+ * \param [out] record file info list length
+ * \param [out] record file info list
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorder_GetSegmentInfoList(const char* location, uint32_t* segmentNums, Aml_MP_DVRSegmentInfo** segmentInfos);
+
 /**
  * \brief Aml_MP_DVRRecorder_DeleteSegment
  * Delete specific record segment file
@@ -220,6 +279,121 @@ int Aml_MP_DVRRecorder_GetSegmentInfo(const char* location, uint64_t segmentId,
  * \return 0 if success
  */
 int Aml_MP_DVRRecorder_DeleteSegment(const char* location, uint64_t segmentId);
+
+/**
+ * \brief Aml_MP_DVRRecorder_DeleteSegments
+ * Delete a list of record segment files in the background, the segments are
+ * removed from the segment list at once, their files are truncated step by
+ * step so that large files don't stall the disk. cb is called from an
+ * internal thread when all segments are deleted.
+ *
+ * \param [in]  record file location
+ * \param [in]  record file id list
+ * \param [in]  record file id list length
+ * \param [in]  completion callback, result is 0 if all segments were deleted
+ * \param [in]  user data of cb
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorder_DeleteSegments(const char* location, const uint64_t* segmentIds, uint32_t segmentNums,
+        Aml_MP_DVRDeleteSegmentsCallback cb, void* userData);
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+#define AML_MP_DVR_GROUP_SERVICES_COUNT 8
+
+typedef struct {
+    char                        location[AML_MP_MAX_PATH_SIZE];
+    int                         programNumber;
+    int                         pmtPid;
+    Aml_MP_DVRStreamArray       streams;
+} Aml_MP_DVRRecorderGroupService;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * \brief Aml_MP_DVRRecorderGroup_Create
+ * Create a recorder group, which records several services of one multiplex
+ * from a single capture. basicParams->location is the scratch location of the
+ * capture, which only holds libdvr's bookkeeping and is cleared on stop. Each
+ * service is written to its own location as a libdvr recording, basicParams
+ * must not be scrambled.
+ *
+ * \param [in]  basic params of the capture
+ * \param [out] recorder group handle
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_Create(Aml_MP_DVRRecorderBasicParams* basicParams, AML_MP_DVRRECORDERGROUP* group);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_Destroy
+ * Destroy recorder group
+ *
+ * \param [in]  recorder group handle
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_Destroy(AML_MP_DVRRECORDERGROUP group);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_RegisterEventCallback
+ * Register the callback receiving the errors of the capture, its status
+ * events are not passed on
+ *
+ * \param [in]  recorder group handle
+ * \param [in]  callback
+ * \param [in]  user data
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_RegisterEventCallback(AML_MP_DVRRECORDERGROUP group, Aml_MP_DVRRecorderEventCallback cb, void* userData);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_AddService
+ * Start recording a service, can be called before or after start
+ *
+ * \param [in]  recorder group handle
+ * \param [in]  service location, program and streams
+ * \param [out] service id
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_AddService(AML_MP_DVRRECORDERGROUP group, const Aml_MP_DVRRecorderGroupService* service, int* serviceId);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_RemoveService
+ * Stop recording a service
+ *
+ * \param [in]  recorder group handle
+ * \param [in]  service id
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_RemoveService(AML_MP_DVRRECORDERGROUP group, int serviceId);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_Start
+ * Start the capture
+ *
+ * \param [in]  recorder group handle
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_Start(AML_MP_DVRRECORDERGROUP group);
+
+/**
+ * \brief Aml_MP_DVRRecorderGroup_Stop
+ * Stop the capture and finish the segments of all services
+ *
+ * \param [in]  recorder group handle
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRRecorderGroup_Stop(AML_MP_DVRRECORDERGROUP group);
 #ifdef __cplusplus
 }
 #endif
@@ -407,6 +581,17 @@ int Aml_MP_DVRPlayer_SetPlaybackRate(AML_MP_DVRPLAYER player, float rate);
  */
 int Aml_MP_DVRPlayer_GetStatus(AML_MP_DVRPLAYER player, Aml_MP_DVRPlayerStatus* status);
 
+/**
+ * \brief Aml_MP_DVRPlayer_GetCryptoStats
+ * Get the statistics of the decryption, zero when the playback isn't decrypted
+ *
+ * \param [in]  DVR player handle
+ * \param [out] crypto statistics
+ *
+ * \return 0 if success
+ */
+int Aml_MP_DVRPlayer_GetCryptoStats(AML_MP_DVRPLAYER player, Aml_MP_DVRCryptoStats* stats);
+
 /**
  * \brief Aml_MP_DVRPlayer_ShowVideo
  * Show video in DVR player
@@ -43,6 +43,7 @@ public:
     int flush() override;
     int setPlaybackRate(float rate) override;
     int switchAudioTrack(const Aml_MP_AudioParams* params) override;
+    using AmlPlayerBase::writeData;
     int writeData(const uint8_t* buffer, size_t size) override;
     int writeEsData(Aml_MP_StreamType type, const uint8_t* buffer, size_t size, int64_t pts) override;
     int getCurrentPts(Aml_MP_StreamType type, int64_t* pts) override;
@@ -10,6 +10,7 @@
 #define LOG_TAG "AmlPlayerBase"
 #include "utils/AmlMpLog.h"
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpBufferChain.h>
 #include "AmlPlayerBase.h"
 #include "AmlTsPlayer.h"
 #ifdef HAVE_CTC
@@ -323,6 +324,26 @@ int AmlPlayerBase::setParameter(Aml_MP_PlayerParameterKey key, void* parameter)
     return 0;
 }
 
+int AmlPlayerBase::writeData(const AmlMpBufferChain& chain)
+{
+    int written = 0;
+
+    for (size_t i = 0; i < chain.segmentCount(); ++i) {
+        const AmlMpBufferChain::Segment& segment = chain.segmentAt(i);
+        int ret = writeData(segment.data, segment.size);
+        if (ret <= 0) {
+            break;
+        }
+
+        written += ret;
+        if ((size_t)ret < segment.size) {
+            break;
+        }
+    }
+
+    return written > 0 ? written : -1;
+}
+
 int AmlPlayerBase::writeEsData(Aml_MP_StreamType type, const uint8_t* buffer, size_t size, int64_t pts)
 {
     //MLOGI("TODO!!! %s, type:%d, buffer:%p, size:%d, pts:%lld", __FUNCTION__, type, buffer, size, pts);
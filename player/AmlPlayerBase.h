@@ -22,6 +22,7 @@ namespace aml_mp {
 //using android::sp;
 //using android::RefBase;
 //using android::NativeHandle;
+class AmlMpBufferChain;
 
 class AmlPlayerBase : public AmlMpRefBase {
 public:
@@ -50,6 +51,8 @@ public:
     virtual int setPlaybackRate(float rate) = 0;
     virtual int switchAudioTrack(const Aml_MP_AudioParams* params) = 0;
     virtual int writeData(const uint8_t* buffer, size_t size) = 0;
+    // write the segments in order without flattening, return bytes written or -1.
+    virtual int writeData(const AmlMpBufferChain& chain);
     virtual int writeEsData(Aml_MP_StreamType type, const uint8_t* buffer, size_t size, int64_t pts);
     virtual int getCurrentPts(Aml_MP_StreamType type, int64_t* pts) = 0;
     virtual int getBufferStat(Aml_MP_BufferStat* bufferStat) = 0;
@@ -97,6 +100,9 @@ protected:
 
     explicit AmlPlayerBase(Aml_MP_PlayerCreateParams* createParams, int instanceId);
     void notifyListener(Aml_MP_PlayerEventType eventType, int64_t param = 0);
+    int instanceId() const {
+        return mInstanceId;
+    }
 
 private:
     char mName[50];
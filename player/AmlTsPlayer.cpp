@@ -135,7 +135,10 @@ AmlTsPlayer::AmlTsPlayer(Aml_MP_PlayerCreateParams* createParams, int instanceId
     }, this);
 #ifdef HAVE_PACKETIZE_ESTOTS
     int temp_buffer_num   = 100;
-    mPacktsBuffer = new AmlMpBuffer(temp_buffer_num * TS_PACKET_SIZE);
+    mPacktsBuffer = AmlMpBuffer::CreateFromArena(temp_buffer_num * TS_PACKET_SIZE, instanceId);
+    if (mPacktsBuffer == nullptr) {
+        mPacktsBuffer = new AmlMpBuffer(temp_buffer_num * TS_PACKET_SIZE);
+    }
     if (AmlMpConfig::instance().mDumpPackts == 1) {
         mPacketizefd = open("/data/PacketizeEstoTsFile.ts", O_CREAT | O_RDWR, 0666);
     }
@@ -461,7 +464,12 @@ int AmlTsPlayer::packetize(
     }
     /*malloc spaces for those ts packets*/
     if (numTSPackets * TS_PACKET_SIZE > mPacktsBuffer->capacity()) {
-        mPacktsBuffer = new AmlMpBuffer(numTSPackets * TS_PACKET_SIZE);
+        sptr<AmlMpBuffer> packtsBuffer = AmlMpBuffer::CreateFromArena(numTSPackets * TS_PACKET_SIZE, instanceId());
+        if (packtsBuffer == nullptr) {
+            ALOGE("packetize alloc %zu packets failed!", numTSPackets);
+            return -1;
+        }
+        mPacktsBuffer = std::move(packtsBuffer);
     }
     //ALOGI("second mPacktsBuffer=%p,numTSPackets=%d,mPacktsBuffer.size=%d,mPacktsBuffer.capacity=%d\n",mPacktsBuffer.get(),numTSPackets,mPacktsBuffer->size(),mPacktsBuffer->capacity());
     uint8_t *packetDataStart = mPacktsBuffer->data();
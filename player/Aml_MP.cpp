@@ -12,6 +12,7 @@
 #include <utils/AmlMpLog.h>
 #include <Aml_MP/Aml_MP.h>
 #include <utils/AmlMpUtils.h>
+#include <utils/AmlMpMemoryTracker.h>
 
 static const char* mName = LOG_TAG;
 ///////////////////////////////////////////////////////////////////////////////
@@ -61,6 +62,14 @@ int Aml_MP_GetDemuxSource(Aml_MP_DemuxId demuxId, Aml_MP_DemuxSource* source)
     return ret;
 }
 
+int Aml_MP_GetMemoryUsage(Aml_MP_MemoryUsage* usage)
+{
+    RETURN_IF(-1, usage == nullptr);
+
+    aml_mp::AmlMpMemoryTracker::instance().getUsage(aml_mp::AmlMpMemoryTracker::kNoInstance, usage);
+    return 0;
+}
+
 
 
 
@@ -204,6 +204,15 @@ int Aml_MP_Player_GetBufferStat(AML_MP_PLAYER handle, Aml_MP_BufferStat* bufferS
     return player->getBufferStat(bufferStat);
 }
 
+int Aml_MP_Player_GetMemoryUsage(AML_MP_PLAYER handle, Aml_MP_MemoryUsage* usage)
+{
+    sptr<AmlMpPlayerImpl> player = aml_handle_cast<AmlMpPlayerImpl>(handle);
+    RETURN_IF(-1, player == nullptr);
+    RETURN_IF(-1, usage == nullptr);
+
+    return player->getMemoryUsage(usage);
+}
+
 int Aml_MP_Player_SetANativeWindow(AML_MP_PLAYER handle, ANativeWindow* nativeWindow)
 {
     sptr<AmlMpPlayerImpl> player = aml_handle_cast<AmlMpPlayerImpl>(handle);
@@ -14,10 +14,14 @@
 #include <utils/AmlMpUtils.h>
 #include <utils/AmlMpConfig.h>
 #include <utils/AmlMpBuffer.h>
+#include <utils/AmlMpBufferChain.h>
+#include <utils/AmlMpArena.h>
+#include <utils/AmlMpMemoryTracker.h>
 #include <sstream>
 #include <mutex>
 #include <condition_variable>
 #include "AmlPlayerBase.h"
+#include "cas/AmlCasSessionPool.h"
 
 #ifdef ANDROID
 #include <media/stagefright/foundation/ADebug.h>
@@ -27,12 +31,14 @@
 #endif
 #endif
 #include <utils/AmlMpEventLooper.h>
+#include <utils/AmlMpExecutor.h>
 
 
 namespace aml_mp {
 
 #define TS_BUFFER_SIZE          (2 * 1024 * 1024)
 #define TEMP_BUFFER_SIZE        (188 * 100)
+#define MIN_TS_BUFFER_SIZE      (256 * 1024)
 
 #define START_ALL_PENDING       (1 << 0)
 #define START_VIDEO_PENDING     (1 << 1)
@@ -41,6 +47,9 @@ namespace aml_mp {
 
 #define FAST_PLAY_THRESHOLD     2.0f
 
+// ECM hold drain retry while the player is full.
+#define ECM_DRAIN_RETRY_US      (20 * 1000)
+
 ///////////////////////////////////////////////////////////////////////////////
 AmlMpPlayerImpl::AmlMpPlayerImpl(const Aml_MP_PlayerCreateParams* createParams)
 : mInstanceId(AmlMpPlayerRoster::instance().registerPlayer(this))
@@ -82,9 +91,26 @@ AmlMpPlayerImpl::AmlMpPlayerImpl(const Aml_MP_PlayerCreateParams* createParams)
     mWaitingEcmMode = (WaitingEcmMode)AmlMpConfig::instance().mWaitingEcmMode;
     MLOGI("mWaitingEcmMode:%d", mWaitingEcmMode);
 
-    mTsBuffer.init(AmlMpConfig::instance().mWriteBufferSize * 1024 * 1024);
+    AmlMpArena::instance().setBudget(mInstanceId, (size_t)AmlMpConfig::instance().mPlayerBufferBudget * 1024 * 1024);
+    // under a memory budget, a PiP player takes a smaller prepare buffer than the main one.
+    size_t tsBufferSize = AmlMpMemoryTracker::instance().adviseSize(
+            AmlMpConfig::instance().mWriteBufferSize * 1024 * 1024, MIN_TS_BUFFER_SIZE,
+            mCreateParams.channelId == AML_MP_CHANNEL_ID_PIP);
+    if (roundUpPowerOfTwo(tsBufferSize) != tsBufferSize) {
+        tsBufferSize = roundUpPowerOfTwo(tsBufferSize) / 2;
+    }
+    mTsBuffer.init(tsBufferSize, std::min(tsBufferSize, (size_t)1 * 1024 * 1024), mInstanceId);
+
+    // chunks are only allocated once TS is held back behind an ECM.
+    mEcmHoldSize = (size_t)std::max(AmlMpConfig::instance().mEcmHoldSize, 0) * 1024;
+    if (mEcmHoldSize > 0) {
+        mEcmHold.init(mEcmHoldSize, std::min(mEcmHoldSize, (size_t)256 * 1024), mInstanceId);
+    }
 
-    mWriteBuffer = new AmlMpBuffer(TEMP_BUFFER_SIZE);
+    mWriteBuffer = AmlMpBuffer::CreateFromArena(TEMP_BUFFER_SIZE, mInstanceId);
+    if (mWriteBuffer == nullptr) {
+        mWriteBuffer = new AmlMpBuffer(TEMP_BUFFER_SIZE);
+    }
     mWriteBuffer->setRange(0, 0);
     mZorder = kZorderBase + mInstanceId;
 
@@ -98,6 +124,7 @@ AmlMpPlayerImpl::~AmlMpPlayerImpl()
     CHECK(mState == STATE_IDLE);
     CHECK(mStreamState == 0);
 
+    AmlMpArena::instance().releaseOwner(mInstanceId);
     AmlMpPlayerRoster::instance().unregisterPlayer(mInstanceId);
 }
 
@@ -233,6 +260,12 @@ int AmlMpPlayerImpl::setCasSession(AML_MP_CASSESSION casSession)
     casBase->getEcmPids(mEcmPids);
     mIsStandaloneCas = true;
 
+    // the app started the zap, a DVB session has no decrypted data to time it by.
+    {
+        std::lock_guard<std::mutex> _lf(mFirstFrameCasLock);
+        mFirstFrameCas = casBase;
+    }
+
     return 0;
 }
 
@@ -245,6 +278,9 @@ int AmlMpPlayerImpl::setIptvCASParams(Aml_MP_CASServiceType serviceType, const A
     mCasServiceType = serviceType;
     mIptvCasParams = *params;
 
+    // open the CAS session while the player is being set up.
+    AmlCasSessionPool::instance().prepare(serviceType, params);
+
     return 0;
 }
 
@@ -418,6 +454,9 @@ int AmlMpPlayerImpl::flush()
 
     int ret;
 
+    // the held TS is as stale as what the player drops.
+    mEcmHold.reset();
+
     ret = mPlayer->flush();
 
     if (ret != AML_MP_ERROR_DEAD_OBJECT) {
@@ -553,7 +592,11 @@ int AmlMpPlayerImpl::writeData(const uint8_t* buffer, size_t size)
         size_t ecmSize = 188;
         ecmOffset = findEcmPacket(buffer, size, mEcmPids, &ecmSize);
         if (ecmSize > 0) {
-            mCasHandle->processEcm(false, 0, buffer + ecmOffset, ecmSize);
+            // otherwise the ECM pipeline takes it when the data is written below.
+            if (mEcmHoldSize == 0 && !mCasHandle->isRepeatedEcm(false, 0, buffer + ecmOffset, ecmSize) &&
+                processEcm_l(false, 0, buffer + ecmOffset, ecmSize) < 0) {
+                mCasHandle->forgetEcm(false, 0, buffer + ecmOffset, ecmSize);
+            }
             mFirstEcmWritten = true;
             MLOGI("first ECM written, offset:%d", mTsBuffer.size() + ecmOffset);
         } else {
@@ -567,9 +610,13 @@ int AmlMpPlayerImpl::writeData(const uint8_t* buffer, size_t size)
             MLOGW("mTsBuffer full!");
             return -1;
         }
-        written = mTsBuffer.put(buffer, size); //TODO: check buffer overflow
+        written = mTsBuffer.put(buffer, size);
+        if (written < (int)size) {
+            MLOGW("mTsBuffer put %d of %zu!", written, size);
+            return written > 0 ? written : -1;
+        }
         if (mParser != nullptr) {
-            written = mParser->writeData(buffer, size);
+            mParser->writeData(buffer, size);
         }
     } else {
         //already start, need move data from mTsBuffer to player
@@ -588,6 +635,12 @@ int AmlMpPlayerImpl::writeData(const uint8_t* buffer, size_t size)
 
     if (written > 0) {
         statisticWriteDataRate_l(written);
+        if (mEcmPrefetcher != nullptr) {
+            mEcmPrefetcher->writeData(buffer, written);
+        }
+        if (mEmmProcessor != nullptr) {
+            mEmmProcessor->writeData(buffer, written);
+        }
     }
 
     return written;
@@ -597,17 +650,31 @@ int AmlMpPlayerImpl::drainDataFromBuffer_l()
 {
     int written = 0;
     int retry = 0;
+    // ECM packets must be found in contiguous TS data, otherwise the fifo
+    // chunks are handed to the player in place.
+    bool scanEcm = mCreateParams.drmMode == AML_MP_INPUT_STREAM_ENCRYPTED &&
+                   mCasHandle != nullptr && mWaitingEcmMode != kWaitingEcmASynchronous;
     do {
-        if (mWriteBuffer->size() == 0) {
-            size_t readSize = mTsBuffer.get(mWriteBuffer->base(), mWriteBuffer->capacity());
-            mWriteBuffer->setRange(0, readSize);
-        }
+        if (!scanEcm && mWriteBuffer->size() == 0) {
+            AmlMpBufferChain chain;
+            mTsBuffer.peek(&chain, mWriteBuffer->capacity());
+            written = mPlayer->writeData(chain);
+            if (written > 0) {
+                mTsBuffer.consume(written);
+            }
+        } else {
+            if (mWriteBuffer->size() == 0) {
+                size_t readSize = mTsBuffer.get(mWriteBuffer->base(), mWriteBuffer->capacity());
+                mWriteBuffer->setRange(0, readSize);
+            }
 
-        written = doWriteData_l(mWriteBuffer->data(), mWriteBuffer->size());
+            written = doWriteData_l(mWriteBuffer->data(), mWriteBuffer->size());
+            if (written > 0) {
+                mWriteBuffer->setRange(mWriteBuffer->offset()+written, mWriteBuffer->size()-written);
+            }
+        }
 
-        if (written > 0) {
-            mWriteBuffer->setRange(mWriteBuffer->offset()+written, mWriteBuffer->size()-written);
-        } else {
+        if (written <= 0) {
             if (retry >= 4) {
                 break;
             }
@@ -630,6 +697,8 @@ int AmlMpPlayerImpl::doWriteData_l(const uint8_t* buffer, size_t size)
     if (mCreateParams.drmMode == AML_MP_INPUT_STREAM_ENCRYPTED) {
         if (mCasHandle == nullptr || mWaitingEcmMode == kWaitingEcmASynchronous) {
             written = mPlayer->writeData(buffer, size);
+        } else if (mEcmHoldSize > 0) {
+            written = writeDataWithEcmPipeline_l(buffer, size);
         } else {
             size_t totalSize = size;
             size_t ecmOffset = size;
@@ -664,7 +733,10 @@ int AmlMpPlayerImpl::doWriteData_l(const uint8_t* buffer, size_t size)
                 } while (partialSize);
 
                 if (ecmSize > 0) {
-                    mCasHandle->processEcm(false, 0, buffer, ecmSize);
+                    if (!mCasHandle->isRepeatedEcm(false, 0, buffer, ecmSize) &&
+                        processEcm_l(false, 0, buffer, ecmSize) < 0) {
+                        mCasHandle->forgetEcm(false, 0, buffer, ecmSize);
+                    }
                     buffer += ecmSize;
                     written += ecmSize;
                     size -= ecmSize;
@@ -682,6 +754,98 @@ exit:
     return written;
 }
 
+int AmlMpPlayerImpl::writeDataWithEcmPipeline_l(const uint8_t* buffer, size_t size)
+{
+    if (mEcmPipeline == nullptr || mEcmPipeline->cas().get() != mCasHandle.get()) {
+        wptr<AmlMpPlayerImpl> weakThis(this);
+        mEcmPipeline.reset(new AmlCasEcmPipeline(mCasHandle, [weakThis] {
+            // mLock may be held by a writer joining the pipeline thread.
+            AmlMpExecutor::instance().post([weakThis] {
+                sptr<AmlMpPlayerImpl> player = weakThis.promote();
+                if (player != nullptr) {
+                    player->onEcmDrained();
+                }
+            });
+        }));
+        mEcmHold.reset();
+    }
+
+    // the CAS has taken the new keys, the TS held behind them can go.
+    if (!mEcmHold.empty() && mEcmPipeline->pending() == 0) {
+        drainEcmHold_l();
+    }
+
+    int written = 0;
+    while (size) {
+        size_t ecmSize = 188;
+        size_t ecmOffset = findEcmPacket(buffer, size, mEcmPids, &ecmSize);
+
+        // TS is held back from a new ECM until it is processed, and behind
+        // what is held already to keep the order.
+        size_t partialSize;
+        if (mEcmHold.empty() && mEcmPipeline->pending() == 0) {
+            int ret = ecmOffset > 0 ? mPlayer->writeData(buffer, ecmOffset) : 0;
+            partialSize = std::max(ret, 0);
+        } else {
+            partialSize = std::min(ecmOffset, mEcmHold.space() / 188 * 188);
+            partialSize = mEcmHold.put(buffer, partialSize);
+        }
+
+        buffer += partialSize;
+        written += partialSize;
+        size -= partialSize;
+        if (partialSize < ecmOffset) {
+            // player or hold full, the caller writes the rest again.
+            break;
+        }
+
+        if (ecmSize > 0) {
+            if (mEcmPipeline->queue(buffer, ecmSize)) {
+                MLOGI("new ECM, %zu bytes held", mEcmHold.size());
+            }
+            buffer += ecmSize;
+            written += ecmSize;
+            size -= ecmSize;
+        }
+    }
+
+    return written;
+}
+
+int AmlMpPlayerImpl::drainEcmHold_l()
+{
+    while (!mEcmHold.empty()) {
+        AmlMpBufferChain chain;
+        mEcmHold.peek(&chain, mWriteBuffer->capacity());
+        int ret = mPlayer->writeData(chain);
+        if (ret <= 0) {
+            return -EAGAIN;
+        }
+        mEcmHold.consume(ret);
+    }
+
+    return 0;
+}
+
+void AmlMpPlayerImpl::onEcmDrained()
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    if (mPlayer == nullptr || mEcmPipeline == nullptr || mEcmPipeline->pending() > 0 || mEcmHold.empty()) {
+        return;
+    }
+
+    if (drainEcmHold_l() < 0) {
+        // the player is full, try again once it has taken some.
+        wptr<AmlMpPlayerImpl> weakThis(this);
+        AmlMpExecutor::instance().post([weakThis] {
+            sptr<AmlMpPlayerImpl> player = weakThis.promote();
+            if (player != nullptr) {
+                player->onEcmDrained();
+            }
+        }, ECM_DRAIN_RETRY_US);
+    }
+}
+
 int AmlMpPlayerImpl::writeEsData(Aml_MP_StreamType type, const uint8_t* buffer, size_t size, int64_t pts)
 {
     std::unique_lock<std::mutex> _l(mLock);
@@ -698,6 +862,13 @@ int AmlMpPlayerImpl::getCurrentPts(Aml_MP_StreamType streamType, int64_t* pts)
     return mPlayer->getCurrentPts(streamType, pts);
 }
 
+int AmlMpPlayerImpl::getMemoryUsage(Aml_MP_MemoryUsage* usage)
+{
+    AmlMpMemoryTracker::instance().getUsage(mInstanceId, usage);
+
+    return 0;
+}
+
 int AmlMpPlayerImpl::getBufferStat(Aml_MP_BufferStat* bufferStat)
 {
     std::unique_lock<std::mutex> _l(mLock);
@@ -1366,7 +1537,7 @@ int AmlMpPlayerImpl::startDescrambling_l()
     }
 
     if (mCasHandle == nullptr) {
-        mCasHandle = AmlCasBase::create(mCasServiceType);
+        mCasHandle = AmlCasSessionPool::instance().acquire(mCasServiceType, &mIptvCasParams);
     }
 
     if (mCasHandle == nullptr) {
@@ -1374,9 +1545,37 @@ int AmlMpPlayerImpl::startDescrambling_l()
         return -1;
     }
 
+    mCasHandle->metrics().startZap();
     int ret = mCasHandle->startDescrambling(&mIptvCasParams);
     mCasHandle->getEcmPids(mEcmPids);
 
+    {
+        std::lock_guard<std::mutex> _l(mFirstFrameCasLock);
+        mFirstFrameCas = mCasHandle;
+    }
+
+    // the ECM prefetcher's parser, when there is one, filters the EMMs too.
+    bool ecmPrefetch = AmlMpConfig::instance().mEcmPrefetch > 0;
+    if (ret == 0 && AmlMpConfig::instance().mCasEmm > 0) {
+        mEmmProcessor.reset(new AmlCasEmmProcessor(mCasHandle, mIptvCasParams.demuxId,
+                    mCreateParams.sourceType == AML_MP_INPUT_SOURCE_TS_DEMOD, !ecmPrefetch));
+    }
+
+    if (ret == 0 && ecmPrefetch) {
+        mEcmPrefetcher.reset(new AmlCasEcmPrefetcher(mCasServiceType, mIptvCasParams,
+                    mCreateParams.sourceType == AML_MP_INPUT_SOURCE_TS_DEMOD, mEmmProcessor.get()));
+    }
+
+    return ret;
+}
+
+//internal function
+int AmlMpPlayerImpl::processEcm_l(bool isSection, int ecmPid, const uint8_t* data, size_t size)
+{
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    int ret = mCasHandle->processEcm(isSection, ecmPid, data, size);
+    mCasHandle->metrics().record(AML_MP_CAS_OP_PROCESS_ECM, startUs, ret, size);
+
     return ret;
 }
 
@@ -1385,8 +1584,19 @@ int AmlMpPlayerImpl::stopDescrambling_l()
 {
     AML_MP_TRACE(10);
 
+    // no ECM or EMM may reach a stopped CAS, the prefetcher feeds the EMM processor.
+    mEcmPrefetcher.reset();
+    mEmmProcessor.reset();
+    mEcmPipeline.reset();
+    mEcmHold.reset();
+
+    {
+        std::lock_guard<std::mutex> _l(mFirstFrameCasLock);
+        mFirstFrameCas.clear();
+    }
+
     if (mCasHandle) {
-        mCasHandle->stopDescrambling();
+        AmlCasSessionPool::instance().release(mCasHandle);
         mCasHandle.clear();
     }
 
@@ -1657,7 +1867,7 @@ void AmlMpPlayerImpl::programEventCallback(Parser::ProgramEventType event, int p
             {
                 std::unique_lock<std::mutex> _l(mLock);
                 if (mCasHandle && mWaitingEcmMode == kWaitingEcmASynchronous) {
-                    mCasHandle->processEcm(true, param1, ecmData, param2);
+                    processEcm_l(true, param1, ecmData, param2);
                 }
 
                 mPrepareWaitingType &= ~kPrepareWaitingEcm;
@@ -1726,8 +1936,13 @@ int AmlMpPlayerImpl::reset_l(std::unique_lock<std::mutex>& lock)
 
     if (!mIsStandaloneCas) {
         stopDescrambling_l();
+    } else {
+        std::lock_guard<std::mutex> _lf(mFirstFrameCasLock);
+        mFirstFrameCas.clear();
     }
     mIsStandaloneCas = false;
+    mEcmPipeline.reset();
+    mEcmHold.reset();
     mCasHandle.clear();
 
     resetVariables_l();
@@ -1766,6 +1981,13 @@ int AmlMpPlayerImpl::applyParameters_l()
 
 void AmlMpPlayerImpl::notifyListener(Aml_MP_PlayerEventType eventType, int64_t param)
 {
+    if (eventType == AML_MP_PLAYER_EVENT_FIRST_FRAME) {
+        std::lock_guard<std::mutex> _l(mFirstFrameCasLock);
+        if (mFirstFrameCas) {
+            mFirstFrameCas->metrics().onFirstFrame();
+        }
+    }
+
     std::unique_lock<std::mutex> _l(mEventLock);
     if (mEventCb) {
         mEventCb(mUserData, eventType, param);
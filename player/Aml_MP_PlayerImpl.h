@@ -17,11 +17,15 @@
 #ifdef ANDROID
 #include <system/window.h>
 #endif
+#include <memory>
 #include <mutex>
 #include <map>
 #include "utils/AmlMpChunkFifo.h"
 #include <condition_variable>
 #include "cas/AmlCasBase.h"
+#include "cas/AmlCasEcmPipeline.h"
+#include "cas/AmlCasEcmPrefetcher.h"
+#include "cas/AmlCasEmmProcessor.h"
 #include "demux/AmlTsParser.h"
 #ifdef ANDROID
 #ifndef __ANDROID_VNDK__
@@ -65,6 +69,7 @@ public:
     int writeEsData(Aml_MP_StreamType type, const uint8_t* buffer, size_t size, int64_t pts);
     int getCurrentPts(Aml_MP_StreamType, int64_t* pts);
     int getBufferStat(Aml_MP_BufferStat* bufferStat);
+    int getMemoryUsage(Aml_MP_MemoryUsage* usage);
     int setANativeWindow(ANativeWindow* nativeWindow);
     int setVideoWindow(int x, int y, int width, int height);
     int setVolume(float volume);
@@ -142,6 +147,10 @@ private:
     void programEventCallback(Parser::ProgramEventType event, int param1, int param2, void* data);
     int drainDataFromBuffer_l();
     int doWriteData_l(const uint8_t* buffer, size_t size);
+    int writeDataWithEcmPipeline_l(const uint8_t* buffer, size_t size);
+    int drainEcmHold_l();
+    void onEcmDrained();
+    int processEcm_l(bool isSection, int ecmPid, const uint8_t* data, size_t size);
 
     void notifyListener(Aml_MP_PlayerEventType eventType, int64_t param);
 
@@ -235,6 +244,16 @@ private:
 
     bool mIsStandaloneCas = false;
     sptr<AmlCasBase> mCasHandle;
+    // ECMs processed off the write path, TS behind a new one waits in mEcmHold.
+    std::unique_ptr<AmlCasEcmPipeline> mEcmPipeline;
+    AmlMpChunkFifo mEcmHold;
+    size_t mEcmHoldSize = 0;
+    // ECMs of the adjacent services, for a fast zap to one of them.
+    std::unique_ptr<AmlCasEcmPrefetcher> mEcmPrefetcher;
+    std::unique_ptr<AmlCasEmmProcessor> mEmmProcessor;
+    // mCasHandle for the event thread, which tells it the first frame.
+    std::mutex mFirstFrameCasLock;
+    sptr<AmlCasBase> mFirstFrameCas;
 
     static constexpr int kZorderBase = -2;
     int mZorder;
@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: software descrambler throughput.
+ *
+ * TS packets, from a local capture or generated, are scrambled with AES-128
+ * or DVB-CSA2, even and odd keys alternating like crypto periods, then
+ * descrambled through a software CAS session, by Aml_MP_CAS_DecryptIPTV() or
+ * by batches of chunks with Aml_MP_CAS_DecryptIPTVv(). The first pass is
+ * checked against the clear packets.
+ */
+
+#define LOG_TAG "AmlMpCasBenchmark"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include <Aml_MP/Cas.h>
+#include <cas/soft_cas/AmlAes128.h>
+#include <cas/soft_cas/AmlDvbCsa.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const char* mName = LOG_TAG;
+using namespace aml_mp;
+
+static const size_t kTsPacketSize = 188;
+static const size_t kMaxCaptureSize = 64 * 1024 * 1024;
+static const size_t kGeneratedSize = 16 * 1024 * 1024;
+// packets per crypto period, the parity flips after each.
+static const size_t kPeriodPackets = 4096;
+
+static const uint8_t kAesKeys[2][16] = {
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+    {0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87, 0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f},
+};
+static const uint8_t kCsaKeys[2][8] = {
+    {0x11, 0x22, 0x33, 0x66, 0x44, 0x55, 0x66, 0xff},
+    {0x12, 0x34, 0x56, 0x9c, 0x78, 0x9a, 0xbc, 0xce},
+};
+static const uint8_t kIv[16] = {
+    0x44, 0x56, 0x42, 0x54, 0x4d, 0x43, 0x50, 0x54, 0x41, 0x45, 0x53, 0x43, 0x49, 0x53, 0x53, 0x41,
+};
+
+struct Argument
+{
+    std::string input;
+    std::string algo = "csa";
+    bool cbc = false;
+    bool alignRight = false;
+    int64_t size = 256LL * 1024 * 1024;
+    size_t chunkSize = 7 * kTsPacketSize;
+    int vector = 0;
+};
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t cpuUs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec;
+}
+
+static std::string toHex(const uint8_t* data, size_t size)
+{
+    std::string hex;
+    char byte[3];
+    for (size_t i = 0; i < size; ++i) {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int loadCapture(const std::string& path, std::vector<uint8_t>* capture)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("open %s failed, %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    capture->resize(kMaxCaptureSize);
+    size_t size = 0;
+    ssize_t len;
+    while (size < capture->size() && (len = read(fd, capture->data() + size, capture->size() - size)) > 0) {
+        size += len;
+    }
+    ::close(fd);
+
+    // start on a sync byte, end on a whole packet.
+    size_t start = 0;
+    while (start + kTsPacketSize < size &&
+           ((*capture)[start] != 0x47 || (*capture)[start + kTsPacketSize] != 0x47)) {
+        start++;
+    }
+    size = start + (size - start) / kTsPacketSize * kTsPacketSize;
+    capture->erase(capture->begin() + size, capture->end());
+    capture->erase(capture->begin(), capture->begin() + start);
+
+    if (capture->empty()) {
+        printf("no TS packets in %s\n", path.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+// video-like packets, some with an adaptation field so the payloads vary.
+static void generateCapture(std::vector<uint8_t>* capture)
+{
+    capture->resize(kGeneratedSize / kTsPacketSize * kTsPacketSize);
+    uint32_t seed = 1;
+    for (size_t offset = 0; offset < capture->size(); offset += kTsPacketSize) {
+        uint8_t* p = capture->data() + offset;
+        size_t index = offset / kTsPacketSize;
+        p[0] = 0x47;
+        p[1] = 0x01;
+        p[2] = 0x00;
+        p[3] = 0x10 | (index & 0x0F);
+        size_t header = 4;
+        if (index % 16 == 0) {
+            p[3] |= 0x20;
+            p[4] = 7 + index % 13;
+            memset(p + 5, 0xFF, p[4]);
+            header += 1 + p[4];
+        }
+        for (size_t i = header; i < kTsPacketSize; ++i) {
+            seed = seed * 1103515245 + 12345;
+            p[i] = seed >> 16;
+        }
+    }
+}
+
+static void scramble(const Argument& argument, std::vector<uint8_t>* capture)
+{
+    AmlAes128 aes[2];
+    AmlDvbCsa csa[2];
+    for (int i = 0; i < 2; ++i) {
+        aes[i].setKey(kAesKeys[i]);
+        csa[i].setKey(kCsaKeys[i]);
+    }
+
+    for (size_t offset = 0; offset < capture->size(); offset += kTsPacketSize) {
+        uint8_t* p = capture->data() + offset;
+        if ((p[3] & 0xC0) || !(p[3] & 0x10) || (p[1] & 0x1F) == 0x1F) {
+            continue;
+        }
+
+        size_t header = 4 + ((p[3] & 0x20) ? 1 + p[4] : 0);
+        if (header >= kTsPacketSize) {
+            continue;
+        }
+
+        int parity = (offset / kTsPacketSize / kPeriodPackets) & 1;
+        uint8_t* payload = p + header;
+        size_t size = kTsPacketSize - header;
+        if (argument.algo == "aes") {
+            size_t blocks = size / AmlAes128::kBlockSize;
+            if (argument.alignRight) {
+                payload += size % AmlAes128::kBlockSize;
+            }
+            if (argument.cbc) {
+                aes[parity].encryptCbc(payload, blocks, kIv);
+            } else {
+                aes[parity].encryptEcb(payload, blocks);
+            }
+        } else {
+            csa[parity].encrypt(payload, size);
+        }
+        p[3] |= parity ? 0xC0 : 0x80;
+    }
+}
+
+static int setKeys(AML_MP_CASSESSION session, const Argument& argument)
+{
+    for (int parity = 0; parity < 2; ++parity) {
+        bool aes = argument.algo == "aes";
+        std::string json = std::string("{\"cmd\":\"setKey\",\"parity\":\"") + (parity ? "odd" : "even") + "\"" +
+            ",\"algo\":\"" + argument.algo + "\"" +
+            ",\"key\":\"" + (aes ? toHex(kAesKeys[parity], 16) : toHex(kCsaKeys[parity], 8)) + "\"";
+        if (aes) {
+            json += std::string(",\"mode\":\"") + (argument.cbc ? "cbc" : "ecb") + "\"" +
+                    ",\"alignment\":\"" + (argument.alignRight ? "right" : "left") + "\"" +
+                    ",\"iv\":\"" + toHex(kIv, sizeof(kIv)) + "\"";
+        }
+        json += "}";
+
+        if (Aml_MP_CAS_Ioctl(session, json.c_str(), nullptr, 0) < 0) {
+            printf("set key failed! %s\n", json.c_str());
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// FIPS-197 C.1 through the session, in an AES-ECB packet without adaptation field.
+static bool checkKnownAnswer(AML_MP_CASSESSION session)
+{
+    static const uint8_t cipher[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+    };
+    std::string json = "{\"cmd\":\"setKey\",\"parity\":\"even\",\"algo\":\"aes\",\"key\":\"" + toHex(kAesKeys[0], 16) + "\"}";
+    if (Aml_MP_CAS_Ioctl(session, json.c_str(), nullptr, 0) < 0) {
+        return false;
+    }
+
+    uint8_t packet[kTsPacketSize] = {0x47, 0x01, 0x00, 0x90};
+    memcpy(packet + 4, cipher, sizeof(cipher));
+    Aml_MP_Buffer out{};
+    if (Aml_MP_CAS_DecryptIPTV(session, packet, sizeof(packet), nullptr, &out) < 0) {
+        return false;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        if (packet[4 + i] != i * 0x11) {
+            return false;
+        }
+    }
+
+    return packet[3] == 0x10;
+}
+
+static int descramble(AML_MP_CASSESSION session, const Argument& argument, uint8_t* data, size_t size)
+{
+    if (argument.vector <= 0) {
+        Aml_MP_Buffer out{};
+        return Aml_MP_CAS_DecryptIPTV(session, data, size, nullptr, &out);
+    }
+
+    std::vector<struct iovec> iov;
+    for (size_t offset = 0; offset < size; offset += argument.chunkSize) {
+        iov.push_back({data + offset, std::min(argument.chunkSize, size - offset)});
+    }
+    std::vector<Aml_MP_Buffer> out(iov.size());
+    return Aml_MP_CAS_DecryptIPTVv(session, iov.data(), iov.size(), nullptr, out.data());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int parseCommandArgs(int argc, char* argv[], Argument* argument)
+{
+    static const struct option longopts[] = {
+        {"help",        no_argument,        nullptr, 'h'},
+        {"algo",        required_argument,  nullptr, 'a'},
+        {"cbc",         no_argument,        nullptr, 'c'},
+        {"right",       no_argument,        nullptr, 'r'},
+        {"size",        required_argument,  nullptr, 's'},
+        {"chunk",       required_argument,  nullptr, 'k'},
+        {"vector",      required_argument,  nullptr, 'v'},
+        {nullptr,       no_argument,        nullptr, 0},
+    };
+
+    int opt, longindex;
+    while ((opt = getopt_long(argc, argv, "", longopts, &longindex)) != -1) {
+        switch (opt) {
+        case 'a':
+            argument->algo = optarg;
+            if (argument->algo != "aes" && argument->algo != "csa") {
+                printf("unsupported algo %s\n", optarg);
+                return -1;
+            }
+            break;
+
+        case 'c':
+            argument->cbc = true;
+            break;
+
+        case 'r':
+            argument->alignRight = true;
+            break;
+
+        case 's':
+            argument->size = strtoll(optarg, nullptr, 0) * 1024 * 1024;
+            break;
+
+        case 'k':
+            argument->chunkSize = std::max(strtoul(optarg, nullptr, 0), 1UL) * kTsPacketSize;
+            break;
+
+        case 'v':
+            argument->vector = std::max((int)strtol(optarg, nullptr, 0), 0);
+            break;
+
+        case 'h':
+        default:
+            return -1;
+        }
+    }
+
+    if (optind < argc) {
+        argument->input = argv[argc-1];
+    }
+
+    return 0;
+}
+
+static void showUsage()
+{
+    printf("Usage: amlMpCasBenchmark <options> [ts file]\n"
+            "options:\n"
+            "    --algo:        aes or csa, default csa\n"
+            "    --cbc          AES-CBC instead of AES-ECB\n"
+            "    --right        AES residue at the start of the payload\n"
+            "    --size:        MB descrambled, default 256\n"
+            "    --chunk:       TS packets per chunk, default 7, one RTP payload\n"
+            "    --vector:      chunks per Aml_MP_CAS_DecryptIPTVv call, default 0: Aml_MP_CAS_DecryptIPTV per chunk\n"
+            "without a ts file, %zu MB of packets are generated.\n"
+            "\n", kGeneratedSize / 1024 / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    Argument argument;
+
+    if (parseCommandArgs(argc, argv, &argument) < 0) {
+        showUsage();
+        return 0;
+    }
+
+    std::vector<uint8_t> clear;
+    if (argument.input.empty()) {
+        generateCapture(&clear);
+    } else if (loadCapture(argument.input, &clear) < 0) {
+        return -1;
+    }
+    std::vector<uint8_t> scrambled = clear;
+    scramble(argument, &scrambled);
+
+    AML_MP_CASSESSION session = nullptr;
+    if (Aml_MP_CAS_OpenSession(&session, AML_MP_CAS_SERVICE_SOFT) < 0) {
+        printf("open software CAS session failed!\n");
+        return -1;
+    }
+
+    bool known = checkKnownAnswer(session);
+    printf("AES-128 known answer: %s\n", known ? "ok" : "FAILED");
+    if (setKeys(session, argument) < 0) {
+        Aml_MP_CAS_CloseSession(session);
+        return -1;
+    }
+
+    std::vector<uint8_t> work(scrambled.size());
+    size_t call = argument.vector > 0 ? argument.chunkSize * argument.vector : argument.chunkSize;
+    call = std::min(call, work.size());
+
+    int64_t bytes = 0;
+    int64_t busyUs = 0;
+    int64_t calls = 0;
+    bool verified = false;
+    int64_t startCpuUs = cpuUs();
+    int64_t startUs = nowUs();
+    while (bytes < argument.size) {
+        memcpy(work.data(), scrambled.data(), work.size());
+
+        for (size_t offset = 0; offset < work.size(); offset += call) {
+            size_t size = std::min(call, work.size() - offset);
+            int64_t callStartUs = nowUs();
+            if (descramble(session, argument, work.data() + offset, size) < 0) {
+                printf("descramble failed!\n");
+                Aml_MP_CAS_CloseSession(session);
+                return -1;
+            }
+            busyUs += nowUs() - callStartUs;
+            bytes += size;
+            calls++;
+        }
+
+        if (!verified) {
+            verified = true;
+            size_t bad = 0;
+            for (size_t offset = 0; offset < work.size(); offset += kTsPacketSize) {
+                bad += memcmp(work.data() + offset, clear.data() + offset, kTsPacketSize) != 0;
+            }
+            printf("descrambled packets: %s, %zu of %zu differ\n", bad ? "FAILED" : "ok",
+                    bad, work.size() / kTsPacketSize);
+        }
+    }
+    int64_t elapsedUs = nowUs() - startUs;
+    int64_t cpuTimeUs = cpuUs() - startCpuUs;
+
+    char stats[256] = {0};
+    Aml_MP_CAS_Ioctl(session, "{\"cmd\":\"getStats\"}", stats, sizeof(stats));
+    Aml_MP_CAS_CloseSession(session);
+
+    double mb = bytes / 1048576.0;
+    double seconds = busyUs / 1e6;
+    int64_t packets = bytes / kTsPacketSize;
+    printf("%s%s: %.1f MB in %" PRId64 " calls of %zu bytes\n", argument.algo.c_str(),
+            argument.algo == "aes" ? (argument.cbc ? "-cbc" : "-ecb") : "", mb, calls, call);
+    printf("    %.1f MB/s, %.1f Mbit/s, %.0f ns per packet, %.1f us per call\n",
+            seconds > 0 ? mb / seconds : 0, seconds > 0 ? bytes * 8 / 1e6 / seconds : 0,
+            packets > 0 ? busyUs * 1000.0 / packets : 0, calls > 0 ? (double)busyUs / calls : 0);
+    printf("    cpu load %.1f%% including copies, stats %s\n",
+            elapsedUs > 0 ? cpuTimeUs * 100.0 / elapsedUs : 0, stats);
+
+    return known && verified ? 0 : -1;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: stub of the IPTV CAS libs loaded by AmCasLibWrapper.
+ */
+
+#define LOG_TAG "AmlMpCasStub"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include <cas/AmCasLibWrapper.h>
+#include <cas/soft_cas/AmlDvbCsa.h>
+#include "AmlMpCasStub.h"
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+static const char* mName = LOG_TAG;
+
+using namespace aml_mp;
+
+static const size_t kTsPacketSize = 188;
+
+namespace {
+
+struct StubCas {
+    std::mutex lock;
+    int instanceId = -1;
+    int videoPid = -1;
+    int audioPid = -1;
+    bool provisioned = false;
+    bool opened = false;
+    bool hasCw = false;
+    uint8_t cw[2][AmlDvbCsa::kKeySize];
+    AmlDvbCsa csa[2];
+};
+
+struct Counters {
+    std::atomic<uint32_t> provision{0};
+    std::atomic<uint32_t> open{0};
+    std::atomic<uint32_t> ecm{0};
+    std::atomic<uint32_t> decrypt{0};
+};
+
+std::mutex gLock;
+AmlMpCasStubConfig gConfig;
+AmlMpCasStubStats gStats;
+Counters gCounters;
+
+AmlMpCasStubConfig config()
+{
+    std::lock_guard<std::mutex> _l(gLock);
+    return gConfig;
+}
+
+void delay(uint32_t us)
+{
+    if (us > 0) {
+        usleep(us);
+    }
+}
+
+// every Nth call of a kind fails.
+bool injectFailure(std::atomic<uint32_t>& counter, uint32_t every)
+{
+    if (every == 0 || ++counter % every != 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.injectedFailures++;
+    return true;
+}
+
+// the ECM payload in a section or TS packet, nullptr if there is none.
+const AmlMpCasStubEcm* findEcm(const uint8_t* data, size_t size)
+{
+    static const size_t kMagicSize = sizeof(AmlMpCasStubEcm::magic);
+    for (size_t i = 0; i + sizeof(AmlMpCasStubEcm) <= size; ++i) {
+        if (memcmp(data + i, AML_MP_CAS_STUB_ECM_MAGIC, kMagicSize) == 0) {
+            return reinterpret_cast<const AmlMpCasStubEcm*>(data + i);
+        }
+    }
+
+    return nullptr;
+}
+
+void setCw_l(StubCas* cas, const AmlMpCasStubEcm* ecm)
+{
+    if (cas->hasCw && memcmp(cas->cw, ecm->cw, sizeof(cas->cw)) == 0) {
+        return;
+    }
+
+    memcpy(cas->cw, ecm->cw, sizeof(cas->cw));
+    cas->csa[0].setKey(cas->cw[0]);
+    cas->csa[1].setKey(cas->cw[1]);
+    cas->hasCw = true;
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.keyChanges++;
+}
+
+void descramble_l(StubCas* cas, uint8_t* data, size_t size)
+{
+    uint64_t descrambled = 0;
+    uint64_t noKey = 0;
+
+    for (size_t offset = 0; offset + kTsPacketSize <= size; offset += kTsPacketSize) {
+        uint8_t* p = data + offset;
+        if (p[0] != 0x47) {
+            continue;
+        }
+
+        size_t header = 4;
+        if (p[3] & 0x20) {
+            header += 1 + p[4];
+        }
+        if (header >= kTsPacketSize) {
+            continue;
+        }
+
+        int scrambling = p[3] >> 6;
+        if (scrambling < 2) {
+            // in-band ECMs, as a web CAS sees them.
+            const AmlMpCasStubEcm* ecm = findEcm(p + header, kTsPacketSize - header);
+            if (ecm != nullptr) {
+                setCw_l(cas, ecm);
+            }
+            continue;
+        }
+
+        if (!cas->hasCw) {
+            noKey++;
+            continue;
+        }
+
+        p[3] &= 0x3F;
+        if (p[3] & 0x10) {
+            cas->csa[scrambling & 1].decrypt(p + header, kTsPacketSize - header);
+        }
+        descrambled++;
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.descrambledPackets += descrambled;
+    gStats.noKeyPackets += noKey;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+extern "C" {
+
+void AmlMpCasStub_SetConfig(const AmlMpCasStubConfig* config)
+{
+    std::lock_guard<std::mutex> _l(gLock);
+    gConfig = *config;
+}
+
+void AmlMpCasStub_GetConfig(AmlMpCasStubConfig* config)
+{
+    std::lock_guard<std::mutex> _l(gLock);
+    *config = gConfig;
+}
+
+void AmlMpCasStub_GetStats(AmlMpCasStubStats* stats)
+{
+    std::lock_guard<std::mutex> _l(gLock);
+    *stats = gStats;
+}
+
+void AmlMpCasStub_ResetStats()
+{
+    std::lock_guard<std::mutex> _l(gLock);
+    memset(&gStats, 0, sizeof(gStats));
+    gCounters.provision = 0;
+    gCounters.open = 0;
+    gCounters.ecm = 0;
+    gCounters.decrypt = 0;
+}
+
+// AmCasLibWrapper symbol table
+AmCasStatus_t createAmCas(void** casObj)
+{
+    // AmCasLibWrapper frees it with delete on a void*, no destructor runs.
+    *casObj = new StubCas;
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.instances++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t setCasInstanceId(void* casObj, int casInstanceId)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    std::lock_guard<std::mutex> _l(cas->lock);
+    cas->instanceId = casInstanceId;
+    return CAS_STATUS_OK;
+}
+
+int getCasInstanceId(void* casObj)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    std::lock_guard<std::mutex> _l(cas->lock);
+    return cas->instanceId;
+}
+
+AmCasStatus_t setPrivateData(void* casObj, void* iDate, int iSize)
+{
+    AML_MP_UNUSED(casObj);
+    AML_MP_UNUSED(iDate);
+    AML_MP_UNUSED(iSize);
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t provision(void* casObj)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    AmlMpCasStubConfig c = config();
+    delay(c.provisionUs);
+    if (injectFailure(gCounters.provision, c.provisionFailEvery)) {
+        return CAS_STATUS_ERROR;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(cas->lock);
+        cas->provisioned = true;
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.provisions++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t setPids(void* casObj, int vPid, int aPid)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    std::lock_guard<std::mutex> _l(cas->lock);
+    cas->videoPid = vPid;
+    cas->audioPid = aPid;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t openSession(void* casObj, uint8_t* sessionId)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    AmlMpCasStubConfig c = config();
+    delay(c.openSessionUs);
+    if (injectFailure(gCounters.open, c.openFailEvery)) {
+        return CAS_STATUS_ERROR;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(cas->lock);
+        if (!cas->provisioned) {
+            MLOGE("openSession before provision!");
+            return CAS_STATUS_ERROR;
+        }
+        cas->opened = true;
+        if (sessionId != nullptr) {
+            *sessionId = 1;
+        }
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.sessionsOpened++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t closeSession(void* casObj, uint8_t* sessionId)
+{
+    AML_MP_UNUSED(sessionId);
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    {
+        std::lock_guard<std::mutex> _l(cas->lock);
+        cas->opened = false;
+        cas->hasCw = false;
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.sessionsClosed++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t processEcm(void* casObj, int isSection, int isVideoEcm, int vEcmPid, int aEcmPid, unsigned char* pBuffer, int iBufferLength)
+{
+    AML_MP_UNUSED(isSection);
+    AML_MP_UNUSED(isVideoEcm);
+    AML_MP_UNUSED(vEcmPid);
+    AML_MP_UNUSED(aEcmPid);
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    AmlMpCasStubConfig c = config();
+    delay(c.ecmUs);
+    if (injectFailure(gCounters.ecm, c.ecmFailEvery)) {
+        return CAS_STATUS_ERROR;
+    }
+
+    const AmlMpCasStubEcm* ecm = findEcm(pBuffer, iBufferLength);
+    if (ecm == nullptr) {
+        MLOGW("no ECM in %d bytes", iBufferLength);
+        return CAS_STATUS_ERROR;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(cas->lock);
+        setCw_l(cas, ecm);
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.ecms++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t processEmm(void* casObj, int isSection, int iPid, uint8_t* pBuffer, int iBufferLength)
+{
+    AML_MP_UNUSED(casObj);
+    AML_MP_UNUSED(isSection);
+    AML_MP_UNUSED(iPid);
+    AML_MP_UNUSED(pBuffer);
+    AML_MP_UNUSED(iBufferLength);
+    delay(config().emmUs);
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.emms++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t decrypt(void* casObj, uint8_t* in, uint8_t* out, int size, void* ext_data)
+{
+    AML_MP_UNUSED(ext_data);
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    AmlMpCasStubConfig c = config();
+    delay(c.decryptUs);
+    if (size < 0 || injectFailure(gCounters.decrypt, c.decryptFailEvery)) {
+        return CAS_STATUS_ERROR;
+    }
+
+    if (out != in) {
+        memmove(out, in, size);
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(cas->lock);
+        descramble_l(cas, out, size);
+    }
+
+    std::lock_guard<std::mutex> _l(gLock);
+    gStats.decryptCalls++;
+    return CAS_STATUS_OK;
+}
+
+AmCasStatus_t releaseAll(void* casObj)
+{
+    StubCas* cas = static_cast<StubCas*>(casObj);
+    std::lock_guard<std::mutex> _l(cas->lock);
+    cas->opened = false;
+    cas->provisioned = false;
+    cas->hasCw = false;
+    return CAS_STATUS_OK;
+}
+
+uint8_t* getOutbuffer(void* casObj)
+{
+    AML_MP_UNUSED(casObj);
+    // decrypt() works in place.
+    return nullptr;
+}
+
+}
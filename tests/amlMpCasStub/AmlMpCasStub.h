@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: stub of the IPTV CAS libs loaded by AmCasLibWrapper.
+ *
+ * Set AmlMpConfig::mCasLib, or vendor.amlmp.cas-lib, to libamlMpCasStub.so
+ * and the VMX and Widevine IPTV CAS types load it instead of their vendor
+ * lib. ECMs carry the clear control words, see AmlMpCasStubEcm, and TS
+ * packets scrambled with them in DVB-CSA2 are descrambled by decrypt().
+ * Each call can be slowed down or made to fail.
+ */
+
+#ifndef _AML_MP_CAS_STUB_H_
+#define _AML_MP_CAS_STUB_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AML_MP_CAS_STUB_LIB         "libamlMpCasStub.so"
+#define AML_MP_CAS_STUB_ECM_MAGIC   "AMCS"
+
+/**\brief ECM payload, after the TS header or as the section body after the
+ * 3 byte section header. A new pair of control words is a key rotation.*/
+typedef struct {
+    char magic[4];              /**< AML_MP_CAS_STUB_ECM_MAGIC*/
+    uint8_t cw[2][8];           /**< Even and odd DVB-CSA2 control words*/
+} AmlMpCasStubEcm;
+
+typedef struct {
+    uint32_t provisionUs;       /**< Time provision() takes*/
+    uint32_t openSessionUs;     /**< Time openSession() takes*/
+    uint32_t ecmUs;             /**< Time processEcm() takes*/
+    uint32_t emmUs;             /**< Time processEmm() takes*/
+    uint32_t decryptUs;         /**< Time decrypt() takes per call, on top of the descrambling*/
+    uint32_t provisionFailEvery;/**< Every Nth provision() fails, 0: never*/
+    uint32_t openFailEvery;     /**< Every Nth openSession() fails, 0: never*/
+    uint32_t ecmFailEvery;      /**< Every Nth processEcm() fails, 0: never*/
+    uint32_t decryptFailEvery;  /**< Every Nth decrypt() fails, 0: never*/
+} AmlMpCasStubConfig;
+
+typedef struct {
+    uint32_t instances;         /**< CAS objects created*/
+    uint32_t provisions;        /**< Successful provision() calls*/
+    uint32_t sessionsOpened;    /**< Successful openSession() calls*/
+    uint32_t sessionsClosed;    /**< closeSession() calls*/
+    uint32_t ecms;              /**< ECMs processed successfully*/
+    uint32_t emms;              /**< EMMs processed*/
+    uint32_t keyChanges;        /**< ECMs or in-band ECMs that brought new control words*/
+    uint32_t decryptCalls;      /**< Successful decrypt() calls*/
+    uint64_t descrambledPackets;/**< TS packets descrambled*/
+    uint64_t noKeyPackets;      /**< Scrambled TS packets left as they were, no control word yet*/
+    uint32_t injectedFailures;  /**< Calls failed on purpose*/
+} AmlMpCasStubStats;
+
+void AmlMpCasStub_SetConfig(const AmlMpCasStubConfig* config);
+void AmlMpCasStub_GetConfig(AmlMpCasStubConfig* config);
+void AmlMpCasStub_GetStats(AmlMpCasStubStats* stats);
+void AmlMpCasStub_ResetStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,675 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: CAS path tests against the stub CAS lib.
+ *
+ * The IPTV CAS types load libamlMpCasStub.so instead of their vendor lib, so
+ * the ECM, decrypt and session paths run on a build host. A capture with
+ * stub ECMs is generated, or given on the command line, e.g. one dumped by
+ * an earlier run with --dump.
+ */
+
+#define LOG_TAG "AmlMpCasTest"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpUtils.h>
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpEventLooper.h>
+#include <Aml_MP/Cas.h>
+#include <cas/AmlCasBase.h>
+#include <cas/AmlCasEcmPipeline.h>
+#include <cas/AmlCasSessionPool.h>
+#include <cas/soft_cas/AmlDvbCsa.h>
+#include <gtest/gtest.h>
+#include "AmlMpCasStub.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace aml_mp;
+
+static const char* mName = LOG_TAG;
+
+static const size_t kTsPacketSize = 188;
+static const int kVideoPid = 0x100;
+static const int kAudioPid = 0x101;
+static const int kEcmPid = 0x1FF;
+static const size_t kPackets = 24000;
+static const size_t kPeriodPackets = 4000;
+static const size_t kEcmInterval = 400;
+// one RTP payload per write.
+static const size_t kChunkPackets = 7;
+
+///////////////////////////////////////////////////////////////////////////////
+struct Capture
+{
+    std::vector<uint8_t> scrambled;
+    std::vector<uint8_t> clear;         // empty for a capture from a file
+    int ecmPid = kEcmPid;
+    std::vector<size_t> ecmOffsets;
+    int keyChanges = 0;
+
+    size_t packets() const {
+        return scrambled.size() / kTsPacketSize;
+    }
+
+    const uint8_t* packet(size_t offset) const {
+        return scrambled.data() + offset;
+    }
+};
+
+static Capture gCapture;
+
+static int tsPid(const uint8_t* p)
+{
+    return (p[1] << 8 | p[2]) & 0x1FFF;
+}
+
+static const uint8_t* tsPayload(const uint8_t* p)
+{
+    return p + 4 + ((p[3] & 0x20) ? 1 + p[4] : 0);
+}
+
+static void controlWord(size_t period, uint8_t cw[AmlDvbCsa::kKeySize])
+{
+    for (size_t i = 0; i < AmlDvbCsa::kKeySize; ++i) {
+        cw[i] = period * 0x35 + i * 0x1D + 0x11;
+    }
+    // the usual DVB checksum bytes.
+    cw[3] = cw[0] + cw[1] + cw[2];
+    cw[7] = cw[4] + cw[5] + cw[6];
+}
+
+// the ECM of a period carries its control word and the one of the next period.
+static void writeEcmPacket(uint8_t* p, size_t period, uint8_t cc)
+{
+    AmlMpCasStubEcm ecm;
+    memcpy(ecm.magic, AML_MP_CAS_STUB_ECM_MAGIC, sizeof(ecm.magic));
+    controlWord(period, ecm.cw[period & 1]);
+    controlWord(period + 1, ecm.cw[(period + 1) & 1]);
+
+    memset(p, 0xFF, kTsPacketSize);
+    p[0] = 0x47;
+    p[1] = 0x40 | kEcmPid >> 8;
+    p[2] = kEcmPid & 0xFF;
+    p[3] = 0x10 | (cc & 0x0F);
+    p[4] = 0;                               // pointer field
+    p[5] = 0x80 | (period & 1);             // table id
+    p[6] = 0x70;
+    p[7] = sizeof(ecm);                     // section length
+    memcpy(p + 8, &ecm, sizeof(ecm));
+}
+
+static void generateCapture(Capture* capture)
+{
+    capture->scrambled.resize(kPackets * kTsPacketSize);
+    capture->clear.resize(kPackets * kTsPacketSize);
+
+    AmlDvbCsa csa;
+    uint32_t seed = 1;
+    uint8_t cc[2] = {0, 0};
+    uint8_t ecmCc = 0;
+    for (size_t i = 0; i < kPackets; ++i) {
+        size_t period = i / kPeriodPackets;
+        uint8_t* p = capture->clear.data() + i * kTsPacketSize;
+
+        if (i % kEcmInterval == 0) {
+            writeEcmPacket(p, period, ecmCc++);
+            memcpy(capture->scrambled.data() + i * kTsPacketSize, p, kTsPacketSize);
+            continue;
+        }
+
+        int audio = i % 4 == 3;
+        int pid = audio ? kAudioPid : kVideoPid;
+        p[0] = 0x47;
+        p[1] = pid >> 8;
+        p[2] = pid & 0xFF;
+        p[3] = 0x10 | (cc[audio]++ & 0x0F);
+        size_t header = 4;
+        if (i % 32 == 1) {
+            p[3] |= 0x20;
+            p[4] = 7;
+            p[5] = 0x10;
+            memset(p + 6, 0xFF, 6);
+            header += 1 + p[4];
+        }
+        for (size_t j = header; j < kTsPacketSize; ++j) {
+            seed = seed * 1103515245 + 12345;
+            p[j] = seed >> 16;
+        }
+
+        uint8_t* s = capture->scrambled.data() + i * kTsPacketSize;
+        memcpy(s, p, kTsPacketSize);
+        uint8_t cw[AmlDvbCsa::kKeySize];
+        controlWord(period, cw);
+        csa.setKey(cw);
+        csa.encrypt(s + header, kTsPacketSize - header);
+        s[3] |= (period & 1) ? 0xC0 : 0x80;
+    }
+}
+
+static int loadCapture(const std::string& path, Capture* capture)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("open %s failed, %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    uint8_t buffer[64 * 1024];
+    ssize_t len;
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        capture->scrambled.insert(capture->scrambled.end(), buffer, buffer + len);
+    }
+    ::close(fd);
+
+    capture->scrambled.resize(capture->scrambled.size() / kTsPacketSize * kTsPacketSize);
+    if (capture->scrambled.empty() || capture->scrambled[0] != 0x47) {
+        printf("%s is not a TS capture\n", path.c_str());
+        return -1;
+    }
+    capture->ecmPid = AML_MP_INVALID_PID;
+
+    return 0;
+}
+
+static int dumpCapture(const std::string& path, const Capture& capture)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf("open %s failed, %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    ssize_t len = write(fd, capture.scrambled.data(), capture.scrambled.size());
+    ::close(fd);
+
+    return len == (ssize_t)capture.scrambled.size() ? 0 : -1;
+}
+
+// the stub ECM packets, and how often their control words change.
+static void indexEcms(Capture* capture)
+{
+    const uint8_t* last = nullptr;
+    for (size_t offset = 0; offset < capture->scrambled.size(); offset += kTsPacketSize) {
+        const uint8_t* p = capture->packet(offset);
+        const uint8_t* payload = tsPayload(p);
+        if ((p[3] & 0xC0) || payload + 4 + sizeof(AmlMpCasStubEcm) > p + kTsPacketSize ||
+            memcmp(payload + 4, AML_MP_CAS_STUB_ECM_MAGIC, 4) != 0) {
+            continue;
+        }
+
+        capture->ecmPid = tsPid(p);
+        capture->ecmOffsets.push_back(offset);
+        if (last == nullptr || memcmp(last, payload + 4, sizeof(AmlMpCasStubEcm)) != 0) {
+            capture->keyChanges++;
+        }
+        last = payload + 4;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct AmlMpCasTest : public testing::Test
+{
+    void SetUp() override {
+        AmlMpCasStubConfig config;
+        memset(&config, 0, sizeof(config));
+        AmlMpCasStub_SetConfig(&config);
+        AmlMpCasStub_ResetStats();
+
+        memset(&mParams, 0, sizeof(mParams));
+        mParams.videoCodec = AML_MP_VIDEO_CODEC_H264;
+        mParams.audioCodec = AML_MP_AUDIO_CODEC_AAC;
+        mParams.videoPid = kVideoPid;
+        mParams.audioPid = kAudioPid;
+        mParams.ecmPid[0] = gCapture.ecmPid;
+        mParams.ecmPid[1] = gCapture.ecmPid;
+        snprintf(mParams.serverAddress, sizeof(mParams.serverAddress), "127.0.0.1");
+        mParams.serverPort = 12686;
+        snprintf(mParams.keyPath, sizeof(mParams.keyPath), "/tmp");
+    }
+
+protected:
+    void setConfig(void (*update)(AmlMpCasStubConfig* config)) {
+        AmlMpCasStubConfig config;
+        AmlMpCasStub_GetConfig(&config);
+        update(&config);
+        AmlMpCasStub_SetConfig(&config);
+    }
+
+    // returns the time open and start took, -1 on error.
+    int64_t startSession(Aml_MP_CASServiceType serviceType, AML_MP_CASSESSION* session) {
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        if (Aml_MP_CAS_OpenSession(session, serviceType) < 0) {
+            return -1;
+        }
+        if (Aml_MP_CAS_StartDescramblingIPTV(*session, &mParams) < 0) {
+            Aml_MP_CAS_CloseSession(*session);
+            return -1;
+        }
+
+        return AmlMpEventLooper::GetNowUs() - startUs;
+    }
+
+    void stopSession(AML_MP_CASSESSION session) {
+        char json[2048];
+        if (Aml_MP_CAS_Ioctl(session, "{\"cmd\":\"getCasMetrics\"}", json, sizeof(json)) == 0) {
+            MLOGI("%s", json);
+        }
+        Aml_MP_CAS_StopDescrambling(session);
+        Aml_MP_CAS_CloseSession(session);
+    }
+
+    static size_t countScrambled(const std::vector<uint8_t>& data) {
+        size_t count = 0;
+        for (size_t offset = 0; offset < data.size(); offset += kTsPacketSize) {
+            count += (data[offset + 3] & 0xC0) != 0;
+        }
+        return count;
+    }
+
+    Aml_MP_IptvCASParams mParams;
+};
+
+TEST_F(AmlMpCasTest, SessionSetup)
+{
+    static const uint32_t kProvisionUs = 20 * 1000;
+    static const uint32_t kOpenSessionUs = 30 * 1000;
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->provisionUs = kProvisionUs;
+        config->openSessionUs = kOpenSessionUs;
+    });
+
+    AML_MP_CASSESSION session;
+    int64_t elapsedUs = startSession(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &session);
+    ASSERT_GE(elapsedUs, 0);
+    printf("session setup: %.1f ms\n", elapsedUs / 1000.0);
+    EXPECT_GE(elapsedUs, kProvisionUs + kOpenSessionUs);
+    stopSession(session);
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.provisions, 1u);
+    EXPECT_EQ(stats.sessionsOpened, 1u);
+    EXPECT_EQ(stats.sessionsClosed, 1u);
+
+    if (AmlMpConfig::instance().mCasSessionPool <= 0) {
+        return;
+    }
+
+    // opened ahead by the pool, only bound to the service at zap time.
+    AmlCasSessionPool& pool = AmlCasSessionPool::instance();
+    pool.prepare(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &mParams);
+    for (int i = 0; i < 200 && stats.sessionsOpened < 2; ++i) {
+        usleep(10 * 1000);
+        AmlMpCasStub_GetStats(&stats);
+    }
+    ASSERT_EQ(stats.sessionsOpened, 2u);
+
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    sptr<AmlCasBase> cas = pool.acquire(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &mParams);
+    ASSERT_NE(cas, nullptr);
+    ASSERT_EQ(cas->startDescrambling(&mParams), 0);
+    elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+    printf("pooled session setup: %.1f ms\n", elapsedUs / 1000.0);
+
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.provisions, 2u);
+    EXPECT_EQ(stats.sessionsOpened, 2u);
+
+    // a released session goes to the next service, still open.
+    pool.release(cas);
+    sptr<AmlCasBase> next = pool.acquire(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &mParams);
+    EXPECT_EQ(next.get(), cas.get());
+    ASSERT_NE(next, nullptr);
+    ASSERT_EQ(next->startDescrambling(&mParams), 0);
+
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.provisions, 2u);
+    EXPECT_EQ(stats.sessionsOpened, 2u);
+    EXPECT_EQ(stats.sessionsClosed, 1u);
+    pool.release(next);
+}
+
+TEST_F(AmlMpCasTest, SessionOpenFailure)
+{
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->openFailEvery = 1;
+    });
+
+    AML_MP_CASSESSION session;
+    EXPECT_LT(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &session), 0);
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.sessionsOpened, 0u);
+    EXPECT_EQ(stats.injectedFailures, 1u);
+}
+
+// ECM TS packets as the player finds them in the written data.
+TEST_F(AmlMpCasTest, EcmLatency)
+{
+    static const uint32_t kEcmUs = 5 * 1000;
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->ecmUs = kEcmUs;
+    });
+
+    AML_MP_CASSESSION session;
+    ASSERT_GE(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &session), 0);
+
+    for (size_t offset : gCapture.ecmOffsets) {
+        EXPECT_EQ(Aml_MP_CAS_ProcessEcmIPTV(session, false, 0, gCapture.packet(offset), kTsPacketSize), 0);
+    }
+
+    Aml_MP_CASStats casStats;
+    ASSERT_EQ(Aml_MP_CAS_GetStats(session, &casStats), 0);
+    const Aml_MP_CASOperationStats& ecm = casStats.operations[AML_MP_CAS_OP_PROCESS_ECM];
+    printf("%zu ECM packets, %" PRIu64 " processed, latency avg %.1f ms, max %.1f ms\n",
+            gCapture.ecmOffsets.size(), ecm.calls, ecm.avgLatencyUs / 1000.0, ecm.maxLatencyUs / 1000.0);
+
+    // repeats never reach the CAS lib.
+    EXPECT_EQ(ecm.calls, (uint64_t)gCapture.keyChanges);
+    EXPECT_EQ(ecm.failures, 0u);
+    EXPECT_GE(ecm.avgLatencyUs, kEcmUs);
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.ecms, (uint32_t)gCapture.keyChanges);
+    EXPECT_EQ(stats.keyChanges, (uint32_t)gCapture.keyChanges);
+
+    stopSession(session);
+}
+
+// an ECM the CAS failed is passed again on its next copy.
+TEST_F(AmlMpCasTest, EcmFailureRetry)
+{
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->ecmFailEvery = 2;
+    });
+
+    AML_MP_CASSESSION session;
+    ASSERT_GE(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV, &session), 0);
+
+    std::vector<const uint8_t*> sections;
+    for (size_t offset : gCapture.ecmOffsets) {
+        const uint8_t* section = tsPayload(gCapture.packet(offset)) + 1;
+        if (sections.empty() || memcmp(sections.back(), section, 3 + sizeof(AmlMpCasStubEcm)) != 0) {
+            sections.push_back(section);
+        }
+    }
+    ASSERT_GE(sections.size(), 2u);
+
+    size_t size = 3 + sizeof(AmlMpCasStubEcm);
+    EXPECT_EQ(Aml_MP_CAS_ProcessEcmIPTV(session, true, gCapture.ecmPid, sections[0], size), 0);
+    EXPECT_LT(Aml_MP_CAS_ProcessEcmIPTV(session, true, gCapture.ecmPid, sections[1], size), 0);
+    EXPECT_EQ(Aml_MP_CAS_ProcessEcmIPTV(session, true, gCapture.ecmPid, sections[1], size), 0);
+    // a repeat of a processed one is not.
+    EXPECT_EQ(Aml_MP_CAS_ProcessEcmIPTV(session, true, gCapture.ecmPid, sections[1], size), 0);
+
+    Aml_MP_CASStats casStats;
+    ASSERT_EQ(Aml_MP_CAS_GetStats(session, &casStats), 0);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_PROCESS_ECM].calls, 3u);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_PROCESS_ECM].failures, 1u);
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.ecms, 2u);
+    EXPECT_EQ(stats.injectedFailures, 1u);
+
+    stopSession(session);
+}
+
+// a web CAS descrambles the TS it is given, ECMs in band.
+TEST_F(AmlMpCasTest, DecryptCapture)
+{
+    AML_MP_CASSESSION session;
+    ASSERT_GE(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_WEB, &session), 0);
+
+    std::vector<uint8_t> data = gCapture.scrambled;
+    size_t chunkSize = kChunkPackets * kTsPacketSize;
+    size_t chunks = 0;
+    int64_t startUs = AmlMpEventLooper::GetNowUs();
+    for (size_t offset = 0; offset < data.size(); offset += chunkSize) {
+        Aml_MP_Buffer out{};
+        size_t size = std::min(chunkSize, data.size() - offset);
+        ASSERT_EQ(Aml_MP_CAS_DecryptIPTV(session, data.data() + offset, size, nullptr, &out), 0);
+        ASSERT_EQ(out.size, size);
+        chunks++;
+    }
+    int64_t elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+    printf("decrypt: %zu calls, %.1f MB/s\n", chunks, elapsedUs > 0 ? data.size() / (double)elapsedUs : 0);
+
+    EXPECT_EQ(countScrambled(data), 0u);
+    if (!gCapture.clear.empty()) {
+        EXPECT_TRUE(data == gCapture.clear);
+    }
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    EXPECT_EQ(stats.decryptCalls, chunks);
+    EXPECT_EQ(stats.noKeyPackets, 0u);
+    EXPECT_EQ(stats.keyChanges, (uint32_t)gCapture.keyChanges);
+
+    Aml_MP_CASStats casStats;
+    ASSERT_EQ(Aml_MP_CAS_GetStats(session, &casStats), 0);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_DECRYPT].calls, chunks);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_DECRYPT].bytes, data.size());
+
+    stopSession(session);
+}
+
+// chunks of a vectored decrypt reach the CAS lib in fewer calls.
+TEST_F(AmlMpCasTest, DecryptCaptureVectored)
+{
+    static const int kIovCount = 16;
+
+    AML_MP_CASSESSION session;
+    ASSERT_GE(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_WEB, &session), 0);
+
+    std::vector<uint8_t> data = gCapture.scrambled;
+    size_t chunkSize = kChunkPackets * kTsPacketSize;
+    // the chunks of a call go to the CAS lib in runs of up to the decrypt batch size.
+    size_t batchSize = (size_t)std::max(AmlMpConfig::instance().mCasDecryptBatch, 0) * 1024 / kTsPacketSize * kTsPacketSize;
+    size_t calls = 0;
+    uint32_t libCalls = 0;
+    for (size_t offset = 0; offset < data.size();) {
+        struct iovec iov[kIovCount];
+        Aml_MP_Buffer out[kIovCount];
+        int count = 0;
+        size_t batched = 0;
+        for (; count < kIovCount && offset < data.size(); ++count) {
+            size_t size = std::min(chunkSize, data.size() - offset);
+            iov[count] = {data.data() + offset, size};
+            out[count] = {};
+            offset += size;
+            if (batched == 0 || batched + size > batchSize) {
+                libCalls++;
+                batched = 0;
+            }
+            batched += size;
+        }
+        ASSERT_EQ(Aml_MP_CAS_DecryptIPTVv(session, iov, count, nullptr, out), 0);
+        for (int i = 0; i < count; ++i) {
+            if (out[i].address != iov[i].iov_base) {
+                memcpy(iov[i].iov_base, out[i].address, out[i].size);
+            }
+        }
+        calls++;
+    }
+
+    EXPECT_EQ(countScrambled(data), 0u);
+    if (!gCapture.clear.empty()) {
+        EXPECT_TRUE(data == gCapture.clear);
+    }
+
+    AmlMpCasStubStats stats;
+    AmlMpCasStub_GetStats(&stats);
+    printf("vectored decrypt: %zu calls, %u CAS lib calls\n", calls, stats.decryptCalls);
+    EXPECT_EQ(stats.decryptCalls, libCalls);
+    EXPECT_EQ(stats.noKeyPackets, 0u);
+
+    stopSession(session);
+}
+
+TEST_F(AmlMpCasTest, DecryptFailureInjection)
+{
+    static const int kCalls = 30;
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->decryptFailEvery = 3;
+    });
+
+    AML_MP_CASSESSION session;
+    ASSERT_GE(startSession(AML_MP_CAS_SERVICE_VERIMATRIX_WEB, &session), 0);
+
+    std::vector<uint8_t> data(gCapture.scrambled.begin(), gCapture.scrambled.begin() + kCalls * kTsPacketSize);
+    int failures = 0;
+    for (int i = 0; i < kCalls; ++i) {
+        Aml_MP_Buffer out{};
+        failures += Aml_MP_CAS_DecryptIPTV(session, data.data() + i * kTsPacketSize, kTsPacketSize, nullptr, &out) != 0;
+    }
+    EXPECT_EQ(failures, kCalls / 3);
+
+    Aml_MP_CASStats casStats;
+    ASSERT_EQ(Aml_MP_CAS_GetStats(session, &casStats), 0);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_DECRYPT].failures, (uint64_t)kCalls / 3);
+
+    stopSession(session);
+}
+
+// the longest write of the player write path, with ECMs handled inline or by
+// the ECM pipeline.
+TEST_F(AmlMpCasTest, WritePathStall)
+{
+    static const uint32_t kEcmUs = 20 * 1000;
+    static const size_t kWritePackets = 64;
+    setConfig([](AmlMpCasStubConfig* config) {
+        config->ecmUs = kEcmUs;
+    });
+
+    auto writeCapture = [](const sptr<AmlCasBase>& cas, AmlCasEcmPipeline* pipeline, int64_t* maxStallUs) {
+        int64_t totalUs = 0;
+        *maxStallUs = 0;
+        size_t writeSize = kWritePackets * kTsPacketSize;
+        for (size_t offset = 0; offset < gCapture.scrambled.size(); offset += writeSize) {
+            size_t end = std::min(offset + writeSize, gCapture.scrambled.size());
+            int64_t startUs = AmlMpEventLooper::GetNowUs();
+            for (size_t i = offset; i < end; i += kTsPacketSize) {
+                const uint8_t* p = gCapture.packet(i);
+                if (tsPid(p) != gCapture.ecmPid) {
+                    continue;
+                }
+                if (pipeline != nullptr) {
+                    pipeline->queue(p, kTsPacketSize);
+                } else if (!cas->isRepeatedEcm(false, 0, p, kTsPacketSize)) {
+                    int64_t ecmStartUs = AmlMpEventLooper::GetNowUs();
+                    int ret = cas->processEcm(false, 0, p, kTsPacketSize);
+                    cas->metrics().record(AML_MP_CAS_OP_PROCESS_ECM, ecmStartUs, ret, kTsPacketSize);
+                    if (ret < 0) {
+                        cas->forgetEcm(false, 0, p, kTsPacketSize);
+                    }
+                }
+            }
+            int64_t elapsedUs = AmlMpEventLooper::GetNowUs() - startUs;
+            *maxStallUs = std::max(*maxStallUs, elapsedUs);
+            totalUs += elapsedUs;
+        }
+        return totalUs;
+    };
+
+    sptr<AmlCasBase> cas = AmlCasBase::create(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV);
+    ASSERT_NE(cas, nullptr);
+    ASSERT_EQ(cas->startDescrambling(&mParams), 0);
+    int64_t inlineMaxUs;
+    int64_t inlineUs = writeCapture(cas, nullptr, &inlineMaxUs);
+    cas->stopDescrambling();
+
+    cas = AmlCasBase::create(AML_MP_CAS_SERVICE_VERIMATRIX_IPTV);
+    ASSERT_NE(cas, nullptr);
+    ASSERT_EQ(cas->startDescrambling(&mParams), 0);
+    int64_t pipelineMaxUs;
+    int64_t pipelineUs;
+    int64_t drainUs;
+    {
+        AmlCasEcmPipeline pipeline(cas);
+        pipelineUs = writeCapture(cas, &pipeline, &pipelineMaxUs);
+        int64_t startUs = AmlMpEventLooper::GetNowUs();
+        for (int i = 0; i < 1000 && pipeline.pending() > 0; ++i) {
+            usleep(1000);
+        }
+        drainUs = AmlMpEventLooper::GetNowUs() - startUs;
+        EXPECT_EQ(pipeline.pending(), 0);
+    }
+
+    Aml_MP_CASStats casStats;
+    cas->metrics().getStats(&casStats);
+    cas->stopDescrambling();
+
+    printf("write path, ECMs inline: %.1f ms, longest write %.1f ms\n", inlineUs / 1000.0, inlineMaxUs / 1000.0);
+    printf("write path, ECM pipeline: %.1f ms, longest write %.1f ms, drained %.1f ms later\n",
+            pipelineUs / 1000.0, pipelineMaxUs / 1000.0, drainUs / 1000.0);
+
+    // inline, the writes wait for every new ECM, the pipeline leaves them the
+    // TS scan. Compared with a wide margin, the machine may be loaded.
+    EXPECT_GE(inlineMaxUs, kEcmUs);
+    EXPECT_GE(inlineUs, gCapture.keyChanges * kEcmUs);
+    EXPECT_LT(pipelineUs, inlineUs / 2);
+    EXPECT_EQ(casStats.operations[AML_MP_CAS_OP_PROCESS_ECM].calls, (uint64_t)gCapture.keyChanges);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void usage()
+{
+    printf("Usage: amlMpCasTest [--dump <file>] [capture]\n"
+            "    capture: TS with stub ECMs, generated if not given\n"
+            "    --dump:  write the capture used to file\n"
+            "   try --help for more details.\n"
+            );
+}
+
+int main(int argc, char *argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+
+    std::string capturePath;
+    std::string dumpPath;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--dump") && i + 1 < argc) {
+            dumpPath = argv[++i];
+        } else if (argv[i][0] != '-') {
+            capturePath = argv[i];
+        } else {
+            usage();
+            return 0;
+        }
+    }
+
+    if (capturePath.empty()) {
+        generateCapture(&gCapture);
+    } else if (loadCapture(capturePath, &gCapture) < 0) {
+        return -1;
+    }
+    indexEcms(&gCapture);
+    printf("capture: %zu packets, %zu ECM packets on pid %#x, %d key changes\n",
+            gCapture.packets(), gCapture.ecmOffsets.size(), gCapture.ecmPid, gCapture.keyChanges);
+    if (gCapture.ecmOffsets.empty()) {
+        printf("no stub ECMs in the capture!\n");
+        return -1;
+    }
+
+    if (!dumpPath.empty() && dumpCapture(dumpPath, gCapture) < 0) {
+        return -1;
+    }
+
+    AmlMpConfig::instance().mCasLib = AML_MP_CAS_STUB_LIB;
+    // opt-in on devices, the pool is read when first used.
+    AmlMpConfig::instance().mCasSessionPool = 1;
+    AmlMpConfig::instance().mCasEcmDedup = 1;
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: AmlDVRTimeshiftRing spill and wrap tests.
+ */
+
+#include <dvr/AmlDVRTimeshiftRing.h>
+#include <dvr/AmlDVRSegmentCache.h>
+#include <dvr/AmlDVRTsIndex.h>
+#include <utils/AmlMpConfig.h>
+#include <dvr_segment.h>
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace aml_mp;
+
+#ifdef __ANDROID__
+static const char* kTmpDir = "/data/local/tmp";
+#else
+static const char* kTmpDir = "/tmp";
+#endif
+
+// four segments go over the 1MB budget, two of them fit.
+static const size_t kSegmentSize = 400 * 1024;
+
+static void removeDir(const std::string& dir)
+{
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            unlink((dir + "/" + de->d_name).c_str());
+        }
+    }
+    closedir(d);
+    rmdir(dir.c_str());
+}
+
+static bool isSymlink(const std::string& path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0 && S_ISLNK(st.st_mode);
+}
+
+static bool isRegular(const std::string& path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+class AmlDVRTimeshiftRingTest : public testing::Test
+{
+protected:
+    void SetUp() override {
+        char dir[256];
+        snprintf(dir, sizeof(dir), "%s/tsringXXXXXX", kTmpDir);
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        mDir = dir;
+        mRamDir = mDir + "/ram";
+        mDiskDir = mDir + "/disk";
+        ASSERT_EQ(mkdir(mRamDir.c_str(), 0755), 0);
+        ASSERT_EQ(mkdir(mDiskDir.c_str(), 0755), 0);
+        mLocation = mDiskDir + "/timeshift";
+
+        AmlMpConfig& config = AmlMpConfig::instance();
+        mSavedRamDir = config.mTimeshiftRamDir;
+        mSavedRamSize = config.mTimeshiftRamSize;
+        config.mTimeshiftRamDir = mRamDir;
+        config.mTimeshiftRamSize = 1;
+    }
+
+    void TearDown() override {
+        AmlMpConfig& config = AmlMpConfig::instance();
+        config.mTimeshiftRamDir = mSavedRamDir;
+        config.mTimeshiftRamSize = mSavedRamSize;
+
+        removeDir(mRamDir);
+        removeDir(mDiskDir);
+        rmdir(mDir.c_str());
+    }
+
+    void writeSegment(const std::string& location, uint64_t id) {
+        std::vector<uint8_t> data(kSegmentSize, 0x47);
+        FILE* fp = fopen(AmlDVRSegmentFile(location.c_str(), id, "ts").c_str(), "we");
+        ASSERT_NE(fp, nullptr);
+        ASSERT_EQ(fwrite(data.data(), 1, data.size(), fp), data.size());
+        fclose(fp);
+    }
+
+    void linkSegments(const std::string& location, std::vector<uint64_t> ids) {
+        ASSERT_EQ(dvr_segment_link(location.c_str(), ids.size(), ids.data()), 0);
+        AmlDVRSegmentCache::instance().invalidate(location.c_str());
+    }
+
+    std::string ramFile(const char* ramLocation, uint64_t id) {
+        return AmlDVRSegmentFile(ramLocation, id, "ts");
+    }
+
+    std::string diskFile(uint64_t id) {
+        return AmlDVRSegmentFile(mLocation.c_str(), id, "ts");
+    }
+
+    std::string mDir;
+    std::string mRamDir;
+    std::string mDiskDir;
+    std::string mLocation;
+    std::string mSavedRamDir;
+    int mSavedRamSize = 0;
+};
+
+TEST_F(AmlDVRTimeshiftRingTest, SpillAndWrap)
+{
+    std::unique_ptr<AmlDVRTimeshiftRing> ring = AmlDVRTimeshiftRing::create(mLocation.c_str());
+    ASSERT_NE(ring, nullptr);
+    std::string ramLocation = ring->location();
+    EXPECT_EQ(ramLocation.compare(0, mRamDir.size(), mRamDir), 0);
+    EXPECT_EQ(AmlDVRTimeshiftRing::resolve(mLocation.c_str()), ramLocation);
+    EXPECT_EQ(AmlDVRTimeshiftRing::resolve("/unknown"), "/unknown");
+
+    // within the budget, nothing moves.
+    for (uint64_t id = 0; id < 2; ++id) {
+        writeSegment(ramLocation, id);
+    }
+    linkSegments(ramLocation, {0, 1});
+    ring->update();
+    EXPECT_TRUE(isRegular(ramFile(ramLocation.c_str(), 0)));
+    EXPECT_EQ(access(diskFile(0).c_str(), F_OK), -1);
+
+    // over the budget, the oldest segments go to disk, the newest stays.
+    for (uint64_t id = 2; id < 4; ++id) {
+        writeSegment(ramLocation, id);
+    }
+    linkSegments(ramLocation, {0, 1, 2, 3});
+    ring->update();
+    for (uint64_t id = 0; id < 2; ++id) {
+        EXPECT_TRUE(isSymlink(ramFile(ramLocation.c_str(), id))) << id;
+        EXPECT_TRUE(isRegular(diskFile(id))) << id;
+    }
+    for (uint64_t id = 2; id < 4; ++id) {
+        EXPECT_TRUE(isRegular(ramFile(ramLocation.c_str(), id))) << id;
+        EXPECT_EQ(access(diskFile(id).c_str(), F_OK), -1) << id;
+    }
+
+    // libdvr drops the oldest segments out of the window and unlinks their symlinks.
+    writeSegment(ramLocation, 4);
+    linkSegments(ramLocation, {2, 3, 4});
+    for (uint64_t id = 0; id < 2; ++id) {
+        unlink(ramFile(ramLocation.c_str(), id).c_str());
+    }
+    ring->update();
+    for (uint64_t id = 0; id < 2; ++id) {
+        EXPECT_EQ(access(diskFile(id).c_str(), F_OK), -1) << id;
+    }
+    EXPECT_TRUE(isSymlink(ramFile(ramLocation.c_str(), 2)));
+    EXPECT_TRUE(isRegular(diskFile(2)));
+    EXPECT_TRUE(isRegular(ramFile(ramLocation.c_str(), 3)));
+    EXPECT_TRUE(isRegular(ramFile(ramLocation.c_str(), 4)));
+
+    // the data reads the same through the symlink.
+    struct stat st;
+    ASSERT_EQ(stat(ramFile(ramLocation.c_str(), 2).c_str(), &st), 0);
+    EXPECT_EQ((size_t)st.st_size, kSegmentSize);
+
+    ring.reset();
+    // the mapping outlives the ring, the app deletes the files through it.
+    EXPECT_EQ(AmlDVRTimeshiftRing::resolve(mLocation.c_str()), ramLocation);
+}
+
+TEST_F(AmlDVRTimeshiftRingTest, DisabledStaysOnDisk)
+{
+    AmlMpConfig::instance().mTimeshiftRamSize = 0;
+    EXPECT_EQ(AmlDVRTimeshiftRing::create(mLocation.c_str()), nullptr);
+
+    AmlMpConfig::instance().mTimeshiftRamSize = 1;
+    AmlMpConfig::instance().mTimeshiftRamDir = mDir + "/missing";
+    EXPECT_EQ(AmlDVRTimeshiftRing::create(mLocation.c_str()), nullptr);
+}
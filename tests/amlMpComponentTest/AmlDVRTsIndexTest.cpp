@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: AmlDVRTsIndex build and lookup tests on a synthetic TS.
+ */
+
+#include <dvr/AmlDVRTsIndex.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace aml_mp;
+
+#ifdef __ANDROID__
+static const char* kTmpDir = "/data/local/tmp";
+#else
+static const char* kTmpDir = "/tmp";
+#endif
+
+static const int kPcrPid = 0x100;
+static const int kPacketIntervalMs = 20;
+static const int kPacketCount = 100;
+// the PCR wraps around halfway through.
+static const uint64_t kFirstPcr = (1ULL << 33) - 50 * kPacketIntervalMs * 90;
+
+// one PCR packet every kPacketIntervalMs, the ones in raps start a PES with
+// random_access_indicator set.
+static std::vector<uint8_t> makeTs(const std::vector<int>& raps)
+{
+    std::vector<uint8_t> ts(188 * kPacketCount, 0xFF);
+
+    for (int i = 0; i < kPacketCount; ++i) {
+        uint8_t* p = ts.data() + 188 * i;
+        bool rap = std::find(raps.begin(), raps.end(), i) != raps.end();
+        uint64_t pcr = (kFirstPcr + (uint64_t)i * kPacketIntervalMs * 90) & ((1ULL << 33) - 1);
+
+        p[0] = 0x47;
+        p[1] = (rap ? 0x40 : 0) | kPcrPid >> 8;
+        p[2] = kPcrPid & 0xFF;
+        p[3] = 0x30 | (i & 0x0F);
+        p[4] = 7;
+        p[5] = (rap ? 0x40 : 0) | 0x10;
+        p[6] = pcr >> 25;
+        p[7] = pcr >> 17;
+        p[8] = pcr >> 9;
+        p[9] = pcr >> 1;
+        p[10] = (pcr & 1) << 7 | 0x7E;
+        p[11] = 0;
+    }
+
+    return ts;
+}
+
+class AmlDVRTsIndexTest : public testing::Test
+{
+protected:
+    void SetUp() override {
+        char dir[256];
+        snprintf(dir, sizeof(dir), "%s/tsindexXXXXXX", kTmpDir);
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        mDir = dir;
+        mTsPath = mDir + "/seg.ts";
+        mIndexPath = mDir + "/seg.tsidx";
+    }
+
+    void TearDown() override {
+        unlink(mTsPath.c_str());
+        unlink(mIndexPath.c_str());
+        rmdir(mDir.c_str());
+    }
+
+    void writeTs(const std::vector<uint8_t>& ts) {
+        FILE* fp = fopen(mTsPath.c_str(), "wb");
+        ASSERT_NE(fp, nullptr);
+        ASSERT_EQ(fwrite(ts.data(), 1, ts.size(), fp), ts.size());
+        fclose(fp);
+    }
+
+    std::string mDir;
+    std::string mTsPath;
+    std::string mIndexPath;
+};
+
+TEST_F(AmlDVRTsIndexTest, BuildAndLookup)
+{
+    // 400ms and 1100ms are too close to the previous random access point.
+    writeTs(makeTs({0, 20, 50, 55, 80}));
+    ASSERT_EQ(AmlDVRTsIndexBuilder::BuildFile(mTsPath.c_str(), mIndexPath.c_str(), 500), 0);
+
+    AmlDVRTsIndexFile index;
+    ASSERT_EQ(index.open(mIndexPath.c_str()), 0);
+    EXPECT_EQ(index.videoPid(), 0x1FFF);
+
+    struct {
+        uint32_t timeMs;
+        uint32_t flags;
+        int packet;
+    } expected[] = {
+        {0, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START, 0},
+        {500, 0, 25},
+        {1000, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START, 50},
+        {1500, 0, 75},
+        {1600, AML_DVR_TS_INDEX_RANDOM_ACCESS | AML_DVR_TS_INDEX_PES_START, 80},
+    };
+    ASSERT_EQ(index.count(), sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < index.count(); ++i) {
+        EXPECT_EQ(index.at(i).timeMs, expected[i].timeMs) << i;
+        EXPECT_EQ(index.at(i).flags, expected[i].flags) << i;
+        EXPECT_EQ(index.at(i).offset, 188u * expected[i].packet) << i;
+    }
+
+    EXPECT_EQ(index.findBefore(1200, AML_DVR_TS_INDEX_RANDOM_ACCESS), 2);
+    EXPECT_EQ(index.findBefore(1000, AML_DVR_TS_INDEX_RANDOM_ACCESS), 2);
+    EXPECT_EQ(index.findBefore(999, AML_DVR_TS_INDEX_RANDOM_ACCESS), 0);
+    EXPECT_EQ(index.findBefore(1200, 0), 2);
+    EXPECT_EQ(index.findAfter(1001, AML_DVR_TS_INDEX_RANDOM_ACCESS), 4);
+    EXPECT_EQ(index.findAfter(1001, 0), 3);
+    EXPECT_EQ(index.findAfter(1700, AML_DVR_TS_INDEX_RANDOM_ACCESS), -1);
+    EXPECT_EQ(index.findAfter(0, AML_DVR_TS_INDEX_KEYFRAME), -1);
+}
+
+TEST_F(AmlDVRTsIndexTest, FeedInPieces)
+{
+    std::vector<uint8_t> ts = makeTs({0, 50});
+    std::vector<uint8_t> noisy(ts.begin(), ts.begin() + 188 * 30);
+    // garbage before a packet is skipped without losing the offsets after it.
+    noisy.insert(noisy.end(), {0x00, 0x11, 0x22});
+    noisy.insert(noisy.end(), ts.begin() + 188 * 30, ts.end());
+
+    AmlDVRTsIndexBuilder builder(500);
+    ASSERT_EQ(builder.open(mIndexPath.c_str()), 0);
+    // split packets across feeds.
+    for (size_t pos = 0; pos < noisy.size(); pos += 100) {
+        builder.feed(noisy.data() + pos, std::min<size_t>(100, noisy.size() - pos));
+    }
+    EXPECT_EQ(builder.offset(), noisy.size());
+    EXPECT_EQ(builder.flush(), 0);
+
+    // the readers see the entries flushed so far.
+    AmlDVRTsIndexFile index;
+    ASSERT_EQ(index.open(mIndexPath.c_str()), 0);
+    EXPECT_EQ(index.count(), builder.entryCount());
+    builder.close();
+    EXPECT_EQ(index.refresh(), builder.entryCount());
+
+    ssize_t rap = index.findBefore(1500, AML_DVR_TS_INDEX_RANDOM_ACCESS);
+    ASSERT_EQ(rap, 2);
+    EXPECT_EQ(index.at(rap).timeMs, 1000u);
+    EXPECT_EQ(index.at(rap).offset, 188u * 50 + 3);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: AmlMpArena budget tests.
+ */
+
+#include <utils/AmlMpArena.h>
+#include <utils/AmlMpBuffer.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+using namespace aml_mp;
+
+// far from the demux and player ids used by the library.
+static const int kOwner = 0x7A3E0001;
+
+TEST(AmlMpArenaTest, RejectsOverBudget)
+{
+    AmlMpArena& arena = AmlMpArena::instance();
+    arena.setBudget(kOwner, 4096);
+
+    // sizes are rounded up to the alignment.
+    void* a = arena.alloc(1000, kOwner);
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(arena.usage(kOwner), 1024u);
+    memset(a, 0x47, 1000);
+
+    void* b = arena.alloc(3000, kOwner);
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(arena.usage(kOwner), 1024u + 3008u);
+
+    // 64 bytes left.
+    EXPECT_EQ(arena.alloc(65, kOwner), nullptr);
+    EXPECT_EQ(AmlMpBuffer::CreateFromArena(128, kOwner), nullptr);
+    EXPECT_EQ(arena.usage(kOwner), 1024u + 3008u);
+
+    void* c = arena.alloc(64, kOwner);
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(arena.usage(kOwner), 4096u);
+
+    // freeing gives the budget back.
+    arena.free(b);
+    EXPECT_EQ(arena.usage(kOwner), 1024u + 64u);
+    b = arena.alloc(3000, kOwner);
+    ASSERT_NE(b, nullptr);
+
+    // other owners are not limited by it.
+    void* shared = arena.alloc(8192);
+    ASSERT_NE(shared, nullptr);
+    arena.free(shared);
+
+    arena.free(a);
+    arena.free(b);
+    arena.free(c);
+    EXPECT_EQ(arena.usage(kOwner), 0u);
+    arena.releaseOwner(kOwner);
+}
+
+TEST(AmlMpArenaTest, BufferReturnsToArena)
+{
+    AmlMpArena& arena = AmlMpArena::instance();
+    arena.setBudget(kOwner + 1, 188 * 1024);
+
+    {
+        sptr<AmlMpBuffer> buffer = AmlMpBuffer::CreateFromArena(188 * 512, kOwner + 1);
+        ASSERT_NE(buffer, nullptr);
+        EXPECT_EQ(buffer->capacity(), 188u * 512);
+        EXPECT_EQ(arena.usage(kOwner + 1), 188u * 512);
+
+        // a slice holds the region, not a budget of its own.
+        sptr<AmlMpBuffer> slice = AmlMpBuffer::CreateSlice(buffer, 188, 188);
+        buffer.clear();
+        EXPECT_EQ(arena.usage(kOwner + 1), 188u * 512);
+        EXPECT_EQ(AmlMpBuffer::CreateFromArena(188 * 512 + 64, kOwner + 1), nullptr);
+    }
+
+    EXPECT_EQ(arena.usage(kOwner + 1), 0u);
+    sptr<AmlMpBuffer> buffer = AmlMpBuffer::CreateFromArena(188 * 1024, kOwner + 1);
+    EXPECT_NE(buffer, nullptr);
+    buffer.clear();
+
+    // released owners forget their budget once drained.
+    arena.releaseOwner(kOwner + 1);
+    void* p = arena.alloc(188 * 2048, kOwner + 1);
+    EXPECT_NE(p, nullptr);
+    arena.free(p);
+    arena.releaseOwner(kOwner + 1);
+}
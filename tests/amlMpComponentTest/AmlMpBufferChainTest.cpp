@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: AmlMpBuffer slice and AmlMpBufferChain tests.
+ */
+
+#include <utils/AmlMpBuffer.h>
+#include <utils/AmlMpBufferChain.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+using namespace aml_mp;
+
+static sptr<AmlMpBuffer> makeBuffer(size_t size, uint8_t first)
+{
+    sptr<AmlMpBuffer> buffer = new AmlMpBuffer(size);
+    for (size_t i = 0; i < size; ++i) {
+        buffer->base()[i] = (uint8_t)(first + i);
+    }
+
+    return buffer;
+}
+
+TEST(AmlMpBufferChainTest, SliceSharesStorage)
+{
+    sptr<AmlMpBuffer> parent = makeBuffer(256, 0);
+    sptr<AmlMpBuffer> slice = AmlMpBuffer::CreateSlice(parent, 16, 32);
+    ASSERT_NE(slice, nullptr);
+    EXPECT_TRUE(slice->isSlice());
+    EXPECT_EQ(slice->data(), parent->base() + 16);
+    EXPECT_EQ(slice->size(), 32u);
+
+    // a slice of a slice references the root buffer.
+    sptr<AmlMpBuffer> inner = AmlMpBuffer::CreateSlice(slice, 8, 8);
+    ASSERT_NE(inner, nullptr);
+    EXPECT_EQ(inner->data(), parent->base() + 24);
+    EXPECT_EQ(parent->getStrongCount(), 3);
+    EXPECT_EQ(slice->getStrongCount(), 1);
+
+    // the ranges are independent.
+    slice->setRange(4, 4);
+    EXPECT_EQ(parent->offset(), 0u);
+    EXPECT_EQ(parent->size(), 256u);
+    EXPECT_EQ(inner->data()[0], 24);
+
+    // the slices keep the storage alive.
+    AmlMpBuffer* root = parent.get();
+    parent.clear();
+    EXPECT_EQ(root->getStrongCount(), 2);
+    EXPECT_EQ(inner->data()[7], 31);
+
+    EXPECT_EQ(AmlMpBuffer::CreateSlice(inner, 4, 8), nullptr);
+}
+
+TEST(AmlMpBufferChainTest, AppendAndConsume)
+{
+    sptr<AmlMpBuffer> a = makeBuffer(100, 0);
+    sptr<AmlMpBuffer> b = makeBuffer(50, 100);
+    uint8_t borrowed[30];
+    for (size_t i = 0; i < sizeof(borrowed); ++i) {
+        borrowed[i] = (uint8_t)(150 + i);
+    }
+
+    AmlMpBufferChain chain;
+    chain.append(a, 0, 40);
+    // contiguous with the previous segment of the same buffer, merged.
+    chain.append(a, 40, 60);
+    chain.append(b);
+    chain.appendBorrowed(borrowed, sizeof(borrowed));
+    // out of range, ignored.
+    chain.append(b, 40, 20);
+
+    EXPECT_EQ(chain.size(), 180u);
+    ASSERT_EQ(chain.segmentCount(), 3u);
+    EXPECT_EQ(chain.segmentAt(0).size, 100u);
+    EXPECT_EQ(chain.segmentAt(0).data, a->data());
+    EXPECT_EQ(chain.segmentAt(1).data, b->data());
+    EXPECT_EQ(chain.segmentAt(2).owner, nullptr);
+
+    std::vector<uint8_t> out(chain.size());
+    EXPECT_EQ(chain.copyTo(out.data(), out.size()), out.size());
+    for (size_t i = 0; i < out.size(); ++i) {
+        ASSERT_EQ(out[i], (uint8_t)i);
+    }
+
+    // a copy across the segment boundaries.
+    uint8_t window[70];
+    EXPECT_EQ(chain.copyTo(window, sizeof(window), 90), sizeof(window));
+    EXPECT_EQ(window[0], 90);
+    EXPECT_EQ(window[69], 159);
+
+    // consuming into the middle of a segment moves its start.
+    EXPECT_EQ(chain.consume(120), 120u);
+    EXPECT_EQ(chain.size(), 60u);
+    ASSERT_EQ(chain.segmentCount(), 2u);
+    EXPECT_EQ(chain.segmentAt(0).data, b->data() + 20);
+    EXPECT_EQ(chain.segmentAt(0).size, 30u);
+
+    struct iovec iov[4];
+    ASSERT_EQ(chain.toIovec(iov, 4), 2);
+    EXPECT_EQ(iov[0].iov_len, 30u);
+    EXPECT_EQ(iov[1].iov_base, (void*)borrowed);
+    EXPECT_EQ(chain.toIovec(iov, 1), 1);
+
+    EXPECT_EQ(chain.consume(100), 60u);
+    EXPECT_TRUE(chain.empty());
+    EXPECT_EQ(chain.segmentCount(), 0u);
+}
+
+TEST(AmlMpBufferChainTest, FlattenSlicesASingleSegment)
+{
+    sptr<AmlMpBuffer> a = makeBuffer(188 * 4, 0);
+
+    // one owned segment comes back as a slice, no copy.
+    AmlMpBufferChain chain;
+    chain.append(a, 188, 188 * 2);
+    sptr<AmlMpBuffer> flat = chain.flatten();
+    ASSERT_NE(flat, nullptr);
+    EXPECT_TRUE(flat->isSlice());
+    EXPECT_EQ(flat->data(), a->data() + 188);
+    EXPECT_EQ(flat->size(), 188u * 2);
+
+    // several segments are copied.
+    sptr<AmlMpBuffer> b = makeBuffer(188, 0x47);
+    chain.append(b);
+    flat = chain.flatten();
+    ASSERT_NE(flat, nullptr);
+    EXPECT_FALSE(flat->isSlice());
+    ASSERT_EQ(flat->size(), 188u * 3);
+    EXPECT_EQ(memcmp(flat->data(), a->data() + 188, 188 * 2), 0);
+    EXPECT_EQ(memcmp(flat->data() + 188 * 2, b->data(), 188), 0);
+
+    // moving hands the segments over.
+    AmlMpBufferChain moved(std::move(chain));
+    EXPECT_TRUE(chain.empty());
+    EXPECT_EQ(moved.size(), 188u * 3);
+}
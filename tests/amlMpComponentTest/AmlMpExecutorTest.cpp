@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: AmlMpExecutor strand tests.
+ */
+
+#include <utils/AmlMpExecutor.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace aml_mp;
+
+static const int kTasks = 2000;
+static const int kPosters = 4;
+
+// every task posted before it has run when this returns.
+static bool waitIdle(const sptr<AmlMpExecutor::Strand>& strand)
+{
+    std::promise<void> done;
+    strand->post([&done] { done.set_value(); });
+
+    return done.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+}
+
+TEST(AmlMpExecutorTest, StrandRunsInPostingOrder)
+{
+    sptr<AmlMpExecutor::Strand> strand = AmlMpExecutor::instance().createStrand("order");
+
+    // each poster's tasks keep its order, whichever worker runs them.
+    std::vector<int> seen[kPosters];
+    std::vector<std::thread> posters;
+    for (int p = 0; p < kPosters; ++p) {
+        posters.emplace_back([&, p] {
+            for (int i = 0; i < kTasks; ++i) {
+                strand->post([&seen, p, i] { seen[p].push_back(i); });
+            }
+        });
+    }
+    for (auto& t : posters) {
+        t.join();
+    }
+    ASSERT_TRUE(waitIdle(strand));
+
+    for (int p = 0; p < kPosters; ++p) {
+        ASSERT_EQ(seen[p].size(), (size_t)kTasks);
+        for (int i = 0; i < kTasks; ++i) {
+            EXPECT_EQ(seen[p][i], i);
+        }
+    }
+
+    strand->shutdown();
+}
+
+TEST(AmlMpExecutorTest, StrandNeverRunsConcurrently)
+{
+    // more strands than workers, so the workers are shared.
+    size_t strandCount = AmlMpExecutor::instance().workerCount() * 2 + 1;
+    std::vector<sptr<AmlMpExecutor::Strand>> strands;
+    std::vector<std::atomic<int>> running(strandCount);
+    std::atomic<int> overlaps{0};
+    std::atomic<int> maxRunning{0};
+    std::atomic<int> totalRunning{0};
+
+    for (size_t s = 0; s < strandCount; ++s) {
+        strands.push_back(AmlMpExecutor::instance().createStrand("concurrency"));
+        running[s] = 0;
+    }
+
+    for (int i = 0; i < kTasks; ++i) {
+        for (size_t s = 0; s < strandCount; ++s) {
+            strands[s]->post([&, s, i] {
+                if (running[s].fetch_add(1) != 0) {
+                    overlaps++;
+                }
+                int total = ++totalRunning;
+                int max = maxRunning;
+                while (total > max && !maxRunning.compare_exchange_weak(max, total)) {
+                }
+                if (i % 64 == 0) {
+                    usleep(100);
+                }
+                totalRunning--;
+                running[s].fetch_sub(1);
+            });
+        }
+    }
+
+    for (auto& strand : strands) {
+        ASSERT_TRUE(waitIdle(strand));
+    }
+
+    EXPECT_EQ(overlaps, 0);
+    // strands don't hold on to a worker, and there are never more than workers.
+    EXPECT_LE(maxRunning, (int)AmlMpExecutor::instance().workerCount());
+
+    for (auto& strand : strands) {
+        strand->shutdown();
+    }
+}
+
+TEST(AmlMpExecutorTest, DelayedTasksKeepOrder)
+{
+    sptr<AmlMpExecutor::Strand> strand = AmlMpExecutor::instance().createStrand("delay");
+
+    std::vector<int> seen;
+    std::promise<void> done;
+    strand->post([&] { seen.push_back(2); }, 20 * 1000);
+    strand->post([&] { seen.push_back(3); }, 20 * 1000);
+    strand->post([&] { seen.push_back(1); });
+    strand->post([&] { done.set_value(); }, 40 * 1000);
+    ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+
+    EXPECT_EQ(seen, std::vector<int>({1, 2, 3}));
+
+    strand->shutdown();
+}
+
+TEST(AmlMpExecutorTest, ShutdownDropsPendingTasks)
+{
+    sptr<AmlMpExecutor::Strand> strand = AmlMpExecutor::instance().createStrand("shutdown");
+
+    std::promise<void> started;
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    strand->post([&] {
+        started.set_value();
+        while (!release) {
+            usleep(1000);
+        }
+    });
+    for (int i = 0; i < 100; ++i) {
+        strand->post([&ran] { ran++; });
+    }
+    ASSERT_EQ(started.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+
+    // shutdown() waits for the running task, the queued ones are dropped.
+    std::thread releaser([&release] {
+        usleep(20 * 1000);
+        release = true;
+    });
+    strand->shutdown();
+    EXPECT_TRUE(release);
+    releaser.join();
+
+    strand->post([&ran] { ran++; });
+    usleep(20 * 1000);
+    EXPECT_EQ(ran, 0);
+}
@@ -0,0 +1,34 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := amlMpComponentTest
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-FTL SPDX-license-identifier-GPL SPDX-license-identifier-LGPL-2.1 SPDX-license-identifier-MIT legacy_by_exception_only legacy_notice
+LOCAL_LICENSE_CONDITIONS := by_exception_only notice restricted
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../LICENSE
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+    AmlMpExecutorTest.cpp \
+    AmlMpBufferChainTest.cpp \
+    AmlMpArenaTest.cpp \
+    AmlDVRTsIndexTest.cpp \
+    AmlDVRTimeshiftRingTest.cpp
+
+LOCAL_CFLAGS := -DANDROID_PLATFORM_SDK_VERSION=$(PLATFORM_SDK_VERSION)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../..
+LOCAL_SHARED_LIBRARIES := libutils \
+    libcutils \
+    liblog \
+    libaml_mp_sdk
+
+ifeq (1, $(shell expr $(PLATFORM_SDK_VERSION) \>= 30))
+LOCAL_SHARED_LIBRARIES += libamdvr.system
+else
+LOCAL_SHARED_LIBRARIES += libamdvr.product
+endif
+
+LOCAL_STATIC_LIBRARIES := libgtest libgtest_main
+
+ifeq (1, $(shell expr $(PLATFORM_SDK_VERSION) \>= 30))
+LOCAL_SYSTEM_EXT_MODULE := true
+endif
+include $(BUILD_EXECUTABLE)
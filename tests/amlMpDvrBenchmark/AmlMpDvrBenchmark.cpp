@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description: DVR record/playback throughput without a tuner.
+ *
+ * A local TS capture is fed through a software stand-in of the recorder data
+ * path: PID filtering, the crypto callback run by AmlDVRCryptoPipeline and
+ * segment writing. The segments are then read back through the playback
+ * inject path, decrypted, and written to a null sink that only checks packet
+ * sync. Several recordings can run at once to size a box.
+ */
+
+#define LOG_TAG "AmlMpDvrBenchmark"
+#include <utils/AmlMpLog.h>
+#include <utils/AmlMpConfig.h>
+#include <utils/AmlMpUtils.h>
+#include <dvr/AmlDVRCryptoPipeline.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* mName = LOG_TAG;
+using namespace aml_mp;
+
+static const size_t kTsPacketSize = 188;
+// capture kept in memory, the input file is looped.
+static const size_t kMaxCaptureSize = 256 * 1024 * 1024;
+static const int64_t kStallUs = 100 * 1000;
+
+struct Argument
+{
+    std::string input;
+    std::string output = "/data/local/tmp/dvrbench";
+    int64_t recordSize = 512LL * 1024 * 1024;
+    int64_t segmentSize = 100LL * 1024 * 1024;
+    int64_t syncInterval = 0;
+    size_t blockSize = 188 * 4096;
+    int instances = 1;
+    bool crypto = false;
+    bool preallocate = false;
+    bool writeThrough = false;
+    bool keep = false;
+    std::set<int> pids;
+};
+
+struct Stats
+{
+    uint64_t bytes = 0;
+    std::vector<uint32_t> latencyUs;
+    uint32_t syncs = 0;
+    uint32_t stalls = 0;
+    int64_t maxSyncUs = 0;
+    uint64_t badPackets = 0;
+
+    void merge(const Stats& other) {
+        bytes += other.bytes;
+        latencyUs.insert(latencyUs.end(), other.latencyUs.begin(), other.latencyUs.end());
+        syncs += other.syncs;
+        stalls += other.stalls;
+        maxSyncUs = std::max(maxSyncUs, other.maxSyncUs);
+        badPackets += other.badPackets;
+    }
+};
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t cpuUs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec +
+           usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec;
+}
+
+static std::string segmentPath(const Argument& argument, int instance, int segmentId)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s%d-%04d.ts", argument.output.c_str(), instance, segmentId);
+    return path;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stand-in for the CAS DVR crypto: scrambles the payload of each TS packet, so
+// it is thread safe and works per packet like the real one. Its own inverse.
+static const uint8_t kKey = 0x5A;
+
+static int benchCrypto(Aml_MP_CASCryptoParams* params, void* userData)
+{
+    AML_MP_UNUSED(userData);
+
+    size_t size = params->inputBuffer.size / kTsPacketSize * kTsPacketSize;
+    const uint8_t* in = params->inputBuffer.address;
+    uint8_t* out = params->outputBuffer.address;
+
+    for (size_t i = 0; i < size; i += kTsPacketSize) {
+        memcpy(out + i, in + i, 4);
+        for (size_t j = 4; j < kTsPacketSize; ++j) {
+            out[i + j] = in[i + j] ^ kKey;
+        }
+    }
+    params->outputSize = size;
+
+    return 0;
+}
+
+static int runCrypto(AmlDVRCryptoPipeline* pipeline, Aml_MP_CASCryptoType type,
+        uint8_t* in, uint8_t* out, size_t size, int segmentId, int64_t offset)
+{
+    Aml_MP_CASCryptoParams params{};
+    params.type = type;
+    params.segmentId = segmentId;
+    params.offset = offset;
+    params.inputBuffer.address = in;
+    params.inputBuffer.size = size;
+    params.outputBuffer.address = out;
+    params.outputBuffer.size = size;
+
+    int ret = AmlDVRCryptoPipeline::process(&params, pipeline);
+    return ret < 0 ? ret : (int)params.outputSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int loadCapture(const std::string& path, std::vector<uint8_t>* capture)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("open %s failed, %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    capture->resize(kMaxCaptureSize);
+    size_t size = 0;
+    ssize_t len;
+    while (size < capture->size() && (len = read(fd, capture->data() + size, capture->size() - size)) > 0) {
+        size += len;
+    }
+    ::close(fd);
+
+    // start on a sync byte, end on a whole packet.
+    size_t start = 0;
+    while (start + kTsPacketSize < size &&
+           ((*capture)[start] != 0x47 || (*capture)[start + kTsPacketSize] != 0x47)) {
+        start++;
+    }
+    size = start + (size - start) / kTsPacketSize * kTsPacketSize;
+    capture->erase(capture->begin() + size, capture->end());
+    capture->erase(capture->begin(), capture->begin() + start);
+
+    if (capture->empty()) {
+        printf("no TS packets in %s\n", path.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool syncSegment(int fd, const Argument& argument, int64_t from, int64_t to, Stats* stats)
+{
+    int64_t startUs = nowUs();
+    int ret;
+    if (argument.writeThrough) {
+        ret = sync_file_range(fd, from, to - from,
+                SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    } else {
+        ret = fdatasync(fd);
+    }
+    int64_t syncUs = nowUs() - startUs;
+
+    // playback has to read from the disk, not from the cache.
+    posix_fadvise(fd, from, to - from, POSIX_FADV_DONTNEED);
+
+    stats->syncs++;
+    stats->maxSyncUs = std::max(stats->maxSyncUs, syncUs);
+    if (syncUs > kStallUs) {
+        stats->stalls++;
+    }
+
+    return ret == 0;
+}
+
+static void recordInstance(const Argument& argument, const std::vector<uint8_t>& capture, int instance,
+        Stats* stats, int* segments)
+{
+    std::unique_ptr<AmlDVRCryptoPipeline> pipeline;
+    if (argument.crypto) {
+        pipeline.reset(new AmlDVRCryptoPipeline(benchCrypto, nullptr));
+    }
+
+    std::vector<uint8_t> block(argument.blockSize);
+    std::vector<uint8_t> encrypted(argument.blockSize);
+    // instances start at different places of the capture.
+    size_t readPos = capture.size() / kTsPacketSize * instance / std::max(argument.instances, 1) * kTsPacketSize;
+    int segmentId = 0;
+    int fd = -1;
+    int64_t segmentOffset = 0;
+    int64_t syncedOffset = 0;
+
+    while ((int64_t)stats->bytes < argument.recordSize) {
+        int64_t startUs = nowUs();
+
+        // demux: keep the filtered PIDs.
+        size_t blockLen = 0;
+        size_t scanned = 0;
+        while (blockLen < block.size()) {
+            if (scanned++ == capture.size() / kTsPacketSize && blockLen == 0) {
+                break;
+            }
+            const uint8_t* packet = capture.data() + readPos;
+            int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+            if (argument.pids.empty() ? pid != 0x1FFF : argument.pids.count(pid) != 0) {
+                memcpy(block.data() + blockLen, packet, kTsPacketSize);
+                blockLen += kTsPacketSize;
+            }
+            readPos += kTsPacketSize;
+            if (readPos >= capture.size()) {
+                readPos = 0;
+            }
+        }
+
+        if (blockLen == 0) {
+            printf("none of the PIDs in the capture!\n");
+            break;
+        }
+
+        const uint8_t* data = block.data();
+        if (pipeline != nullptr) {
+            int len = runCrypto(pipeline.get(), AML_MP_CAS_ENCRYPT, block.data(), encrypted.data(), blockLen, segmentId, segmentOffset);
+            if (len < 0) {
+                printf("encrypt failed!\n");
+                break;
+            }
+            data = encrypted.data();
+            blockLen = len;
+        }
+
+        if (fd < 0) {
+            fd = ::open(segmentPath(argument, instance, segmentId).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                printf("open segment failed, %s\n", strerror(errno));
+                break;
+            }
+            if (argument.preallocate && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, argument.segmentSize) < 0) {
+                MLOGW("fallocate failed, %s", strerror(errno));
+            }
+            segmentOffset = 0;
+            syncedOffset = 0;
+        }
+
+        if (write(fd, data, blockLen) != (ssize_t)blockLen) {
+            printf("write failed, %s\n", strerror(errno));
+            break;
+        }
+        segmentOffset += blockLen;
+        stats->bytes += blockLen;
+
+        if (argument.writeThrough || (argument.syncInterval > 0 && segmentOffset - syncedOffset >= argument.syncInterval)) {
+            syncSegment(fd, argument, syncedOffset, segmentOffset, stats);
+            syncedOffset = segmentOffset;
+        }
+
+        stats->latencyUs.push_back(nowUs() - startUs);
+
+        if (segmentOffset >= argument.segmentSize || (int64_t)stats->bytes >= argument.recordSize) {
+            syncSegment(fd, argument, syncedOffset, segmentOffset, stats);
+            if (argument.preallocate) {
+                ftruncate(fd, segmentOffset);
+            }
+            ::close(fd);
+            fd = -1;
+            segmentId++;
+        }
+    }
+
+    if (fd >= 0) {
+        ::close(fd);
+        segmentId++;
+    }
+    *segments = segmentId;
+}
+
+static void playbackInstance(const Argument& argument, int instance, int segments, Stats* stats)
+{
+    std::unique_ptr<AmlDVRCryptoPipeline> pipeline;
+    if (argument.crypto) {
+        pipeline.reset(new AmlDVRCryptoPipeline(benchCrypto, nullptr));
+    }
+
+    std::vector<uint8_t> block(argument.blockSize);
+    std::vector<uint8_t> decrypted(argument.blockSize);
+
+    for (int segmentId = 0; segmentId < segments; ++segmentId) {
+        int fd = ::open(segmentPath(argument, instance, segmentId).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            printf("open segment failed, %s\n", strerror(errno));
+            return;
+        }
+
+        int64_t offset = 0;
+        for (;;) {
+            int64_t startUs = nowUs();
+            ssize_t len = read(fd, block.data(), block.size());
+            if (len <= 0) {
+                break;
+            }
+
+            const uint8_t* data = block.data();
+            if (pipeline != nullptr) {
+                len = runCrypto(pipeline.get(), AML_MP_CAS_DECRYPT, block.data(), decrypted.data(), len, segmentId, offset);
+                if (len < 0) {
+                    printf("decrypt failed!\n");
+                    break;
+                }
+                data = decrypted.data();
+            }
+
+            // null sink: what the TsPlayer would get is only checked for sync.
+            for (ssize_t i = 0; i < len; i += kTsPacketSize) {
+                if (data[i] != 0x47) {
+                    stats->badPackets++;
+                }
+            }
+
+            offset += len;
+            stats->bytes += len;
+            stats->latencyUs.push_back(nowUs() - startUs);
+        }
+
+        ::close(fd);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void report(const char* phase, const Argument& argument, const Stats& stats, int64_t elapsedUs, int64_t cpuTimeUs)
+{
+    std::vector<uint32_t> latency = stats.latencyUs;
+    std::sort(latency.begin(), latency.end());
+    uint64_t sum = 0;
+    for (uint32_t l : latency) {
+        sum += l;
+    }
+    uint32_t avg = latency.empty() ? 0 : sum / latency.size();
+    uint32_t p99 = latency.empty() ? 0 : latency[latency.size() * 99 / 100];
+    uint32_t max = latency.empty() ? 0 : latency.back();
+
+    double seconds = elapsedUs / 1e6;
+    double mbits = stats.bytes * 8 / 1e6;
+
+    printf("%s: %d x %.1f MB in %.2f s, %.1f MB/s\n", phase, argument.instances,
+            stats.bytes / 1048576.0 / argument.instances, seconds, seconds > 0 ? stats.bytes / 1048576.0 / seconds : 0);
+    printf("    block %zu KB latency: avg %u us, p99 %u us, max %u us\n", argument.blockSize / 1024, avg, p99, max);
+    if (stats.syncs > 0) {
+        printf("    syncs: %u, stalls over %" PRId64 " ms: %u, longest %" PRId64 " ms\n",
+                stats.syncs, kStallUs / 1000, stats.stalls, stats.maxSyncUs / 1000);
+    }
+    if (stats.badPackets > 0) {
+        printf("    packets out of sync: %" PRIu64 "\n", stats.badPackets);
+    }
+    printf("    cpu: %.3f ms per Mbit, load %.1f%%\n", mbits > 0 ? cpuTimeUs / 1000.0 / mbits : 0,
+            elapsedUs > 0 ? cpuTimeUs * 100.0 / elapsedUs : 0);
+}
+
+static int parseCommandArgs(int argc, char* argv[], Argument* argument)
+{
+    static const struct option longopts[] = {
+        {"help",        no_argument,        nullptr, 'h'},
+        {"output",      required_argument,  nullptr, 'o'},
+        {"size",        required_argument,  nullptr, 's'},
+        {"segment",     required_argument,  nullptr, 'g'},
+        {"sync",        required_argument,  nullptr, 'y'},
+        {"block",       required_argument,  nullptr, 'b'},
+        {"instances",   required_argument,  nullptr, 'n'},
+        {"pids",        required_argument,  nullptr, 'p'},
+        {"crypto",      no_argument,        nullptr, 'c'},
+        {"preallocate", no_argument,        nullptr, 'a'},
+        {"write-through", no_argument,      nullptr, 'd'},
+        {"keep",        no_argument,        nullptr, 'k'},
+        {nullptr,       no_argument,        nullptr, 0},
+    };
+
+    int opt, longindex;
+    while ((opt = getopt_long(argc, argv, "", longopts, &longindex)) != -1) {
+        switch (opt) {
+        case 'o':
+            argument->output = optarg;
+            break;
+
+        case 's':
+            argument->recordSize = strtoll(optarg, nullptr, 0) * 1024 * 1024;
+            break;
+
+        case 'g':
+            argument->segmentSize = strtoll(optarg, nullptr, 0) * 1024 * 1024;
+            break;
+
+        case 'y':
+            argument->syncInterval = strtoll(optarg, nullptr, 0) * 1024 * 1024;
+            break;
+
+        case 'b':
+        {
+            size_t kb = strtoul(optarg, nullptr, 0);
+            argument->blockSize = std::max(kb * 1024 / kTsPacketSize, (size_t)1) * kTsPacketSize;
+        }
+        break;
+
+        case 'n':
+            argument->instances = std::max((int)strtol(optarg, nullptr, 0), 1);
+            break;
+
+        case 'p':
+        {
+            char* p = optarg;
+            while (*p) {
+                char* end;
+                long pid = strtol(p, &end, 0);
+                if (end == p) {
+                    printf("parse %s failed! %s\n", longopts[longindex].name, optarg);
+                    return -1;
+                }
+                argument->pids.insert(pid);
+                p = *end == ',' ? end + 1 : end;
+            }
+        }
+        break;
+
+        case 'c':
+            argument->crypto = true;
+            break;
+
+        case 'a':
+            argument->preallocate = true;
+            break;
+
+        case 'd':
+            argument->writeThrough = true;
+            break;
+
+        case 'k':
+            argument->keep = true;
+            break;
+
+        case 'h':
+        default:
+            return -1;
+        }
+    }
+
+    if (optind < argc) {
+        argument->input = argv[argc-1];
+    }
+
+    return 0;
+}
+
+static void showUsage()
+{
+    printf("Usage: amlMpDvrBenchmark <options> <ts file>\n"
+            "options:\n"
+            "    --output:      segment location prefix, default /data/local/tmp/dvrbench\n"
+            "    --size:        MB recorded per instance, default 512\n"
+            "    --segment:     segment size in MB, default 100\n"
+            "    --sync:        fdatasync every this many MB, default 0: at segment end only\n"
+            "    --block:       record/inject block in KB, default 752\n"
+            "    --instances:   concurrent recordings, default 1\n"
+            "    --pids:        recorded PIDs, eg: 0,0x100,0x101, default all but null packets\n"
+            "    --crypto       run the crypto callback, vendor.amlmp.dvr-crypto-threads workers\n"
+            "    --preallocate  fallocate each segment, like AML_MP_DVRRECORDER_PREALLOCATE\n"
+            "    --write-through write back each block, like AML_MP_DVRRECORDER_WRITE_THROUGH\n"
+            "    --keep         keep the segments\n"
+            "\n"
+            );
+}
+
+int main(int argc, char *argv[])
+{
+    Argument argument;
+
+    if (parseCommandArgs(argc, argv, &argument) < 0 || argument.input.empty()) {
+        showUsage();
+        return 0;
+    }
+
+    std::vector<uint8_t> capture;
+    if (loadCapture(argument.input, &capture) < 0) {
+        return -1;
+    }
+    printf("capture: %zu packets, block %zu bytes, crypto workers %d\n", capture.size() / kTsPacketSize,
+            argument.blockSize, argument.crypto ? AmlMpConfig::instance().mDvrCryptoThreads : 0);
+
+    // record
+    std::vector<Stats> stats(argument.instances);
+    std::vector<int> segments(argument.instances);
+    std::vector<std::thread> threads;
+    int64_t startUs = nowUs();
+    int64_t startCpuUs = cpuUs();
+    for (int i = 0; i < argument.instances; ++i) {
+        threads.emplace_back(recordInstance, std::cref(argument), std::cref(capture), i, &stats[i], &segments[i]);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    Stats total;
+    for (auto& s : stats) {
+        total.merge(s);
+    }
+    report("record", argument, total, nowUs() - startUs, cpuUs() - startCpuUs);
+
+    // playback
+    threads.clear();
+    stats.assign(argument.instances, Stats());
+    startUs = nowUs();
+    startCpuUs = cpuUs();
+    for (int i = 0; i < argument.instances; ++i) {
+        threads.emplace_back(playbackInstance, std::cref(argument), i, segments[i], &stats[i]);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    total = Stats();
+    for (auto& s : stats) {
+        total.merge(s);
+    }
+    report("playback", argument, total, nowUs() - startUs, cpuUs() - startCpuUs);
+
+    if (!argument.keep) {
+        for (int i = 0; i < argument.instances; ++i) {
+            for (int segmentId = 0; segmentId < segments[i]; ++segmentId) {
+                unlink(segmentPath(argument, i, segmentId).c_str());
+            }
+        }
+    }
+
+    return 0;
+}
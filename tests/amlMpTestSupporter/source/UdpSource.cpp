@@ -15,7 +15,6 @@
 #include <netdb.h>
 #include <errno.h>
 #include <netinet/in.h>
-#include <utils/Looper.h>
 #include <cutils/properties.h>
 #include <utils/AmlMpEventLooper.h>
 #include <fcntl.h>
@@ -100,6 +99,11 @@ int UdpSource::initCheck()
 
 int UdpSource::start()
 {
+    if (mFifo.initCheck() < 0) {
+        MLOGE("fifo init failed!");
+        return -1;
+    }
+
     mSocket = ::socket(mAddrInfo->ai_family, mAddrInfo->ai_socktype, mAddrInfo->ai_protocol);
     if (mSocket < 0) {
         MLOGE("create socket failed! %s", strerror(errno));
@@ -169,12 +173,6 @@ int UdpSource::start()
         MLOGE("join multicast success!\n");
     }
 
-    mLooper = new Looper(Looper::PREPARE_ALLOW_NON_CALLBACKS);
-    if (mLooper == nullptr) {
-        MLOGE("create looper failed!");
-        return -1;
-    }
-
     bool enableDump = property_get_bool("vendor.amlmp.udpdump", false);
     if (enableDump) {
         mDumpFd = ::open("/data/aml_dump.ts", O_WRONLY | O_TRUNC | O_CREAT, 0666);
@@ -183,14 +181,22 @@ int UdpSource::start()
         }
     }
 
-    mReadThread = std::thread([this] {
-        readThreadLoop();
-    });
-
     mFeedThread = std::thread([this] {
         feedThreadLoop();
     });
 
+    mReadStrand = AmlMpExecutor::instance().createStrand("UdpSourceRead");
+
+    sptr<LooperCallback> callback = new SimpleLooperCallback([](int, int events, void* data) {
+        return static_cast<UdpSource*>(data)->onSocketEvent(events);
+    });
+
+    ret = mReadStrand->addFd(mSocket, Looper::EVENT_INPUT|Looper::EVENT_ERROR, callback, this);
+    if (ret != 1) {
+        MLOGE("addFd failed!");
+        return -1;
+    }
+
     return 0;
 }
 
@@ -198,9 +204,10 @@ int UdpSource::stop()
 {
     signalQuit();
 
-    MLOGI("join...");
-    if (mReadThread.joinable()) {
-        mReadThread.join();
+    MLOGI("shutdown...");
+    if (mReadStrand != nullptr) {
+        mReadStrand->shutdown();
+        mReadStrand.clear();
     }
 
     if (mFeedThread.joinable()) {
@@ -229,82 +236,66 @@ int UdpSource::stop()
 void UdpSource::signalQuit()
 {
     mRequestQuit = true;
-    if (mLooper) {
-        mLooper->wake();
+    if (mReadStrand != nullptr) {
+        mReadStrand->removeFd(mSocket);
     }
 
     MLOGI("sendFeedWorkCommand");
     sendFeedWorkCommand(kWorkQuit);
 }
 
-void UdpSource::readThreadLoop()
+int UdpSource::onSocketEvent(int events)
 {
-    int ret = 0;
-
-    if (mLooper == nullptr) {
-        MLOGE("looper is NULL!");
-        return;
+    if (mRequestQuit) {
+        MLOGE("Quit!");
+        return 0;
     }
-    Looper::setForThread(mLooper);
 
-    ret = mLooper->addFd(mSocket, SOCKET_FD_IDENTIFIER, Looper::EVENT_INPUT|Looper::EVENT_ERROR, nullptr, nullptr);
-    if (ret < 0) {
-        MLOGE("looper addFd failed!");
-        return;
+    if (events & Looper::EVENT_ERROR) {
+        MLOGE("error!");
+        return 0;
     }
 
-    for (;;) {
-        if (mRequestQuit) {
-            MLOGE("Quit!");
+    // drain what the socket has queued, then give the strand back to the executor.
+    for (int i = 0; i < kMaxReadsPerEvent; ++i) {
+        uint8_t buffer[4096];
+        uint8_t* pBuf = buffer;
+        int ret = recv(mSocket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            MLOGE("read failed! %s", strerror(errno));
+            return 0;
+        } else if (ret == 0) {
+            MLOGE("eof!");
             break;
         }
 
-        ret = mLooper->pollOnce(1000);
-        if (ret == Looper::POLL_WAKE) {
-            MLOGE("exit!");
-            break;
-        } else if (ret == Looper::POLL_ERROR) {
-            MLOGE("error!");
-            break;
-        } else if (ret >= 0) {
-            if (ret != SOCKET_FD_IDENTIFIER) {
+        doStatistic(ret);
+        if (mIsRTP) {
+            if (parseRtpPayload(pBuf, ret) < 0) {
                 continue;
             }
-
-            uint8_t buffer[4096];
-            uint8_t* pBuf = buffer;
-            ret = read(mSocket, buffer, sizeof(buffer));
-            if (ret < 0) {
-                MLOGE("read failed! %s", strerror(errno));
-                break;
-            } else if (ret == 0) {
-                MLOGE("eof!");
-            } else {
-                doStatistic(ret);
-                if (mIsRTP) {
-                    if (parseRtpPayload(pBuf, ret) < 0) {
-                        continue;
-                    }
-                }
-                MLOGV("udp write data:%d", ret);
-                if (mDumpFd >= 0) {
-                    if (::write(mDumpFd, pBuf, ret) != ret) {
-                        MLOGE("write dump file failed!");
-                    }
-                }
-
-                if (mFifo.put(pBuf, ret) != ret) {
-                    MLOGW("fifo full, reset!");
-                    mFifo.reset();
-                } else {
-                    //MLOGI("sendFeedWorkCommand kWorkFeedData");
-                    sendFeedWorkCommand(kWorkFeedData);
-                }
+        }
+        MLOGV("udp write data:%d", ret);
+        if (mDumpFd >= 0) {
+            if (::write(mDumpFd, pBuf, ret) != ret) {
+                MLOGE("write dump file failed!");
             }
         }
+
+        if (mFifo.put(pBuf, ret) != ret) {
+            MLOGW("fifo full, reset!");
+            mFifo.reset();
+        }
+    }
+
+    if (!mFifo.empty()) {
+        sendFeedWorkCommand(kWorkFeedData);
     }
 
-    MLOGI("UdpSource readThreadLoop exited!");
+    return 1;
 }
 
 void UdpSource::feedThreadLoop()
@@ -321,7 +312,6 @@ void UdpSource::feedThreadLoop()
             mFeedCond.wait(_l, [this, &work] { return (work = mFeedWork) != 0;});
         }
 
-        //MLOGI("feedWork = %#x", work);
         if (work & kWorkQuit) {
             MLOGI("quit feed thread!");
             signalFeedWorkDone(kWorkQuit);
@@ -329,13 +319,13 @@ void UdpSource::feedThreadLoop()
         }
 
         if (work & kWorkFeedData) {
-            if (mFifo.empty()) {
-                continue;
-            }
-
             len = mFifo.get(buffer.get(), bufferSize);
             if (len <= 0) {
-                signalFeedWorkDone(kWorkFeedData);
+                // the read strand may have put data since, don't lose its command.
+                std::lock_guard<std::mutex> _l(mFeedLock);
+                if (mFifo.empty()) {
+                    mFeedWork &= ~ kWorkFeedData;
+                }
             } else  {
                 receiver = sourceReceiver();
                 if (receiver != nullptr) {
@@ -12,11 +12,12 @@
 
 #include "Source.h"
 #include <string>
+#include <memory>
 #include <thread>
-#include <utils/AmlMpFifo.h>
-#include <utils/AmlMpLooper.h>
 #include <mutex>
 #include <condition_variable>
+#include <utils/AmlMpFifo.h>
+#include <utils/AmlMpExecutor.h>
 
 struct addrinfo;
 
@@ -34,7 +35,7 @@ public:
     virtual void signalQuit() override;
 
 private:
-    void readThreadLoop();
+    int onSocketEvent(int events);
     void feedThreadLoop();
     void doStatistic(int size);
     int parseRtpPayload(uint8_t*& buffer, int& size);
@@ -45,9 +46,10 @@ private:
     struct addrinfo* mAddrInfo = nullptr;
     bool mIsMultiCast = false;
     int mSocket = -1;
-    std::thread mReadThread;
-    sptr<Looper> mLooper;
+    sptr<AmlMpExecutor::Strand> mReadStrand;
 
+    // writeData may block, keep feeding on a thread of its own instead of
+    // holding an executor worker.
     std::thread mFeedThread;
     std::mutex mFeedLock;
     std::condition_variable mFeedCond;
@@ -70,7 +72,7 @@ private:
         mFeedWork &= ~ work;
     }
 
-    static const int SOCKET_FD_IDENTIFIER = 0x100;
+    static const int kMaxReadsPerEvent = 64;
 
     int mDumpFd = -1;
 
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlMpArena"
+#include "AmlMpLog.h"
+#include "AmlMpArena.h"
+#include "AmlMpConfig.h"
+#include "AmlMpMemoryTracker.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <iterator>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const size_t kHugePageSize = AmlMpArena::kSlabSize;
+// empty slabs and freed regions kept for reuse while other owners are alive.
+static const size_t kMaxCachedBytes = 8 * 1024 * 1024;
+
+AmlMpArena& AmlMpArena::instance()
+{
+    static AmlMpArena* arena = new AmlMpArena();
+    return *arena;
+}
+
+AmlMpArena::AmlMpArena()
+: mPageSize(sysconf(_SC_PAGESIZE) > 0 ? sysconf(_SC_PAGESIZE) : 4096)
+, mHugePageMode(AmlMpConfig::instance().mArenaHugePage)
+{
+    MLOGI("page size:%zu, huge page mode:%d", mPageSize, mHugePageMode);
+}
+
+size_t AmlMpArena::mapSize(size_t size) const
+{
+    size_t align = mHugePageMode != kHugePageNone ? kHugePageSize : mPageSize;
+
+    return (size + align - 1) & ~(align - 1);
+}
+
+void* AmlMpArena::mapRegion(size_t size)
+{
+    void* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (mHugePageMode == kHugePageTlb && size % kHugePageSize == 0) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+
+    if (p != MAP_FAILED) {
+        return p;
+    }
+
+    if (mHugePageMode == kHugePageNone || size % kHugePageSize != 0) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            MLOGE("mmap %zu bytes failed!", size);
+            return nullptr;
+        }
+        return p;
+    }
+
+    // transparent huge pages only back huge page aligned ranges, map one
+    // huge page more and trim both ends.
+    p = mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        MLOGE("mmap %zu bytes failed!", size + kHugePageSize);
+        return nullptr;
+    }
+
+    uintptr_t start = (uintptr_t)p;
+    uintptr_t aligned = (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    if (aligned > start) {
+        munmap(p, aligned - start);
+    }
+    munmap((void*)(aligned + size), start + kHugePageSize - aligned);
+    p = (void*)aligned;
+
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+
+    return p;
+}
+
+void* AmlMpArena::carve_l(size_t size, Slab** slab)
+{
+    // first fit, slabs holding regions first so that empty ones can be trimmed.
+    Slab* emptySlab = nullptr;
+    for (Slab& s : mSlabs) {
+        if (s.used == 0) {
+            if (emptySlab == nullptr) {
+                emptySlab = &s;
+            }
+            continue;
+        }
+
+        for (auto it = s.freeRanges.begin(); it != s.freeRanges.end(); ++it) {
+            if (it->second < size) {
+                continue;
+            }
+
+            size_t offset = it->first;
+            size_t remaining = it->second - size;
+            s.freeRanges.erase(it);
+            if (remaining > 0) {
+                s.freeRanges.emplace(offset + size, remaining);
+            }
+            s.used += size;
+            *slab = &s;
+            return s.base + offset;
+        }
+    }
+
+    if (emptySlab != nullptr) {
+        mCachedBytes -= kSlabSize;
+    } else {
+        uint8_t* base = (uint8_t*)mapRegion(kSlabSize);
+        if (base == nullptr) {
+            return nullptr;
+        }
+
+        mSlabs.emplace_back();
+        emptySlab = &mSlabs.back();
+        emptySlab->base = base;
+        emptySlab->freeRanges.emplace(0, kSlabSize);
+    }
+
+    emptySlab->freeRanges.clear();
+    if (size < kSlabSize) {
+        emptySlab->freeRanges.emplace(size, kSlabSize - size);
+    }
+    emptySlab->used = size;
+    *slab = emptySlab;
+    return emptySlab->base;
+}
+
+void AmlMpArena::release_l(Slab* slab, void* ptr, size_t size)
+{
+    slab->used -= size;
+    if (slab->used == 0) {
+        slab->freeRanges.clear();
+        slab->freeRanges.emplace(0, kSlabSize);
+        mCachedBytes += kSlabSize;
+        return;
+    }
+
+    size_t offset = (uint8_t*)ptr - slab->base;
+    auto next = slab->freeRanges.lower_bound(offset);
+    if (next != slab->freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = slab->freeRanges.erase(next);
+    }
+
+    if (next != slab->freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            slab->freeRanges.erase(prev);
+        }
+    }
+
+    slab->freeRanges.emplace(offset, size);
+}
+
+void* AmlMpArena::alloc(size_t size, int owner)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    bool carved = size <= kSlabSize;
+    size_t blockSize = carved ? (size + kAlignment - 1) & ~(kAlignment - 1) : mapSize(size);
+    void* p = nullptr;
+    Slab* slab = nullptr;
+
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        Owner& o = mOwners[owner];
+        o.released = false;
+        if (o.budget != 0 && o.used + blockSize > o.budget) {
+            MLOGW("owner %d over budget, used:%zu, request:%zu, budget:%zu", owner, o.used, blockSize, o.budget);
+            return nullptr;
+        }
+
+        if (!AmlMpMemoryTracker::instance().tryCharge(AML_MP_MEMORY_TS_BUFFER, owner, blockSize)) {
+            return nullptr;
+        }
+
+        if (carved) {
+            p = carve_l(blockSize, &slab);
+            if (p == nullptr) {
+                AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_TS_BUFFER, owner, blockSize);
+                return nullptr;
+            }
+
+            o.used += blockSize;
+            mTotalUsed += blockSize;
+            mBlocks.emplace(p, Block{blockSize, owner, slab});
+            return p;
+        }
+
+        // only reuse a cached region of the very size, so the budget and the
+        // charged size stay exact.
+        auto it = mCache.find(blockSize);
+        if (it != mCache.end()) {
+            p = it->second;
+            mCachedBytes -= it->first;
+            mCache.erase(it);
+        }
+
+        // charge before mapping so that concurrent allocations respect the budget.
+        o.used += blockSize;
+        mTotalUsed += blockSize;
+    }
+
+    if (p == nullptr) {
+        p = mapRegion(blockSize);
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (p == nullptr) {
+        mOwners[owner].used -= blockSize;
+        mTotalUsed -= blockSize;
+        AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_TS_BUFFER, owner, blockSize);
+        return nullptr;
+    }
+
+    mBlocks.emplace(p, Block{blockSize, owner, nullptr});
+    return p;
+}
+
+void AmlMpArena::free(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mBlocks.find(ptr);
+    if (it == mBlocks.end()) {
+        MLOGE("free unknown region %p", ptr);
+        return;
+    }
+
+    Block block = it->second;
+    mBlocks.erase(it);
+    mTotalUsed -= block.size;
+    AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_TS_BUFFER, block.owner, block.size);
+
+    bool drained = false;
+    auto o = mOwners.find(block.owner);
+    if (o != mOwners.end()) {
+        o->second.used -= block.size;
+        if (o->second.used == 0 && o->second.released) {
+            mOwners.erase(o);
+            drained = true;
+        }
+    }
+
+    if (block.slab != nullptr) {
+        release_l(block.slab, ptr, block.size);
+    } else {
+        mCache.emplace(block.size, ptr);
+        mCachedBytes += block.size;
+    }
+
+    trim_l(drained ? 0 : kMaxCachedBytes);
+}
+
+void AmlMpArena::setBudget(int owner, size_t budget)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    Owner& o = mOwners[owner];
+    o.budget = budget;
+    o.released = false;
+}
+
+void AmlMpArena::releaseOwner(int owner)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    auto o = mOwners.find(owner);
+    if (o == mOwners.end()) {
+        return;
+    }
+
+    if (o->second.used == 0) {
+        mOwners.erase(o);
+        trim_l(0);
+    } else {
+        o->second.released = true;
+    }
+}
+
+size_t AmlMpArena::usage(int owner) const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    auto o = mOwners.find(owner);
+    return o != mOwners.end() ? o->second.used : 0;
+}
+
+size_t AmlMpArena::totalUsage() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mTotalUsed;
+}
+
+void AmlMpArena::trim()
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    trim_l(0);
+}
+
+void AmlMpArena::trim_l(size_t keepBytes)
+{
+    while (mCachedBytes > keepBytes && !mCache.empty()) {
+        // drop the largest regions first.
+        auto it = std::prev(mCache.end());
+        munmap(it->second, it->first);
+        mCachedBytes -= it->first;
+        mCache.erase(it);
+    }
+
+    for (auto it = mSlabs.begin(); mCachedBytes > keepBytes && it != mSlabs.end();) {
+        if (it->used != 0) {
+            ++it;
+            continue;
+        }
+
+        munmap(it->base, kSlabSize);
+        mCachedBytes -= kSlabSize;
+        it = mSlabs.erase(it);
+    }
+}
+
+}
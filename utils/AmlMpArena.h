@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef AML_MP_ARENA_H_
+#define AML_MP_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <map>
+#include <unordered_map>
+
+namespace aml_mp {
+
+/*
+ * Process-wide allocator for TS staging buffers (fifos, write and packetize buffers).
+ *
+ * Regions up to kSlabSize are carved, 64 bytes aligned, from slabs of one huge
+ * page each, so the staging buffers of all players share a few huge pages
+ * instead of each being a small heap block. Depending on
+ * AmlMpConfig::mArenaHugePage the slabs are mapped with hugetlb pages or
+ * aligned and advised for transparent huge pages. Larger regions are mapped
+ * on their own. Empty slabs and freed large regions are cached and reused,
+ * so players that are created and destroyed repeatedly don't fragment memory.
+ *
+ * Regions are charged to an owner, normally the player instance id. An owner
+ * with a budget gets nullptr once an allocation would exceed it.
+ */
+class AmlMpArena
+{
+public:
+    static constexpr int kSharedOwner = -1;
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kSlabSize = 2 * 1024 * 1024;
+
+    static AmlMpArena& instance();
+
+    void* alloc(size_t size, int owner = kSharedOwner);
+    void free(void* ptr);
+
+    // budget in bytes, 0 means unlimited.
+    void setBudget(int owner, size_t budget);
+    // the owner is destroyed: forget its budget once all its regions are freed,
+    // and give the cached regions back to the system.
+    void releaseOwner(int owner);
+
+    size_t usage(int owner) const;
+    size_t totalUsage() const;
+
+    void trim();
+
+private:
+    enum HugePageMode {
+        kHugePageNone,
+        kHugePageAdvise,
+        kHugePageTlb,
+    };
+
+    struct Slab {
+        uint8_t* base = nullptr;
+        size_t used = 0;
+        // offset -> size, coalesced.
+        std::map<size_t, size_t> freeRanges;
+    };
+
+    struct Block {
+        size_t size;
+        int owner;
+        // nullptr for regions mapped on their own.
+        Slab* slab;
+    };
+
+    struct Owner {
+        size_t used = 0;
+        size_t budget = 0;
+        bool released = false;
+    };
+
+    AmlMpArena();
+    ~AmlMpArena() = default;
+
+    size_t mapSize(size_t size) const;
+    void* mapRegion(size_t size);
+    void* carve_l(size_t size, Slab** slab);
+    void release_l(Slab* slab, void* ptr, size_t size);
+    void trim_l(size_t keepBytes);
+
+    const size_t mPageSize;
+    const int mHugePageMode;
+
+    mutable std::mutex mLock;
+    std::unordered_map<void*, Block> mBlocks;
+    std::map<int, Owner> mOwners;
+    std::list<Slab> mSlabs;
+    // freed regions mapped on their own, by size.
+    std::multimap<size_t, void*> mCache;
+    // bytes of empty slabs and of mCache.
+    size_t mCachedBytes = 0;
+    size_t mTotalUsed = 0;
+
+    AmlMpArena(const AmlMpArena&) = delete;
+    AmlMpArena& operator= (const AmlMpArena&) = delete;
+};
+
+}
+
+#endif
@@ -15,7 +15,10 @@
  */
 
 #include "AmlMpBuffer.h"
+#include "AmlMpArena.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace aml_mp {
 
@@ -42,6 +45,40 @@ AmlMpBuffer::AmlMpBuffer(void *data, size_t capacity)
       mOwnsData(false) {
 }
 
+AmlMpBuffer::AmlMpBuffer(const sptr<AmlMpBuffer>& parent, void *data, size_t capacity)
+    : mData(data),
+      mCapacity(capacity),
+      mRangeOffset(0),
+      mRangeLength(capacity),
+      mInt32Data(0),
+      mOwnsData(false),
+      mParent(parent) {
+}
+
+// static
+sptr<AmlMpBuffer> AmlMpBuffer::CreateSlice(const sptr<AmlMpBuffer>& parent, size_t offset, size_t size)
+{
+    if (parent == nullptr || offset > parent->capacity() || size > parent->capacity() - offset) {
+        return NULL;
+    }
+
+    const sptr<AmlMpBuffer>& owner = parent->mParent != nullptr ? parent->mParent : parent;
+    return new AmlMpBuffer(owner, parent->base() + offset, size);
+}
+
+// static
+sptr<AmlMpBuffer> AmlMpBuffer::CreateFromArena(size_t capacity, int owner)
+{
+    void* data = AmlMpArena::instance().alloc(capacity, owner);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    sptr<AmlMpBuffer> res = new AmlMpBuffer(data, capacity);
+    res->mArenaData = true;
+    return res;
+}
+
 // static
 sptr<AmlMpBuffer> AmlMpBuffer::CreateAsCopy(const void *data, size_t capacity)
 {
@@ -59,6 +96,9 @@ AmlMpBuffer::~AmlMpBuffer() {
             free(mData);
             mData = NULL;
         }
+    } else if (mArenaData) {
+        AmlMpArena::instance().free(mData);
+        mData = NULL;
     }
 }
 
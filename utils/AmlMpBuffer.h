@@ -21,11 +21,12 @@
 #include <sys/types.h>
 #include <stdint.h>
 
-#include "AmlMpRefBase.h"
+#include "AmlMpLightRefBase.h"
 
 namespace aml_mp {
 
-struct AmlMpBuffer : public AmlMpRefBase {
+// Buffers are created per feed and per section, they only need strong references.
+struct AmlMpBuffer : public AmlMpLightRefBase<AmlMpBuffer> {
     explicit AmlMpBuffer(size_t capacity);
     AmlMpBuffer(void *data, size_t capacity);
 
@@ -40,13 +41,28 @@ struct AmlMpBuffer : public AmlMpRefBase {
     // create buffer from dup of some memory block
     static sptr<AmlMpBuffer> CreateAsCopy(const void *data, size_t capacity);
 
+    // create a view of [offset, offset + size) of parent's storage, offset is
+    // relative to parent->base(). No data is copied, the slice keeps the
+    // storage alive through a strong reference on the owning buffer and has
+    // its own range, so setRange() on either side doesn't affect the other.
+    static sptr<AmlMpBuffer> CreateSlice(const sptr<AmlMpBuffer>& parent, size_t offset, size_t size);
+
+    bool isSlice() const { return mParent != nullptr; }
+
+    // create buffer whose storage comes from AmlMpArena and is charged to owner,
+    // return NULL if the owner's budget is exhausted.
+    static sptr<AmlMpBuffer> CreateFromArena(size_t capacity, int owner);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
 protected:
     virtual ~AmlMpBuffer();
 
+    friend class AmlMpLightRefBase<AmlMpBuffer>;
+
 private:
+    AmlMpBuffer(const sptr<AmlMpBuffer>& parent, void *data, size_t capacity);
 
     void *mData;
     size_t mCapacity;
@@ -56,6 +72,10 @@ private:
     int32_t mInt32Data;
 
     bool mOwnsData;
+    bool mArenaData = false;
+
+    // storage owner of a slice, always the root buffer.
+    sptr<AmlMpBuffer> mParent;
 
     AmlMpBuffer(const AmlMpBuffer&) = delete;
     AmlMpBuffer& operator= (const AmlMpBuffer&) = delete;
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlMpBufferChain"
+#include "AmlMpLog.h"
+#include "AmlMpBufferChain.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+AmlMpBufferChain::AmlMpBufferChain(AmlMpBufferChain&& other) noexcept
+: mSegments(std::move(other.mSegments))
+, mSize(other.mSize)
+{
+    other.mSegments.clear();
+    other.mSize = 0;
+}
+
+AmlMpBufferChain& AmlMpBufferChain::operator= (AmlMpBufferChain&& other) noexcept
+{
+    if (this != &other) {
+        mSegments = std::move(other.mSegments);
+        mSize = other.mSize;
+        other.mSegments.clear();
+        other.mSize = 0;
+    }
+
+    return *this;
+}
+
+void AmlMpBufferChain::append(const sptr<AmlMpBuffer>& buffer)
+{
+    if (buffer == nullptr) {
+        return;
+    }
+
+    append(buffer, 0, buffer->size());
+}
+
+void AmlMpBufferChain::append(const sptr<AmlMpBuffer>& buffer, size_t offset, size_t size)
+{
+    if (buffer == nullptr || size == 0) {
+        return;
+    }
+
+    if (offset > buffer->size() || size > buffer->size() - offset) {
+        MLOGE("append out of range, offset:%zu, size:%zu, buffer size:%zu", offset, size, buffer->size());
+        return;
+    }
+
+    uint8_t* data = buffer->data() + offset;
+    if (!mSegments.empty()) {
+        Segment& last = mSegments.back();
+        if (last.owner == buffer && last.data + last.size == data) {
+            last.size += size;
+            mSize += size;
+            return;
+        }
+    }
+
+    mSegments.push_back({buffer, data, size});
+    mSize += size;
+}
+
+void AmlMpBufferChain::append(const AmlMpBufferChain& other)
+{
+    for (const Segment& s : other.mSegments) {
+        mSegments.push_back(s);
+    }
+    mSize += other.mSize;
+}
+
+void AmlMpBufferChain::append(const Segment& segment)
+{
+    if (segment.size == 0) {
+        return;
+    }
+
+    mSegments.push_back(segment);
+    mSize += segment.size;
+}
+
+void AmlMpBufferChain::appendBorrowed(const void* data, size_t size)
+{
+    if (data == nullptr || size == 0) {
+        return;
+    }
+
+    mSegments.push_back({nullptr, (uint8_t*)data, size});
+    mSize += size;
+}
+
+size_t AmlMpBufferChain::consume(size_t size)
+{
+    size_t consumed = 0;
+
+    while (size > 0 && !mSegments.empty()) {
+        Segment& s = mSegments.front();
+        if (s.size > size) {
+            s.data += size;
+            s.size -= size;
+            consumed += size;
+            break;
+        }
+
+        size -= s.size;
+        consumed += s.size;
+        mSegments.pop_front();
+    }
+
+    mSize -= consumed;
+    return consumed;
+}
+
+void AmlMpBufferChain::clear()
+{
+    mSegments.clear();
+    mSize = 0;
+}
+
+size_t AmlMpBufferChain::copyTo(void* dst, size_t size, size_t offset) const
+{
+    uint8_t* out = (uint8_t*)dst;
+    size_t copied = 0;
+
+    for (const Segment& s : mSegments) {
+        if (copied == size) {
+            break;
+        }
+
+        if (offset >= s.size) {
+            offset -= s.size;
+            continue;
+        }
+
+        size_t len = std::min(s.size - offset, size - copied);
+        memcpy(out + copied, s.data + offset, len);
+        copied += len;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+int AmlMpBufferChain::toIovec(struct iovec* iov, int maxCount) const
+{
+    int count = 0;
+
+    for (const Segment& s : mSegments) {
+        if (count >= maxCount) {
+            break;
+        }
+
+        iov[count].iov_base = s.data;
+        iov[count].iov_len = s.size;
+        ++count;
+    }
+
+    return count;
+}
+
+sptr<AmlMpBuffer> AmlMpBufferChain::flatten() const
+{
+    if (mSegments.size() == 1 && mSegments.front().owner != nullptr) {
+        const Segment& s = mSegments.front();
+        return AmlMpBuffer::CreateSlice(s.owner, s.data - s.owner->base(), s.size);
+    }
+
+    sptr<AmlMpBuffer> buffer = new AmlMpBuffer(mSize);
+    if (buffer->base() == nullptr && mSize > 0) {
+        MLOGE("flatten alloc %zu bytes failed!", mSize);
+        return nullptr;
+    }
+
+    copyTo(buffer->base(), mSize);
+    buffer->setRange(0, mSize);
+    return buffer;
+}
+
+}
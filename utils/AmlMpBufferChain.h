@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef AML_MP_BUFFER_CHAIN_H_
+#define AML_MP_BUFFER_CHAIN_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <deque>
+#include "AmlMpBuffer.h"
+
+namespace aml_mp {
+
+/*
+ * Ordered list of memory segments that is handed along as one logical byte
+ * stream, so producers don't have to flatten data into a single buffer.
+ *
+ * A segment either holds a strong reference on the AmlMpBuffer it points into,
+ * or borrows caller memory which must stay valid while the chain is in use.
+ */
+class AmlMpBufferChain
+{
+public:
+    struct Segment {
+        sptr<AmlMpBuffer> owner;
+        uint8_t* data;
+        size_t size;
+    };
+
+    AmlMpBufferChain() = default;
+    ~AmlMpBufferChain() = default;
+    AmlMpBufferChain(AmlMpBufferChain&& other) noexcept;
+    AmlMpBufferChain& operator= (AmlMpBufferChain&& other) noexcept;
+
+    // reference the current range of buffer.
+    void append(const sptr<AmlMpBuffer>& buffer);
+    // reference [offset, offset + size) of buffer, offset is relative to buffer->data().
+    void append(const sptr<AmlMpBuffer>& buffer, size_t offset, size_t size);
+    void append(const AmlMpBufferChain& other);
+    void append(const Segment& segment);
+    void appendBorrowed(const void* data, size_t size);
+
+    size_t size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    size_t segmentCount() const {
+        return mSegments.size();
+    }
+
+    const Segment& segmentAt(size_t index) const {
+        return mSegments[index];
+    }
+
+    // drop size bytes from the front, return the number of bytes dropped.
+    size_t consume(size_t size);
+    void clear();
+
+    // copy up to size bytes starting at offset into dst, return the number of bytes copied.
+    size_t copyTo(void* dst, size_t size, size_t offset = 0) const;
+
+    // fill at most maxCount iovecs, return the number filled.
+    int toIovec(struct iovec* iov, int maxCount) const;
+
+    // return the chain as one contiguous buffer. A single owned segment is
+    // returned as a slice of its owner, otherwise the data is copied.
+    sptr<AmlMpBuffer> flatten() const;
+
+private:
+    std::deque<Segment> mSegments;
+    size_t mSize = 0;
+
+    AmlMpBufferChain(const AmlMpBufferChain&) = delete;
+    AmlMpBufferChain& operator= (const AmlMpBufferChain&) = delete;
+};
+
+}
+
+#endif
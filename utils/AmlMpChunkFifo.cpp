@@ -10,6 +10,7 @@
 #define LOG_TAG "AmlMpChunkFifo"
 #include <utils/AmlMpLog.h>
 #include "AmlMpChunkFifo.h"
+#include "AmlMpBufferChain.h"
 #include <algorithm>
 #include <cassert>
 #include <string.h>
@@ -22,8 +23,9 @@ AmlMpChunkFifo::AmlMpChunkFifo()
 {
 }
 
-void AmlMpChunkFifo::init(size_t maxSize, size_t chunkSize)
+void AmlMpChunkFifo::init(size_t maxSize, size_t chunkSize, int arenaOwner)
 {
+    mArenaOwner = arenaOwner;
     mMaxSize = roundUpPowerOfTwo(maxSize);
     mChunkSize = roundUpPowerOfTwo(chunkSize);
     mChunkCount = mMaxSize / mChunkSize;
@@ -47,7 +49,7 @@ AmlMpChunkFifo::~AmlMpChunkFifo()
                 break;
             }
 
-            delete[] mChunkTable[i];
+            AmlMpArena::instance().free(mChunkTable[i]);
         }
 
         delete[] mChunkTable;
@@ -67,7 +69,12 @@ size_t AmlMpChunkFifo::put(const void* buffer, size_t size)
         char* f = mChunkTable[index];
         if (f == nullptr) {
             assert(offset == 0);
-            f = mChunkTable[index] = new char[mChunkSize];
+            f = (char*)AmlMpArena::instance().alloc(mChunkSize, mArenaOwner);
+            if (f == nullptr) {
+                MLOGW("alloc chunk failed, put %zu of %zu bytes", total - size, total);
+                break;
+            }
+            mChunkTable[index] = f;
         }
         len = std::min(size, mChunkSize-offset);
         memcpy(f+offset, buffer, len);
@@ -82,28 +89,57 @@ size_t AmlMpChunkFifo::put(const void* buffer, size_t size)
 size_t AmlMpChunkFifo::get(void* buffer, size_t size)
 {
     std::unique_lock<std::mutex> _l(mLock);
+    size_t total = forEachChunk_l(size, [&buffer](char* data, size_t len) {
+        memcpy(buffer, data, len);
+        buffer = (char*)buffer + len;
+    });
+    mGetSize += total;
+
+    return total;
+}
+
+size_t AmlMpChunkFifo::peek(AmlMpBufferChain* chain, size_t size) const
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    return forEachChunk_l(size, [chain](char* data, size_t len) {
+        chain->appendBorrowed(data, len);
+    });
+}
+
+template <typename Visitor>
+size_t AmlMpChunkFifo::forEachChunk_l(size_t size, Visitor&& visitor) const
+{
     size = std::min(size, mPutSize - mGetSize);
     size_t total = size;
+    size_t getSize = mGetSize;
 
     size_t len = 0;
     while (size) {
-        int index = (mGetSize/mChunkSize) % mChunkCount;
-        int offset = mGetSize % mChunkSize;
+        int index = (getSize/mChunkSize) % mChunkCount;
+        int offset = getSize % mChunkSize;
         char* f = mChunkTable[index];
         if (f == nullptr) {
-            MLOGE("ERROR, chunk buffer is NULL, index:%d, size:%d", index, size);
+            MLOGE("ERROR, chunk buffer is NULL, index:%d, size:%zu", index, size);
             break;
         }
         len = std::min(size, mChunkSize-offset);
-        memcpy(buffer, f+offset, len);
+        visitor(f+offset, len);
         size -= len;
-        buffer = (char*)buffer + len;
-        mGetSize += len;
+        getSize += len;
     }
 
     return total - size;
 }
 
+size_t AmlMpChunkFifo::consume(size_t size)
+{
+    std::unique_lock<std::mutex> _l(mLock);
+    size = std::min(size, mPutSize - mGetSize);
+    mGetSize += size;
+
+    return size;
+}
+
 size_t AmlMpChunkFifo::size() const
 {
     std::unique_lock<std::mutex> _l(mLock);
@@ -12,23 +12,34 @@
 
 #include <mutex>
 #include "AmlMpFifo.h"
+#include "AmlMpArena.h"
 
 namespace aml_mp {
+class AmlMpBufferChain;
 
 struct AmlMpChunkFifo {
 public:
     AmlMpChunkFifo();
-    void init(size_t maxSize, size_t chunkSize = 1 * 1024 * 1024);
+    // chunks are allocated lazily from AmlMpArena and charged to arenaOwner.
+    void init(size_t maxSize, size_t chunkSize = 1 * 1024 * 1024, int arenaOwner = AmlMpArena::kSharedOwner);
     ~AmlMpChunkFifo();
 
     size_t get(void* buffer, size_t size);
     size_t put(const void*buffer, size_t size);
+    // reference up to size readable bytes in place, the segments stay valid
+    // until they are consumed or the fifo is reset.
+    size_t peek(AmlMpBufferChain* chain, size_t size) const;
+    size_t consume(size_t size);
     size_t size() const;
     size_t space() const;
     bool empty() const;
     void reset();
 
 private:
+    // visit up to size readable bytes chunk by chunk, without consuming them.
+    template <typename Visitor>
+    size_t forEachChunk_l(size_t size, Visitor&& visitor) const;
+
     mutable std::mutex mLock;
     char** mChunkTable = nullptr;
     size_t mChunkSize = 0;
@@ -36,6 +47,7 @@ private:
     size_t mChunkCount = 0;
     size_t mPutSize = 0;
     size_t mGetSize = 0;
+    int mArenaOwner = AmlMpArena::kSharedOwner;
 
     AmlMpChunkFifo(const AmlMpChunkFifo&) = delete;
     AmlMpChunkFifo& operator= (const AmlMpChunkFifo&) = delete;
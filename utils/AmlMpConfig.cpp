@@ -51,6 +51,27 @@ void AmlMpConfig::reset()
     mWaitingEcmMode = 1;
     mWriteBufferSize = 2; // default write buffer size set to 2MB.
     mDumpPackts = 0;
+    mExecutorThreads = 0; // 0: decided by the number of cores.
+    mArenaHugePage = 1; // 0: none, 1: madvise THP, 2: MAP_HUGETLB with THP fallback.
+    mPlayerBufferBudget = 0; // staging buffer budget per player in MB, 0: unlimited.
+    mMemoryBudget = 0; // process-wide memory budget in MB, 0: unlimited.
+    mDvrIndexInterval = 0; // DVR ts index interval in ms, costs clear recordings a copy, 0: don't index recordings.
+    mTimeshiftRamDir = "/dev/shm"; // tmpfs directory for timeshift, empty: timeshift on disk.
+    mTimeshiftRamSize = 0; // timeshift kept in RAM in MB, older segments are moved to disk, 0: disabled.
+    mDvrCryptoThreads = 0; // DVR crypto workers, 0: crypto on the record/inject thread.
+    mDvrCryptoBatch = 256; // DVR crypto data per CAS call in KB.
+    mDvrReadahead = 4000; // DVR playback time read ahead in ms, grows on slow disks, 0: disabled.
+    mDvrDeleteStep = 64; // DVR background deletion truncates segment files by this many MB per step.
+    mDvrDeleteInterval = 50; // DVR background deletion pause between truncate steps in ms.
+    mEcmHoldSize = 4096; // TS held back behind a new ECM in KB, 0: ECMs processed inline on the write path.
+    mCasSessionPool = 0; // IPTV CAS sessions kept open per CAS type for zapping, 0: disabled.
+    mEcmPrefetch = 0; // services next to the playing one whose ECMs are processed ahead of a zap, 0: disabled.
+    mCasEcmDedup = 0; // repeated ECMs passed to Aml_MP_CAS_ProcessEcmIPTV are dropped before the CAS lib, 0: all passed.
+    mCasDecryptBatch = 64; // IPTV CAS data gathered per CAS lib decrypt call of a vectored decrypt in KB, 0: one call per chunk.
+    mCasLib = ""; // CAS lib loaded instead of the vendor one of each IPTV CAS type, e.g. the stub for tests, debuggable builds only, empty: vendor libs.
+    mCasShareDescrambling = 0; // CAS HAL sessions shared by the live and record consumers of a service, 0: one session each.
+    mCasEmm = 0; // EMMs of the CAT EMM PID passed by the player to its IPTV CAS session, after the EMM filters, 0: disabled.
+    mEmmCacheSize = 256; // recent EMMs whose repeats are dropped before the CAS, 0: repeats passed.
 
 #if ANDROID_PLATFORM_SDK_VERSION == 29
     mUseVideoTunnel = 0;
@@ -68,6 +89,30 @@ void AmlMpConfig::init()
     initProperty("vendor.amlmp.waiting-ecm-mode", mWaitingEcmMode);
     initProperty("vendor.amlmp.write-buffer-size", mWriteBufferSize);
     initProperty("vendor.enable.dump.packts", mDumpPackts);
+    initProperty("vendor.amlmp.executor-threads", mExecutorThreads);
+    initProperty("vendor.amlmp.arena-hugepage", mArenaHugePage);
+    initProperty("vendor.amlmp.player-buffer-budget", mPlayerBufferBudget);
+    initProperty("vendor.amlmp.memory-budget", mMemoryBudget);
+    initProperty("vendor.amlmp.dvr-index-interval", mDvrIndexInterval);
+    initProperty("vendor.amlmp.timeshift-ram-dir", mTimeshiftRamDir);
+    initProperty("vendor.amlmp.timeshift-ram-size", mTimeshiftRamSize);
+    initProperty("vendor.amlmp.dvr-crypto-threads", mDvrCryptoThreads);
+    initProperty("vendor.amlmp.dvr-crypto-batch", mDvrCryptoBatch);
+    initProperty("vendor.amlmp.dvr-readahead", mDvrReadahead);
+    initProperty("vendor.amlmp.dvr-delete-step", mDvrDeleteStep);
+    initProperty("vendor.amlmp.dvr-delete-interval", mDvrDeleteInterval);
+    initProperty("vendor.amlmp.ecm-hold-size", mEcmHoldSize);
+    initProperty("vendor.amlmp.cas-session-pool", mCasSessionPool);
+    initProperty("vendor.amlmp.ecm-prefetch", mEcmPrefetch);
+    initProperty("vendor.amlmp.cas-ecm-dedup", mCasEcmDedup);
+    initProperty("vendor.amlmp.cas-decrypt-batch", mCasDecryptBatch);
+    // a CAS lib of the user's choice would see the keys, tests only run on debuggable builds.
+    if (property_get_bool("ro.debuggable", false)) {
+        initProperty("vendor.amlmp.cas-lib", mCasLib);
+    }
+    initProperty("vendor.amlmp.cas-share-descrambling", mCasShareDescrambling);
+    initProperty("vendor.amlmp.cas-emm", mCasEmm);
+    initProperty("vendor.amlmp.emm-cache-size", mEmmCacheSize);
 
 #endif
 
@@ -10,6 +10,8 @@
 #ifndef _AML_MP_CONFIG_H_
 #define _AML_MP_CONFIG_H_
 
+#include <string>
+
 namespace aml_mp {
 
 
@@ -31,6 +33,27 @@ public:
     int mWaitingEcmMode;
     int mWriteBufferSize;
     int mDumpPackts;
+    int mExecutorThreads;
+    int mArenaHugePage;
+    int mPlayerBufferBudget;
+    int mMemoryBudget;
+    int mDvrIndexInterval;
+    std::string mTimeshiftRamDir;
+    int mTimeshiftRamSize;
+    int mDvrCryptoThreads;
+    int mDvrCryptoBatch;
+    int mDvrReadahead;
+    int mDvrDeleteStep;
+    int mDvrDeleteInterval;
+    int mEcmHoldSize;
+    int mCasSessionPool;
+    int mEcmPrefetch;
+    int mCasEcmDedup;
+    int mCasDecryptBatch;
+    std::string mCasLib;
+    int mCasShareDescrambling;
+    int mCasEmm;
+    int mEmmCacheSize;
 
 private:
     void reset();
@@ -89,7 +89,7 @@ AmlMpEventLooper::~AmlMpEventLooper() {
 }
 
 void AmlMpEventLooper::setName(const char *name) {
-    mName = name;
+    mLooperName = name;
 }
 
 AmlMpEventLooper::handler_id AmlMpEventLooper::registerHandler(const sptr<AmlMpEventHandler> &handler) {
@@ -106,7 +106,7 @@ int AmlMpEventLooper::start(
         {
             std::lock_guard<std::mutex> autoLock(mLock);
 
-            if (mThread != NULL || mRunningLocally) {
+            if (mThread != NULL || mStrand != NULL || mRunningLocally) {
                 return -EINVAL;
             }
 
@@ -121,7 +121,7 @@ int AmlMpEventLooper::start(
 
     std::lock_guard<std::mutex> autoLock(mLock);
 
-    if (mThread != NULL || mRunningLocally) {
+    if (mThread != NULL || mStrand != NULL || mRunningLocally) {
         return -EINVAL;
     }
 
@@ -136,19 +136,46 @@ int AmlMpEventLooper::start(
     return err;
 }
 
+int AmlMpEventLooper::startOnExecutor() {
+    std::lock_guard<std::mutex> autoLock(mLock);
+
+    if (mThread != NULL || mStrand != NULL || mRunningLocally) {
+        return -EINVAL;
+    }
+
+    mStrand = AmlMpExecutor::instance().createStrand(
+            mLooperName.empty() ? "AmlMpEventLooper" : mLooperName.c_str());
+
+    return 0;
+}
+
 int AmlMpEventLooper::stop() {
     sptr<LooperThread> thread;
+    sptr<AmlMpExecutor::Strand> strand;
     bool runningLocally;
 
     {
         std::lock_guard<std::mutex> autoLock(mLock);
 
         thread = mThread;
+        strand = mStrand;
         runningLocally = mRunningLocally;
         mThread.clear();
+        mStrand.clear();
         mRunningLocally = false;
     }
 
+    if (strand != NULL) {
+        {
+            std::lock_guard<std::mutex> autoLock(mRepliesLock);
+            mRepliesCondition.notify_all();
+        }
+
+        // pending messages are dropped, same as the thread mode.
+        strand->shutdown();
+        return 0;
+    }
+
     if (thread == NULL && !runningLocally) {
         return -EINVAL;
     }
@@ -175,7 +202,19 @@ int AmlMpEventLooper::stop() {
 }
 
 void AmlMpEventLooper::post(const sptr<AmlMpMessage> &msg, int64_t delayUs) {
-    std::lock_guard<std::mutex> autoLock(mLock);
+    msg->markQueued();
+
+    std::unique_lock<std::mutex> autoLock(mLock);
+
+    if (mStrand != NULL) {
+        sptr<AmlMpExecutor::Strand> strand = mStrand;
+        autoLock.unlock();
+
+        strand->post([msg] {
+            msg->deliver();
+        }, delayUs);
+        return;
+    }
 
     int64_t whenUs;
     if (delayUs > 0) {
@@ -254,7 +293,7 @@ int AmlMpEventLooper::awaitResponse(const sptr<AReplyToken> &replyToken, sptr<Am
     while (!replyToken->retrieveReply(response)) {
         {
             std::unique_lock<std::mutex> autoLock(mLock);
-            if (mThread == NULL) {
+            if (mThread == NULL && mStrand == NULL) {
                 return -ENOENT;
             }
         }
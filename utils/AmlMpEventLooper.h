@@ -25,6 +25,7 @@
 #include <list>
 #include "AmlMpRefBase.h"
 #include "AmlMpThread.h"
+#include "AmlMpExecutor.h"
 
 namespace aml_mp {
 
@@ -50,6 +51,10 @@ struct AmlMpEventLooper : public AmlMpRefBase {
             int32_t priority = 0
             );
 
+    // Deliver messages on a strand of the shared AmlMpExecutor instead of
+    // a dedicated thread. Handlers still see single-threaded delivery.
+    int startOnExecutor();
+
     int stop();
 
     static int64_t GetNowUs();
@@ -78,6 +83,7 @@ private:
 
     struct LooperThread;
     sptr<LooperThread> mThread;
+    sptr<AmlMpExecutor::Strand> mStrand;
     bool mRunningLocally;
 
     // use a separate lock for reply handling, as it is always on another thread
@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlMpExecutor"
+#include "AmlMpLog.h"
+#include "AmlMpExecutor.h"
+#include "AmlMpConfig.h"
+#include <pthread.h>
+#include <chrono>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+static const size_t kMaxWorkerCount = 8;
+static const size_t kMinWorkerCount = 2;
+// run at most this many tasks per strand turn, so a busy strand can't starve the others.
+static const int kMaxTasksPerDrain = 16;
+
+static thread_local AmlMpExecutor* sCurrentExecutor = nullptr;
+static thread_local size_t sCurrentWorker = 0;
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct AmlMpExecutor::Strand::FdWatch : public LooperCallback
+{
+    FdWatch(Strand* strand, int fd, int events, const sptr<LooperCallback>& callback, void* data)
+    : mStrand(strand)
+    , mFd(fd)
+    , mEvents(events)
+    , mCallback(callback)
+    , mData(data)
+    {
+    }
+
+    // called on the poll thread, disarm the fd until the strand has consumed the event,
+    // otherwise level triggered fds would keep waking the poll thread.
+    virtual int handleEvent(int fd, int events, void* data) override {
+        (void)data;
+        sptr<Strand> strand = mStrand.promote();
+        if (strand == nullptr || mRemoved) {
+            return 0;
+        }
+
+        sptr<FdWatch> self(this);
+        strand->post([self, fd, events] {
+            self->dispatch(fd, events);
+        });
+
+        return 0;
+    }
+
+    void dispatch(int fd, int events) {
+        if (mRemoved) {
+            return;
+        }
+
+        int keep = mCallback->handleEvent(fd, events, mData);
+        sptr<Strand> strand = mStrand.promote();
+        if (strand == nullptr) {
+            return;
+        }
+
+        if (keep) {
+            strand->rearmFd(this);
+        } else {
+            strand->forgetFd(mFd, this);
+        }
+    }
+
+    wptr<Strand> mStrand;
+    const int mFd;
+    const int mEvents;
+    sptr<LooperCallback> mCallback;
+    void* mData;
+    std::atomic<bool> mRemoved{false};
+
+protected:
+    virtual ~FdWatch() = default;
+};
+
+AmlMpExecutor::Strand::Strand(AmlMpExecutor* executor, const char* name)
+: mExecutor(executor)
+, mStrandName(name ? name : "strand")
+{
+}
+
+AmlMpExecutor::Strand::~Strand()
+{
+}
+
+void AmlMpExecutor::Strand::post(const Task& task, int64_t delayUs)
+{
+    if (delayUs > 0) {
+        wptr<Strand> weakSelf(this);
+        mExecutor->post([weakSelf, task] {
+            sptr<Strand> strand = weakSelf.promote();
+            if (strand != nullptr) {
+                strand->post(task);
+            }
+        }, delayUs);
+        return;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mShutdown) {
+        return;
+    }
+
+    mTasks.push_back(task);
+    if (!mScheduled) {
+        schedule_l();
+    }
+}
+
+void AmlMpExecutor::Strand::schedule_l()
+{
+    mScheduled = true;
+
+    sptr<Strand> self(this);
+    mExecutor->post([self] {
+        self->drain();
+    });
+}
+
+void AmlMpExecutor::Strand::drain()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mRunningThread = std::this_thread::get_id();
+    }
+
+    for (int i = 0; i < kMaxTasksPerDrain; ++i) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            if (mTasks.empty() || mShutdown) {
+                break;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+
+        task();
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mRunningThread = std::thread::id();
+    if (!mTasks.empty() && !mShutdown) {
+        schedule_l();
+    } else {
+        mScheduled = false;
+        mIdleCond.notify_all();
+    }
+}
+
+bool AmlMpExecutor::Strand::isCurrentThread() const
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    return mRunningThread == std::this_thread::get_id();
+}
+
+int AmlMpExecutor::Strand::addFd(int fd, int events, const sptr<LooperCallback>& callback, void* data)
+{
+    if (fd < 0 || callback == nullptr) {
+        return -1;
+    }
+
+    sptr<FdWatch> watch = new FdWatch(this, fd, events, callback, data);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    if (mShutdown) {
+        return -1;
+    }
+
+    auto it = mFdWatches.find(fd);
+    if (it != mFdWatches.end()) {
+        it->second->mRemoved = true;
+    }
+
+    // registered under mLock, so a concurrent removeFd() can't be undone.
+    int ret = mExecutor->pollLooper()->addFd(fd, Looper::POLL_CALLBACK, events, watch, nullptr);
+    if (ret != 1) {
+        MLOGE("%s addFd %d failed!", name(), fd);
+        if (it != mFdWatches.end()) {
+            mFdWatches.erase(it);
+        }
+        return ret;
+    }
+    mFdWatches[fd] = watch;
+
+    return ret;
+}
+
+int AmlMpExecutor::Strand::removeFd(int fd)
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        auto it = mFdWatches.find(fd);
+        if (it == mFdWatches.end()) {
+            return 0;
+        }
+        // marked under mLock, see rearmFd().
+        it->second->mRemoved = true;
+        mFdWatches.erase(it);
+    }
+
+    mExecutor->pollLooper()->removeFd(fd);
+
+    return 1;
+}
+
+void AmlMpExecutor::Strand::rearmFd(FdWatch* watch)
+{
+    // a dispatch in flight must not re-arm an fd removed meanwhile, the
+    // caller may have closed it already and the number may be reused.
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mFdWatches.find(watch->mFd);
+    if (watch->mRemoved || it == mFdWatches.end() || it->second.get() != watch) {
+        return;
+    }
+
+    sptr<FdWatch> self(watch);
+    if (mExecutor->pollLooper()->addFd(watch->mFd, Looper::POLL_CALLBACK, watch->mEvents, self, nullptr) != 1) {
+        MLOGE("%s rearm fd:%d failed!", name(), watch->mFd);
+        mFdWatches.erase(it);
+    }
+}
+
+void AmlMpExecutor::Strand::forgetFd(int fd, const FdWatch* watch)
+{
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mFdWatches.find(fd);
+    if (it != mFdWatches.end() && it->second.get() == watch) {
+        mFdWatches.erase(it);
+    }
+}
+
+void AmlMpExecutor::Strand::shutdown()
+{
+    std::map<int, sptr<FdWatch>> fdWatches;
+    std::deque<Task> tasks;
+
+    std::unique_lock<std::mutex> _l(mLock);
+    mShutdown = true;
+    tasks.swap(mTasks);
+    fdWatches.swap(mFdWatches);
+    for (auto& p : fdWatches) {
+        p.second->mRemoved = true;
+    }
+
+    _l.unlock();
+    for (auto& p : fdWatches) {
+        mExecutor->pollLooper()->removeFd(p.first);
+    }
+    // tasks may hold the last reference of their owner, release them without mLock.
+    tasks.clear();
+    _l.lock();
+
+    if (mRunningThread == std::this_thread::get_id()) {
+        return;
+    }
+
+    mIdleCond.wait(_l, [this] { return !mScheduled; });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AmlMpExecutor& AmlMpExecutor::instance()
+{
+    // never destroyed, workers may still be draining strands at process exit.
+    static AmlMpExecutor* executor = new AmlMpExecutor();
+    return *executor;
+}
+
+AmlMpExecutor::AmlMpExecutor()
+{
+    size_t count = AmlMpConfig::instance().mExecutorThreads;
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+    }
+    count = std::max(kMinWorkerCount, std::min(count, kMaxWorkerCount));
+
+    MLOGI("worker count:%zu", count);
+
+    for (size_t i = 0; i < count; ++i) {
+        mWorkers.push_back(new Worker);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        mWorkers[i]->thread = std::thread([this, i] {
+            workerLoop(i);
+        });
+    }
+}
+
+AmlMpExecutor::~AmlMpExecutor()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExiting = true;
+        mCond.notify_all();
+    }
+
+    for (auto worker : mWorkers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        delete worker;
+    }
+    mWorkers.clear();
+
+    if (mPollLooper != nullptr) {
+        mPollLooper->wake();
+        if (mPollThread.joinable()) {
+            mPollThread.join();
+        }
+    }
+}
+
+void AmlMpExecutor::post(const Task& task, int64_t delayUs)
+{
+    if (delayUs > 0) {
+        std::lock_guard<std::mutex> _l(mLock);
+        int64_t whenUs = nowUs() + delayUs;
+        bool earliest = mTimers.empty() || whenUs < mTimers.begin()->first;
+        mTimers.emplace(whenUs, task);
+        if (earliest) {
+            mCond.notify_one();
+        }
+        return;
+    }
+
+    pushTask(task);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    mCond.notify_one();
+}
+
+sptr<AmlMpExecutor::Strand> AmlMpExecutor::createStrand(const char* name)
+{
+    return new Strand(this, name);
+}
+
+void AmlMpExecutor::pushTask(const Task& task)
+{
+    size_t index;
+    if (sCurrentExecutor == this) {
+        // keep tasks spawned by a worker local, others steal them when idle.
+        index = sCurrentWorker;
+    } else {
+        index = mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    }
+
+    Worker* worker = mWorkers[index];
+    {
+        std::lock_guard<std::mutex> _l(worker->lock);
+        worker->tasks.push_back(task);
+    }
+    mPendingTasks.fetch_add(1);
+}
+
+bool AmlMpExecutor::popTask(size_t index, Task& task)
+{
+    Worker* worker = mWorkers[index];
+    std::lock_guard<std::mutex> _l(worker->lock);
+    if (worker->tasks.empty()) {
+        return false;
+    }
+
+    task = std::move(worker->tasks.front());
+    worker->tasks.pop_front();
+    mPendingTasks.fetch_sub(1);
+    return true;
+}
+
+bool AmlMpExecutor::stealTask(size_t index, Task& task)
+{
+    size_t count = mWorkers.size();
+    for (size_t i = 1; i < count; ++i) {
+        Worker* victim = mWorkers[(index + i) % count];
+        std::unique_lock<std::mutex> _l(victim->lock, std::try_to_lock);
+        if (!_l.owns_lock() || victim->tasks.empty()) {
+            continue;
+        }
+
+        task = std::move(victim->tasks.back());
+        victim->tasks.pop_back();
+        mPendingTasks.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+int64_t AmlMpExecutor::scheduleDueTimers_l(int64_t now)
+{
+    int64_t nextUs = -1;
+    int count = 0;
+
+    while (!mTimers.empty()) {
+        auto it = mTimers.begin();
+        if (it->first > now) {
+            nextUs = it->first;
+            break;
+        }
+
+        Task task = std::move(it->second);
+        mTimers.erase(it);
+        pushTask(task);
+        count++;
+    }
+
+    if (count > 1) {
+        mCond.notify_all();
+    }
+
+    return nextUs;
+}
+
+void AmlMpExecutor::workerLoop(size_t index)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "amlmp-exec-%zu", index);
+    pthread_setname_np(pthread_self(), name);
+
+    sCurrentExecutor = this;
+    sCurrentWorker = index;
+
+    for (;;) {
+        Task task;
+        if (popTask(index, task) || stealTask(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> _l(mLock);
+        if (mExiting) {
+            break;
+        }
+
+        int64_t nextUs = scheduleDueTimers_l(nowUs());
+        if (mPendingTasks.load() > 0) {
+            continue;
+        }
+
+        if (nextUs < 0) {
+            mCond.wait(_l);
+        } else {
+            mCond.wait_for(_l, std::chrono::microseconds(nextUs - nowUs()));
+        }
+    }
+
+    sCurrentExecutor = nullptr;
+}
+
+sptr<Looper> AmlMpExecutor::pollLooper()
+{
+    std::call_once(mPollOnce, [this] {
+        mPollLooper = new Looper(Looper::PREPARE_ALLOW_NON_CALLBACKS);
+        mPollThread = std::thread([this] {
+            pollThreadLoop();
+        });
+    });
+
+    return mPollLooper;
+}
+
+void AmlMpExecutor::pollThreadLoop()
+{
+    pthread_setname_np(pthread_self(), "amlmp-poll");
+    Looper::setForThread(mPollLooper);
+
+    for (;;) {
+        int ret = mPollLooper->pollOnce(-1);
+        if (ret == Looper::POLL_ERROR) {
+            MLOGE("poll error!");
+            break;
+        }
+
+        std::lock_guard<std::mutex> _l(mLock);
+        if (mExiting) {
+            break;
+        }
+    }
+
+    MLOGI("poll thread exited!");
+}
+
+}
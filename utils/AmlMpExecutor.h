@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef AML_MP_EXECUTOR_H_
+#define AML_MP_EXECUTOR_H_
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include "AmlMpRefBase.h"
+#include "AmlMpLooper.h"
+
+namespace aml_mp {
+
+/*
+ * Process-wide worker pool shared by the demux, looper and source components.
+ *
+ * Tasks posted to the executor run on any worker; idle workers steal from the
+ * queues of busy ones. Components that need single-threaded semantics create
+ * a Strand: tasks posted to the same strand never run concurrently and run in
+ * posting order, while different strands share the same bounded set of threads.
+ *
+ * File descriptors can be watched through Strand::addFd(), the callback is
+ * invoked on the strand instead of on a per-component polling thread.
+ */
+class AmlMpExecutor
+{
+public:
+    typedef std::function<void()> Task;
+
+    class Strand : public AmlMpRefBase
+    {
+    public:
+        const char* name() const {
+            return mStrandName.c_str();
+        }
+
+        // delayUs > 0 defers the task, tasks with the same deadline keep posting order.
+        void post(const Task& task, int64_t delayUs = 0);
+
+        // Same contract as Looper::addFd(), return 1 on success.
+        // The callback returns 1 to keep watching the fd, or 0 to unregister it.
+        int addFd(int fd, int events, const sptr<LooperCallback>& callback, void* data);
+        int removeFd(int fd);
+
+        bool isCurrentThread() const;
+
+        // drop pending tasks and fd watches, then wait for the running task
+        // to finish unless called from the strand itself.
+        void shutdown();
+
+    protected:
+        virtual ~Strand();
+
+    private:
+        friend class AmlMpExecutor;
+        struct FdWatch;
+
+        Strand(AmlMpExecutor* executor, const char* name);
+        void schedule_l();
+        void drain();
+        void rearmFd(FdWatch* watch);
+        void forgetFd(int fd, const FdWatch* watch);
+
+        AmlMpExecutor* mExecutor;
+        std::string mStrandName;
+
+        mutable std::mutex mLock;
+        std::condition_variable mIdleCond;
+        std::deque<Task> mTasks;
+        bool mScheduled = false;
+        bool mShutdown = false;
+        std::thread::id mRunningThread;
+        std::map<int, sptr<FdWatch>> mFdWatches;
+
+        Strand(const Strand&) = delete;
+        Strand& operator= (const Strand&) = delete;
+    };
+
+    static AmlMpExecutor& instance();
+
+    void post(const Task& task, int64_t delayUs = 0);
+    sptr<Strand> createStrand(const char* name);
+
+    size_t workerCount() const {
+        return mWorkers.size();
+    }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    AmlMpExecutor();
+    ~AmlMpExecutor();
+
+    void pushTask(const Task& task);
+    bool popTask(size_t index, Task& task);
+    bool stealTask(size_t index, Task& task);
+    int64_t scheduleDueTimers_l(int64_t nowUs);
+    void workerLoop(size_t index);
+
+    sptr<Looper> pollLooper();
+    void pollThreadLoop();
+
+    std::vector<Worker*> mWorkers;
+    std::atomic<size_t> mNextWorker{0};
+    std::atomic<int> mPendingTasks{0};
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::multimap<int64_t, Task> mTimers;
+    bool mExiting = false;
+
+    std::once_flag mPollOnce;
+    sptr<Looper> mPollLooper;
+    std::thread mPollThread;
+
+    AmlMpExecutor(const AmlMpExecutor&) = delete;
+    AmlMpExecutor& operator= (const AmlMpExecutor&) = delete;
+};
+
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <mutex>
 #include <string.h>
+#include "AmlMpArena.h"
 
 namespace aml_mp {
 
@@ -31,21 +32,34 @@ static inline size_t roundUpPowerOfTwo(size_t size)
 class AmlMpFifo
 {
 public:
-    explicit AmlMpFifo(size_t size) {
-        mSize = roundUpPowerOfTwo(size);
-        mBuffer = (uint8_t*)calloc(mSize, 1);
-        ALOG(LOG_INFO, "AmlMpFifo", "Fifo_Size:%#x", mSize);
+    explicit AmlMpFifo(size_t size, int arenaOwner = AmlMpArena::kSharedOwner) {
+        size_t fifoSize = roundUpPowerOfTwo(size);
+        mBuffer = (uint8_t*)AmlMpArena::instance().alloc(fifoSize, arenaOwner);
+        if (mBuffer == nullptr) {
+            // mSize stays 0, get() and put() move nothing and skip the index masks.
+            ALOG(LOG_ERROR, "AmlMpFifo", "alloc fifo failed, size:%#zx", fifoSize);
+            return;
+        }
+        mSize = fifoSize;
+        ALOG(LOG_INFO, "AmlMpFifo", "Fifo_Size:%#zx", mSize);
+    }
+
+    int initCheck() const {
+        return mBuffer != nullptr ? 0 : -1;
     }
 
     ~AmlMpFifo() {
         if (mBuffer) {
-            free(mBuffer);
+            AmlMpArena::instance().free(mBuffer);
             mBuffer = nullptr;
         }
     }
 
     size_t get(void* buffer, size_t size) {
         std::unique_lock<std::mutex> _l(mLock);
+        if (mBuffer == nullptr) {
+            return 0;
+        }
 
         size_t len = std::min(size, in - out);
         size_t l = std::min(len, mSize - (out & mSize-1));
@@ -58,6 +72,9 @@ public:
 
     size_t put(const void* buffer, size_t size) {
         std::unique_lock<std::mutex> _l(mLock);
+        if (mBuffer == nullptr) {
+            return 0;
+        }
 
         size_t len = std::min(size, mSize - in + out);
         size_t l = std::min(len, mSize - (in & mSize-1));
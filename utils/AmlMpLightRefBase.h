@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef AML_MP_LIGHT_REF_BASE_H_
+#define AML_MP_LIGHT_REF_BASE_H_
+
+#include <atomic>
+#include <stdint.h>
+#include "AmlMpStrongPointer.h"
+
+namespace aml_mp {
+
+/*
+ * Intrusive strong-only reference count, usable with sptr<T>.
+ *
+ * Unlike AmlMpRefBase there is no separately allocated weakref_impl, so an
+ * object costs a single allocation and sptr copies are one atomic add.
+ * Use it for data plane objects (buffers, section payloads) that are never
+ * referenced through wptr.
+ *
+ * T must be the most derived class or have a virtual destructor, and must
+ * grant AmlMpLightRefBase<T> access to it when the destructor is not public.
+ */
+template <class T>
+class AmlMpLightRefBase
+{
+public:
+    inline AmlMpLightRefBase() : mCount(0) { }
+
+    inline void incStrong(__attribute__((unused)) const void* id) const {
+        mCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void decStrong(__attribute__((unused)) const void* id) const {
+        if (mCount.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            delete static_cast<const T*>(this);
+        }
+    }
+
+    inline int32_t getStrongCount() const {
+        return mCount.load(std::memory_order_relaxed);
+    }
+
+protected:
+    inline ~AmlMpLightRefBase() { }
+
+private:
+    mutable std::atomic<int32_t> mCount;
+
+    AmlMpLightRefBase(const AmlMpLightRefBase&) = delete;
+    AmlMpLightRefBase& operator= (const AmlMpLightRefBase&) = delete;
+};
+
+}
+
+#endif
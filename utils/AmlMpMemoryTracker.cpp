@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#define LOG_TAG "AmlMpMemoryTracker"
+#include "AmlMpLog.h"
+#include "AmlMpMemoryTracker.h"
+#include "AmlMpConfig.h"
+#include <string.h>
+#include <algorithm>
+
+static const char* mName = LOG_TAG;
+
+namespace aml_mp {
+
+AmlMpMemoryTracker& AmlMpMemoryTracker::instance()
+{
+    static AmlMpMemoryTracker* tracker = new AmlMpMemoryTracker();
+    return *tracker;
+}
+
+AmlMpMemoryTracker::AmlMpMemoryTracker()
+: mBudget((size_t)AmlMpConfig::instance().mMemoryBudget * 1024 * 1024)
+{
+    MLOGI("memory budget:%zu", mBudget);
+}
+
+void AmlMpMemoryTracker::Counters::add(Aml_MP_MemoryComponent component, size_t bytes)
+{
+    components[component].fetch_add(bytes, std::memory_order_relaxed);
+    size_t now = total.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    size_t old = peak.load(std::memory_order_relaxed);
+    while (now > old && !peak.compare_exchange_weak(old, now, std::memory_order_relaxed)) {
+    }
+}
+
+void AmlMpMemoryTracker::Counters::sub(Aml_MP_MemoryComponent component, size_t bytes)
+{
+    components[component].fetch_sub(bytes, std::memory_order_relaxed);
+    total.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+AmlMpMemoryTracker::Counters& AmlMpMemoryTracker::slot(int instanceId)
+{
+    if (instanceId < 0 || instanceId >= kInstanceSlots - 1) {
+        return mInstances[0];
+    }
+
+    return mInstances[instanceId + 1];
+}
+
+const AmlMpMemoryTracker::Counters& AmlMpMemoryTracker::slot(int instanceId) const
+{
+    return const_cast<AmlMpMemoryTracker*>(this)->slot(instanceId);
+}
+
+bool AmlMpMemoryTracker::tryCharge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes)
+{
+    if (component < 0 || component >= AML_MP_MEMORY_COMPONENT_MAX) {
+        return false;
+    }
+
+    if (mBudget != 0) {
+        size_t total = mTotal.total.load(std::memory_order_relaxed);
+        do {
+            if (total + bytes > mBudget) {
+                MLOGW("over memory budget, component:%d, instance:%d, used:%zu, request:%zu, budget:%zu",
+                        component, instanceId, total, bytes, mBudget);
+                return false;
+            }
+        } while (!mTotal.total.compare_exchange_weak(total, total + bytes, std::memory_order_relaxed));
+
+        // total is already reserved.
+        mTotal.components[component].fetch_add(bytes, std::memory_order_relaxed);
+        size_t now = total + bytes;
+        size_t old = mTotal.peak.load(std::memory_order_relaxed);
+        while (now > old && !mTotal.peak.compare_exchange_weak(old, now, std::memory_order_relaxed)) {
+        }
+    } else {
+        mTotal.add(component, bytes);
+    }
+
+    slot(instanceId).add(component, bytes);
+    return true;
+}
+
+void AmlMpMemoryTracker::charge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes)
+{
+    if (component < 0 || component >= AML_MP_MEMORY_COMPONENT_MAX) {
+        return;
+    }
+
+    mTotal.add(component, bytes);
+    slot(instanceId).add(component, bytes);
+}
+
+void AmlMpMemoryTracker::uncharge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes)
+{
+    if (component < 0 || component >= AML_MP_MEMORY_COMPONENT_MAX) {
+        return;
+    }
+
+    mTotal.sub(component, bytes);
+    slot(instanceId).sub(component, bytes);
+}
+
+size_t AmlMpMemoryTracker::adviseSize(size_t wanted, size_t minimum, bool secondary) const
+{
+    if (mBudget == 0) {
+        return wanted;
+    }
+
+    size_t used = mTotal.total.load(std::memory_order_relaxed);
+    size_t available = used < mBudget ? mBudget - used : 0;
+    if (secondary) {
+        available /= 2;
+    }
+
+    size_t size = std::max(minimum, std::min(wanted, available));
+    if (size < wanted) {
+        MLOGI("shrink buffer from %zu to %zu, used:%zu, budget:%zu", wanted, size, used, mBudget);
+    }
+
+    return size;
+}
+
+void AmlMpMemoryTracker::getUsage(int instanceId, Aml_MP_MemoryUsage* usage) const
+{
+    const Counters& c = instanceId == kNoInstance ? mTotal : slot(instanceId);
+
+    memset(usage, 0, sizeof(*usage));
+    for (int i = 0; i < AML_MP_MEMORY_COMPONENT_MAX; ++i) {
+        usage->components[i] = c.components[i].load(std::memory_order_relaxed);
+    }
+    usage->total = c.total.load(std::memory_order_relaxed);
+    usage->peak = c.peak.load(std::memory_order_relaxed);
+    usage->budget = mBudget;
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021 Amlogic, Inc. All rights reserved.
+ *
+ * This source code is subject to the terms and conditions defined in the
+ * file 'LICENSE' which is part of this source code package.
+ *
+ * Description:
+ */
+
+#ifndef AML_MP_MEMORY_TRACKER_H_
+#define AML_MP_MEMORY_TRACKER_H_
+
+#include <Aml_MP/Common.h>
+#include <atomic>
+#include "AmlMpPlayerRoster.h"
+
+namespace aml_mp {
+
+/*
+ * Accounts the memory held by each component, per player instance.
+ *
+ * Only the TS buffers are tied to a player. Demux sections, looper queues, CAS
+ * secure memory and DVR buffers are shared or not owned by a player and are
+ * accounted to kNoInstance, so they only show up in the process usage.
+ * AmlMpConfig::mMemoryBudget sets a process-wide budget: tryCharge() refuses
+ * allocations beyond it, and adviseSize() lets buffers pick a smaller size up
+ * front instead of failing later.
+ */
+class AmlMpMemoryTracker
+{
+public:
+    static constexpr int kNoInstance = -1;
+
+    static AmlMpMemoryTracker& instance();
+
+    bool tryCharge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes);
+    // charge memory that can't be refused, it may exceed the budget.
+    void charge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes);
+    void uncharge(Aml_MP_MemoryComponent component, int instanceId, size_t bytes);
+
+    // budget in bytes, 0 means unlimited.
+    size_t budget() const {
+        return mBudget;
+    }
+
+    // size for a buffer that wants wanted bytes and can't work below minimum.
+    // A secondary (PiP, background) instance only gets half of what is left.
+    size_t adviseSize(size_t wanted, size_t minimum, bool secondary) const;
+
+    // kNoInstance reports the whole process.
+    void getUsage(int instanceId, Aml_MP_MemoryUsage* usage) const;
+
+private:
+    static constexpr int kInstanceSlots = AmlMpPlayerRoster::kPlayerInstanceMax + 1;
+
+    struct Counters {
+        std::atomic<size_t> components[AML_MP_MEMORY_COMPONENT_MAX];
+        std::atomic<size_t> total{0};
+        std::atomic<size_t> peak{0};
+
+        Counters() {
+            for (auto& c : components) {
+                c.store(0, std::memory_order_relaxed);
+            }
+        }
+        void add(Aml_MP_MemoryComponent component, size_t bytes);
+        void sub(Aml_MP_MemoryComponent component, size_t bytes);
+    };
+
+    AmlMpMemoryTracker();
+    ~AmlMpMemoryTracker() = default;
+
+    Counters& slot(int instanceId);
+    const Counters& slot(int instanceId) const;
+
+    const size_t mBudget;
+    Counters mInstances[kInstanceSlots];
+    Counters mTotal;
+
+    AmlMpMemoryTracker(const AmlMpMemoryTracker&) = delete;
+    AmlMpMemoryTracker& operator= (const AmlMpMemoryTracker&) = delete;
+};
+
+}
+
+#endif
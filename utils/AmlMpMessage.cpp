@@ -30,6 +30,7 @@
 #include "AmlMpBuffer.h"
 #include "AmlMpEventLooperRoster.h"
 #include "AmlMpEventHandler.h"
+#include "AmlMpMemoryTracker.h"
 #include <string>
 #include "AmlMpUtils.h"
 
@@ -70,6 +71,7 @@ AmlMpMessage::AmlMpMessage(uint32_t what, const sptr<const AmlMpEventHandler> &h
 }
 
 AmlMpMessage::~AmlMpMessage() {
+    unmarkQueued();
     clear();
 }
 
@@ -113,7 +115,6 @@ void AmlMpMessage::freeItemValue(Item *item) {
 
         case kTypeObject:
         case kTypeMessage:
-        case kTypeBuffer:
         {
             if (item->u.refValue != NULL) {
                 item->u.refValue->decStrong(this);
@@ -121,6 +122,14 @@ void AmlMpMessage::freeItemValue(Item *item) {
             break;
         }
 
+        case kTypeBuffer:
+        {
+            if (item->u.bufferValue != NULL) {
+                item->u.bufferValue->decStrong(this);
+            }
+            break;
+        }
+
         default:
             break;
     }
@@ -326,7 +335,11 @@ void AmlMpMessage::setObject(const char *name, const sptr<AmlMpRefBase> &obj) {
 }
 
 void AmlMpMessage::setBuffer(const char *name, const sptr<AmlMpBuffer> &buffer) {
-    setObjectInternal(name, sptr<AmlMpRefBase>(buffer), kTypeBuffer);
+    Item *item = allocateItem(name);
+    item->mType = kTypeBuffer;
+
+    if (buffer != NULL) { buffer->incStrong(this); }
+    item->u.bufferValue = buffer.get();
 }
 
 void AmlMpMessage::setMessage(const char *name, const sptr<AmlMpMessage> &obj) {
@@ -370,7 +383,7 @@ bool AmlMpMessage::findObject(const char *name, sptr<AmlMpRefBase> *obj) const {
 bool AmlMpMessage::findBuffer(const char *name, sptr<AmlMpBuffer> *buf) const {
     const Item *item = findItem(name, kTypeBuffer);
     if (item) {
-        *buf = (AmlMpBuffer *)(item->u.refValue);
+        *buf = item->u.bufferValue;
         return true;
     }
     return false;
@@ -401,7 +414,37 @@ bool AmlMpMessage::findRect(
     return true;
 }
 
+size_t AmlMpMessage::footprint() const {
+    size_t bytes = sizeof(*this);
+
+    for (size_t i = 0; i < mNumItems; ++i) {
+        const Item *item = &mItems[i];
+        if (item->mType == kTypeBuffer && item->u.bufferValue != NULL) {
+            bytes += item->u.bufferValue->capacity();
+        } else if (item->mType == kTypeString && item->u.stringValue != NULL) {
+            bytes += item->u.stringValue->capacity();
+        }
+    }
+
+    return bytes;
+}
+
+void AmlMpMessage::markQueued() {
+    size_t bytes = footprint();
+    mQueuedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    AmlMpMemoryTracker::instance().charge(AML_MP_MEMORY_LOOPER, AmlMpMemoryTracker::kNoInstance, bytes);
+}
+
+void AmlMpMessage::unmarkQueued() {
+    size_t bytes = mQueuedBytes.exchange(0, std::memory_order_relaxed);
+    if (bytes != 0) {
+        AmlMpMemoryTracker::instance().uncharge(AML_MP_MEMORY_LOOPER, AmlMpMemoryTracker::kNoInstance, bytes);
+    }
+}
+
 void AmlMpMessage::deliver() {
+    unmarkQueued();
+
     sptr<AmlMpEventHandler> handler = mHandler.promote();
     if (handler == NULL) {
         MLOGW("failed to deliver message as target handler %d is gone.", mTarget);
@@ -498,13 +541,21 @@ sptr<AmlMpMessage> AmlMpMessage::dup() const {
             }
 
             case kTypeObject:
-            case kTypeBuffer:
             {
                 to->u.refValue = from->u.refValue;
                 to->u.refValue->incStrong(msg.get());
                 break;
             }
 
+            case kTypeBuffer:
+            {
+                to->u.bufferValue = from->u.bufferValue;
+                if (to->u.bufferValue != NULL) {
+                    to->u.bufferValue->incStrong(msg.get());
+                }
+                break;
+            }
+
             case kTypeMessage:
             {
                 sptr<AmlMpMessage> copy =
@@ -605,7 +656,7 @@ std::string AmlMpMessage::debugString(int32_t indent) const {
                 break;
             case kTypeBuffer:
             {
-                sptr<AmlMpBuffer> buffer = static_cast<AmlMpBuffer *>(item.u.refValue);
+                sptr<AmlMpBuffer> buffer = item.u.bufferValue;
 
                 if (buffer != NULL && buffer->data() != NULL && buffer->size() <= 64) {
                     tmp = AStringPrintf("Buffer %s = {\n", item.mName);
@@ -890,14 +941,14 @@ sptr<AmlMpMessage> AmlMpMessage::changesFrom(const sptr<const AmlMpMessage> &oth
 
             case kTypeBuffer:
             {
-                sptr<AmlMpBuffer> myBuf = static_cast<AmlMpBuffer *>(item.u.refValue);
+                sptr<AmlMpBuffer> myBuf = item.u.bufferValue;
                 if (myBuf == NULL) {
-                    if (oitem == NULL || oitem->u.refValue != NULL) {
+                    if (oitem == NULL || oitem->u.bufferValue != NULL) {
                         diff->setBuffer(item.mName, NULL);
                     }
                     break;
                 }
-                sptr<AmlMpBuffer> oBuf = oitem == NULL ? NULL : static_cast<AmlMpBuffer *>(oitem->u.refValue);
+                sptr<AmlMpBuffer> oBuf = oitem == NULL ? NULL : oitem->u.bufferValue;
                 if (oBuf == NULL
                         || myBuf->size() != oBuf->size()
                         || (!myBuf->data() ^ !oBuf->data()) // data nullness differs
@@ -982,7 +1033,7 @@ AmlMpMessage::ItemData AmlMpMessage::getEntryAt(size_t index) const {
                 break;
             }
             case kTypeBuffer: {
-                sptr<AmlMpBuffer> buf = static_cast<AmlMpBuffer *>(mItems[index].u.refValue);
+                sptr<AmlMpBuffer> buf = mItems[index].u.bufferValue;
                 it.set(buf);
                 break;
             }
@@ -1056,7 +1107,7 @@ int AmlMpMessage::setEntryAt(size_t index, const ItemData &item) {
         dst->mType = kTypeMessage;
     } else if (item.find(&bufValue)) {
         if (bufValue != NULL) { bufValue->incStrong(this); }
-        dst->u.refValue = bufValue.get();
+        dst->u.bufferValue = bufValue.get();
         dst->mType = kTypeBuffer;
     } else {
         // unsupported item - we should not be here.
@@ -21,6 +21,7 @@
 #include "AmlMpEventLooper.h"
 #include "AmlMpRefBase.h"
 #include <vector>
+#include <atomic>
 
 namespace aml_mp {
 
@@ -278,6 +279,7 @@ private:
             double doubleValue;
             void *ptrValue;
             AmlMpRefBase *refValue;
+            AmlMpBuffer *bufferValue;
             std::string *stringValue;
             Rect rectValue;
         } u;
@@ -304,6 +306,12 @@ private:
 
     void deliver();
 
+    // memory held while queued on a looper: the message itself and its buffers.
+    size_t footprint() const;
+    void markQueued();
+    void unmarkQueued();
+    std::atomic<size_t> mQueuedBytes{0};
+
     AmlMpMessage(const AmlMpMessage&) = delete;
     AmlMpMessage& operator= (const AmlMpMessage&) = delete;
 };
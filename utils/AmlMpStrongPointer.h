@@ -74,7 +74,7 @@ public:
     sptr(sptr<T>&& other) noexcept;
     template<typename U> sptr(U* other);  // NOLINT(implicit)
     template<typename U> sptr(const sptr<U>& other);  // NOLINT(implicit)
-    template<typename U> sptr(sptr<U>&& other);  // NOLINT(implicit)
+    template<typename U> sptr(sptr<U>&& other) noexcept;  // NOLINT(implicit)
 
     ~sptr();
 
@@ -85,7 +85,7 @@ public:
     sptr& operator=(sptr<T>&& other) noexcept;
 
     template<typename U> sptr& operator = (const sptr<U>& other);
-    template<typename U> sptr& operator = (sptr<U>&& other);
+    template<typename U> sptr& operator = (sptr<U>&& other) noexcept;
     template<typename U> sptr& operator = (U* other);
 
     //! sptrecial optimization for use by ProcessState (and nobody else).
@@ -171,7 +171,7 @@ sptr<T>::sptr(const sptr<U>& other)
 }
 
 template<typename T> template<typename U>
-sptr<T>::sptr(sptr<U>&& other)
+sptr<T>::sptr(sptr<U>&& other) noexcept
         : m_ptr(other.m_ptr) {
     other.m_ptr = nullptr;
 }
@@ -196,6 +196,8 @@ sptr<T>& sptr<T>::operator =(const sptr<T>& other) {
 
 template <typename T>
 sptr<T>& sptr<T>::operator=(sptr<T>&& other) noexcept {
+    // moving into itself must keep the reference.
+    if (this == &other) return *this;
     T* oldPtr(*const_cast<T* volatile*>(&m_ptr));
     if (oldPtr) oldPtr->decStrong(this);
     if (oldPtr != *const_cast<T* volatile*>(&m_ptr)) sptr_report_race();
@@ -226,9 +228,9 @@ sptr<T>& sptr<T>::operator =(const sptr<U>& other) {
 }
 
 template<typename T> template<typename U>
-sptr<T>& sptr<T>::operator =(sptr<U>&& other) {
+sptr<T>& sptr<T>::operator =(sptr<U>&& other) noexcept {
     T* oldPtr(*const_cast<T* volatile*>(&m_ptr));
-    if (m_ptr) m_ptr->decStrong(this);
+    if (oldPtr) oldPtr->decStrong(this);
     if (oldPtr != *const_cast<T* volatile*>(&m_ptr)) sptr_report_race();
     m_ptr = other.m_ptr;
     other.m_ptr = nullptr;
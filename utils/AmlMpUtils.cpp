@@ -271,6 +271,7 @@ const char* mpCASServiceType2Str(Aml_MP_CASServiceType serviceType)
     case AML_MP_CAS_SERVICE_VERIMATRIX_IPTV: return "verimatrix IPTV";
     case AML_MP_CAS_SERVICE_VERIMATRIX_WEB: return "verimatrix WEB";
     case AML_MP_CAS_SERVICE_WIDEVINE: return "widevine";
+    case AML_MP_CAS_SERVICE_SOFT: return "software";
     }
 
     return TO_STR(AML_MP_CAS_SERVICE_TYPE_INVALID);